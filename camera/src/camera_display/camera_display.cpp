@@ -164,7 +164,7 @@ namespace camera_display
             ImGui::Text("%u", camera.frame_height);
 
             ImGui::TableSetColumnIndex((int)columns::fps);
-            ImGui::Text("%u", camera.fps);
+            ImGui::Text("%u", camera.fps.load());
 
             ImGui::TableSetColumnIndex((int)columns::format);
             ImGui::Text("%s", camera.format.begin);
@@ -210,7 +210,7 @@ namespace camera_display
         };
 
         if (!ImGui::BeginTable("CameraPropertiesTable", (int)columns::count, table_flags, table_dims)) 
-        { 
+        {
             return; 
         }
 
@@ -233,6 +233,13 @@ namespace camera_display
 {
     static void init_cameras(CameraState& state)
     {
+        auto n_threads = std::thread::hardware_concurrency();
+
+        convert::create_thread_pool(n_threads, false);
+
+        // MJPG cameras
+        cam::create_decode_pool(num::max(n_threads / 2, 1u));
+
         state.cameras = camera_usb::enumerate_cameras();
 
         for (u32 i = 0; i < state.cameras.count; i++)
@@ -240,12 +247,63 @@ namespace camera_display
             auto& camera = state.cameras.list[i];
             open_camera(camera);
         }
+
+        state.cameras_ready = true;
+    }
+
+
+    class TileGrid
+    {
+    public:
+        u32 columns = 1;
+        u32 rows = 1;
+
+        u32 tile_width = DISPLAY_WIDTH;
+        u32 tile_height = DISPLAY_HEIGHT;
+    };
+
+
+    // as square as the camera count allows, 16 cameras are 4 x 4
+    static TileGrid tile_grid(u32 n_cameras)
+    {
+        TileGrid grid{};
+
+        while (grid.columns * grid.columns < n_cameras)
+        {
+            grid.columns++;
+        }
+
+        grid.rows = num::max((n_cameras + grid.columns - 1) / grid.columns, 1u);
+
+        grid.tile_width = DISPLAY_WIDTH / grid.columns;
+        grid.tile_height = DISPLAY_HEIGHT / grid.rows;
+
+        return grid;
+    }
+
+
+    static u32 camera_slot(CameraState const& state, cam::Camera const& camera)
+    {
+        return (u32)(&camera - state.cameras.list);
     }
 
 
-    static void grab_image(CameraState& state, cam::Camera& camera)
+    // one tile per camera slot, larger modes are scaled down keeping the aspect ratio
+    static img::SubView camera_tile(CameraState const& state, cam::Camera const& camera)
     {
-        cam::grab_image(camera, state.display);
+        auto grid = tile_grid(state.cameras.count);
+        auto slot = camera_slot(state, camera);
+
+        auto x = (slot % grid.columns) * grid.tile_width;
+        auto y = (slot / grid.columns) * grid.tile_height;
+
+        auto scale = num::min((f32)grid.tile_width / camera.frame_width, (f32)grid.tile_height / camera.frame_height);
+        scale = num::min(scale, 1.0f);
+
+        auto w = num::max(num::min((u32)(camera.frame_width * scale), grid.tile_width), 1u);
+        auto h = num::max(num::min((u32)(camera.frame_height * scale), grid.tile_height), 1u);
+
+        return img::sub_view(state.display, img::make_rect(x, y, w, h));
     }
 
 
@@ -273,68 +331,81 @@ namespace camera_display
     }
 
 
-    static void stream_camera(CameraState& state, cam::Camera& camera)
+    static void start_stream(CameraState& state, cam::Camera& camera)
     {
-        auto const is_on = [&](){ return state.is_streaming; };
+        // histogram follows the last camera started
+        state.histogram_id = camera.id;
+
+        // frames are decoded into the display on the ui thread, see update_display
+        cam::start_stream_ring(camera, 3, cam::OverflowPolicy::DropOldest, cam::DecodeOrder::LatestOnly);
+    }
 
-        state.is_streaming = true;
 
-        for (u32 i = 0; i < state.cameras.count; i++)
-        {
-            auto& c = state.cameras.list[i];
-            c.busy = 1;
-        }
+    static void stop_stream_async(CameraState& state, cam::Camera& camera)
+    {
+        state.grab_pending[camera_slot(state, camera)] = 0;
+
+        // waits for the camera's last frame, update_cameras skips until it is done
+        state.n_stopping++;
 
-        auto const proc = [&](img::View3u8 const& yuv)
+        std::thread th([&]()
         {
-            convert::yuv_to_rgba(yuv, state.display);
-            update_histogram(yuv, state);
-        };
-        
-        cam::stream_planar_yuv(camera, proc, is_on);
+            cam::stop_stream(camera);
+            state.n_stopping--;
+        });
+
+        th.detach();
     }
 
 
-    static void grab_image_async(CameraState& state, cam::Camera& camera)
+    static void read_stream(CameraState& state, cam::Camera& camera)
     {
-        if (camera.busy)
+        cam::FrameYUV frame{};
+
+        if (!cam::read_latest_frame(camera, frame))
         {
             return;
         }
 
-        std::thread th([&](){ grab_image(state, camera); });
+        auto tile = camera_tile(state, camera);
+        convert::yuv_to_rgba(frame.view, tile, convert::Resample::Area, cam::get_color_table(camera));
 
-        th.detach();
+        if (state.histogram_id == camera.id)
+        {
+            update_histogram(frame.view, state);
+        }
+
+        cam::release_frame(camera);
+
+        if (state.grab_pending[camera_slot(state, camera)])
+        {
+            stop_stream_async(state, camera);
+        }
     }
 
 
-    static void stream_camera_async(CameraState& state, cam::Camera& camera)
+    // streams until read_stream has the first frame, the display is only written on the ui thread
+    static void grab_image_async(CameraState& state, cam::Camera& camera)
     {
-        if (camera.busy)
+        auto& pending = state.grab_pending[camera_slot(state, camera)];
+
+        // fails while the camera is already streaming
+        if (!pending && cam::start_stream_ring(camera, 1, cam::OverflowPolicy::DropOldest))
         {
-            return;
+            pending = 1;
         }
+    }
 
-        std::thread th([&](){ stream_camera(state, camera); });
 
-        th.detach();
-    }
-    
-    
     static void toggle_stream_async(CameraState& state, cam::Camera& camera)
     {
-        if (state.is_streaming)
+        if (camera.status == cam::CameraStatus::Streaming)
         {
-            state.is_streaming = false;
-            for (u32 i = 0; i < state.cameras.count; i++)
-            {
-                auto& c = state.cameras.list[i];
-                c.busy = 0;
-            }
+            stop_stream_async(state, camera);
         }
-        else
+        else if (!camera.busy)
         {
-            stream_camera_async(state, camera);
+            start_stream(state, camera);
         }
     }
 
@@ -366,7 +437,14 @@ namespace camera_display
 
     void close_async(CameraState& state)
     {
-        std::thread th([&](){ camera_usb::close(state.cameras); });
+        state.cameras_ready = false;
+
+        std::thread th([&]()
+        {
+            camera_usb::close(state.cameras);
+            camera_usb::destroy_decode_pool();
+            convert::destroy_thread_pool();
+        });
 
         th.detach();
     }
@@ -390,4 +468,52 @@ namespace camera_display
         plot_histogram(state);
         
     }
+
+
+    void update_cameras(CameraState& state)
+    {
+        // a removed device would be released while another thread is using it
+        if (!state.cameras_ready || state.n_stopping)
+        {
+            return;
+        }
+
+        auto n_cameras = state.cameras.count;
+
+        if (!cam::update_cameras(state.cameras))
+        {
+            return;
+        }
+
+        // new slots change the grid
+        if (state.cameras.count != n_cameras)
+        {
+            img::fill(state.display, img::to_pixel(128));
+        }
+
+        // cameras that came back are restored by update_cameras, retried until they reopen
+        for (u32 i = 0; i < state.cameras.count; i++)
+        {
+            auto& camera = state.cameras.list[i];
+            if (cam::is_new_camera(camera))
+            {
+                cam::open_camera(camera);
+            }
+        }
+    }
+
+
+    void update_display(CameraState& state)
+    {
+        // the list and rings are being built or torn down on another thread
+        if (!state.cameras_ready)
+        {
+            return;
+        }
+
+        for (u32 i = 0; i < state.cameras.count; i++)
+        {
+            read_stream(state, state.cameras.list[i]);
+        }
+    }
 }
\ No newline at end of file
@@ -2,6 +2,8 @@
 
 #include "../../../libs/usb/camera_usb.hpp"
 
+#include <atomic>
+
 
 namespace cam = camera_usb;
 namespace img = image;
@@ -9,6 +11,11 @@ namespace img = image;
 
 namespace camera_display
 {
+    // cameras share the display, one tile each, see tile_grid
+    constexpr u32 DISPLAY_WIDTH = 1280;
+    constexpr u32 DISPLAY_HEIGHT = 960;
+
+
     class CameraState
     {
     public:
@@ -18,7 +25,16 @@ namespace camera_display
 
         cam::CameraList cameras; 
 
-        bool is_streaming = false;
+        // set when init_async has opened the cameras
+        std::atomic<bool> cameras_ready = false;
+
+        // stop_stream calls still joining their stream threads, see toggle_stream_async
+        std::atomic<u32> n_stopping = 0;
+
+        int histogram_id = -1;
+
+        // one shot grabs still waiting for their frame, by camera slot, see grab_image_async
+        b8 grab_pending[sizeof(cam::CameraList::list) / sizeof(cam::Camera)] = { 0 };
 
 
         static constexpr auto hist_count = sizeof(histogram) / sizeof(histogram[0]);
@@ -30,4 +46,10 @@ namespace camera_display
     void close_async(CameraState& state);
 
     void show_cameras(CameraState& state);
+
+    // cameras that leave are closed, returning ones restart and new ones are opened
+    void update_cameras(CameraState& state);
+
+    // call before the display is uploaded
+    void update_display(CameraState& state);
 }
\ No newline at end of file
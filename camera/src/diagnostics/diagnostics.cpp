@@ -1,32 +1,15 @@
 #pragma once
 
+#include "diagnostics.hpp"
 #include "../../../libs/imgui/imgui.h"
 
 //#define ALLOC_COUNT
 
-#ifndef ALLOC_COUNT
-
-namespace diagnostics
-{
-    void show_diagnostics(){}
-}
 
-#else
-
-
-/* memory */
+/* format */
 
 namespace diagnostics
 {
-    constexpr auto WHITE = ImVec4(1.0f, 1.0f, 1.0f, 1.0f);
-
-
-    constexpr auto gray(f32 value)
-    {
-        return ImVec4(value, value, value, 1.0f);
-    }
-
-
     class ValueSuffix
     {
     public:
@@ -74,6 +57,33 @@ namespace diagnostics
 
         ImGui::Text("%s", text);
     }
+}
+
+
+#ifndef ALLOC_COUNT
+
+namespace diagnostics
+{
+    static void show_memory(){}
+
+    static void show_uvc_memory(){}
+}
+
+#else
+
+
+/* memory */
+
+namespace diagnostics
+{
+    constexpr auto WHITE = ImVec4(1.0f, 1.0f, 1.0f, 1.0f);
+
+
+    constexpr auto gray(f32 value)
+    {
+        return ImVec4(value, value, value, 1.0f);
+    }
+
 
 
     static void current_alloc_table()
@@ -348,17 +358,81 @@ namespace diagnostics
         current_alloc_table();
         alloc_history_table();
     }
+}
+
+#endif
+
+
+/* cameras */
+
+namespace diagnostics
+{
+    static void camera_stats(camera_usb::Camera const& camera)
+    {
+        auto stats = camera_usb::get_stats(camera);
+
+        auto usb = bytes_suffix(stats.usb_bytes_per_sec);
+
+        ImGui::Text("fps: %5.1f   sensor: %5.1f", stats.fps, stats.sensor_fps);
+        ImGui::Text("USB: %5.1f %cB/s", usb.value, usb.suffix);
+        ImGui::Text("latency: %5.1f ms   max: %5.1f ms", stats.latency_ms, stats.latency_max_ms);
+        ImGui::Text("dropped: %llu transfer   %llu consumer", (unsigned long long)stats.dropped_transfer, (unsigned long long)stats.dropped_consumer);
+        ImGui::Text("convert: %5.2f ms", stats.convert_ms);
+
+        constexpr auto N = camera_usb::CONVERT_HIST_BINS;
+
+        f32 hist[N] = { 0 };
+        for (u32 i = 0; i < N; i++)
+        {
+            hist[i] = (f32)stats.convert_hist[i];
+        }
+
+        // bins of CONVERT_HIST_BIN_MS
+        ImGui::PlotHistogram("convert ms", hist, (int)N, 0, NULL, 0.0f, FLT_MAX, ImVec2(0, 40.0f));
+    }
+
+
+    static void show_cameras(camera_usb::CameraList const& cameras)
+    {
+        if (!ImGui::CollapsingHeader("Cameras"))
+        {
+            return;
+        }
+
+        for (u32 i = 0; i < cameras.count; i++)
+        {
+            auto& camera = cameras.list[i];
+            if (!camera.is_open())
+            {
+                continue;
+            }
+
+            ImGui::PushID((int)i);
+
+            if (ImGui::TreeNode("camera", "%s", camera.label.begin))
+            {
+                camera_stats(camera);
+                ImGui::TreePop();
+            }
+
+            ImGui::PopID();
+        }
+    }
+}
 
 
-    void show_diagnostics()
+/* api */
+
+namespace diagnostics
+{
+    void show_diagnostics(camera_usb::CameraList const& cameras)
     {
         ImGui::Begin("Diagnostics");
 
+        show_cameras(cameras);
         show_memory();
         show_uvc_memory();
 
         ImGui::End();
     }
-}
-
-#endif
\ No newline at end of file
+}
\ No newline at end of file
@@ -1,7 +1,9 @@
 #pragma once
 
+#include "../../../libs/usb/camera_usb.hpp"
+
 
 namespace diagnostics
 {
-    void show_diagnostics();
+    void show_diagnostics(camera_usb::CameraList const& cameras);
 }
\ No newline at end of file
@@ -140,8 +140,8 @@ static bool init_input_display()
 static void init_camera_display()
 {
     // TODO init camera app
-    u32 w = 640;
-    u32 h = 480;
+    u32 w = cdsp::DISPLAY_WIDTH;
+    u32 h = cdsp::DISPLAY_HEIGHT;
     camera_buffer = img::create_buffer32(w * h, "camera display");
     camera_state.display = img::make_view(w, h, camera_buffer);
     img::fill(camera_state.display, img::to_pixel(128));
@@ -306,10 +306,10 @@ static void render_imgui_frame()
 
 #ifndef NDEBUG
     texture_window("Input", textures.get_imgui_texture(input_texture_id), io_state.display.width, io_state.display.height, 2.0f);
-    diagnostics::show_diagnostics();
+    diagnostics::show_diagnostics(camera_state.cameras);
 #endif
     
-    texture_window("Camera", textures.get_imgui_texture(camera_texture_id), camera_state.display.width, camera_state.display.height, 1.0f);
+    texture_window("Camera", textures.get_imgui_texture(camera_texture_id), camera_state.display.width, camera_state.display.height, 0.5f);
     ui_camera_controls_window(camera_state);
 
     ImGui::Render();
@@ -433,6 +433,8 @@ static void main_loop()
         idsp::update(input, io_state);
         dx11::render_texture(textures.get(input_texture_id), dx_ctx);
 #endif 
+        cdsp::update_cameras(camera_state);
+        cdsp::update_display(camera_state);
         dx11::render_texture(textures.get(camera_texture_id), dx_ctx);
 
         render_imgui_frame(); 
@@ -0,0 +1,419 @@
+#include "../../../libs/image/convert.hpp"
+#include "../tool.hpp"
+
+#include <vector>
+#include <string>
+#include <cstdio>
+#include <functional>
+#include <thread>
+
+namespace img = image;
+namespace cvt = convert;
+
+using PF = cvt::PixelFormat;
+
+
+/* options */
+
+namespace
+{
+    enum class OutputType : u32
+    {
+        CSV = 0,
+        JSON
+    };
+
+
+    class BenchOptions
+    {
+    public:
+        u32 warm_up = 5;
+        u32 repetitions = 50;
+        u32 n_threads = 1;
+
+        OutputType output = OutputType::CSV;
+        cstr out_path = nullptr;
+    };
+
+
+    struct Resolution
+    {
+        u32 width;
+        u32 height;
+    };
+
+
+    const Resolution resolutions[] = {
+        { 640, 480 },
+        { 1280, 720 },
+        { 1920, 1080 },
+    };
+
+
+    // one fourcc per layout, aliases convert identically
+    const PF formats[] = {
+        PF::YUYV,
+        PF::YVYU,
+        PF::UYVY,
+        PF::NV12,
+        PF::NV21,
+        PF::YV12,
+        PF::I420,
+        PF::P010,
+    };
+
+
+    static void print_usage()
+    {
+        printf("usage: convert_bench [--csv | --json] [--out <file>] [--reps <n>] [--warmup <n>] [--threads <n>]\n");
+    }
+
+
+    static bool parse_options(int argc, char* argv[], BenchOptions& opt)
+    {
+        auto ok = tool::read_args(argc, argv, 1, [&](tool::ArgReader& args)
+        {
+            return
+                args.read_flag("--csv", opt.output, OutputType::CSV) ||
+                args.read_flag("--json", opt.output, OutputType::JSON) ||
+                args.read_value("--out", opt.out_path) ||
+                args.read_value("--reps", opt.repetitions) ||
+                args.read_value("--warmup", opt.warm_up) ||
+                args.read_value("--threads", opt.n_threads);
+        });
+
+        return ok && opt.repetitions > 0 && opt.n_threads > 0;
+    }
+}
+
+
+/* frames */
+
+namespace
+{
+    static u32 frame_size(PF format, u32 width, u32 height)
+    {
+        switch (format)
+        {
+        case PF::YUYV:
+        case PF::YVYU:
+        case PF::UYVY:
+            return width * height * 2;
+
+        case PF::P010:
+            return width * height * 3;
+
+        default:
+            return width * height + width * height / 2;
+        }
+    }
+
+
+    static void fill_frame(std::vector<u8>& frame, PF format)
+    {
+        // deterministic noise, same frame every run
+        u32 state = 0x12345678;
+
+        auto const next = [&]()
+        {
+            state = state * 1664525u + 1013904223u;
+            return state >> 24;
+        };
+
+        if (format == PF::P010)
+        {
+            auto data = (u16*)frame.data();
+            auto len = (u32)frame.size() / 2;
+
+            for (u32 i = 0; i < len; i++)
+            {
+                data[i] = (u16)((next() << 8 | next()) & 0xFFC0);
+            }
+
+            return;
+        }
+
+        for (auto& b : frame)
+        {
+            b = (u8)next();
+        }
+    }
+
+
+    static cstr format_name(PF format, char* fcc)
+    {
+        cvt::pf_to_fcc(format, fcc);
+        fcc[4] = 0;
+
+        return fcc;
+    }
+}
+
+
+/* timing */
+
+namespace
+{
+    class BenchResult
+    {
+    public:
+        std::string format;
+        std::string op;
+
+        u32 width = 0;
+        u32 height = 0;
+
+        f64 mpix_s = 0.0;
+        f64 ns_pixel = 0.0;
+        f64 p50_ms = 0.0;
+        f64 p99_ms = 0.0;
+    };
+
+
+    static BenchResult run_bench(std::function<void()> const& fn, u32 width, u32 height, BenchOptions const& opt)
+    {
+        auto t = tool::time_repetitions([&](){ return tool::time_ms(fn); }, opt.warm_up, opt.repetitions);
+
+        auto n_pixels = (f64)width * height;
+
+        BenchResult res{};
+        res.width = width;
+        res.height = height;
+        res.mpix_s = n_pixels / (t.mean_ms * 1000.0);
+        res.ns_pixel = t.mean_ms * 1.0e6 / n_pixels;
+        res.p50_ms = t.p50_ms;
+        res.p99_ms = t.p99_ms;
+
+        return res;
+    }
+}
+
+
+/* benchmarks */
+
+namespace
+{
+    using ResultList = std::vector<BenchResult>;
+
+
+    static void add_result(ResultList& results, BenchResult res, cstr format, cstr op)
+    {
+        res.format = format;
+        res.op = op;
+
+        fprintf(stderr, "%-5s %-16s %4ux%-4u %9.1f MPix/s %7.3f ns/px  p50 %7.3f ms  p99 %7.3f ms\n",
+            format, op, res.width, res.height, res.mpix_s, res.ns_pixel, res.p50_ms, res.p99_ms);
+
+        results.push_back(res);
+    }
+
+
+    static bool bench_format(PF format, Resolution res, BenchOptions const& opt, ResultList& results)
+    {
+        auto w = res.width;
+        auto h = res.height;
+
+        char fcc[5] = { 0 };
+        auto name = format_name(format, fcc);
+
+        std::vector<u8> frame(frame_size(format, w, h));
+        fill_frame(frame, format);
+
+        auto src = span::make_view(frame.data(), (u32)frame.size());
+
+        if (cvt::validate_format(src.length, w, h, format) != format)
+        {
+            return false;
+        }
+
+        // sub view dst is inset in a larger image so rows are strided
+        constexpr u32 pad = 32;
+
+        auto buffer32 = img::create_buffer32(w * h + (w + pad) * (h + pad) + (w / 2) * (h / 2), "bench rgba");
+        auto buffer8 = img::create_buffer8(w * h * 3, "bench yuv");
+        if (!buffer32.ok || !buffer8.ok)
+        {
+            mb::destroy_buffer(buffer32);
+            mb::destroy_buffer(buffer8);
+            return false;
+        }
+
+        auto rgba = img::make_view(w, h, buffer32);
+        auto canvas = img::make_view(w + pad, h + pad, buffer32);
+        auto sub = img::sub_view(canvas, img::make_rect(pad / 2, pad / 2, w, h));
+        auto yuv = cvt::make_view_yuv(w, h, buffer8);
+
+        add_result(results, run_bench([&](){ cvt::convert_view(src, rgba, format); }, w, h, opt), name, "convert_view");
+        add_result(results, run_bench([&](){ cvt::convert_sub_view(src, sub, format); }, w, h, opt), name, "convert_sub_view");
+        add_result(results, run_bench([&](){ cvt::to_yuv(src, w, h, yuv, format); }, w, h, opt), name, "to_yuv");
+
+        // half size dst, rates are per source pixel
+        auto half = img::make_view(w / 2, h / 2, buffer32);
+
+        add_result(results, run_bench([&](){ cvt::convert_resize(src, w, h, half, format, cvt::Resample::Area); }, w, h, opt), name, "resize_area");
+        add_result(results, run_bench([&](){ cvt::convert_resize(src, w, h, half, format, cvt::Resample::Bilinear); }, w, h, opt), name, "resize_bilinear");
+
+        if (format == PF::P010)
+        {
+            auto buffer16 = img::create_buffer16(w * h * 3, "bench yuv16");
+            if (buffer16.ok)
+            {
+                auto yuv16 = cvt::make_view_yuv16(w, h, buffer16);
+                cvt::to_yuv(src, w, h, yuv16, format);
+
+                add_result(results, run_bench([&](){ cvt::to_yuv(src, w, h, yuv16, format); }, w, h, opt), name, "to_yuv16");
+                add_result(results, run_bench([&](){ cvt::yuv_to_rgba(yuv16, rgba); }, w, h, opt), name, "yuv16_to_rgba");
+            }
+
+            mb::destroy_buffer(buffer16);
+        }
+
+        mb::destroy_buffer(buffer32);
+        mb::destroy_buffer(buffer8);
+
+        return true;
+    }
+
+
+    // planar conversions do not depend on the camera format
+    static bool bench_planar(Resolution res, BenchOptions const& opt, ResultList& results)
+    {
+        auto w = res.width;
+        auto h = res.height;
+
+        auto buffer32 = img::create_buffer32(w * h, "bench rgba");
+        auto buffer8 = img::create_buffer8(w * h * 6, "bench yuv");
+        if (!buffer32.ok || !buffer8.ok)
+        {
+            mb::destroy_buffer(buffer32);
+            mb::destroy_buffer(buffer8);
+            return false;
+        }
+
+        auto rgba = img::make_view(w, h, buffer32);
+        auto yuv = cvt::make_view_yuv(w, h, buffer8);
+        auto rgb = img::make_view_3(w, h, buffer8);
+
+        std::vector<u8> frame(frame_size(PF::YUYV, w, h));
+        fill_frame(frame, PF::YUYV);
+        cvt::to_yuv(span::make_view(frame.data(), (u32)frame.size()), w, h, yuv, PF::YUYV);
+
+        add_result(results, run_bench([&](){ cvt::yuv_to_rgba(yuv, rgba); }, w, h, opt), "YUV", "yuv_to_rgba");
+        add_result(results, run_bench([&](){ cvt::yuv_to_rgb(yuv, rgb); }, w, h, opt), "YUV", "yuv_to_rgb");
+
+        mb::destroy_buffer(buffer32);
+        mb::destroy_buffer(buffer8);
+
+        return true;
+    }
+}
+
+
+/* output */
+
+namespace
+{
+    static void write_csv(FILE* out, ResultList const& results)
+    {
+        fprintf(out, "format,op,width,height,mpix_s,ns_pixel,p50_ms,p99_ms\n");
+
+        for (auto const& r : results)
+        {
+            fprintf(out, "%s,%s,%u,%u,%.3f,%.4f,%.4f,%.4f\n",
+                r.format.c_str(), r.op.c_str(), r.width, r.height, r.mpix_s, r.ns_pixel, r.p50_ms, r.p99_ms);
+        }
+    }
+
+
+    static void write_json(FILE* out, ResultList const& results, BenchOptions const& opt)
+    {
+        fprintf(out, "{\n  \"threads\": %u,\n  \"repetitions\": %u,\n  \"results\": [\n", opt.n_threads, opt.repetitions);
+
+        for (size_t i = 0; i < results.size(); i++)
+        {
+            auto const& r = results[i];
+
+            fprintf(out, "    { \"format\": \"%s\", \"op\": \"%s\", \"width\": %u, \"height\": %u, "
+                "\"mpix_s\": %.3f, \"ns_pixel\": %.4f, \"p50_ms\": %.4f, \"p99_ms\": %.4f }%s\n",
+                r.format.c_str(), r.op.c_str(), r.width, r.height, r.mpix_s, r.ns_pixel, r.p50_ms, r.p99_ms,
+                i + 1 < results.size() ? "," : "");
+        }
+
+        fprintf(out, "  ]\n}\n");
+    }
+}
+
+
+int main(int argc, char* argv[])
+{
+    BenchOptions opt{};
+
+    if (!parse_options(argc, argv, opt))
+    {
+        print_usage();
+        return EXIT_FAILURE;
+    }
+
+    if (opt.n_threads > 1 && !cvt::create_thread_pool(opt.n_threads, false))
+    {
+        printf("thread pool: FAIL\n");
+        return EXIT_FAILURE;
+    }
+
+    ResultList results;
+
+    for (auto res : resolutions)
+    {
+        for (auto format : formats)
+        {
+            if (!bench_format(format, res, opt, results))
+            {
+                printf("bench %ux%u: FAIL\n", res.width, res.height);
+                return EXIT_FAILURE;
+            }
+        }
+
+        if (!bench_planar(res, opt, results))
+        {
+            printf("bench %ux%u: FAIL\n", res.width, res.height);
+            return EXIT_FAILURE;
+        }
+    }
+
+    cvt::destroy_thread_pool();
+
+    FILE* out = stdout;
+    if (opt.out_path)
+    {
+        out = fopen(opt.out_path, "w");
+        if (!out)
+        {
+            printf("open %s: FAIL\n", opt.out_path);
+            return EXIT_FAILURE;
+        }
+    }
+
+    switch (opt.output)
+    {
+    case OutputType::CSV:
+        write_csv(out, results);
+        break;
+
+    case OutputType::JSON:
+        write_json(out, results, opt);
+        break;
+    }
+
+    if (out != stdout)
+    {
+        fclose(out);
+    }
+
+    return EXIT_SUCCESS;
+}
+
+#include "../../../libs/image/image.cpp"
+#include "../../../libs/image/convert.cpp"
+#include "../../../libs/span/span.cpp"
+#include "../../../libs/qsprintf/qsprintf.cpp"
+#include "../../../libs/alloc_type/alloc_type.cpp"
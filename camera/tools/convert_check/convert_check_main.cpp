@@ -0,0 +1,1050 @@
+#include "../../../libs/image/convert.hpp"
+#include "../tool.hpp"
+
+#include <algorithm>
+#include <vector>
+#include <cmath>
+
+namespace img = image;
+namespace cvt = convert;
+
+using PF = cvt::PixelFormat;
+
+
+/* options */
+
+namespace
+{
+    struct Resolution
+    {
+        u32 width;
+        u32 height;
+    };
+
+
+    // widths off the simd block sizes exercise the scalar tails
+    const Resolution resolutions[] = {
+        { 16, 2 },
+        { 38, 22 },
+        { 640, 480 },
+    };
+
+
+    const PF formats[] = {
+        PF::YUYV,
+        PF::YVYU,
+        PF::UYVY,
+        PF::NV12,
+        PF::NV21,
+        PF::YV12,
+        PF::I420,
+        PF::P010,
+    };
+
+
+    struct ResizeCheck
+    {
+        Resolution src;
+        Resolution dst;
+    };
+
+
+    // non-integer ratios, down, up and mixed, each run for every resample mode
+    const ResizeCheck resize_checks[] = {
+        { { 16, 2 }, { 5, 3 } },
+        { { 38, 22 }, { 13, 7 } },
+        { { 38, 22 }, { 57, 33 } },
+        { { 640, 480 }, { 641, 479 } },
+        { { 640, 480 }, { 213, 161 } },
+    };
+
+
+    const cvt::Resample resample_modes[] = {
+        cvt::Resample::Bilinear,
+        cvt::Resample::Area,
+    };
+
+
+    // serial and banded
+    const u32 thread_counts[] = { 1, 4 };
+
+
+    // AVX2 kernels when the cpu has them, then the 128 bit kernels
+    const bool simd_256_levels[] = { true, false };
+
+
+    // sub views are inset in a canvas with an odd pitch
+    constexpr u32 PAD_X = 13;
+    constexpr u32 PAD_Y = 7;
+
+    constexpr u32 RGB_TOLERANCE = 1;
+
+    // resampled yuv is rounded to 8 bits before conversion, limited range chroma scales that by about 2
+    constexpr u32 RESAMPLE_TOLERANCE = 3;
+}
+
+
+/* reference */
+
+namespace
+{
+    class RefSample
+    {
+    public:
+        // 8 bit scale
+        f64 y;
+        f64 u;
+        f64 v;
+    };
+
+
+    class RefMatrix
+    {
+    public:
+        f64 vr;
+        f64 ug;
+        f64 vg;
+        f64 ub;
+
+        f64 y_offset;
+        f64 c_offset;
+        f64 y_scale;
+        f64 c_scale;
+    };
+
+
+    static RefMatrix ref_matrix_legacy()
+    {
+        // analog yuv as used by the camera display
+        return { 1.13983, -0.39465, -0.5806, 2.03211, 0.0, 127.5, 1.0, 1.0 };
+    }
+
+
+    static RefMatrix ref_matrix(f64 kr, f64 kb, bool limited)
+    {
+        auto kg = 1.0 - kr - kb;
+
+        RefMatrix m{};
+        m.vr = 2.0 * (1.0 - kr);
+        m.ub = 2.0 * (1.0 - kb);
+        m.ug = -2.0 * kb * (1.0 - kb) / kg;
+        m.vg = -2.0 * kr * (1.0 - kr) / kg;
+        m.c_offset = 128.0;
+
+        m.y_offset = limited ? 16.0 : 0.0;
+        m.y_scale = limited ? 255.0 / 219.0 : 1.0;
+        m.c_scale = limited ? 255.0 / 224.0 : 1.0;
+
+        return m;
+    }
+
+
+    static u8 ref_channel(f64 value)
+    {
+        return (u8)std::lround(std::clamp(value, 0.0, 255.0));
+    }
+
+
+    static img::Pixel ref_rgba(RefSample s, RefMatrix const& m)
+    {
+        auto y = (s.y - m.y_offset) * m.y_scale;
+        auto u = (s.u - m.c_offset) * m.c_scale;
+        auto v = (s.v - m.c_offset) * m.c_scale;
+
+        return img::to_pixel(
+            ref_channel(y + m.vr * v),
+            ref_channel(y + m.ug * u + m.vg * v),
+            ref_channel(y + m.ub * u));
+    }
+
+
+    class Frame
+    {
+    public:
+        PF format;
+        u32 width;
+        u32 height;
+
+        std::vector<u8> data;
+    };
+
+
+    static u32 frame_size(PF format, u32 width, u32 height)
+    {
+        switch (format)
+        {
+        case PF::YUYV:
+        case PF::YVYU:
+        case PF::UYVY:
+            return width * height * 2;
+
+        case PF::P010:
+            return width * height * 3;
+
+        default:
+            return width * height + width * height / 2;
+        }
+    }
+
+
+    static Frame make_frame(PF format, u32 width, u32 height)
+    {
+        Frame frame{};
+        frame.format = format;
+        frame.width = width;
+        frame.height = height;
+        frame.data.resize(frame_size(format, width, height));
+
+        // deterministic noise with the extremes at the start
+        u32 state = 0x9E3779B9 ^ (u32)format ^ (width << 16) ^ height;
+
+        auto const next = [&]()
+        {
+            state = state * 1664525u + 1013904223u;
+            return state >> 24;
+        };
+
+        if (format == PF::P010)
+        {
+            auto data = (u16*)frame.data.data();
+            auto len = (u32)frame.data.size() / 2;
+
+            for (u32 i = 0; i < len; i++)
+            {
+                data[i] = (u16)((next() << 8 | next()) & 0xFFC0);
+            }
+
+            data[0] = 0;
+            data[1] = 0xFFC0;
+
+            return frame;
+        }
+
+        for (auto& b : frame.data)
+        {
+            b = (u8)next();
+        }
+
+        frame.data[0] = 0;
+        frame.data[1] = 255;
+
+        return frame;
+    }
+
+
+    // decoded independently of the converter offsets
+    static RefSample ref_sample(Frame const& frame, u32 x, u32 y)
+    {
+        auto const w = frame.width;
+        auto const h = frame.height;
+        auto const s = frame.data.data();
+
+        auto const pair = [&](u32 iy0, u32 iu, u32 iy1, u32 iv)
+        {
+            auto p = s + (y * w + (x & ~1u)) * 2;
+
+            RefSample r{};
+            r.y = p[x % 2 ? iy1 : iy0];
+            r.u = p[iu];
+            r.v = p[iv];
+
+            return r;
+        };
+
+        auto const planar = [&](u32 u_plane, u32 v_plane)
+        {
+            auto c = s + w * h;
+            auto c_size = (w / 2) * (h / 2);
+            auto i = (y / 2) * (w / 2) + x / 2;
+
+            RefSample r{};
+            r.y = s[y * w + x];
+            r.u = c[u_plane * c_size + i];
+            r.v = c[v_plane * c_size + i];
+
+            return r;
+        };
+
+        RefSample r{};
+
+        switch (frame.format)
+        {
+        case PF::YUYV:
+            return pair(0, 1, 2, 3);
+
+        case PF::YVYU:
+            return pair(0, 3, 2, 1);
+
+        case PF::UYVY:
+            return pair(1, 0, 3, 2);
+
+        case PF::NV12:
+        case PF::NV21:
+        {
+            auto c = s + w * h + (y / 2) * w + (x & ~1u);
+            auto swap = frame.format == PF::NV21;
+
+            r.y = s[y * w + x];
+            r.u = c[swap ? 1 : 0];
+            r.v = c[swap ? 0 : 1];
+        } break;
+
+        case PF::YV12:
+            return planar(1, 0);
+
+        case PF::I420:
+            return planar(0, 1);
+
+        case PF::P010:
+        {
+            // msb aligned 10 bit, narrowed to the top 8 bits
+            auto sy = (u16*)s;
+            auto c = sy + w * h + (y / 2) * w + (x & ~1u);
+
+            r.y = sy[y * w + x] >> 8;
+            r.u = c[0] >> 8;
+            r.v = c[1] >> 8;
+        } break;
+
+        default:
+            break;
+        }
+
+        return r;
+    }
+
+
+    class RefTaps
+    {
+    public:
+        u32 first = 0;
+        std::vector<f64> weights;
+    };
+
+
+    // source positions in pixels, sample j covers [j, j + 1)
+    static std::vector<RefTaps> ref_axis(u32 src_len, u32 dst_len, cvt::Resample mode)
+    {
+        std::vector<RefTaps> axis(dst_len);
+
+        auto scale = (f64)src_len / dst_len;
+
+        for (u32 i = 0; i < dst_len; i++)
+        {
+            auto& t = axis[i];
+
+            if (mode == cvt::Resample::Area)
+            {
+                // box average over the output pixel's footprint
+                auto begin = i * scale;
+                auto end = begin + scale;
+
+                t.first = (u32)std::floor(begin);
+
+                for (auto j = t.first; j < src_len && j < end; j++)
+                {
+                    auto overlap = std::min(end, j + 1.0) - std::max(begin, (f64)j);
+                    t.weights.push_back(overlap / scale);
+                }
+            }
+            else
+            {
+                // pixel centers aligned, clamped at the edges
+                auto pos = std::max((i + 0.5) * scale - 0.5, 0.0);
+
+                t.first = std::min((u32)std::floor(pos), src_len - 1);
+
+                auto f = pos - t.first;
+
+                if (t.first + 1 < src_len)
+                {
+                    t.weights = { 1.0 - f, f };
+                }
+                else
+                {
+                    t.weights = { 1.0 };
+                }
+            }
+        }
+
+        return axis;
+    }
+
+
+    // every source sample resampled to width x height
+    static std::vector<RefSample> ref_resample(Frame const& frame, u32 width, u32 height, cvt::Resample mode)
+    {
+        auto const w = frame.width;
+
+        std::vector<RefSample> src(w * frame.height);
+        for (u32 y = 0; y < frame.height; y++)
+        {
+            for (u32 x = 0; x < w; x++)
+            {
+                src[y * w + x] = ref_sample(frame, x, y);
+            }
+        }
+
+        auto ax = ref_axis(w, width, mode);
+        auto ay = ref_axis(frame.height, height, mode);
+
+        std::vector<RefSample> dst(width * height);
+
+        for (u32 y = 0; y < height; y++)
+        {
+            auto& ty = ay[y];
+
+            for (u32 x = 0; x < width; x++)
+            {
+                auto& tx = ax[x];
+
+                RefSample r{};
+
+                for (u32 ky = 0; ky < ty.weights.size(); ky++)
+                {
+                    for (u32 kx = 0; kx < tx.weights.size(); kx++)
+                    {
+                        auto wt = ty.weights[ky] * tx.weights[kx];
+                        auto& s = src[(ty.first + ky) * w + tx.first + kx];
+
+                        r.y += wt * s.y;
+                        r.u += wt * s.u;
+                        r.v += wt * s.v;
+                    }
+                }
+
+                dst[y * width + x] = r;
+            }
+        }
+
+        return dst;
+    }
+
+
+    // 10 bit samples for the 16 bit planar path
+    static u16 ref_sample16(Frame const& frame, u32 x, u32 y, u32 ch)
+    {
+        auto const w = frame.width;
+        auto sy = (u16*)frame.data.data();
+        auto c = sy + w * frame.height + (y / 2) * w + (x & ~1u);
+
+        switch (ch)
+        {
+        case 0: return sy[y * w + x] >> 6;
+        case 1: return c[0] >> 6;
+        default: return c[1] >> 6;
+        }
+    }
+}
+
+
+/* compare */
+
+namespace
+{
+    class CheckResult
+    {
+    public:
+        u32 max_error = 0;
+        u32 mismatches = 0;
+        u32 total = 0;
+    };
+
+
+    static void compare(CheckResult& res, u32 a, u32 b, u32 tolerance)
+    {
+        auto e = a > b ? a - b : b - a;
+
+        res.max_error = std::max(res.max_error, e);
+        res.mismatches += e > tolerance;
+        res.total++;
+    }
+
+
+    template <class VIEW>
+    static CheckResult compare_rgba(Frame const& frame, VIEW const& view, RefMatrix const& m)
+    {
+        CheckResult res{};
+
+        for (u32 y = 0; y < frame.height; y++)
+        {
+            auto row = img::row_begin(view, y);
+
+            for (u32 x = 0; x < frame.width; x++)
+            {
+                auto ref = ref_rgba(ref_sample(frame, x, y), m);
+                auto p = row[x];
+
+                compare(res, p.red, ref.red, RGB_TOLERANCE);
+                compare(res, p.green, ref.green, RGB_TOLERANCE);
+                compare(res, p.blue, ref.blue, RGB_TOLERANCE);
+                compare(res, p.alpha, 255, 0);
+            }
+        }
+
+        return res;
+    }
+
+
+    static u8 channel_at(img::ViewRGBu8 const& view, img::RGB ch, u32 x, u32 y)
+    {
+        return view.channel_data[(u32)ch][y * view.width + x];
+    }
+
+
+    static u8 channel_at(img::SubViewRGBu8 const& view, img::RGB ch, u32 x, u32 y)
+    {
+        return view.channel_data[(u32)ch][(view.y_begin + y) * view.channel_width + view.x_begin + x];
+    }
+
+
+    template <class VIEW>
+    static CheckResult compare_rgb(Frame const& frame, VIEW const& view, RefMatrix const& m)
+    {
+        using RGB = img::RGB;
+
+        CheckResult res{};
+
+        for (u32 y = 0; y < frame.height; y++)
+        {
+            for (u32 x = 0; x < frame.width; x++)
+            {
+                auto ref = ref_rgba(ref_sample(frame, x, y), m);
+
+                compare(res, channel_at(view, RGB::R, x, y), ref.red, RGB_TOLERANCE);
+                compare(res, channel_at(view, RGB::G, x, y), ref.green, RGB_TOLERANCE);
+                compare(res, channel_at(view, RGB::B, x, y), ref.blue, RGB_TOLERANCE);
+            }
+        }
+
+        return res;
+    }
+
+
+    static CheckResult compare_yuv(Frame const& frame, cvt::ViewYUV const& view)
+    {
+        CheckResult res{};
+
+        for (u32 y = 0; y < frame.height; y++)
+        {
+            for (u32 x = 0; x < frame.width; x++)
+            {
+                auto ref = ref_sample(frame, x, y);
+                auto i = y * frame.width + x;
+
+                compare(res, view.channel_data[(u32)cvt::YUV::Y][i], (u32)ref.y, 0);
+                compare(res, view.channel_data[(u32)cvt::YUV::U][i], (u32)ref.u, 0);
+                compare(res, view.channel_data[(u32)cvt::YUV::V][i], (u32)ref.v, 0);
+            }
+        }
+
+        return res;
+    }
+
+
+    template <u32 SX, u32 SY>
+    static CheckResult compare_subsampled(Frame const& frame, cvt::SubsampledYUV<SX, SY> const& view)
+    {
+        CheckResult res{};
+
+        for (u32 y = 0; y < frame.height; y++)
+        {
+            for (u32 x = 0; x < frame.width; x++)
+            {
+                auto ref = ref_sample(frame, x, y);
+
+                compare(res, *img::xy_at(view.y, x, y), (u32)ref.y, 0);
+                compare(res, *img::xy_at(view.u, x / SX, y / SY), (u32)ref.u, 0);
+                compare(res, *img::xy_at(view.v, x / SX, y / SY), (u32)ref.v, 0);
+            }
+        }
+
+        return res;
+    }
+
+
+    static CheckResult compare_yuv16(Frame const& frame, cvt::ViewYUV16 const& view)
+    {
+        CheckResult res{};
+
+        auto n = frame.width * frame.height;
+
+        for (u32 i = 0; i < n; i++)
+        {
+            auto x = i % frame.width;
+            auto y = i / frame.width;
+
+            for (u32 ch = 0; ch < 3; ch++)
+            {
+                compare(res, view.channel_data[ch][i], ref_sample16(frame, x, y, ch), 0);
+            }
+        }
+
+        return res;
+    }
+
+
+    template <class VIEW>
+    static CheckResult compare_resampled(std::vector<RefSample> const& ref, VIEW const& view, RefMatrix const& m)
+    {
+        CheckResult res{};
+
+        for (u32 y = 0; y < view.height; y++)
+        {
+            auto row = img::row_begin(view, y);
+
+            for (u32 x = 0; x < view.width; x++)
+            {
+                auto e = ref_rgba(ref[y * view.width + x], m);
+                auto p = row[x];
+
+                compare(res, p.red, e.red, RESAMPLE_TOLERANCE);
+                compare(res, p.green, e.green, RESAMPLE_TOLERANCE);
+                compare(res, p.blue, e.blue, RESAMPLE_TOLERANCE);
+                compare(res, p.alpha, 255, 0);
+            }
+        }
+
+        return res;
+    }
+
+
+    // the same image converted two ways
+    template <class VIEW>
+    static CheckResult compare_views(img::ImageView const& expected, VIEW const& view)
+    {
+        CheckResult res{};
+
+        for (u32 y = 0; y < expected.height; y++)
+        {
+            auto e = img::row_begin(expected, y);
+            auto d = img::row_begin(view, y);
+
+            for (u32 x = 0; x < expected.width; x++)
+            {
+                compare(res, d[x].red, e[x].red, 0);
+                compare(res, d[x].green, e[x].green, 0);
+                compare(res, d[x].blue, e[x].blue, 0);
+            }
+        }
+
+        return res;
+    }
+
+
+    static u32 as_u32(u8 value)
+    {
+        return value;
+    }
+
+
+    // pixels around a sub view must not be written
+    template <typename T>
+    static CheckResult compare_border(MatrixView2D<T> const& canvas, Rect2Du32 const& r, T fill)
+    {
+        CheckResult res{};
+
+        for (u32 y = 0; y < canvas.height; y++)
+        {
+            auto row = img::row_begin(canvas, y);
+
+            for (u32 x = 0; x < canvas.width; x++)
+            {
+                auto inside = x >= r.x_begin && x < r.x_end && y >= r.y_begin && y < r.y_end;
+                if (!inside)
+                {
+                    compare(res, as_u32(row[x]), as_u32(fill), 0);
+                }
+            }
+        }
+
+        return res;
+    }
+}
+
+
+/* checks */
+
+namespace
+{
+    using CheckReport = tool::CheckReport;
+
+
+    static void report(CheckReport& rep, CheckResult const& res, Frame const& frame, u32 n_threads, cstr op)
+    {
+        char fcc[5] = { 0 };
+        cvt::pf_to_fcc(frame.format, fcc);
+
+        auto ok = res.mismatches == 0 && res.total > 0;
+
+        printf("%-5s %-22s %4ux%-4u t%u  max err %3u  mismatches %7u / %-8u %s\n",
+            fcc, op, frame.width, frame.height, n_threads, res.max_error, res.mismatches, res.total, ok ? "OK" : "FAIL");
+
+        tool::add_check(rep, ok);
+    }
+
+
+    class Buffers
+    {
+    public:
+        img::Buffer32 buffer32;
+        img::Buffer8 buffer8;
+        img::Buffer16 buffer16;
+
+        bool ok() const { return buffer32.ok && buffer8.ok && buffer16.ok; }
+    };
+
+
+    static Buffers create_buffers(u32 width, u32 height)
+    {
+        auto n = width * height;
+
+        Buffers b{};
+        b.buffer32 = img::create_buffer32(n + (width + PAD_X) * (height + PAD_Y), "check rgba");
+        b.buffer8 = img::create_buffer8(n * 3 * 2 + (width + PAD_X) * (height + PAD_Y) * 3, "check yuv");
+        b.buffer16 = img::create_buffer16(n * 3, "check yuv16");
+
+        return b;
+    }
+
+
+    static void destroy_buffers(Buffers& b)
+    {
+        mb::destroy_buffer(b.buffer32);
+        mb::destroy_buffer(b.buffer8);
+        mb::destroy_buffer(b.buffer16);
+    }
+
+
+    static void reset_buffers(Buffers& b)
+    {
+        mb::reset_buffer(b.buffer32);
+        mb::reset_buffer(b.buffer8);
+        mb::reset_buffer(b.buffer16);
+    }
+
+
+    static void check_rgba(Frame const& frame, Buffers& b, u32 n_threads, CheckReport& rep)
+    {
+        auto const w = frame.width;
+        auto const h = frame.height;
+        auto src = span::make_view((u8*)frame.data.data(), (u32)frame.data.size());
+
+        auto legacy = ref_matrix_legacy();
+        auto bt709 = ref_matrix(0.2126, 0.0722, true);
+        auto bt2020 = ref_matrix(0.2627, 0.0593, false);
+
+        auto table709 = cvt::make_color_table(cvt::ColorMatrix::BT709, cvt::ColorRange::Limited);
+        auto table2020 = cvt::make_color_table(cvt::ColorMatrix::BT2020, cvt::ColorRange::Full);
+
+        reset_buffers(b);
+        auto rgba = img::make_view(w, h, b.buffer32);
+        auto canvas = img::make_view(w + PAD_X, h + PAD_Y, b.buffer32);
+
+        auto const run = [&](cstr op, RefMatrix const& m, auto const& convert)
+        {
+            img::fill(rgba, img::to_pixel(0));
+            convert();
+            report(rep, compare_rgba(frame, rgba, m), frame, n_threads, op);
+        };
+
+        run("convert_view", legacy, [&](){ cvt::convert_view(src, rgba, frame.format); });
+        run("convert_view float", legacy, [&](){ cvt::convert_view(src, rgba, frame.format, cvt::Kernel::Float); });
+        run("convert_view bt709 lim", bt709, [&](){ cvt::convert_view(src, rgba, frame.format, table709); });
+        run("convert_view bt2020", bt2020, [&](){ cvt::convert_view(src, rgba, frame.format, table2020); });
+
+        auto fill = img::to_pixel(1, 2, 3, 4);
+        auto range = img::make_rect(PAD_X / 2, PAD_Y / 2, w, h);
+        auto sub = img::sub_view(canvas, range);
+
+        img::fill(canvas, fill);
+        cvt::convert_sub_view(src, sub, frame.format);
+        report(rep, compare_rgba(frame, sub, legacy), frame, n_threads, "convert_sub_view");
+        report(rep, compare_border(canvas, range, fill), frame, n_threads, "convert_sub_view edge");
+
+        img::fill(canvas, fill);
+        cvt::convert_sub_view(src, sub, frame.format, table709);
+        report(rep, compare_rgba(frame, sub, bt709), frame, n_threads, "convert_sub_view bt709");
+    }
+
+
+    static void check_planar(Frame const& frame, Buffers& b, u32 n_threads, CheckReport& rep)
+    {
+        auto const w = frame.width;
+        auto const h = frame.height;
+        auto src = span::make_view((u8*)frame.data.data(), (u32)frame.data.size());
+
+        auto legacy = ref_matrix_legacy();
+        auto bt709 = ref_matrix(0.2126, 0.0722, true);
+        auto table709 = cvt::make_color_table(cvt::ColorMatrix::BT709, cvt::ColorRange::Limited);
+
+        reset_buffers(b);
+        auto rgba = img::make_view(w, h, b.buffer32);
+        auto yuv = cvt::make_view_yuv(w, h, b.buffer8);
+        auto rgb = img::make_view_3(w, h, b.buffer8);
+
+        cvt::to_yuv(src, w, h, yuv, frame.format);
+        report(rep, compare_yuv(frame, yuv), frame, n_threads, "to_yuv");
+
+        cvt::yuv_to_rgba(yuv, rgba);
+        report(rep, compare_rgba(frame, rgba, legacy), frame, n_threads, "yuv_to_rgba");
+
+        cvt::yuv_to_rgba(yuv, rgba, cvt::Kernel::Float);
+        report(rep, compare_rgba(frame, rgba, legacy), frame, n_threads, "yuv_to_rgba float");
+
+        cvt::yuv_to_rgba(yuv, rgba, table709);
+        report(rep, compare_rgba(frame, rgba, bt709), frame, n_threads, "yuv_to_rgba bt709");
+
+        cvt::yuv_to_rgb(yuv, rgb);
+        report(rep, compare_rgb(frame, rgb, legacy), frame, n_threads, "yuv_to_rgb");
+
+        cvt::yuv_to_rgb(yuv, rgb, cvt::Kernel::Float);
+        report(rep, compare_rgb(frame, rgb, legacy), frame, n_threads, "yuv_to_rgb float");
+
+        cvt::yuv_to_rgb(yuv, rgb, table709);
+        report(rep, compare_rgb(frame, rgb, bt709), frame, n_threads, "yuv_to_rgb bt709");
+
+        auto canvas = img::make_view(w + PAD_X, h + PAD_Y, b.buffer32);
+        auto canvas3 = img::make_view_3(w + PAD_X, h + PAD_Y, b.buffer8);
+
+        auto range = img::make_rect(PAD_X / 2, PAD_Y / 2, w, h);
+        auto sub = img::sub_view(canvas, range);
+        auto sub3 = img::sub_view(canvas3, range);
+
+        auto fill = img::to_pixel(1, 2, 3, 4);
+        auto red = img::select_channel(canvas3, (u32)img::RGB::R);
+
+        img::fill(canvas, fill);
+        cvt::yuv_to_rgba(yuv, sub);
+        report(rep, compare_rgba(frame, sub, legacy), frame, n_threads, "yuv_to_rgba sub");
+        report(rep, compare_border(canvas, range, fill), frame, n_threads, "yuv_to_rgba sub edge");
+
+        cvt::yuv_to_rgba(yuv, sub, table709);
+        report(rep, compare_rgba(frame, sub, bt709), frame, n_threads, "yuv_to_rgba sub bt709");
+
+        std::fill_n(red.matrix_data_, red.width * red.height, (u8)7);
+        cvt::yuv_to_rgb(yuv, sub3);
+        report(rep, compare_rgb(frame, sub3, legacy), frame, n_threads, "yuv_to_rgb sub");
+        report(rep, compare_border(red, range, (u8)7), frame, n_threads, "yuv_to_rgb sub edge");
+
+        cvt::yuv_to_rgb(yuv, sub3, table709);
+        report(rep, compare_rgb(frame, sub3, bt709), frame, n_threads, "yuv_to_rgb sub bt709");
+
+        // resampled planes match resampling the frame
+        auto half = rgba;
+        half.width = w / 2;
+        half.height = h / 2;
+
+        auto range_half = img::make_rect(PAD_X / 2, PAD_Y / 2, half.width, half.height);
+        auto sub_half = img::sub_view(canvas, range_half);
+
+        cvt::convert_resize(src, w, h, half, frame.format, cvt::Resample::Area, table709);
+
+        img::fill(canvas, fill);
+        cvt::yuv_to_rgba(yuv, sub_half, cvt::Resample::Area, table709);
+        report(rep, compare_views(half, sub_half), frame, n_threads, "yuv_to_rgba resize");
+        report(rep, compare_border(canvas, range_half, fill), frame, n_threads, "yuv_to_rgba resize edge");
+    }
+
+
+    // native layouts only, resampled chroma has no exact reference
+    static void check_subsampled(Frame const& frame, Buffers& b, u32 n_threads, CheckReport& rep)
+    {
+        auto const w = frame.width;
+        auto const h = frame.height;
+        auto src = span::make_view((u8*)frame.data.data(), (u32)frame.data.size());
+
+        auto legacy = ref_matrix_legacy();
+
+        reset_buffers(b);
+        auto rgba = img::make_view(w, h, b.buffer32);
+
+        switch (frame.format)
+        {
+        case PF::YUYV:
+        case PF::YVYU:
+        case PF::UYVY:
+        {
+            auto yuv = cvt::make_view_yuv422(w, h, b.buffer8);
+
+            cvt::to_yuv(src, yuv, frame.format);
+            report(rep, compare_subsampled(frame, yuv), frame, n_threads, "to_yuv 422");
+
+            cvt::yuv_to_rgba(yuv, rgba);
+            report(rep, compare_rgba(frame, rgba, legacy), frame, n_threads, "yuv_to_rgba 422");
+        } break;
+
+        case PF::NV12:
+        case PF::NV21:
+        case PF::YV12:
+        case PF::I420:
+        {
+            auto yuv = cvt::make_view_yuv420(w, h, b.buffer8);
+
+            cvt::to_yuv(src, yuv, frame.format);
+            report(rep, compare_subsampled(frame, yuv), frame, n_threads, "to_yuv 420");
+
+            cvt::yuv_to_rgba(yuv, rgba);
+            report(rep, compare_rgba(frame, rgba, legacy), frame, n_threads, "yuv_to_rgba 420");
+        } break;
+
+        default:
+            break;
+        }
+    }
+
+
+    // both resample paths against the reference at each size in resize_checks
+    static void check_resize(Frame const& frame, u32 n_threads, CheckReport& rep)
+    {
+        auto const w = frame.width;
+        auto const h = frame.height;
+        auto src = span::make_view((u8*)frame.data.data(), (u32)frame.data.size());
+
+        auto bt709 = ref_matrix(0.2126, 0.0722, true);
+        auto table709 = cvt::make_color_table(cvt::ColorMatrix::BT709, cvt::ColorRange::Limited);
+
+        for (auto check : resize_checks)
+        {
+            if (check.src.width != w || check.src.height != h)
+            {
+                continue;
+            }
+
+            auto dw = check.dst.width;
+            auto dh = check.dst.height;
+
+            auto buffer32 = img::create_buffer32(dw * dh + (dw + PAD_X) * (dh + PAD_Y), "check resize");
+            auto buffer8 = img::create_buffer8(w * h * 3, "check resize yuv");
+            if (!buffer32.ok || !buffer8.ok)
+            {
+                mb::destroy_buffer(buffer32);
+                mb::destroy_buffer(buffer8);
+                tool::add_check(rep, false);
+                printf("buffers %ux%u: FAIL\n", dw, dh);
+                return;
+            }
+
+            auto dst = img::make_view(dw, dh, buffer32);
+            auto canvas = img::make_view(dw + PAD_X, dh + PAD_Y, buffer32);
+            auto range = img::make_rect(PAD_X / 2, PAD_Y / 2, dw, dh);
+            auto sub = img::sub_view(canvas, range);
+
+            auto yuv = cvt::make_view_yuv(w, h, buffer8);
+            cvt::to_yuv(src, w, h, yuv, frame.format);
+
+            auto fill = img::to_pixel(1, 2, 3, 4);
+
+            for (auto mode : resample_modes)
+            {
+                auto ref = ref_resample(frame, dw, dh, mode);
+                auto name = mode == cvt::Resample::Area ? "area" : "bilinear";
+
+                char op[32];
+
+                img::fill(dst, img::to_pixel(0));
+                cvt::convert_resize(src, w, h, dst, frame.format, mode, table709);
+                snprintf(op, 32, "resize %s %ux%u", name, dw, dh);
+                report(rep, compare_resampled(ref, dst, bt709), frame, n_threads, op);
+
+                img::fill(canvas, fill);
+                cvt::yuv_to_rgba(yuv, sub, mode, table709);
+                snprintf(op, 32, "yuv resize %s %ux%u", name, dw, dh);
+                report(rep, compare_resampled(ref, sub, bt709), frame, n_threads, op);
+                report(rep, compare_border(canvas, range, fill), frame, n_threads, "yuv resize edge");
+            }
+
+            mb::destroy_buffer(buffer32);
+            mb::destroy_buffer(buffer8);
+        }
+    }
+
+
+    static void check_yuv16(Frame const& frame, Buffers& b, u32 n_threads, CheckReport& rep)
+    {
+        if (frame.format != PF::P010)
+        {
+            return;
+        }
+
+        auto const w = frame.width;
+        auto const h = frame.height;
+        auto src = span::make_view((u8*)frame.data.data(), (u32)frame.data.size());
+
+        reset_buffers(b);
+        auto rgba = img::make_view(w, h, b.buffer32);
+        auto yuv16 = cvt::make_view_yuv16(w, h, b.buffer16);
+
+        cvt::to_yuv(src, w, h, yuv16, frame.format);
+        report(rep, compare_yuv16(frame, yuv16), frame, n_threads, "to_yuv 16");
+
+        cvt::yuv_to_rgba(yuv16, rgba);
+        report(rep, compare_rgba(frame, rgba, ref_matrix_legacy()), frame, n_threads, "yuv_to_rgba 16");
+    }
+}
+
+
+int main()
+{
+    CheckReport rep{};
+
+    for (auto simd_256 : simd_256_levels)
+    {
+        if (cvt::enable_simd_256(simd_256) != simd_256)
+        {
+            printf("\nsimd 256: not supported, skipped\n");
+            continue;
+        }
+
+        printf("\nsimd %u\n", simd_256 ? 256u : 128u);
+
+        for (auto n_threads : thread_counts)
+        {
+            if (n_threads > 1 && !cvt::create_thread_pool(n_threads, false))
+            {
+                printf("thread pool: FAIL\n");
+                return EXIT_FAILURE;
+            }
+
+            for (auto res : resolutions)
+            {
+                auto buffers = create_buffers(res.width, res.height);
+                if (!buffers.ok())
+                {
+                    printf("buffers %ux%u: FAIL\n", res.width, res.height);
+                    destroy_buffers(buffers);
+                    return EXIT_FAILURE;
+                }
+
+                for (auto format : formats)
+                {
+                    auto frame = make_frame(format, res.width, res.height);
+
+                    if (cvt::validate_format((u32)frame.data.size(), res.width, res.height, format) != format)
+                    {
+                        printf("validate_format: FAIL\n");
+                        return EXIT_FAILURE;
+                    }
+
+                    check_rgba(frame, buffers, n_threads, rep);
+                    check_planar(frame, buffers, n_threads, rep);
+                    check_subsampled(frame, buffers, n_threads, rep);
+                    check_resize(frame, n_threads, rep);
+                    check_yuv16(frame, buffers, n_threads, rep);
+                }
+
+                destroy_buffers(buffers);
+            }
+
+            cvt::destroy_thread_pool();
+        }
+    }
+
+    return tool::print_summary(rep);
+}
+
+#include "../../../libs/image/image.cpp"
+#include "../../../libs/image/convert.cpp"
+#include "../../../libs/span/span.cpp"
+#include "../../../libs/qsprintf/qsprintf.cpp"
+#include "../../../libs/alloc_type/alloc_type.cpp"
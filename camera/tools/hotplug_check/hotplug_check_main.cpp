@@ -0,0 +1,406 @@
+#include "../../../libs/usb/camera_uvc.cpp"
+#include "../tool.hpp"
+
+#include <thread>
+
+namespace cam = camera_usb;
+
+using SE = cam::SlotEvent;
+
+
+/* fake devices */
+
+namespace
+{
+    constexpr u32 BUS_MAX = cam::HOTPLUG_SCAN_MAX;
+
+
+    // what the backend did with a slot, restoring the stream is checked on the real backend
+    class FakeCamera
+    {
+    public:
+        b8 connected = 0;
+
+        // the bus device it was given, see FakeBackend::add
+        cam::DeviceKey key{};
+
+        u32 n_reconnects = 0;
+        u32 n_releases = 0;
+    };
+
+
+    class FakeBus
+    {
+    public:
+        cam::DeviceKey devices[BUS_MAX];
+        u32 count = 0;
+
+        u32 next_address = 1;
+    };
+
+
+    class FakeBackend
+    {
+    public:
+        FakeBus bus;
+
+        FakeCamera cameras[cam::HOTPLUG_SLOTS_MAX];
+
+        u32 n_scans = 0;
+
+
+        u32 scan(cam::DeviceKey* dst, u32 capacity)
+        {
+            n_scans++;
+
+            u32 n = 0;
+            for (; n < bus.count && n < capacity; n++)
+            {
+                dst[n] = bus.devices[n];
+            }
+
+            return n;
+        }
+
+
+        void release(u32 slot)
+        {
+            auto& c = cameras[slot];
+            if (!c.connected)
+            {
+                return;
+            }
+
+            c.connected = 0;
+            c.n_releases++;
+        }
+
+
+        void remove(u32 slot)
+        {
+            release(slot);
+        }
+
+
+        // scan copies the bus in order, scan_index is a bus index until the next change
+        void add(u32 slot, u32 scan_index)
+        {
+            cameras[slot] = {};
+            cameras[slot].connected = 1;
+            cameras[slot].key = bus.devices[scan_index];
+        }
+
+
+        void reconnect(u32 slot, u32 scan_index)
+        {
+            release(slot);
+
+            auto& c = cameras[slot];
+            c.connected = 1;
+            c.key = bus.devices[scan_index];
+            c.n_reconnects++;
+        }
+
+
+        void end_scan()
+        {
+
+        }
+    };
+
+
+    static cam::DeviceKey make_key(u16 vendor_id, u16 product_id, cstr serial)
+    {
+        cam::DeviceKey key{};
+        key.vendor_id = vendor_id;
+        key.product_id = product_id;
+        strncpy(key.serial_number, serial, sizeof(key.serial_number) - 1);
+
+        return key;
+    }
+
+
+    // a new bus address every time, as after a replug
+    static void plug(FakeBus& bus, cam::DeviceKey key)
+    {
+        key.location = 1 << 8 | bus.next_address++;
+        bus.devices[bus.count++] = key;
+    }
+
+
+    static void unplug(FakeBus& bus, cam::DeviceKey const& key)
+    {
+        for (u32 i = 0; i < bus.count; i++)
+        {
+            if (cam::hotplug::same_device(bus.devices[i], key))
+            {
+                bus.devices[i] = bus.devices[--bus.count];
+                return;
+            }
+        }
+    }
+
+
+    static void unplug_at(FakeBus& bus, u32 location)
+    {
+        for (u32 i = 0; i < bus.count; i++)
+        {
+            if (bus.devices[i].location == location)
+            {
+                bus.devices[i] = bus.devices[--bus.count];
+                return;
+            }
+        }
+    }
+}
+
+
+/* checks */
+
+namespace
+{
+    using CheckReport = tool::CheckReport;
+
+
+    static void check(CheckReport& rep, bool ok, cstr what)
+    {
+        printf("%-56s %s\n", what, ok ? "OK" : "FAIL");
+
+        tool::add_check(rep, ok);
+    }
+
+
+    static bool events_are(cam::DeviceTable const& table, SE const* expected, u32 n)
+    {
+        if (table.count != n)
+        {
+            return false;
+        }
+
+        for (u32 i = 0; i < n; i++)
+        {
+            if (table.slots[i].event != expected[i])
+            {
+                return false;
+            }
+        }
+
+        return true;
+    }
+
+
+    static bool has_key(FakeBackend const& be, u32 slot, cam::DeviceKey const& key)
+    {
+        return cam::hotplug::same_device(be.cameras[slot].key, key);
+    }
+
+
+    static void check_plug_cycle(CheckReport& rep)
+    {
+        cam::DeviceTable table{};
+        FakeBackend be{};
+
+        auto key_a = make_key(0x046d, 0x0825, "A100");
+        auto key_b = make_key(0x046d, 0x0825, "B200");
+        auto key_c = make_key(0x1bcf, 0x2c99, "C300");
+
+        plug(be.bus, key_a);
+        plug(be.bus, key_b);
+
+        auto n = cam::hotplug::rescan(table, be);
+
+        SE const added[] = { SE::Added, SE::Added };
+        check(rep, n == 2 && events_are(table, added, 2), "initial scan adds both cameras");
+        check(rep, has_key(be, 0, key_a) && has_key(be, 1, key_b), "each slot gets its own device");
+
+        n = cam::hotplug::rescan(table, be);
+
+        SE const none[] = { SE::None, SE::None };
+        check(rep, n == 0 && events_are(table, none, 2), "rescan without changes reports nothing");
+
+        unplug(be.bus, key_a);
+        n = cam::hotplug::rescan(table, be);
+
+        SE const removed[] = { SE::Removed, SE::None };
+        check(rep, n == 1 && events_are(table, removed, 2), "unplug removes only that camera");
+        check(rep, !be.cameras[0].connected && !table.slots[0].present, "removed camera is released");
+        check(rep, be.cameras[1].connected && !be.cameras[1].n_releases, "other camera is untouched");
+
+        plug(be.bus, key_a);
+        n = cam::hotplug::rescan(table, be);
+
+        SE const back[] = { SE::Reconnected, SE::None };
+        check(rep, n == 1 && events_are(table, back, 2), "replug reconnects into the same slot");
+        check(rep, be.cameras[0].connected && be.cameras[0].n_reconnects == 1, "reconnected camera is connected again");
+        check(rep, has_key(be, 0, key_a) && be.cameras[0].key.location == be.bus.devices[be.bus.count - 1].location, "reconnected camera opens the new address");
+        check(rep, !be.cameras[1].n_reconnects && !be.cameras[1].n_releases, "other camera is still untouched");
+
+        // gone and back before the next scan, only the location changed
+        unplug(be.bus, key_b);
+        plug(be.bus, key_b);
+        n = cam::hotplug::rescan(table, be);
+
+        SE const quick[] = { SE::None, SE::Reconnected };
+        check(rep, n == 1 && events_are(table, quick, 2), "replug between scans reconnects");
+        check(rep, be.cameras[1].n_releases == 1 && be.cameras[1].connected && be.cameras[1].n_reconnects == 1, "stale connection released before reopening");
+
+        plug(be.bus, key_c);
+        n = cam::hotplug::rescan(table, be);
+
+        SE const third[] = { SE::None, SE::None, SE::Added };
+        check(rep, n == 1 && events_are(table, third, 3), "new camera gets a new slot");
+        check(rep, be.cameras[2].connected && !be.cameras[2].n_reconnects, "new camera is added, not reconnected");
+    }
+
+
+    static void check_same_serial(CheckReport& rep)
+    {
+        cam::DeviceTable table{};
+        FakeBackend be{};
+
+        // identical cameras without serial numbers
+        auto key = make_key(0x05a3, 0x9230, "");
+
+        plug(be.bus, key);
+        plug(be.bus, key);
+
+        cam::hotplug::rescan(table, be);
+
+        check(rep, table.count == 2, "identical cameras get a slot each");
+
+        unplug_at(be.bus, table.slots[1].key.location);
+        auto n = cam::hotplug::rescan(table, be);
+
+        SE const removed[] = { SE::None, SE::Removed };
+        check(rep, n == 1 && events_are(table, removed, 2), "unplug is matched by location");
+        check(rep, be.cameras[0].connected && !be.cameras[0].n_releases, "identical camera stays connected");
+
+        plug(be.bus, key);
+        cam::hotplug::rescan(table, be);
+
+        check(rep, table.slots[1].event == SE::Reconnected && be.cameras[1].n_reconnects == 1, "identical camera returns to the free slot");
+    }
+
+
+    static void check_full_table(CheckReport& rep)
+    {
+        cam::DeviceTable table{};
+        FakeBackend be{};
+
+        char serial[8] = { 0 };
+
+        for (u32 i = 0; i < cam::HOTPLUG_SLOTS_MAX + 2; i++)
+        {
+            snprintf(serial, sizeof(serial), "S%u", i);
+            plug(be.bus, make_key(0x2bd9, 0x0011, serial));
+        }
+
+        auto n = cam::hotplug::rescan(table, be);
+
+        check(rep, n == cam::HOTPLUG_SLOTS_MAX && table.count == cam::HOTPLUG_SLOTS_MAX, "devices past the table are ignored");
+
+        n = cam::hotplug::rescan(table, be);
+
+        check(rep, n == 0, "ignored devices are not reported again");
+    }
+
+
+    static bool wait_for_frame(cam::Camera& camera)
+    {
+        cam::FrameYUV frame;
+
+        for (u32 i = 0; i < 200; i++)
+        {
+            if (cam::read_frame(camera, frame))
+            {
+                cam::release_frame(camera);
+                return true;
+            }
+
+            std::this_thread::sleep_for(std::chrono::milliseconds(5));
+        }
+
+        return false;
+    }
+
+
+    static bool same_table(convert::ColorTable const& a, convert::ColorTable const& b)
+    {
+        return memcmp(&a, &b, sizeof(a)) == 0;
+    }
+
+
+    // synthetic cameras on the libuvc backend, the camera comes back through restore_device
+    static void check_restore(CheckReport& rep)
+    {
+        setenv("CAMERA_SYNTHETIC", "NV12:640x480@30*2", 1);
+
+        auto cameras = cam::enumerate_cameras();
+
+        check(rep, cameras.count == 2, "synthetic cameras are listed");
+        if (cameras.count != 2)
+        {
+            cam::close(cameras);
+            return;
+        }
+
+        auto& cam_a = cameras.list[0];
+        auto& cam_b = cameras.list[1];
+
+        auto bt709 = convert::make_color_table(convert::ColorMatrix::BT709, convert::ColorRange::Full);
+
+        cam::ModeRequest request{};
+        request.width = 640;
+        request.height = 480;
+
+        auto ok = cam::open_camera(cam_a, request) && cam::open_camera(cam_b, request);
+        if (ok)
+        {
+            cam::set_color_space(cam_a, convert::ColorMatrix::BT709, convert::ColorRange::Full);
+
+            ok = cam::start_stream_ring(cam_a, 3, cam::OverflowPolicy::DropOldest) &&
+                 cam::start_stream_ring(cam_b, 3, cam::OverflowPolicy::DropOldest);
+        }
+
+        check(rep, ok && wait_for_frame(cam_a) && wait_for_frame(cam_b), "both cameras stream");
+
+        cam::plug_synthetic_camera(0, false);
+        auto changed = cam::update_cameras(cameras);
+
+        check(rep, changed && cam_a.status == cam::CameraStatus::Inactive, "unplugged camera becomes inactive");
+        check(rep, wait_for_frame(cam_b), "other camera keeps streaming");
+
+        cam::plug_synthetic_camera(0, true);
+        changed = cam::update_cameras(cameras);
+
+        check(rep, changed && wait_for_frame(cam_a), "replugged camera streams again");
+        check(rep, cam_a.status == cam::CameraStatus::Streaming && cam_a.frame_width == 640 && cam_a.frame_height == 480, "replugged camera reopens with its mode");
+        check(rep, same_table(cam::get_color_table(cam_a), bt709), "replugged camera keeps its color space");
+        check(rep, !cam::is_new_camera(cam_a) && !cam::is_new_camera(cam_b), "replugged camera is not opened as a new one");
+
+        changed = cam::update_cameras(cameras);
+
+        check(rep, !changed && wait_for_frame(cam_b), "update without changes leaves both streaming");
+
+        cam::close(cameras);
+    }
+}
+
+
+int main()
+{
+    CheckReport rep{};
+
+    check_plug_cycle(rep);
+    check_same_serial(rep);
+    check_full_table(rep);
+    check_restore(rep);
+
+    return tool::print_summary(rep);
+}
+
+#include "../../../libs/alloc_type/alloc_type.cpp"
+#include "../../../libs/image/image.cpp"
+#include "../../../libs/qsprintf/qsprintf.cpp"
+#include "../../../libs/span/span.cpp"
+#include "../../../libs/image/convert.cpp"
@@ -0,0 +1,212 @@
+#include "../../../libs/usb/camera_modes.hpp"
+#include "../tool.hpp"
+
+namespace cam = camera_usb;
+
+using PF = convert::PixelFormat;
+
+
+/* fake descriptors */
+
+namespace
+{
+    // 30 fps in 100 ns units
+    constexpr u32 FPS_30 = 333'333;
+    constexpr u32 FPS_15 = 666'666;
+
+
+    static void add(cam::CameraModeList& modes, PF format, u32 width, u32 height, u32 interval)
+    {
+        cam::modes::add_mode(modes, (u32)format, width, height, interval, modes.count);
+    }
+
+
+    // many webcams list MJPG before YUY2, with faster intervals at the larger sizes
+    static cam::CameraModeList mjpg_first_camera()
+    {
+        cam::CameraModeList modes{};
+
+        add(modes, PF::MJPG, 1920, 1080, FPS_30);
+        add(modes, PF::MJPG, 1280, 720, FPS_30);
+        add(modes, PF::MJPG, 640, 480, FPS_30);
+        add(modes, PF::MJPG, 640, 480, FPS_15);
+
+        add(modes, PF::YUY2, 1920, 1080, FPS_15 * 2);
+        add(modes, PF::YUY2, 1280, 720, FPS_15);
+        add(modes, PF::YUY2, 640, 480, FPS_30);
+        add(modes, PF::YUY2, 640, 480, FPS_15);
+
+        return modes;
+    }
+
+
+    static cam::CameraModeList mjpg_only_camera()
+    {
+        cam::CameraModeList modes{};
+
+        add(modes, PF::MJPG, 1280, 720, FPS_30);
+        add(modes, PF::MJPG, 640, 480, FPS_30);
+
+        return modes;
+    }
+
+
+    static cam::ModeRequest make_request(cam::ModePolicy policy, u32 width, u32 height, u32 fps, PF format)
+    {
+        cam::ModeRequest request{};
+        request.policy = policy;
+        request.width = width;
+        request.height = height;
+        request.fps = fps;
+        request.pixel_format = format;
+
+        return request;
+    }
+}
+
+
+/* checks */
+
+namespace
+{
+    using CheckReport = tool::CheckReport;
+
+
+    static void check(CheckReport& rep, bool ok, cstr what)
+    {
+        printf("%-56s %s\n", what, ok ? "OK" : "FAIL");
+
+        tool::add_check(rep, ok);
+    }
+
+
+    static bool selects(cam::CameraModeList const& modes, cam::ModeRequest const& request, PF format, u32 width, u32 height, u32 interval)
+    {
+        auto i = cam::modes::select_mode(modes, request);
+        if (i < 0)
+        {
+            return false;
+        }
+
+        auto& mode = modes.list[i];
+
+        return mode.pixel_format == format && mode.width == width && mode.height == height && mode.interval == interval;
+    }
+
+
+    static void check_mjpg_first(CheckReport& rep)
+    {
+        using MP = cam::ModePolicy;
+
+        auto modes = mjpg_first_camera();
+
+        // the default open_camera request
+        check(rep, selects(modes, cam::ModeRequest{}, PF::YUY2, 640, 480, FPS_30), "mjpg first, default request keeps YUY2");
+
+        auto max_fps = make_request(MP::MaxFps, 1280, 720, 0, PF::Unknown);
+        check(rep, selects(modes, max_fps, PF::YUY2, 1280, 720, FPS_15), "mjpg first, max fps keeps YUY2");
+
+        auto max_res = make_request(MP::MaxResolution, 0, 0, 30, PF::Unknown);
+        check(rep, selects(modes, max_res, PF::YUY2, 640, 480, FPS_30), "mjpg first, max resolution at 30 fps keeps YUY2");
+
+        auto min_bw = make_request(MP::MinBandwidth, 640, 480, 30, PF::Unknown);
+        check(rep, selects(modes, min_bw, PF::YUY2, 640, 480, FPS_30), "mjpg first, min bandwidth keeps YUY2");
+
+        auto named = make_request(MP::MaxResolution, 0, 0, 30, PF::MJPG);
+        check(rep, selects(modes, named, PF::MJPG, 1920, 1080, FPS_30), "mjpg first, a request naming MJPG gets it");
+
+        auto exact = make_request(MP::Exact, 640, 480, 0, PF::MJPG);
+        check(rep, selects(modes, exact, PF::MJPG, 640, 480, FPS_30), "mjpg first, exact MJPG request");
+    }
+
+
+    static void check_mjpg_only(CheckReport& rep)
+    {
+        auto modes = mjpg_only_camera();
+
+        check(rep, selects(modes, cam::ModeRequest{}, PF::MJPG, 640, 480, FPS_30), "mjpg only, default request still opens");
+
+        auto yuy2 = make_request(cam::ModePolicy::Exact, 640, 480, 0, PF::YUY2);
+        check(rep, cam::modes::select_mode(modes, yuy2) < 0, "mjpg only, YUY2 request matches nothing");
+    }
+
+
+    static bool has_mode(cam::CameraModeList const& modes, PF format, u32 width, u32 height, u32 interval)
+    {
+        for (u32 i = 0; i < modes.count; i++)
+        {
+            auto& mode = modes.list[i];
+            if (cam::modes::same_frame(mode, (u32)format, width, height) && mode.interval == interval)
+            {
+                return true;
+            }
+        }
+
+        return false;
+    }
+
+
+    static void check_full_list(CheckReport& rep)
+    {
+        constexpr u32 N = cam::CAMERA_MODES_MAX;
+
+        // more intervals than fit, every size stays
+        cam::CameraModeList modes{};
+
+        for (u32 s = 0; s < N / 2; s++)
+        {
+            add(modes, PF::YUY2, 160 + s * 16, 120, FPS_15);
+            add(modes, PF::YUY2, 160 + s * 16, 120, FPS_15 * 2);
+            add(modes, PF::YUY2, 160 + s * 16, 120, FPS_15 * 4);
+        }
+
+        u32 n_sizes = 0;
+        for (u32 s = 0; s < N / 2; s++)
+        {
+            n_sizes += has_mode(modes, PF::YUY2, 160 + s * 16, 120, FPS_15);
+        }
+
+        check(rep, modes.count == N && modes.truncated, "full list, truncated is set");
+        check(rep, n_sizes == N / 2, "full list, every size keeps its fastest interval");
+
+        // one interval per size, a faster interval replaces the only one
+        modes = cam::CameraModeList{};
+
+        for (u32 s = 0; s < N; s++)
+        {
+            add(modes, PF::YUY2, 160 + s * 16, 120, FPS_15);
+        }
+
+        check(rep, modes.count == N && !modes.truncated, "one interval per size, fits");
+
+        add(modes, PF::YUY2, 160, 120, FPS_30);
+        check(rep, has_mode(modes, PF::YUY2, 160, 120, FPS_30) && !has_mode(modes, PF::YUY2, 160, 120, FPS_15),
+            "one interval per size, faster interval replaces it");
+
+        add(modes, PF::YUY2, 176, 120, FPS_15 * 2);
+        check(rep, has_mode(modes, PF::YUY2, 176, 120, FPS_15) && !has_mode(modes, PF::YUY2, 176, 120, FPS_15 * 2),
+            "one interval per size, slower interval is dropped");
+
+        add(modes, PF::MJPG, 640, 480, FPS_30);
+        check(rep, modes.count == N && modes.truncated && !has_mode(modes, PF::MJPG, 640, 480, FPS_30),
+            "one interval per size, a new size is dropped");
+    }
+}
+
+
+int main()
+{
+    CheckReport rep{};
+
+    check_mjpg_first(rep);
+    check_mjpg_only(rep);
+    check_full_list(rep);
+
+    return tool::print_summary(rep);
+}
+
+#include "../../../libs/image/image.cpp"
+#include "../../../libs/image/convert.cpp"
+#include "../../../libs/span/span.cpp"
+#include "../../../libs/qsprintf/qsprintf.cpp"
+#include "../../../libs/alloc_type/alloc_type.cpp"
@@ -0,0 +1,458 @@
+#include "../../../libs/util/types.hpp"
+
+#define LIBUVC_IMPLEMENTATION
+#include "../../../libs/usb/libuvc3.hpp"
+#include "../../../libs/usb/uvc_payload.hpp"
+#include "../tool.hpp"
+
+#include <algorithm>
+#include <vector>
+#include <cstring>
+#include <cstdlib>
+#include <cstdio>
+#include <functional>
+
+
+/* options */
+
+namespace
+{
+    class BenchOptions
+    {
+    public:
+        u32 warm_up = 3;
+        u32 repetitions = 20;
+    };
+
+
+    struct Resolution
+    {
+        u32 width;
+        u32 height;
+    };
+
+
+    const Resolution resolutions[] = {
+        { 640, 480 },
+        { 1280, 720 },
+        { 1920, 1080 },
+    };
+
+
+    static void print_usage()
+    {
+        printf("usage: payload_bench [--reps <n>] [--warmup <n>]\n");
+    }
+
+
+    static bool parse_options(int argc, char* argv[], BenchOptions& opt)
+    {
+        auto ok = tool::read_args(argc, argv, 1, [&](tool::ArgReader& args)
+        {
+            return
+                args.read_value("--reps", opt.repetitions) ||
+                args.read_value("--warmup", opt.warm_up);
+        });
+
+        return ok && opt.repetitions > 0;
+    }
+}
+
+
+/* recording */
+
+namespace
+{
+    constexpr u32 HEADER_BYTES = camera_usb::payload::HEADER_BYTES;
+
+    // high bandwidth high speed endpoint, 3 x 1024 bytes per microframe
+    constexpr u32 ISO_PACKET_BYTES = 3 * 1024;
+    constexpr u32 ISO_PACKETS = 32;
+
+    // distinct frames, the recording repeats them
+    constexpr u32 RECORDED_FRAMES = 4;
+
+
+    using Bytes = std::vector<u8>;
+
+
+    // payloads as the camera sent them, header first
+    class Recording
+    {
+    public:
+        u32 frame_bytes = 0;
+        u32 payload_bytes = 0;
+
+        std::vector<Bytes> frames;
+        std::vector<Bytes> payloads;
+    };
+
+
+    static void fill_frame(Bytes& frame, u32 seed)
+    {
+        // deterministic noise, same frame every run
+        u32 state = 0x12345678 + seed;
+
+        for (auto& b : frame)
+        {
+            state = state * 1664525u + 1013904223u;
+            b = (u8)(state >> 24);
+        }
+    }
+
+
+    static void record_frames(Recording& rec, u32 frame_bytes)
+    {
+        rec.frame_bytes = frame_bytes;
+        rec.frames.resize(RECORDED_FRAMES);
+
+        for (u32 i = 0; i < RECORDED_FRAMES; i++)
+        {
+            rec.frames[i].resize(frame_bytes);
+            fill_frame(rec.frames[i], i);
+        }
+    }
+
+
+    // one payload per frame, the stream's payload size holds a whole frame
+    static Recording record_bulk(u32 frame_bytes)
+    {
+        Recording rec{};
+        record_frames(rec, frame_bytes);
+
+        rec.payload_bytes = HEADER_BYTES + frame_bytes;
+
+        for (u32 f = 0; f < RECORDED_FRAMES; f++)
+        {
+            Bytes payload(rec.payload_bytes);
+            camera_usb::payload::write_header(payload.data(), f, true, f * 333'333, f * 48'000);
+            memcpy(payload.data() + HEADER_BYTES, rec.frames[f].data(), frame_bytes);
+
+            rec.payloads.push_back(std::move(payload));
+        }
+
+        return rec;
+    }
+
+
+    // one payload per packet, the last packet of a frame is short and has EOF
+    static Recording record_iso(u32 frame_bytes)
+    {
+        Recording rec{};
+        record_frames(rec, frame_bytes);
+
+        rec.payload_bytes = ISO_PACKET_BYTES;
+
+        constexpr u32 data_bytes = ISO_PACKET_BYTES - HEADER_BYTES;
+
+        for (u32 f = 0; f < RECORDED_FRAMES; f++)
+        {
+            for (u32 offset = 0; offset < frame_bytes; offset += data_bytes)
+            {
+                auto len = std::min(data_bytes, frame_bytes - offset);
+                auto eof = offset + len == frame_bytes;
+
+                Bytes payload(HEADER_BYTES + len);
+                camera_usb::payload::write_header(payload.data(), f, eof, f * 333'333, f * 48'000 + offset / data_bytes);
+                memcpy(payload.data() + HEADER_BYTES, rec.frames[f].data() + offset, len);
+
+                rec.payloads.push_back(std::move(payload));
+            }
+        }
+
+        return rec;
+    }
+}
+
+
+/* stream */
+
+namespace
+{
+    using uvc_stream = uvc::uvc_stream_handle_t;
+
+
+    // only what the payload path touches, nothing is opened
+    static uvc_stream* create_stream(uvc::uvc_device_handle_t* devh, Recording const& rec, bool iso, bool scatter)
+    {
+        auto strmh = uvc::uvc_malloc<uvc_stream>("bench strmh");
+        if (!strmh)
+        {
+            return nullptr;
+        }
+
+        strmh->devh = devh;
+        strmh->cur_ctrl.dwMaxVideoFrameSize = rec.frame_bytes;
+        strmh->cur_ctrl.dwMaxPayloadTransferSize = rec.payload_bytes;
+
+        strmh->frame_buf_bytes = std::max(rec.frame_bytes, rec.payload_bytes);
+        strmh->frame_bytes = rec.frame_bytes;
+
+        strmh->xfer_iso = iso;
+        strmh->xfer_packets = iso ? (int)ISO_PACKETS : 0;
+        strmh->xfer_packet_bytes = iso ? ISO_PACKET_BYTES : 0;
+        strmh->xfer_size = iso ? ISO_PACKETS * ISO_PACKET_BYTES : rec.payload_bytes;
+        strmh->xfer_scatter = scatter;
+
+        strmh->outbuf = uvc::_uvc_alloc_frame_buf(strmh, "bench outbuf");
+        strmh->holdbuf = uvc::_uvc_alloc_frame_buf(strmh, "bench holdbuf");
+        strmh->meta_outbuf = uvc::uvc_malloc<u8>(LIBUVC_XFER_META_BUF_SIZE, "bench meta_outbuf");
+        strmh->meta_holdbuf = uvc::uvc_malloc<u8>(LIBUVC_XFER_META_BUF_SIZE, "bench meta_holdbuf");
+
+        uvc::mutex_init(strmh->cb_mutex);
+
+        return strmh;
+    }
+
+
+    static void destroy_stream(uvc_stream* strmh)
+    {
+        uvc::_uvc_free_frame_buf(strmh->outbuf);
+        uvc::_uvc_free_frame_buf(strmh->holdbuf);
+        uvc::uvc_free(strmh->meta_outbuf);
+        uvc::uvc_free(strmh->meta_holdbuf);
+
+        uvc::mutex_destroy(strmh->cb_mutex);
+
+        uvc::uvc_free(strmh);
+    }
+
+
+    static libusb_transfer* create_transfer(u32 n_packets)
+    {
+        auto size = sizeof(libusb_transfer) + n_packets * sizeof(libusb_iso_packet_descriptor);
+
+        return (libusb_transfer*)calloc(1, size);
+    }
+
+
+    // the last frame of the recording was published complete
+    static bool check_frame(uvc_stream* strmh, Recording const& rec)
+    {
+        auto& last = rec.frames.back();
+
+        return strmh->hold_bytes == rec.frame_bytes && !memcmp(strmh->holdbuf, last.data(), rec.frame_bytes);
+    }
+}
+
+
+/* replay */
+
+namespace
+{
+    class BenchResult
+    {
+    public:
+        f64 mb_s = 0.0;
+        f64 us_frame = 0.0;
+        f64 p50_ms = 0.0;
+        f64 p99_ms = 0.0;
+
+        bool ok = false;
+    };
+
+
+    // processing time of one pass over the recording, receiving into the transfers is not counted
+    using replay_fn = std::function<f64()>;
+
+
+    static BenchResult run_bench(replay_fn const& fn, u32 frame_bytes, BenchOptions const& opt)
+    {
+        auto t = tool::time_repetitions(fn, opt.warm_up, opt.repetitions);
+
+        BenchResult res{};
+        res.mb_s = (f64)frame_bytes * RECORDED_FRAMES / (t.mean_ms * 1000.0);
+        res.us_frame = t.mean_ms * 1000.0 / RECORDED_FRAMES;
+        res.p50_ms = t.p50_ms;
+        res.p99_ms = t.p99_ms;
+
+        return res;
+    }
+
+
+    // the path before batching, one _uvc_process_payload per packet
+    static f64 replay_iso_packets(uvc_stream* strmh, std::vector<libusb_transfer*> const& transfers)
+    {
+        Stopwatch sw;
+        sw.start();
+
+        for (auto transfer : transfers)
+        {
+            for (int i = 0; i < transfer->num_iso_packets; i++)
+            {
+                auto pkt = transfer->iso_packet_desc + i;
+                auto buf = libusb_get_iso_packet_buffer_simple(transfer, (u32)i);
+
+                uvc::_uvc_process_payload(strmh, buf, pkt->actual_length);
+            }
+        }
+
+        return sw.get_time_milli();
+    }
+
+
+    static f64 replay_iso_batched(uvc_stream* strmh, std::vector<libusb_transfer*> const& transfers)
+    {
+        Stopwatch sw;
+        sw.start();
+
+        for (auto transfer : transfers)
+        {
+            uvc::_uvc_process_iso_transfer(strmh, transfer);
+        }
+
+        return sw.get_time_milli();
+    }
+
+
+    // receives each payload into the transfer as the host controller would
+    static f64 replay_bulk(uvc_stream* strmh, libusb_transfer* transfer, Recording const& rec)
+    {
+        Stopwatch sw;
+        f64 total_ms = 0.0;
+
+        for (auto& payload : rec.payloads)
+        {
+            memcpy(transfer->buffer, payload.data(), payload.size());
+            transfer->actual_length = (int)payload.size();
+
+            sw.start();
+            uvc::_uvc_process_bulk_transfer(strmh, transfer);
+            total_ms += sw.get_time_milli();
+        }
+
+        return total_ms;
+    }
+}
+
+
+/* benchmarks */
+
+namespace
+{
+    static void print_result(BenchResult const& res, Resolution size, cstr transfer, cstr path)
+    {
+        printf("%-4s %-12s %4ux%-4u %9.1f MB/s %9.1f us/frame  p50 %7.3f ms  p99 %7.3f ms  %s\n",
+            transfer, path, size.width, size.height, res.mb_s, res.us_frame, res.p50_ms, res.p99_ms, res.ok ? "OK" : "FAIL");
+    }
+
+
+    static bool bench_iso(uvc::uvc_device_handle_t* devh, Resolution size, BenchOptions const& opt)
+    {
+        auto rec = record_iso(size.width * size.height * 2);
+
+        // transfers filled once, the packet path only reads them
+        std::vector<libusb_transfer*> transfers;
+        std::vector<Bytes> buffers;
+
+        for (u32 p = 0; p < rec.payloads.size(); p += ISO_PACKETS)
+        {
+            auto n = std::min(ISO_PACKETS, (u32)rec.payloads.size() - p);
+
+            auto transfer = create_transfer(n);
+            buffers.emplace_back(ISO_PACKETS * ISO_PACKET_BYTES);
+
+            transfer->buffer = buffers.back().data();
+            transfer->num_iso_packets = (int)n;
+
+            for (u32 i = 0; i < n; i++)
+            {
+                auto& payload = rec.payloads[p + i];
+
+                transfer->iso_packet_desc[i].length = ISO_PACKET_BYTES;
+                transfer->iso_packet_desc[i].actual_length = (u32)payload.size();
+                memcpy(transfer->buffer + i * ISO_PACKET_BYTES, payload.data(), payload.size());
+            }
+
+            transfers.push_back(transfer);
+        }
+
+        bool ok = true;
+
+        auto strmh = create_stream(devh, rec, true, false);
+        auto res = run_bench([&](){ return replay_iso_packets(strmh, transfers); }, rec.frame_bytes, opt);
+        res.ok = check_frame(strmh, rec);
+        print_result(res, size, "iso", "per_packet");
+        ok &= res.ok;
+        destroy_stream(strmh);
+
+        strmh = create_stream(devh, rec, true, false);
+        res = run_bench([&](){ return replay_iso_batched(strmh, transfers); }, rec.frame_bytes, opt);
+        res.ok = check_frame(strmh, rec);
+        print_result(res, size, "iso", "batched");
+        ok &= res.ok;
+        destroy_stream(strmh);
+
+        for (auto transfer : transfers)
+        {
+            free(transfer);
+        }
+
+        return ok;
+    }
+
+
+    static bool bench_bulk(uvc::uvc_device_handle_t* devh, Resolution size, BenchOptions const& opt)
+    {
+        auto rec = record_bulk(size.width * size.height * 2);
+
+        bool ok = true;
+
+        auto transfer = create_transfer(0);
+
+        // copy, a transfer buffer of its own
+        auto strmh = create_stream(devh, rec, false, false);
+        Bytes buffer(rec.payload_bytes);
+        transfer->buffer = buffer.data();
+
+        auto res = run_bench([&](){ return replay_bulk(strmh, transfer, rec); }, rec.frame_bytes, opt);
+        res.ok = check_frame(strmh, rec);
+        print_result(res, size, "bulk", "copy");
+        ok &= res.ok;
+        destroy_stream(strmh);
+
+        // scatter, the transfer receives into a frame buffer and trades it with the stream
+        strmh = create_stream(devh, rec, false, true);
+        transfer->buffer = uvc::_uvc_alloc_frame_buf(strmh, "bench transfer") - LIBUVC_BULK_HEADER_BYTES;
+
+        res = run_bench([&](){ return replay_bulk(strmh, transfer, rec); }, rec.frame_bytes, opt);
+        res.ok = check_frame(strmh, rec) && strmh->scatter_frames;
+        print_result(res, size, "bulk", "scatter");
+        ok &= res.ok;
+
+        uvc::_uvc_free_frame_buf(transfer->buffer + LIBUVC_BULK_HEADER_BYTES);
+        destroy_stream(strmh);
+
+        free(transfer);
+
+        return ok;
+    }
+}
+
+
+int main(int argc, char* argv[])
+{
+    BenchOptions opt{};
+
+    if (!parse_options(argc, argv, opt))
+    {
+        print_usage();
+        return EXIT_FAILURE;
+    }
+
+    auto devh = uvc::uvc_malloc<uvc::uvc_device_handle_t>("bench devh");
+
+    bool ok = true;
+
+    for (auto size : resolutions)
+    {
+        ok &= bench_iso(devh, size, opt);
+        ok &= bench_bulk(devh, size, opt);
+    }
+
+    uvc::uvc_free(devh);
+
+    return ok ? EXIT_SUCCESS : EXIT_FAILURE;
+}
+
+#include "../../../libs/span/span.cpp"
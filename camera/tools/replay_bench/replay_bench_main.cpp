@@ -0,0 +1,399 @@
+// the replay file format is in the libuvc implementation
+#include "../../../libs/usb/camera_uvc.cpp"
+#include "../../../libs/usb/uvc_payload.hpp"
+#include "../tool.hpp"
+
+#include <vector>
+#include <string>
+#include <thread>
+
+namespace cam = camera_usb;
+
+
+/* options */
+
+namespace
+{
+    enum class Mode : u32
+    {
+        Replay = 0,
+        Record,
+        Make
+    };
+
+
+    class BenchOptions
+    {
+    public:
+        Mode mode = Mode::Replay;
+        cstr path = nullptr;
+
+        u32 seconds = 5;
+
+        // replay
+        f32 rate = 0.0f;
+        u32 n_cameras = 1;
+
+        // make
+        u32 width = 1280;
+        u32 height = 720;
+        u32 n_frames = 30;
+    };
+
+
+    static void print_usage()
+    {
+        printf(
+            "usage: replay_bench <file> [--rate <r>] [--cameras <n>] [--seconds <n>]\n"
+            "       replay_bench record <file> [--seconds <n>]\n"
+            "       replay_bench make <file> [--size <w>x<h>] [--frames <n>]\n"
+            "\n"
+            "  rate 0 replays as fast as possible, 1 with the recorded timing\n"
+            "  record writes the payloads of the first camera at 640 x 480\n"
+            "  make writes a synthetic YUYV recording at 30 fps\n"
+            );
+    }
+
+
+    static bool parse_options(int argc, char* argv[], BenchOptions& opt)
+    {
+        tool::ArgReader args{ argc, argv, 1 };
+
+        if (args.i < argc)
+        {
+            args.read_flag("record", opt.mode, Mode::Record) || args.read_flag("make", opt.mode, Mode::Make);
+        }
+
+        if (args.i >= argc)
+        {
+            return false;
+        }
+
+        opt.path = argv[args.i];
+
+        auto ok = tool::read_args(argc, argv, args.i + 1, [&](tool::ArgReader& args)
+        {
+            return
+                args.read_value("--rate", opt.rate) ||
+                args.read_value("--cameras", opt.n_cameras) ||
+                args.read_value("--seconds", opt.seconds) ||
+                args.read_size("--size", opt.width, opt.height) ||
+                args.read_value("--frames", opt.n_frames);
+        });
+
+        return ok && opt.seconds > 0 && opt.n_cameras > 0 && opt.n_frames > 0 && opt.width && opt.height;
+    }
+}
+
+
+/* make */
+
+namespace
+{
+    constexpr u32 HEADER_BYTES = cam::payload::HEADER_BYTES;
+
+    // high bandwidth high speed endpoint, 3 x 1024 bytes per microframe
+    constexpr u32 ISO_PACKET_BYTES = 3 * 1024;
+    constexpr u64 ISO_PACKET_NS = 125'000;
+
+    // 30 fps in 100 ns units
+    constexpr u32 FRAME_INTERVAL = 333'333;
+
+    constexpr u8 YUY2_GUID[16] = { 'Y', 'U', 'Y', '2', 0x00, 0x00, 0x10, 0x00, 0x80, 0x00, 0x00, 0xaa, 0x00, 0x38, 0x9b, 0x71 };
+
+
+    // a bar moving across a gray ramp, each frame differs
+    static void fill_frame(std::vector<u8>& frame, u32 width, u32 height, u32 index)
+    {
+        auto bar = (index * 16) % width;
+
+        for (u32 y = 0; y < height; y++)
+        {
+            auto row = frame.data() + (size_t)y * width * 2;
+
+            for (u32 x = 0; x < width; x++)
+            {
+                auto on_bar = x >= bar && x < bar + 16;
+
+                row[2 * x] = on_bar ? 235 : (u8)(16 + (x * 219) / width);
+                row[2 * x + 1] = 128;
+            }
+        }
+    }
+
+
+    // iso packets as a high speed camera sends them, the last of a frame is short and has EOF
+    static bool make_recording(BenchOptions const& opt)
+    {
+        auto frame_bytes = opt.width * opt.height * 2;
+
+        uvc::_uvc_replay_header header = {};
+        memcpy(header.magic, uvc::_uvc_replay_magic, sizeof(header.magic));
+        header.version = uvc::_uvc_replay_version;
+        memcpy(header.guidFormat, YUY2_GUID, sizeof(header.guidFormat));
+        header.bDescriptorSubtype = uvc::UVC_VS_FORMAT_UNCOMPRESSED;
+        header.bBitsPerPixel = 16;
+        header.width = opt.width;
+        header.height = opt.height;
+        header.dwFrameInterval = FRAME_INTERVAL;
+        header.dwMaxVideoFrameSize = frame_bytes;
+        header.dwMaxPayloadTransferSize = ISO_PACKET_BYTES;
+
+        auto file = fopen(opt.path, "wb");
+        if (!file)
+        {
+            printf("could not write %s\n", opt.path);
+            return false;
+        }
+
+        bool ok = fwrite(&header, sizeof(header), 1, file) == 1;
+
+        std::vector<u8> frame(frame_bytes);
+        u8 payload[ISO_PACKET_BYTES];
+
+        constexpr u32 data_bytes = ISO_PACKET_BYTES - HEADER_BYTES;
+
+        u64 n_payloads = 0;
+
+        for (u32 f = 0; f < opt.n_frames && ok; f++)
+        {
+            fill_frame(frame, opt.width, opt.height, f);
+
+            auto frame_ns = (u64)f * FRAME_INTERVAL * 100;
+            u32 packet = 0;
+
+            for (u32 offset = 0; offset < frame_bytes && ok; offset += data_bytes, packet++)
+            {
+                auto len = std::min(data_bytes, frame_bytes - offset);
+                auto eof = offset + len == frame_bytes;
+
+                cam::payload::write_header(payload, f, eof, f * FRAME_INTERVAL, f * 48'000 + packet);
+                memcpy(payload + HEADER_BYTES, frame.data() + offset, len);
+
+                uvc::_uvc_replay_record record = {};
+                record.time_ns = frame_ns + packet * ISO_PACKET_NS;
+                record.length = HEADER_BYTES + len;
+
+                ok = fwrite(&record, sizeof(record), 1, file) == 1 &&
+                    fwrite(payload, record.length, 1, file) == 1;
+
+                n_payloads++;
+            }
+        }
+
+        ok &= fclose(file) == 0;
+
+        if (ok)
+        {
+            printf("%s: %u x %u YUYV, %u frames, %llu payloads\n", opt.path, opt.width, opt.height, opt.n_frames, (unsigned long long)n_payloads);
+        }
+        else
+        {
+            printf("could not write %s\n", opt.path);
+        }
+
+        return ok;
+    }
+}
+
+
+/* record */
+
+namespace
+{
+    static bool record_camera(BenchOptions const& opt)
+    {
+        auto cameras = cam::enumerate_cameras();
+        if (!cameras.count)
+        {
+            printf("no cameras\n");
+            return false;
+        }
+
+        auto& camera = cameras.list[0];
+
+        bool ok = cam::open_camera(camera) && cam::start_recording(camera, opt.path);
+        if (ok)
+        {
+            printf("recording %u x %u %.*s to %s\n", camera.frame_width, camera.frame_height,
+                (int)camera.format.length, camera.format.begin, opt.path);
+
+            std::this_thread::sleep_for(std::chrono::seconds(opt.seconds));
+
+            auto n = cam::stop_recording(camera);
+            printf("%llu payloads\n", (unsigned long long)n);
+        }
+        else
+        {
+            printf("could not record\n");
+        }
+
+        cam::close(cameras);
+
+        return ok;
+    }
+}
+
+
+/* replay */
+
+namespace
+{
+    class ReaderStats
+    {
+    public:
+        u64 frames = 0;
+        u64 gaps = 0;
+    };
+
+
+    static void read_frames(cam::Camera& camera, ReaderStats& rs, std::atomic<bool> const& on)
+    {
+        cam::FrameYUV frame;
+        u64 last = 0;
+
+        while (on)
+        {
+            if (!cam::read_frame(camera, frame))
+            {
+                std::this_thread::sleep_for(std::chrono::microseconds(100));
+                continue;
+            }
+
+            if (rs.frames && frame.sequence != last + 1)
+            {
+                rs.gaps++;
+            }
+
+            last = frame.sequence;
+            rs.frames++;
+
+            cam::release_frame(camera);
+        }
+    }
+
+
+    static bool replay(BenchOptions const& opt)
+    {
+        auto n = std::min(opt.n_cameras, cam::REPLAY_DEVICES_MAX);
+
+        std::string paths = opt.path;
+        for (u32 i = 1; i < n; i++)
+        {
+            paths += ":";
+            paths += opt.path;
+        }
+
+        char rate[32];
+        snprintf(rate, sizeof(rate), "%f", opt.rate);
+
+        setenv("CAMERA_REPLAY", paths.c_str(), 1);
+        setenv("CAMERA_REPLAY_RATE", rate, 1);
+
+        auto cameras = cam::enumerate_cameras();
+        if (cameras.count < n)
+        {
+            printf("could not open %s\n", opt.path);
+            cam::close(cameras);
+            return false;
+        }
+
+        // recordings are listed after the usb cameras
+        auto first = cameras.count - n;
+
+        cam::ModeRequest request{};
+        request.policy = cam::ModePolicy::MaxFps;
+        request.width = 0;
+        request.height = 0;
+
+        bool ok = true;
+
+        for (u32 i = first; i < cameras.count && ok; i++)
+        {
+            auto& camera = cameras.list[i];
+            ok = cam::open_camera(camera, request) && cam::start_stream_ring(camera, 4, cam::OverflowPolicy::DropOldest);
+        }
+
+        if (!ok)
+        {
+            printf("could not stream %s\n", opt.path);
+            cam::close(cameras);
+            return false;
+        }
+
+        auto& c0 = cameras.list[first];
+        printf("%s: %u x %u %.*s, %u camera(s), rate %g\n", opt.path, c0.frame_width, c0.frame_height,
+            (int)c0.format.length, c0.format.begin, n, opt.rate);
+
+        std::atomic<bool> on = true;
+
+        ReaderStats rs[cam::REPLAY_DEVICES_MAX] = {};
+        std::thread readers[cam::REPLAY_DEVICES_MAX];
+
+        for (u32 i = 0; i < n; i++)
+        {
+            readers[i] = std::thread([&, i](){ read_frames(cameras.list[first + i], rs[i], on); });
+        }
+
+        std::this_thread::sleep_for(std::chrono::seconds(opt.seconds));
+
+        cam::CameraStats stats[cam::REPLAY_DEVICES_MAX];
+        for (u32 i = 0; i < n; i++)
+        {
+            stats[i] = cam::get_stats(cameras.list[first + i]);
+        }
+
+        on = false;
+        for (u32 i = 0; i < n; i++)
+        {
+            readers[i].join();
+            cam::stop_stream(cameras.list[first + i]);
+        }
+
+        printf("camera,read_fps,stream_fps,latency_ms,latency_max_ms,convert_ms,frames,dropped_transfer,dropped_consumer,gaps\n");
+
+        for (u32 i = 0; i < n; i++)
+        {
+            auto& s = stats[i];
+            printf("%u,%.1f,%.1f,%.3f,%.3f,%.3f,%llu,%llu,%llu,%llu\n",
+                i, (f64)rs[i].frames / opt.seconds, s.fps, s.latency_ms, s.latency_max_ms, s.convert_ms,
+                (unsigned long long)s.frames, (unsigned long long)s.dropped_transfer, (unsigned long long)s.dropped_consumer,
+                (unsigned long long)rs[i].gaps);
+
+            ok &= rs[i].frames > 0;
+        }
+
+        cam::close(cameras);
+
+        return ok;
+    }
+}
+
+
+int main(int argc, char* argv[])
+{
+    BenchOptions opt{};
+
+    if (!parse_options(argc, argv, opt))
+    {
+        print_usage();
+        return EXIT_FAILURE;
+    }
+
+    bool ok = false;
+
+    switch (opt.mode)
+    {
+    case Mode::Replay: ok = replay(opt); break;
+    case Mode::Record: ok = record_camera(opt); break;
+    case Mode::Make: ok = make_recording(opt); break;
+    }
+
+    return ok ? EXIT_SUCCESS : EXIT_FAILURE;
+}
+
+#include "../../../libs/alloc_type/alloc_type.cpp"
+#include "../../../libs/image/image.cpp"
+#include "../../../libs/qsprintf/qsprintf.cpp"
+#include "../../../libs/span/span.cpp"
+#include "../../../libs/image/convert.cpp"
@@ -0,0 +1,273 @@
+#include "../../../libs/usb/camera_uvc.cpp"
+#include "../tool.hpp"
+
+#include <thread>
+
+namespace cam = camera_usb;
+
+
+/* options */
+
+namespace
+{
+    class SoakOptions
+    {
+    public:
+        // see synthetic::parse_cameras
+        cstr cameras = "16";
+
+        u32 seconds = 10;
+        u32 report_seconds = 2;
+
+        cstr jitter_us = nullptr;
+        cstr drop_rate = nullptr;
+
+        u32 decode_workers = 4;
+        u32 ring_capacity = 4;
+    };
+
+
+    static void print_usage()
+    {
+        printf(
+            "usage: synthetic_soak [--cameras <spec>] [--seconds <n>] [--report <n>]\n"
+            "                      [--jitter <us>] [--drop <rate>] [--workers <n>] [--ring <n>]\n"
+            "\n"
+            "  spec is a camera count or entries like NV12:1280x720@30:counter*4, separated by ','\n"
+            "  counter cameras fail the run when a frame read is older than the one before it\n"
+            );
+    }
+
+
+    static bool parse_options(int argc, char* argv[], SoakOptions& opt)
+    {
+        auto ok = tool::read_args(argc, argv, 1, [&](tool::ArgReader& args)
+        {
+            return
+                args.read_value("--cameras", opt.cameras) ||
+                args.read_value("--seconds", opt.seconds) ||
+                args.read_value("--report", opt.report_seconds) ||
+                args.read_value("--jitter", opt.jitter_us) ||
+                args.read_value("--drop", opt.drop_rate) ||
+                args.read_value("--workers", opt.decode_workers) ||
+                args.read_value("--ring", opt.ring_capacity);
+        });
+
+        return ok && opt.seconds > 0 && opt.report_seconds > 0 && opt.ring_capacity > 0;
+    }
+}
+
+
+/* readers */
+
+namespace
+{
+    class ReaderState
+    {
+    public:
+        cam::SyntheticCamera spec;
+
+        std::atomic<u64> frames = 0;
+        std::atomic<u64> counter_errors = 0;
+
+        u64 last_counter = 0;
+        b8 has_counter = 0;
+
+        // corrected capture times against the frame interval, see check_capture_time
+        std::atomic<u64> capture_err_max_ns = 0;
+        u64 last_capture_ns = 0;
+    };
+
+
+    static void check_counter(ReaderState& rs, cam::FrameYUV const& frame)
+    {
+        auto& view = frame.view;
+        auto row = view.channel_data[0] + (size_t)cam::synthetic::counter_row(view.height) * view.width;
+        auto counter = cam::synthetic::read_counter(row, view.width);
+
+        // MJPG frames repeat, a frame must at least differ from the one before
+        auto mjpeg = rs.spec.pixel_format == convert::PixelFormat::MJPG;
+        auto ok = mjpeg ? counter < cam::SYNTHETIC_JPEG_CYCLE && counter != rs.last_counter : counter > rs.last_counter;
+
+        if (rs.has_counter && !ok)
+        {
+            rs.counter_errors++;
+        }
+
+        rs.last_counter = counter;
+        rs.has_counter = 1;
+    }
+
+
+    // synthetic pts are exact, corrected capture times fall on the frame interval
+    static void check_capture_time(ReaderState& rs, cam::FrameYUV const& frame, u64 n_frames)
+    {
+        auto interval_ns = (i64)(1'000'000'000ull / rs.spec.fps);
+        auto delta_ns = (i64)(frame.capture_ns - rs.last_capture_ns);
+
+        rs.last_capture_ns = frame.capture_ns;
+
+        // receive times until the device clock is fitted
+        if (n_frames <= cam::CLOCK_SAMPLES_MIN)
+        {
+            return;
+        }
+
+        auto n_intervals = (delta_ns + interval_ns / 2) / interval_ns;
+        auto err_ns = (u64)std::abs(delta_ns - n_intervals * interval_ns);
+
+        if (err_ns > rs.capture_err_max_ns)
+        {
+            rs.capture_err_max_ns = err_ns;
+        }
+    }
+
+
+    static void read_frames(cam::Camera& camera, ReaderState& rs, std::atomic<bool> const& on)
+    {
+        cam::FrameYUV frame;
+
+        while (on)
+        {
+            if (!cam::read_frame(camera, frame))
+            {
+                std::this_thread::sleep_for(std::chrono::microseconds(200));
+                continue;
+            }
+
+            if (rs.spec.pattern == cam::TestPattern::Counter)
+            {
+                check_counter(rs, frame);
+            }
+
+            check_capture_time(rs, frame, rs.frames);
+
+            rs.frames++;
+
+            cam::release_frame(camera);
+        }
+    }
+
+
+    static void print_report(cam::CameraList const& cameras, ReaderState const* rs, u32 elapsed_sec)
+    {
+        printf("\n%us\ncamera,format,size,fps,stream_fps,latency_ms,latency_max_ms,convert_ms,clock_jitter_ms,clock_hz,capture_err_us,dropped_transfer,dropped_consumer,counter_errors\n", elapsed_sec);
+
+        for (u32 i = 0; i < cameras.count; i++)
+        {
+            auto& camera = cameras.list[i];
+            auto s = cam::get_stats(camera);
+
+            printf("%.*s,%.*s,%ux%u,%u,%.1f,%.3f,%.3f,%.3f,%.3f,%.0f,%.1f,%llu,%llu,%llu\n",
+                (int)camera.label.length, camera.label.begin,
+                (int)camera.format.length, camera.format.begin,
+                camera.frame_width, camera.frame_height, camera.fps.load(),
+                s.fps, s.latency_ms, s.latency_max_ms, s.convert_ms,
+                s.clock_jitter_ms, s.device_clock_hz, rs[i].capture_err_max_ns.load() / 1000.0,
+                (unsigned long long)s.dropped_transfer, (unsigned long long)s.dropped_consumer,
+                (unsigned long long)rs[i].counter_errors.load());
+        }
+    }
+}
+
+
+int main(int argc, char* argv[])
+{
+    SoakOptions opt{};
+
+    if (!parse_options(argc, argv, opt))
+    {
+        print_usage();
+        return EXIT_FAILURE;
+    }
+
+    cam::SyntheticConfig config;
+    if (!cam::synthetic::parse_cameras(opt.cameras, config))
+    {
+        printf("bad camera spec %s\n", opt.cameras);
+        return EXIT_FAILURE;
+    }
+
+    // replaces the usb cameras for the whole process
+    setenv("CAMERA_SYNTHETIC", opt.cameras, 1);
+
+    if (opt.jitter_us)
+    {
+        setenv("CAMERA_SYNTHETIC_JITTER_US", opt.jitter_us, 1);
+    }
+
+    if (opt.drop_rate)
+    {
+        setenv("CAMERA_SYNTHETIC_DROP", opt.drop_rate, 1);
+    }
+
+    if (opt.decode_workers && !cam::create_decode_pool(opt.decode_workers))
+    {
+        printf("no decode pool\n");
+        return EXIT_FAILURE;
+    }
+
+    auto cameras = cam::enumerate_cameras();
+
+    // one mode per synthetic camera
+    cam::ModeRequest request{};
+    request.policy = cam::ModePolicy::MaxFps;
+    request.width = 0;
+    request.height = 0;
+
+    bool ok = cameras.count == config.count;
+
+    for (u32 i = 0; i < cameras.count && ok; i++)
+    {
+        auto& camera = cameras.list[i];
+        ok = cam::open_camera(camera, request) && cam::start_stream_ring(camera, opt.ring_capacity, cam::OverflowPolicy::DropOldest);
+    }
+
+    if (!ok)
+    {
+        printf("could not stream %u synthetic cameras\n", config.count);
+        cam::close(cameras);
+        cam::destroy_decode_pool();
+        return EXIT_FAILURE;
+    }
+
+    std::atomic<bool> on = true;
+
+    ReaderState rs[cam::SYNTHETIC_CAMERAS_MAX];
+    std::thread readers[cam::SYNTHETIC_CAMERAS_MAX];
+
+    for (u32 i = 0; i < cameras.count; i++)
+    {
+        rs[i].spec = config.cameras[i];
+        readers[i] = std::thread([&, i](){ read_frames(cameras.list[i], rs[i], on); });
+    }
+
+    for (u32 t = opt.report_seconds; t <= opt.seconds; t += opt.report_seconds)
+    {
+        std::this_thread::sleep_for(std::chrono::seconds(opt.report_seconds));
+        print_report(cameras, rs, t);
+    }
+
+    on = false;
+
+    for (u32 i = 0; i < cameras.count; i++)
+    {
+        readers[i].join();
+        cam::stop_stream(cameras.list[i]);
+
+        ok &= rs[i].frames > 0 && rs[i].counter_errors == 0;
+    }
+
+    cam::close(cameras);
+    cam::destroy_decode_pool();
+
+    printf("\n%s\n", ok ? "ok" : "FAILED");
+
+    return ok ? EXIT_SUCCESS : EXIT_FAILURE;
+}
+
+#include "../../../libs/alloc_type/alloc_type.cpp"
+#include "../../../libs/image/image.cpp"
+#include "../../../libs/qsprintf/qsprintf.cpp"
+#include "../../../libs/span/span.cpp"
+#include "../../../libs/image/convert.cpp"
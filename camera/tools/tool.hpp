@@ -0,0 +1,221 @@
+#pragma once
+
+// shared by the tools, include after the library headers
+
+#include "../../libs/util/types.hpp"
+#include "../../libs/util/stopwatch.hpp"
+
+#include <algorithm>
+#include <vector>
+#include <cstring>
+#include <cstdlib>
+#include <cstdio>
+
+
+/* options */
+
+namespace tool
+{
+    // reads "--name" and "--name <value>" arguments, a read that matches consumes them
+    class ArgReader
+    {
+    public:
+        int argc = 0;
+        char** argv = nullptr;
+
+        int i = 1;
+
+
+        bool read_flag(cstr name)
+        {
+            if (strcmp(argv[i], name))
+            {
+                return false;
+            }
+
+            i++;
+            return true;
+        }
+
+
+        template <typename T>
+        bool read_flag(cstr name, T& dst, T value)
+        {
+            if (!read_flag(name))
+            {
+                return false;
+            }
+
+            dst = value;
+            return true;
+        }
+
+
+        bool read_value(cstr name, cstr& dst)
+        {
+            if (i + 1 >= argc || strcmp(argv[i], name))
+            {
+                return false;
+            }
+
+            dst = argv[i + 1];
+            i += 2;
+            return true;
+        }
+
+
+        bool read_value(cstr name, u32& dst)
+        {
+            cstr value = nullptr;
+            if (!read_value(name, value))
+            {
+                return false;
+            }
+
+            dst = (u32)atoi(value);
+            return true;
+        }
+
+
+        bool read_value(cstr name, f32& dst)
+        {
+            cstr value = nullptr;
+            if (!read_value(name, value))
+            {
+                return false;
+            }
+
+            dst = (f32)atof(value);
+            return true;
+        }
+
+
+        // "<width>x<height>", 0 x 0 when the value is not a size
+        bool read_size(cstr name, u32& width, u32& height)
+        {
+            cstr value = nullptr;
+            if (!read_value(name, value))
+            {
+                return false;
+            }
+
+            if (sscanf(value, "%ux%u", &width, &height) != 2)
+            {
+                width = 0;
+                height = 0;
+            }
+
+            return true;
+        }
+    };
+
+
+    // read_one(ArgReader&) -> bool reads one option, false when none matches
+    template <class FN>
+    inline bool read_args(int argc, char* argv[], int first, FN const& read_one)
+    {
+        ArgReader args{ argc, argv, first };
+
+        while (args.i < argc)
+        {
+            if (!read_one(args))
+            {
+                return false;
+            }
+        }
+
+        return true;
+    }
+}
+
+
+/* timing */
+
+namespace tool
+{
+    class Timing
+    {
+    public:
+        f64 mean_ms = 0.0;
+        f64 p50_ms = 0.0;
+        f64 p99_ms = 0.0;
+    };
+
+
+    inline f64 percentile(std::vector<f64> const& sorted, f64 p)
+    {
+        auto i = (size_t)(p * (sorted.size() - 1) + 0.5);
+
+        return sorted[std::min(i, sorted.size() - 1)];
+    }
+
+
+    template <class FN>
+    inline f64 time_ms(FN const& fn)
+    {
+        Stopwatch sw;
+        sw.start();
+
+        fn();
+
+        return sw.get_time_milli();
+    }
+
+
+    // rep_ms() runs once and returns the milliseconds to count, see time_ms
+    template <class FN>
+    inline Timing time_repetitions(FN const& rep_ms, u32 warm_up, u32 repetitions)
+    {
+        for (u32 i = 0; i < warm_up; i++)
+        {
+            rep_ms();
+        }
+
+        std::vector<f64> times_ms(repetitions);
+
+        f64 total_ms = 0.0;
+        for (auto& t : times_ms)
+        {
+            t = rep_ms();
+            total_ms += t;
+        }
+
+        std::sort(times_ms.begin(), times_ms.end());
+
+        Timing res{};
+        res.mean_ms = total_ms / times_ms.size();
+        res.p50_ms = percentile(times_ms, 0.50);
+        res.p99_ms = percentile(times_ms, 0.99);
+
+        return res;
+    }
+}
+
+
+/* checks */
+
+namespace tool
+{
+    class CheckReport
+    {
+    public:
+        u32 n_checks = 0;
+        u32 n_failed = 0;
+    };
+
+
+    inline void add_check(CheckReport& rep, bool ok)
+    {
+        rep.n_checks++;
+        rep.n_failed += !ok;
+    }
+
+
+    // prints the totals, returns the exit code
+    inline int print_summary(CheckReport const& rep)
+    {
+        printf("\n%u checks, %u failed\n", rep.n_checks, rep.n_failed);
+
+        return rep.n_failed ? EXIT_FAILURE : EXIT_SUCCESS;
+    }
+}
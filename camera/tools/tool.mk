@@ -0,0 +1,67 @@
+# shared rules for the tools, each Makefile sets exe, GPP_OPT, ALL_LFLAGS and main_dep then includes this
+#
+#   exe := payload_bench
+#   GPP_OPT := -O3 -DNDEBUG
+#   ALL_LFLAGS = $(USB)
+#   main_dep = $(libs)/usb/libuvc3.hpp
+#
+#   include ../tool.mk
+
+GPP := g++-11 -std=c++20 -mavx
+
+GPP += $(GPP_OPT)
+
+NO_FLAGS :=
+USB := -pthread `pkg-config --libs --cflags libusb-1.0` -ljpeg
+
+
+root   := ../../..
+
+tools := $(root)/camera/tools
+
+src := $(tools)/$(exe)
+
+build := $(tools)/build/$(exe)
+
+libs := $(root)/libs
+
+program_exe := $(build)/$(exe)
+
+# the tool's arguments for make run, a multi line define runs it more than once
+run_commands ?= $(program_exe)
+
+
+
+#*** main cpp ***
+
+main_c := $(src)/$(exe)_main.cpp
+main_o := $(build)/main.o
+obj := $(main_o)
+
+#************
+
+
+$(main_o): $(main_c) $(main_dep) $(tools)/tool.hpp
+	@echo "\n  main"
+	$(GPP) -o $@ -c $< $(ALL_LFLAGS)
+
+
+$(program_exe): $(obj)
+	@echo "\n  program_exe"
+	$(GPP) -o $@ $+ $(ALL_LFLAGS)
+
+
+
+build: $(program_exe)
+
+
+run: build
+	$(run_commands)
+	@echo "\n"
+
+
+clean:
+	rm -rfv $(build)/*
+
+setup:
+	mkdir -p $(build)
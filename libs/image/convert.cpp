@@ -2,6 +2,251 @@
 
 #include "convert.hpp"
 
+#if defined(__SSE4_1__) || defined(__AVX__) || defined(__AVX2__)
+#define CONVERT_SIMD_128
+#endif
+
+// 256 bit kernels are always built and used when the cpu has AVX2, see use_simd_256
+#if defined(CONVERT_SIMD_128) && (defined(__GNUC__) || defined(_MSC_VER))
+#define CONVERT_SIMD_256
+#endif
+
+#if defined(__GNUC__) && !defined(__AVX2__)
+#define CONVERT_TARGET_256 __attribute__((target("avx2")))
+#else
+#define CONVERT_TARGET_256
+#endif
+
+
+#ifdef CONVERT_SIMD_128
+#include <immintrin.h>
+
+#ifdef _MSC_VER
+#include <intrin.h>
+#endif
+
+namespace convert
+{
+    using i128 = __m128i;
+
+#ifdef CONVERT_SIMD_256
+    using i256 = __m256i;
+#endif
+}
+
+#endif
+
+#include <atomic>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+
+#ifdef __linux__
+#include <pthread.h>
+#endif
+
+
+/* row bands */
+
+namespace convert
+{
+    constexpr u32 THREAD_COUNT_MAX = 16;
+    constexpr u32 BAND_HEIGHT_MIN = 16;
+
+
+    using band_fn = void (*)(void* ctx, u32 y_begin, u32 y_end);
+
+
+    class BandJob
+    {
+    public:
+        band_fn run = nullptr;
+        void* ctx = nullptr;
+
+        // band i is [y_begin[i], y_begin[i + 1])
+        u32 y_begin[THREAD_COUNT_MAX + 1] = { 0 };
+        u32 n_bands = 0;
+    };
+
+
+    class ThreadPool
+    {
+    public:
+        // including the calling thread, written with dispatch_mtx held
+        std::atomic<u32> n_threads = 1;
+
+        BandJob job;
+        u64 job_id = 0;
+        u32 n_remaining = 0;
+
+        u32 n_running = 0;
+        bool stop = false;
+
+        // one frame in flight, other callers convert on their own thread
+        std::mutex dispatch_mtx;
+
+        std::mutex mtx;
+        std::condition_variable cv_start;
+        std::condition_variable cv_done;
+
+        // detached workers must be gone before the condition variables are destroyed
+        ~ThreadPool()
+        {
+            std::lock_guard<std::mutex> dispatch_lock(dispatch_mtx);
+            stop_workers(*this);
+        }
+
+        // with dispatch_mtx held, a frame in flight finishes its bands before the workers go
+        static void stop_workers(ThreadPool& pool)
+        {
+            std::unique_lock<std::mutex> lock(pool.mtx);
+
+            pool.stop = true;
+            pool.cv_start.notify_all();
+            pool.cv_done.wait(lock, [&](){ return pool.n_running == 0; });
+
+            pool.stop = false;
+            pool.n_threads = 1;
+        }
+    };
+
+
+    static ThreadPool thread_pool;
+
+
+    static void run_worker(u32 worker_id, u64 job_id)
+    {
+        auto& pool = thread_pool;
+
+        std::unique_lock<std::mutex> lock(pool.mtx);
+
+        while (true)
+        {
+            pool.cv_start.wait(lock, [&](){ return pool.stop || pool.job_id != job_id; });
+            if (pool.stop)
+            {
+                break;
+            }
+
+            job_id = pool.job_id;
+            auto job = pool.job;
+
+            lock.unlock();
+
+            if (worker_id < job.n_bands)
+            {
+                job.run(job.ctx, job.y_begin[worker_id], job.y_begin[worker_id + 1]);
+            }
+
+            lock.lock();
+
+            pool.n_remaining--;
+            if (!pool.n_remaining)
+            {
+                pool.cv_done.notify_all();
+            }
+        }
+
+        pool.n_running--;
+        pool.cv_done.notify_all();
+    }
+
+
+    static bool pin_thread(std::thread& th, u32 core)
+    {
+#ifdef __linux__
+
+        cpu_set_t cpu_set;
+        CPU_ZERO(&cpu_set);
+        CPU_SET(core, &cpu_set);
+
+        return pthread_setaffinity_np(th.native_handle(), sizeof(cpu_set_t), &cpu_set) == 0;
+
+#else
+
+        return false;
+
+#endif
+    }
+
+
+    template <class FN>
+    static void for_each_band(u32 height, u32 align, FN const& band)
+    {
+        auto& pool = thread_pool;
+
+        auto const count_bands = [&](){ return num::min(pool.n_threads.load(), height / (align * BAND_HEIGHT_MIN)); };
+
+        if (count_bands() < 2 || !pool.dispatch_mtx.try_lock())
+        {
+            band(0u, height);
+            return;
+        }
+
+        std::unique_lock<std::mutex> dispatch_lock(pool.dispatch_mtx, std::adopt_lock);
+
+        // the pool may have been resized before the lock
+        auto n_bands = count_bands();
+        if (n_bands < 2)
+        {
+            band(0u, height);
+            return;
+        }
+
+        BandJob job{};
+        job.run = [](void* ctx, u32 y_begin, u32 y_end){ (*(FN const*)ctx)(y_begin, y_end); };
+        job.ctx = (void*)&band;
+        job.n_bands = n_bands;
+
+        auto n_aligned = height / align;
+        for (u32 i = 0; i < n_bands; i++)
+        {
+            job.y_begin[i] = align * (n_aligned * i / n_bands);
+        }
+        job.y_begin[n_bands] = height;
+
+        {
+            std::lock_guard<std::mutex> lock(pool.mtx);
+
+            pool.job = job;
+            pool.job_id++;
+            pool.n_remaining = pool.n_threads - 1;
+        }
+
+        pool.cv_start.notify_all();
+
+        band(job.y_begin[0], job.y_begin[1]);
+
+        std::unique_lock<std::mutex> lock(pool.mtx);
+        pool.cv_done.wait(lock, [&](){ return pool.n_remaining == 0; });
+    }
+
+
+    template <typename T>
+    static img::View1<T> sub_rows(img::View1<T> const& view, u32 y_begin, u32 y_end)
+    {
+        auto sub = view;
+        sub.matrix_data_ += y_begin * view.width;
+        sub.height = y_end - y_begin;
+
+        return sub;
+    }
+
+
+    static ViewYUV sub_rows(ViewYUV const& view, u32 y_begin, u32 y_end)
+    {
+        auto sub = view;
+        for (u32 ch = 0; ch < 3; ch++)
+        {
+            sub.channel_data[ch] += y_begin * view.width;
+        }
+        sub.height = y_end - y_begin;
+
+        return sub;
+    }
+}
+
+
 /* yuyv_to_planar */
 
 namespace convert
@@ -87,7 +332,8 @@ namespace convert
         case PF::NV21:
             uv.u = 1;
             uv.v = 0;
-        
+            break;
+
         default:
             uv.u = 0;
             uv.v = 0;
@@ -276,8 +522,8 @@ namespace convert
                 dv[i] = *sv;
 
                 ++i;
-                ++su;
-                ++sv;
+                su += 2;
+                sv += 2;
             }
 
             sy1 += py;
@@ -352,7 +598,7 @@ namespace convert
         assert(src_v.height == dst.height);
 
         img::copy(src_u, img::select_channel(dst, (u32)YUV::U));
-        img::copy(src_y, img::select_channel(dst, (u32)YUV::Y));
+        img::copy(src_v, img::select_channel(dst, (u32)YUV::V));
 
         auto width = dst.width;
         auto height = dst.height;
@@ -480,262 +726,1374 @@ namespace convert
 }
 
 
-/* to rgba */
+/* yuv to rgb fixed point */
 
 namespace convert
 {
-    static void span_yuyv_to_pixel(SpanView<u8> const& src, SpanView<img::Pixel> const& dst, OffsetYUYV yuyv)
+    namespace fxp
     {
-        auto const len  = src.length;
+        // Q14 against (y - y_offset) and doubled chroma c2 = 2 * c - c_offset2
+        // doubling keeps the analog 127.5 chroma offset exact
+        constexpr u32 Q = 14;
+        constexpr i32 HALF = 1 << (Q - 1);
 
-        auto s = src.begin;
 
-        auto d1 = dst.begin;
-        auto d2 = d1 + 1;
-
-        auto y1 = yuyv.y1;
-        auto y2 = yuyv.y2;
-        auto u = yuyv.u;
-        auto v = yuyv.v;
-
-        for (u32 i = 0; i < len; i += 4)
-        {
-            yuv_to_rgb(s[y1], s[u], s[v], d1);
-            yuv_to_rgb(s[y2], s[u], s[v], d2);
-
-            d1->alpha = 255;
-            d2->alpha = 255;
+        // coefficient pairs for madd against interleaved (a, b)
+        constexpr i32 to_pair(i16 ca, i16 cb) { return (i32)((u32)(u16)ca | ((u32)(u16)cb << 16)); }
+    }
 
-            d1 += 2;
-            d2 += 2;
 
-            s += 4;
-        }
+    static inline u8 fxp_to_u8(i32 value)
+    {
+        return (u8)num::clamp(value >> fxp::Q, 0, 255);
     }
 
 
-    static void yuyv_to_rgba(SpanView<u8> const& src, img::ImageView const& dst, PixelFormat format)
+    static inline void yuv_to_rgb_fixed(u8 y, u8 u, u8 v, u8* r, u8* g, u8* b, ColorTable const& ct)
     {
-        assert(src.length == dst.width * dst.height * 2);
+        auto yq = ct.y[y];
 
-        auto yuyv = offset_yuyv(format);
-
-        span_yuyv_to_pixel(src, img::to_span(dst), yuyv);
+        *r = fxp_to_u8(yq + ct.vr[v]);
+        *g = fxp_to_u8(yq + ct.ug[u] + ct.vg[v]);
+        *b = fxp_to_u8(yq + ct.ub[u]);
     }
 
 
-    static void yuyv_to_rgba(SpanView<u8> const& src, img::SubView const& dst, PixelFormat format)
+    static inline void yuv_to_rgb_fixed(u8 y, u8 u, u8 v, img::Pixel* dst, ColorTable const& ct)
     {
-        assert(src.length == dst.width * dst.height * 2);
-
-        auto yuyv = offset_yuyv(format);
+        yuv_to_rgb_fixed(y, u, v, &dst->red, &dst->green, &dst->blue, ct);
+    }
 
-        auto const w = dst.width;
 
-        for (u32 y = 0; y < dst.height; y++)
+    template <Kernel K>
+    static inline void yuv_to_pixel(u8 y, u8 u, u8 v, img::Pixel* dst, ColorTable const& ct)
+    {
+        if constexpr (K == Kernel::Float)
+        {
+            yuv_to_rgb(y, u, v, dst);
+        }
+        else
         {
-            span_yuyv_to_pixel(span::sub_view(src, y * w, w), img::row_span(dst, y), yuyv);
+            yuv_to_rgb_fixed(y, u, v, dst, ct);
         }
     }
-    
-
-    template <class VIEW>
-    static void nv12_to_rgba(SpanView<u8> const& src, VIEW const& dst, PixelFormat format)
-    {
-        auto const width = dst.width;
-        auto const height = dst.height;
 
-        assert(src.length == width * height + width * height / 2);
-
-        auto sy = src.begin;
-        auto suv = sy + width * height;
-        auto sd = img::row_begin(dst, 0);
 
-        auto uv = offset_uv(format);
-
-        auto u = suv + uv.u;
-        auto v = suv + uv.v;        
+    static ColorTable const& default_color_table()
+    {
+        static ColorTable const table = make_color_table(ColorMatrix::YUV, ColorRange::Full);
 
-        for (u32 h = 0; h < height; h += 2)
-        {
-            auto y1 = sy + h * width;
-            auto y2 = y1 + 1;
-            auto y3 = y1 + width;
-            auto y4 = y3 + 1;
+        return table;
+    }
+}
 
-            auto d1 = img::row_begin(dst, h);
-            auto d2 = d1 + 1;
-            auto d3 = img::row_begin(dst, h + 1);
-            auto d4 = d3 + 1;
 
-            for (u32 w = 0; w < width; w += 2)
-            {  
-                yuv_to_rgb(*y1, *u, *v, d1);
-                yuv_to_rgb(*y2, *u, *v, d2);
-                yuv_to_rgb(*y3, *u, *v, d3);
-                yuv_to_rgb(*y4, *u, *v, d4);
+/* simd level */
 
-                d1->alpha = 255;
-                d2->alpha = 255;
-                d3->alpha = 255;
-                d4->alpha = 255;
+namespace convert
+{
+    static bool cpu_has_avx2()
+    {
+#if !defined(CONVERT_SIMD_256)
 
-                y1 += 2;
-                y2 += 2;
-                y3 += 2;
-                y4 += 2;
+        return false;
 
-                d1 += 2;
-                d2 += 2;
-                d3 += 2;
-                d4 += 2;
+#elif defined(__AVX2__)
 
-                u += 2;
-                v += 2;
-            }
-        }
-    }
-    
-    
-    template <class VIEW>
-    static void yv12_to_rgba(SpanView<u8> const& src, VIEW const& dst, PixelFormat format)
-    {
-        auto const width = dst.width;
-        auto const height = dst.height;
+        return true;
 
-        assert(src.length == width * height + width * height / 2);
+#elif defined(__GNUC__)
 
-        auto sy = src.begin;
-        auto suv = sy + width * height;
-        auto sd = img::row_begin(dst, 0);
+        return __builtin_cpu_supports("avx2");
 
-        auto u = suv;
-        auto v = suv;
+#else
 
-        using PF = PixelFormat;
+        // the os must also save the ymm registers
+        int info[4];
 
-        switch (format)
+        __cpuid(info, 0);
+        if (info[0] < 7)
         {
-        case PF::YV12:
-            u += width * height / 4;
-            break;
-
-        case PF::I420:
-        case PF::IYUV:
-            v += width * height / 4;
-            break;
+            return false;
         }
 
-        for (u32 h = 0; h < height; h += 2)
+        __cpuid(info, 1);
+        auto osxsave_avx = (1 << 27) | (1 << 28);
+        if ((info[2] & osxsave_avx) != osxsave_avx || (_xgetbv(0) & 6) != 6)
         {
-            auto y1 = sy + h * width;
-            auto y2 = y1 + 1;
-            auto y3 = y1 + width;
-            auto y4 = y3 + 1;
+            return false;
+        }
 
-            auto d1 = img::row_begin(dst, h);
-            auto d2 = d1 + 1;
-            auto d3 = img::row_begin(dst, h + 1);
-            auto d4 = d3 + 1;
+        __cpuidex(info, 7, 0);
 
-            for (u32 w = 0; w < width; w += 2)
-            {  
-                yuv_to_rgb(*y1, *u, *v, d1);
-                yuv_to_rgb(*y2, *u, *v, d2);
-                yuv_to_rgb(*y3, *u, *v, d3);
-                yuv_to_rgb(*y4, *u, *v, d4);
+        return (info[1] & (1 << 5)) != 0;
 
-                d1->alpha = 255;
-                d2->alpha = 255;
-                d3->alpha = 255;
-                d4->alpha = 255;
+#endif
+    }
 
-                y1 += 2;
-                y2 += 2;
-                y3 += 2;
-                y4 += 2;
 
-                d1 += 2;
-                d2 += 2;
-                d3 += 2;
-                d4 += 2;
+    static bool& simd_256_enabled()
+    {
+        static bool enabled = cpu_has_avx2();
 
-                u += 1;
-                v += 1;
-            }
-        }
+        return enabled;
+    }
+
+
+    static inline bool use_simd_256()
+    {
+        return simd_256_enabled();
     }
 }
 
 
-/* to yuv planar */
+#ifdef CONVERT_SIMD_128
+
+/* yuv to rgb fixed point 128 */
 
 namespace convert
 {
-    static void yuyv_to_yuv(SpanView<u8> const& src, u32 width, u32 height, ViewYUV const& dst, PixelFormat format)
+    class RGB128
     {
-        assert(src.length == width * height * 2);
+    public:
+        // u8 results in the low 8 bytes
+        i128 r;
+        i128 g;
+        i128 b;
+    };
 
-        auto yuyv = offset_yuyv(format);
 
-        img::View1<u32> v32{};
-        v32.width = width / 2;
-        v32.height = height;
-        v32.matrix_data_ = (u32*)src.begin;
+    class Coeffs128
+    {
+    public:
+        i128 y_offset;
+        i128 c_offset2;
+
+        // madd pairs
+        i128 ky_half;
+        i128 uv_r;
+        i128 uv_g;
+        i128 uv_b;
+    };
 
-        if (height == dst.height)
-        {
-            yuyv_to_planar_1_1(v32, dst, yuyv);
-        }
-        else
-        {
-           yuyv_to_planar_2_1(v32, dst, yuyv);
-        }
+
+    static inline Coeffs128 load_coeffs_128(ColorTable const& ct)
+    {
+        Coeffs128 k{};
+        k.y_offset = _mm_set1_epi16(ct.y_offset);
+        k.c_offset2 = _mm_set1_epi16(ct.c_offset2);
+        k.ky_half = _mm_set1_epi32(fxp::to_pair(ct.ky, (i16)fxp::HALF));
+        k.uv_r = _mm_set1_epi32(fxp::to_pair(0, ct.kvr));
+        k.uv_g = _mm_set1_epi32(fxp::to_pair(ct.kug, ct.kvg));
+        k.uv_b = _mm_set1_epi32(fxp::to_pair(ct.kub, 0));
+
+        return k;
     }
 
 
-    static void nv12_to_yuv(SpanView<u8> const& src, u32 width, u32 height, ViewYUV const& dst, PixelFormat format)
-    { 
-        //                  |--- nv12 y ---| |------- nv12 uv ------|
-        assert(src.length == width * height + 2 * width * height / 4);
+    static inline i128 load_u8_128(u8* src)
+    {
+        return _mm_cvtepu8_epi16(_mm_loadl_epi64((i128*)src));
+    }
 
-        img::View1u8 src_y{};
-        src_y.width = width;
-        src_y.height = height;
-        src_y.matrix_data_ = src.begin;
 
-        img::View1<u16> src_uv{};
-        src_uv.width = width / 2;
-        src_uv.height = height / 2;
-        src_uv.matrix_data_ = (u16*)(src.begin + width * height);
+    static inline i128 load_u8x4_128(u8* src)
+    {
+        return _mm_cvtsi32_si128((i32)(src[0] | src[1] << 8 | src[2] << 16 | (u32)src[3] << 24));
+    }
 
-        auto uv = offset_uv(format);
 
-        if (height == dst.height)
-        {
-            nv12_to_planar_1_1(src_y, src_uv, dst, uv);
-        }
-        else
-        {
-            nv12_to_planar_2_1(src_y, src_uv, dst, uv);
-        }
+    static inline i128 fxp_channel_128(i128 y_lo, i128 y_hi, i128 uv_lo, i128 uv_hi, i128 pair)
+    {
+        auto lo = _mm_srai_epi32(_mm_add_epi32(y_lo, _mm_madd_epi16(uv_lo, pair)), fxp::Q);
+        auto hi = _mm_srai_epi32(_mm_add_epi32(y_hi, _mm_madd_epi16(uv_hi, pair)), fxp::Q);
+
+        auto c16 = _mm_packs_epi32(lo, hi);
+
+        return _mm_packus_epi16(c16, c16);
     }
 
 
-    static void yv12_to_yuv(SpanView<u8> const& src, u32 width, u32 height, ViewYUV const& dst, PixelFormat format)
-    { 
-        //                  |--- yv12 y ---| |--------- yv12 u --------| |--------- yv12 v --------|
-        assert(src.length == width * height + (width / 2) * (width / 2) + (width / 2) * (width / 2) );
+    // 8 pixels, u16 lanes
+    static inline RGB128 yuv_to_rgb_fixed_128(i128 y, i128 u, i128 v, Coeffs128 const& k)
+    {
+        auto const one = _mm_set1_epi16(1);
 
-        img::View1u8 src_y{};
-        src_y.width = width;
-        src_y.height = height;
-        src_y.matrix_data_ = src.begin;
+        auto u2 = _mm_sub_epi16(_mm_add_epi16(u, u), k.c_offset2);
+        auto v2 = _mm_sub_epi16(_mm_add_epi16(v, v), k.c_offset2);
 
-        img::View1u8 src_u{};
-        src_u.width = width / 2;
-        src_u.height = height / 2;
-        src_u.matrix_data_ = src.begin + width * height;
+        auto uv_lo = _mm_unpacklo_epi16(u2, v2);
+        auto uv_hi = _mm_unpackhi_epi16(u2, v2);
+
+        // ky * (y - y_offset) + HALF
+        auto ys = _mm_sub_epi16(y, k.y_offset);
+        auto y_lo = _mm_madd_epi16(_mm_unpacklo_epi16(ys, one), k.ky_half);
+        auto y_hi = _mm_madd_epi16(_mm_unpackhi_epi16(ys, one), k.ky_half);
+
+        RGB128 rgb{};
+        rgb.r = fxp_channel_128(y_lo, y_hi, uv_lo, uv_hi, k.uv_r);
+        rgb.g = fxp_channel_128(y_lo, y_hi, uv_lo, uv_hi, k.uv_g);
+        rgb.b = fxp_channel_128(y_lo, y_hi, uv_lo, uv_hi, k.uv_b);
+
+        return rgb;
+    }
+
+
+    static inline void store_rgba_128(RGB128 const& rgb, img::Pixel* dst)
+    {
+        auto a = _mm_set1_epi8(-1);
+
+        auto rg = _mm_unpacklo_epi8(rgb.r, rgb.g);
+        auto ba = _mm_unpacklo_epi8(rgb.b, a);
+
+        _mm_storeu_si128((i128*)dst, _mm_unpacklo_epi16(rg, ba));
+        _mm_storeu_si128((i128*)(dst + 4), _mm_unpackhi_epi16(rg, ba));
+    }
+
+
+    static inline void store_rgb_128(RGB128 const& rgb, u8* r, u8* g, u8* b)
+    {
+        _mm_storel_epi64((i128*)r, rgb.r);
+        _mm_storel_epi64((i128*)g, rgb.g);
+        _mm_storel_epi64((i128*)b, rgb.b);
+    }
+}
+
+#endif
+
+
+#ifdef CONVERT_SIMD_256
+
+/* yuv to rgb fixed point 256 */
+
+namespace convert
+{
+    class RGB256
+    {
+    public:
+        // u8 results in the low 8 bytes of each 128 bit lane
+        i256 r;
+        i256 g;
+        i256 b;
+    };
+
+
+    class Coeffs256
+    {
+    public:
+        i256 y_offset;
+        i256 c_offset2;
+
+        // madd pairs
+        i256 ky_half;
+        i256 uv_r;
+        i256 uv_g;
+        i256 uv_b;
+    };
+
+
+    CONVERT_TARGET_256
+    static inline Coeffs256 load_coeffs_256(ColorTable const& ct)
+    {
+        Coeffs256 k{};
+        k.y_offset = _mm256_set1_epi16(ct.y_offset);
+        k.c_offset2 = _mm256_set1_epi16(ct.c_offset2);
+        k.ky_half = _mm256_set1_epi32(fxp::to_pair(ct.ky, (i16)fxp::HALF));
+        k.uv_r = _mm256_set1_epi32(fxp::to_pair(0, ct.kvr));
+        k.uv_g = _mm256_set1_epi32(fxp::to_pair(ct.kug, ct.kvg));
+        k.uv_b = _mm256_set1_epi32(fxp::to_pair(ct.kub, 0));
+
+        return k;
+    }
+
+
+    CONVERT_TARGET_256
+    static inline i256 load_u8_256(u8* src)
+    {
+        return _mm256_cvtepu8_epi16(_mm_loadu_si128((i128*)src));
+    }
+
+
+    CONVERT_TARGET_256
+    static inline i256 fxp_channel_256(i256 y_lo, i256 y_hi, i256 uv_lo, i256 uv_hi, i256 pair)
+    {
+        auto lo = _mm256_srai_epi32(_mm256_add_epi32(y_lo, _mm256_madd_epi16(uv_lo, pair)), fxp::Q);
+        auto hi = _mm256_srai_epi32(_mm256_add_epi32(y_hi, _mm256_madd_epi16(uv_hi, pair)), fxp::Q);
+
+        auto c16 = _mm256_packs_epi32(lo, hi);
+
+        return _mm256_packus_epi16(c16, c16);
+    }
+
+
+    // 16 pixels, u16 lanes
+    CONVERT_TARGET_256
+    static inline RGB256 yuv_to_rgb_fixed_256(i256 y, i256 u, i256 v, Coeffs256 const& k)
+    {
+        auto const one = _mm256_set1_epi16(1);
+
+        auto u2 = _mm256_sub_epi16(_mm256_add_epi16(u, u), k.c_offset2);
+        auto v2 = _mm256_sub_epi16(_mm256_add_epi16(v, v), k.c_offset2);
+
+        // unpack/pack stay within 128 bit lanes so pixel order is preserved
+        auto uv_lo = _mm256_unpacklo_epi16(u2, v2);
+        auto uv_hi = _mm256_unpackhi_epi16(u2, v2);
+
+        // ky * (y - y_offset) + HALF
+        auto ys = _mm256_sub_epi16(y, k.y_offset);
+        auto y_lo = _mm256_madd_epi16(_mm256_unpacklo_epi16(ys, one), k.ky_half);
+        auto y_hi = _mm256_madd_epi16(_mm256_unpackhi_epi16(ys, one), k.ky_half);
+
+        RGB256 rgb{};
+        rgb.r = fxp_channel_256(y_lo, y_hi, uv_lo, uv_hi, k.uv_r);
+        rgb.g = fxp_channel_256(y_lo, y_hi, uv_lo, uv_hi, k.uv_g);
+        rgb.b = fxp_channel_256(y_lo, y_hi, uv_lo, uv_hi, k.uv_b);
+
+        return rgb;
+    }
+
+
+    CONVERT_TARGET_256
+    static inline void store_rgba_256(RGB256 const& rgb, img::Pixel* dst)
+    {
+        auto a = _mm256_set1_epi8(-1);
+
+        auto rg = _mm256_unpacklo_epi8(rgb.r, rgb.g);
+        auto ba = _mm256_unpacklo_epi8(rgb.b, a);
+
+        auto lo = _mm256_unpacklo_epi16(rg, ba); // 0-3, 8-11
+        auto hi = _mm256_unpackhi_epi16(rg, ba); // 4-7, 12-15
+
+        _mm256_storeu_si256((i256*)dst, _mm256_permute2x128_si256(lo, hi, 0x20));
+        _mm256_storeu_si256((i256*)(dst + 8), _mm256_permute2x128_si256(lo, hi, 0x31));
+    }
+
+
+    CONVERT_TARGET_256
+    static inline void store_rgb_256(RGB256 const& rgb, u8* r, u8* g, u8* b)
+    {
+        constexpr int q0_q2 = 0b00001000;
+
+        _mm_storeu_si128((i128*)r, _mm256_castsi256_si128(_mm256_permute4x64_epi64(rgb.r, q0_q2)));
+        _mm_storeu_si128((i128*)g, _mm256_castsi256_si128(_mm256_permute4x64_epi64(rgb.g, q0_q2)));
+        _mm_storeu_si128((i128*)b, _mm256_castsi256_si128(_mm256_permute4x64_epi64(rgb.b, q0_q2)));
+    }
+}
+
+#endif
+
+
+/* yuv to rgb fixed point span */
+
+namespace convert
+{
+#ifdef CONVERT_SIMD_256
+
+    // the 256 bit loops return how many pixels they converted, the callers finish the rest
+
+    CONVERT_TARGET_256
+    static u32 yuv_to_rgba_fixed_256(u8* y, u8* u, u8* v, img::Pixel* dst, u32 len, ColorTable const& ct)
+    {
+        u32 i = 0;
+
+        auto k256 = load_coeffs_256(ct);
+
+        for (; i + 16 <= len; i += 16)
+        {
+            auto rgb = yuv_to_rgb_fixed_256(load_u8_256(y + i), load_u8_256(u + i), load_u8_256(v + i), k256);
+            store_rgba_256(rgb, dst + i);
+        }
+
+        return i;
+    }
+
+
+    CONVERT_TARGET_256
+    static u32 yuv_to_rgb_fixed_256(u8* y, u8* u, u8* v, u8* r, u8* g, u8* b, u32 len, ColorTable const& ct)
+    {
+        u32 i = 0;
+
+        auto k256 = load_coeffs_256(ct);
+
+        for (; i + 16 <= len; i += 16)
+        {
+            auto rgb = yuv_to_rgb_fixed_256(load_u8_256(y + i), load_u8_256(u + i), load_u8_256(v + i), k256);
+            store_rgb_256(rgb, r + i, g + i, b + i);
+        }
+
+        return i;
+    }
+
+#endif
+
+
+    static void yuv_to_rgba_fixed(u8* y, u8* u, u8* v, img::Pixel* dst, u32 len, ColorTable const& ct)
+    {
+        u32 i = 0;
+
+#ifdef CONVERT_SIMD_256
+
+        if (use_simd_256())
+        {
+            i = yuv_to_rgba_fixed_256(y, u, v, dst, len, ct);
+        }
+
+#endif
+
+#ifdef CONVERT_SIMD_128
+
+        auto k128 = load_coeffs_128(ct);
+
+        for (; i + 8 <= len; i += 8)
+        {
+            auto rgb = yuv_to_rgb_fixed_128(load_u8_128(y + i), load_u8_128(u + i), load_u8_128(v + i), k128);
+            store_rgba_128(rgb, dst + i);
+        }
+
+#endif
+
+        for (; i < len; i++)
+        {
+            yuv_to_rgb_fixed(y[i], u[i], v[i], dst + i, ct);
+            dst[i].alpha = 255;
+        }
+    }
+
+
+    static void yuv_to_rgb_fixed(u8* y, u8* u, u8* v, u8* r, u8* g, u8* b, u32 len, ColorTable const& ct)
+    {
+        u32 i = 0;
+
+#ifdef CONVERT_SIMD_256
+
+        if (use_simd_256())
+        {
+            i = yuv_to_rgb_fixed_256(y, u, v, r, g, b, len, ct);
+        }
+
+#endif
+
+#ifdef CONVERT_SIMD_128
+
+        auto k128 = load_coeffs_128(ct);
+
+        for (; i + 8 <= len; i += 8)
+        {
+            auto rgb = yuv_to_rgb_fixed_128(load_u8_128(y + i), load_u8_128(u + i), load_u8_128(v + i), k128);
+            store_rgb_128(rgb, r + i, g + i, b + i);
+        }
+
+#endif
+
+        for (; i < len; i++)
+        {
+            yuv_to_rgb_fixed(y[i], u[i], v[i], r + i, g + i, b + i, ct);
+        }
+    }
+}
+
+
+/* to rgba shuffle */
+
+#ifdef CONVERT_SIMD_128
+
+namespace convert
+{
+    // byte shuffles that expand packed chroma/luma to u16 lanes, 8 pixels per 128 bits
+
+    class ShuffleYUV
+    {
+    public:
+        i128 y;
+        i128 u;
+        i128 v;
+    };
+
+
+    static inline i128 to_shuffle(i8 const* mask)
+    {
+        return _mm_loadu_si128((i128*)mask);
+    }
+
+
+    static ShuffleYUV shuffle_yuyv(OffsetYUYV yuyv)
+    {
+        i8 y[16];
+        i8 u[16];
+        i8 v[16];
+
+        for (i8 p = 0; p < 8; p++)
+        {
+            i8 s = 4 * (p / 2);
+
+            y[2 * p] = s + (p % 2 ? yuyv.y2 : yuyv.y1);
+            u[2 * p] = s + yuyv.u;
+            v[2 * p] = s + yuyv.v;
+
+            y[2 * p + 1] = u[2 * p + 1] = v[2 * p + 1] = -128;
+        }
+
+        return { to_shuffle(y), to_shuffle(u), to_shuffle(v) };
+    }
+
+
+    static ShuffleYUV shuffle_nv12(OffsetUV uv, i8 lane_offset)
+    {
+        i8 u[16];
+        i8 v[16];
+
+        for (i8 p = 0; p < 8; p++)
+        {
+            i8 s = lane_offset + 2 * (p / 2);
+
+            u[2 * p] = s + uv.u;
+            v[2 * p] = s + uv.v;
+
+            u[2 * p + 1] = v[2 * p + 1] = -128;
+        }
+
+        return { _mm_setzero_si128(), to_shuffle(u), to_shuffle(v) };
+    }
+
+
+    static i128 shuffle_yv12(i8 lane_offset)
+    {
+        i8 c[16];
+
+        for (i8 p = 0; p < 8; p++)
+        {
+            c[2 * p] = lane_offset + p / 2;
+            c[2 * p + 1] = -128;
+        }
+
+        return to_shuffle(c);
+    }
+}
+
+#endif
+
+
+/* p010 */
+
+#ifdef CONVERT_SIMD_128
+
+namespace convert
+{
+    // repeats the u (c = 0) or v (c = 1) of 4 interleaved u16 pairs across 8 u16 lanes
+    static i128 shuffle_p010(i8 c)
+    {
+        i8 mask[16];
+
+        for (i8 j = 0; j < 8; j++)
+        {
+            i8 lane = 2 * (j / 2) + c;
+
+            mask[2 * j] = 2 * lane;
+            mask[2 * j + 1] = 2 * lane + 1;
+        }
+
+        return to_shuffle(mask);
+    }
+
+
+    static inline void store_u16_128(i128 src, u16* dst)
+    {
+        _mm_storeu_si128((i128*)dst, src);
+    }
+
+
+    static inline void store_u16_128(i128 src, u8* dst)
+    {
+        _mm_storel_epi64((i128*)dst, _mm_packus_epi16(src, src));
+    }
+}
+
+#endif
+
+
+namespace convert
+{
+    // 16 bit little endian samples with 10 significant high bits
+    // Y plane followed by interleaved UV at half width and half height
+
+    constexpr u32 P010_SHIFT = 6;
+
+
+    static inline u32 p010_size(u32 width, u32 height)
+    {
+        return width * height * 3;
+    }
+
+
+    // SHIFT = P010_SHIFT keeps 10 bits, SHIFT = P010_SHIFT + 2 narrows to 8 bits
+    template <u32 SHIFT, typename T>
+    static void p010_row_to_planar(u16* src_y, u16* src_uv, T* dst_y, T* dst_u, T* dst_v, u32 width)
+    {
+        u32 i = 0;
+
+#ifdef CONVERT_SIMD_128
+
+        auto sh_u = shuffle_p010(0);
+        auto sh_v = shuffle_p010(1);
+
+        for (; i + 8 <= width; i += 8)
+        {
+            auto y = _mm_srli_epi16(_mm_loadu_si128((i128*)(src_y + i)), SHIFT);
+            auto uv = _mm_srli_epi16(_mm_loadu_si128((i128*)(src_uv + i)), SHIFT);
+
+            store_u16_128(y, dst_y + i);
+            store_u16_128(_mm_shuffle_epi8(uv, sh_u), dst_u + i);
+            store_u16_128(_mm_shuffle_epi8(uv, sh_v), dst_v + i);
+        }
+
+#endif
+
+        for (; i < width; i++)
+        {
+            auto c = 2 * (i / 2);
+
+            dst_y[i] = (T)(src_y[i] >> SHIFT);
+            dst_u[i] = (T)(src_uv[c] >> SHIFT);
+            dst_v[i] = (T)(src_uv[c + 1] >> SHIFT);
+        }
+    }
+
+
+#ifdef CONVERT_SIMD_256
+
+    CONVERT_TARGET_256
+    static u32 p010_row_to_rgba_256(u16* src_y, u16* src_uv, img::Pixel* dst, u32 width, ColorTable const& ct)
+    {
+        constexpr u32 SHIFT = P010_SHIFT + 2;
+
+        u32 i = 0;
+
+        auto k256 = load_coeffs_256(ct);
+
+        auto sh_u_256 = _mm256_broadcastsi128_si256(shuffle_p010(0));
+        auto sh_v_256 = _mm256_broadcastsi128_si256(shuffle_p010(1));
+
+        for (; i + 16 <= width; i += 16)
+        {
+            auto y = _mm256_srli_epi16(_mm256_loadu_si256((i256*)(src_y + i)), SHIFT);
+            auto uv = _mm256_srli_epi16(_mm256_loadu_si256((i256*)(src_uv + i)), SHIFT);
+
+            auto u = _mm256_shuffle_epi8(uv, sh_u_256);
+            auto v = _mm256_shuffle_epi8(uv, sh_v_256);
+
+            store_rgba_256(yuv_to_rgb_fixed_256(y, u, v, k256), dst + i);
+        }
+
+        return i;
+    }
+
+#endif
+
+
+    static void p010_row_to_rgba(u16* src_y, u16* src_uv, img::Pixel* dst, u32 width, ColorTable const& ct)
+    {
+        constexpr u32 SHIFT = P010_SHIFT + 2;
+
+        u32 i = 0;
+
+#ifdef CONVERT_SIMD_256
+
+        if (use_simd_256())
+        {
+            i = p010_row_to_rgba_256(src_y, src_uv, dst, width, ct);
+        }
+
+#endif
+
+#ifdef CONVERT_SIMD_128
+
+        auto k128 = load_coeffs_128(ct);
+
+        auto sh_u = shuffle_p010(0);
+        auto sh_v = shuffle_p010(1);
+
+        for (; i + 8 <= width; i += 8)
+        {
+            auto y = _mm_srli_epi16(_mm_loadu_si128((i128*)(src_y + i)), SHIFT);
+            auto uv = _mm_srli_epi16(_mm_loadu_si128((i128*)(src_uv + i)), SHIFT);
+
+            auto u = _mm_shuffle_epi8(uv, sh_u);
+            auto v = _mm_shuffle_epi8(uv, sh_v);
+
+            store_rgba_128(yuv_to_rgb_fixed_128(y, u, v, k128), dst + i);
+        }
+
+#endif
+
+        for (; i < width; i++)
+        {
+            auto c = 2 * (i / 2);
+
+            auto y = (u8)(src_y[i] >> SHIFT);
+            auto u = (u8)(src_uv[c] >> SHIFT);
+            auto v = (u8)(src_uv[c + 1] >> SHIFT);
+
+            yuv_to_rgb_fixed(y, u, v, dst + i, ct);
+            dst[i].alpha = 255;
+        }
+    }
+
+
+    template <class VIEW>
+    static void p010_to_rgba(SpanView<u8> const& src, VIEW const& dst, u32 y_begin, u32 y_end, ColorTable const& ct)
+    {
+        auto const width = dst.width;
+        auto const height = dst.height;
+
+        assert(src.length == p010_size(width, height));
+
+        auto sy = (u16*)src.begin;
+        auto suv = sy + width * height;
+
+        for (u32 h = y_begin; h < y_end; h++)
+        {
+            p010_row_to_rgba(sy + h * width, suv + (h / 2) * width, img::row_begin(dst, h), width, ct);
+        }
+    }
+
+
+    template <u32 SHIFT, typename T>
+    static void p010_to_planar(SpanView<u8> const& src, u32 width, u32 height, img::View3<T> const& dst)
+    {
+        assert(src.length == p010_size(width, height));
+
+        auto sy = (u16*)src.begin;
+        auto suv = sy + width * height;
+
+        auto dy = dst.channel_data[(u32)YUV::Y];
+        auto du = dst.channel_data[(u32)YUV::U];
+        auto dv = dst.channel_data[(u32)YUV::V];
+
+        if (height == dst.height)
+        {
+            assert(width == dst.width);
+
+            for_each_band(height, 2, [&](u32 y_begin, u32 y_end)
+            {
+                for (u32 h = y_begin; h < y_end; h++)
+                {
+                    auto d = h * width;
+                    p010_row_to_planar<SHIFT>(sy + h * width, suv + (h / 2) * width, dy + d, du + d, dv + d, width);
+                }
+            });
+
+            return;
+        }
+
+        assert(width == dst.width * 2);
+        assert(height == dst.height * 2);
+
+        // 2:1, luma averaged
+        for_each_band(dst.height, 1, [&](u32 y_begin, u32 y_end)
+        {
+            for (u32 h = y_begin; h < y_end; h++)
+            {
+                auto sy1 = sy + 2 * h * width;
+                auto sy2 = sy1 + width;
+                auto sc = suv + h * width;
+
+                auto d = h * dst.width;
+
+                for (u32 w = 0; w < dst.width; w++)
+                {
+                    auto sw = 2 * w;
+                    auto y = ((u32)sy1[sw] + sy1[sw + 1] + sy2[sw] + sy2[sw + 1]) / 4;
+
+                    dy[d + w] = (T)(y >> SHIFT);
+                    du[d + w] = (T)(sc[sw] >> SHIFT);
+                    dv[d + w] = (T)(sc[sw + 1] >> SHIFT);
+                }
+            }
+        });
+    }
+}
+
+
+/* yuv16 to rgba */
+
+namespace convert
+{
+    class ToneMapLUT
+    {
+    public:
+        u8 reinhard[1024];
+    };
+
+
+    static ToneMapLUT make_tone_map_lut()
+    {
+        // extended reinhard with exposure k and the white point at full scale
+        constexpr f32 k = 4.0f;
+
+        ToneMapLUT lut{};
+
+        for (u32 i = 0; i < 1024; i++)
+        {
+            auto x = k * i / 1023.0f;
+            auto t = x * (1.0f + x / (k * k)) / (1.0f + x);
+
+            lut.reinhard[i] = num::round_to_unsigned<u8>(num::clamp(t * 255.0f, 0.0f, 255.0f));
+        }
+
+        return lut;
+    }
+
+
+    static u8 const* tone_map_lut(ToneMap tone)
+    {
+        static ToneMapLUT const lut = make_tone_map_lut();
+
+        switch (tone)
+        {
+        case ToneMap::Reinhard:
+            return lut.reinhard;
+
+        default:
+            return nullptr;
+        }
+    }
+
+
+#ifdef CONVERT_SIMD_256
+
+    CONVERT_TARGET_256
+    static u32 yuv16_to_rgba_linear_256(u16* y, u16* u, u16* v, img::Pixel* dst, u32 len, ColorTable const& ct)
+    {
+        u32 i = 0;
+
+        auto k256 = load_coeffs_256(ct);
+
+        for (; i + 16 <= len; i += 16)
+        {
+            auto yn = _mm256_srli_epi16(_mm256_loadu_si256((i256*)(y + i)), 2);
+            auto un = _mm256_srli_epi16(_mm256_loadu_si256((i256*)(u + i)), 2);
+            auto vn = _mm256_srli_epi16(_mm256_loadu_si256((i256*)(v + i)), 2);
+
+            store_rgba_256(yuv_to_rgb_fixed_256(yn, un, vn, k256), dst + i);
+        }
+
+        return i;
+    }
+
+#endif
+
+
+    static void yuv16_to_rgba_linear(u16* y, u16* u, u16* v, img::Pixel* dst, u32 len, ColorTable const& ct)
+    {
+        u32 i = 0;
+
+#ifdef CONVERT_SIMD_256
+
+        if (use_simd_256())
+        {
+            i = yuv16_to_rgba_linear_256(y, u, v, dst, len, ct);
+        }
+
+#endif
+
+#ifdef CONVERT_SIMD_128
+
+        auto k128 = load_coeffs_128(ct);
+
+        for (; i + 8 <= len; i += 8)
+        {
+            auto yn = _mm_srli_epi16(_mm_loadu_si128((i128*)(y + i)), 2);
+            auto un = _mm_srli_epi16(_mm_loadu_si128((i128*)(u + i)), 2);
+            auto vn = _mm_srli_epi16(_mm_loadu_si128((i128*)(v + i)), 2);
+
+            store_rgba_128(yuv_to_rgb_fixed_128(yn, un, vn, k128), dst + i);
+        }
+
+#endif
+
+        for (; i < len; i++)
+        {
+            yuv_to_rgb_fixed((u8)(y[i] >> 2), (u8)(u[i] >> 2), (u8)(v[i] >> 2), dst + i, ct);
+            dst[i].alpha = 255;
+        }
+    }
+
+
+    static void yuv16_to_rgba_lut(u16* y, u16* u, u16* v, img::Pixel* dst, u32 len, u8 const* lut, ColorTable const& ct)
+    {
+        for (u32 i = 0; i < len; i++)
+        {
+            yuv_to_rgb_fixed(lut[y[i] & 1023], (u8)(u[i] >> 2), (u8)(v[i] >> 2), dst + i, ct);
+            dst[i].alpha = 255;
+        }
+    }
+}
+
+
+/* to rgba */
+
+namespace convert
+{
+#ifdef CONVERT_SIMD_256
+
+    CONVERT_TARGET_256
+    static u32 yuyv_row_to_rgba_256(u8* src, img::Pixel* dst, u32 width, OffsetYUYV yuyv, ColorTable const& ct)
+    {
+        u32 i = 0;
+
+        auto k256 = load_coeffs_256(ct);
+
+        auto sh = shuffle_yuyv(yuyv);
+
+        auto sh_y = _mm256_broadcastsi128_si256(sh.y);
+        auto sh_u = _mm256_broadcastsi128_si256(sh.u);
+        auto sh_v = _mm256_broadcastsi128_si256(sh.v);
+
+        for (; i + 16 <= width; i += 16)
+        {
+            auto s = _mm256_loadu_si256((i256*)(src + 2 * i));
+
+            auto y = _mm256_shuffle_epi8(s, sh_y);
+            auto u = _mm256_shuffle_epi8(s, sh_u);
+            auto v = _mm256_shuffle_epi8(s, sh_v);
+
+            store_rgba_256(yuv_to_rgb_fixed_256(y, u, v, k256), dst + i);
+        }
+
+        return i;
+    }
+
+
+    CONVERT_TARGET_256
+    static u32 nv12_row_to_rgba_256(u8* src_y, u8* src_uv, img::Pixel* dst, u32 width, OffsetUV uv, ColorTable const& ct)
+    {
+        u32 i = 0;
+
+        auto k256 = load_coeffs_256(ct);
+
+        auto sh = shuffle_nv12(uv, 0);
+        auto sh_hi = shuffle_nv12(uv, 8);
+
+        auto sh_u = _mm256_set_m128i(sh_hi.u, sh.u);
+        auto sh_v = _mm256_set_m128i(sh_hi.v, sh.v);
+
+        for (; i + 16 <= width; i += 16)
+        {
+            auto s = _mm256_broadcastsi128_si256(_mm_loadu_si128((i128*)(src_uv + i)));
+
+            auto y = load_u8_256(src_y + i);
+            auto u = _mm256_shuffle_epi8(s, sh_u);
+            auto v = _mm256_shuffle_epi8(s, sh_v);
+
+            store_rgba_256(yuv_to_rgb_fixed_256(y, u, v, k256), dst + i);
+        }
+
+        return i;
+    }
+
+
+    CONVERT_TARGET_256
+    static u32 yv12_row_to_rgba_256(u8* src_y, u8* src_u, u8* src_v, img::Pixel* dst, u32 width, ColorTable const& ct)
+    {
+        u32 i = 0;
+
+        auto k256 = load_coeffs_256(ct);
+
+        auto sh_c = _mm256_set_m128i(shuffle_yv12(4), shuffle_yv12(0));
+
+        for (; i + 16 <= width; i += 16)
+        {
+            auto su = _mm256_broadcastsi128_si256(_mm_loadl_epi64((i128*)(src_u + i / 2)));
+            auto sv = _mm256_broadcastsi128_si256(_mm_loadl_epi64((i128*)(src_v + i / 2)));
+
+            auto y = load_u8_256(src_y + i);
+            auto u = _mm256_shuffle_epi8(su, sh_c);
+            auto v = _mm256_shuffle_epi8(sv, sh_c);
+
+            store_rgba_256(yuv_to_rgb_fixed_256(y, u, v, k256), dst + i);
+        }
+
+        return i;
+    }
+
+#endif
+
+
+    template <Kernel K>
+    static void yuyv_row_to_rgba(u8* src, img::Pixel* dst, u32 width, OffsetYUYV yuyv, ColorTable const& ct)
+    {
+        u32 i = 0;
+
+        if constexpr (K == Kernel::Fixed)
+        {
+#ifdef CONVERT_SIMD_256
+
+            if (use_simd_256())
+            {
+                i = yuyv_row_to_rgba_256(src, dst, width, yuyv, ct);
+            }
+
+#endif
+
+#ifdef CONVERT_SIMD_128
+
+            auto k128 = load_coeffs_128(ct);
+
+            auto sh = shuffle_yuyv(yuyv);
+
+            for (; i + 8 <= width; i += 8)
+            {
+                auto s = _mm_loadu_si128((i128*)(src + 2 * i));
+
+                auto y = _mm_shuffle_epi8(s, sh.y);
+                auto u = _mm_shuffle_epi8(s, sh.u);
+                auto v = _mm_shuffle_epi8(s, sh.v);
+
+                store_rgba_128(yuv_to_rgb_fixed_128(y, u, v, k128), dst + i);
+            }
+
+#endif
+        }
+
+        for (; i < width; i++)
+        {
+            auto s = src + 4 * (i / 2);
+            auto y = i % 2 ? yuyv.y2 : yuyv.y1;
+
+            yuv_to_pixel<K>(s[y], s[yuyv.u], s[yuyv.v], dst + i, ct);
+            dst[i].alpha = 255;
+        }
+    }
+
+
+    template <Kernel K>
+    static void nv12_row_to_rgba(u8* src_y, u8* src_uv, img::Pixel* dst, u32 width, OffsetUV uv, ColorTable const& ct)
+    {
+        u32 i = 0;
+
+        if constexpr (K == Kernel::Fixed)
+        {
+#ifdef CONVERT_SIMD_256
+
+            if (use_simd_256())
+            {
+                i = nv12_row_to_rgba_256(src_y, src_uv, dst, width, uv, ct);
+            }
+
+#endif
+
+#ifdef CONVERT_SIMD_128
+
+            auto k128 = load_coeffs_128(ct);
+
+            auto sh = shuffle_nv12(uv, 0);
+
+            for (; i + 8 <= width; i += 8)
+            {
+                auto s = _mm_loadl_epi64((i128*)(src_uv + i));
+
+                auto y = load_u8_128(src_y + i);
+                auto u = _mm_shuffle_epi8(s, sh.u);
+                auto v = _mm_shuffle_epi8(s, sh.v);
+
+                store_rgba_128(yuv_to_rgb_fixed_128(y, u, v, k128), dst + i);
+            }
+
+#endif
+        }
+
+        for (; i < width; i++)
+        {
+            auto s = src_uv + 2 * (i / 2);
+
+            yuv_to_pixel<K>(src_y[i], s[uv.u], s[uv.v], dst + i, ct);
+            dst[i].alpha = 255;
+        }
+    }
+
+
+    template <Kernel K>
+    static void yv12_row_to_rgba(u8* src_y, u8* src_u, u8* src_v, img::Pixel* dst, u32 width, ColorTable const& ct)
+    {
+        u32 i = 0;
+
+        if constexpr (K == Kernel::Fixed)
+        {
+#ifdef CONVERT_SIMD_256
+
+            if (use_simd_256())
+            {
+                i = yv12_row_to_rgba_256(src_y, src_u, src_v, dst, width, ct);
+            }
+
+#endif
+
+#ifdef CONVERT_SIMD_128
+
+            auto k128 = load_coeffs_128(ct);
+
+            auto sh = shuffle_yv12(0);
+
+            for (; i + 8 <= width; i += 8)
+            {
+                auto su = load_u8x4_128(src_u + i / 2);
+                auto sv = load_u8x4_128(src_v + i / 2);
+
+                auto y = load_u8_128(src_y + i);
+                auto u = _mm_shuffle_epi8(su, sh);
+                auto v = _mm_shuffle_epi8(sv, sh);
+
+                store_rgba_128(yuv_to_rgb_fixed_128(y, u, v, k128), dst + i);
+            }
+
+#endif
+        }
+
+        for (; i < width; i++)
+        {
+            yuv_to_pixel<K>(src_y[i], src_u[i / 2], src_v[i / 2], dst + i, ct);
+            dst[i].alpha = 255;
+        }
+    }
+
+
+    template <Kernel K>
+    static void yuyv_to_rgba(SpanView<u8> const& src, img::ImageView const& dst, PixelFormat format, u32 y_begin, u32 y_end, ColorTable const& ct)
+    {
+        assert(src.length == dst.width * dst.height * 2);
+
+        auto yuyv = offset_yuyv(format);
+
+        auto const width = dst.width;
+
+        // contiguous rows
+        auto s = src.begin + y_begin * width * 2;
+        auto d = dst.matrix_data_ + y_begin * width;
+
+        yuyv_row_to_rgba<K>(s, d, width * (y_end - y_begin), yuyv, ct);
+    }
+
+
+    template <Kernel K>
+    static void yuyv_to_rgba(SpanView<u8> const& src, img::SubView const& dst, PixelFormat format, u32 y_begin, u32 y_end, ColorTable const& ct)
+    {
+        assert(src.length == dst.width * dst.height * 2);
+
+        auto yuyv = offset_yuyv(format);
+
+        auto const pitch = dst.width * 2;
+
+        for (u32 y = y_begin; y < y_end; y++)
+        {
+            yuyv_row_to_rgba<K>(src.begin + y * pitch, img::row_begin(dst, y), dst.width, yuyv, ct);
+        }
+    }
+    
+
+    template <Kernel K, class VIEW>
+    static void nv12_to_rgba(SpanView<u8> const& src, VIEW const& dst, PixelFormat format, u32 y_begin, u32 y_end, ColorTable const& ct)
+    {
+        auto const width = dst.width;
+        auto const height = dst.height;
+
+        assert(src.length == width * height + width * height / 2);
+
+        auto sy = src.begin;
+        auto suv = sy + width * height;
+
+        auto uv = offset_uv(format);
+
+        for (u32 h = y_begin; h < y_end; h++)
+        {
+            auto y = sy + h * width;
+            auto c = suv + (h / 2) * width;
+
+            nv12_row_to_rgba<K>(y, c, img::row_begin(dst, h), width, uv, ct);
+        }
+    }
+    
+    
+    template <Kernel K, class VIEW>
+    static void yv12_to_rgba(SpanView<u8> const& src, VIEW const& dst, PixelFormat format, u32 y_begin, u32 y_end, ColorTable const& ct)
+    {
+        auto const width = dst.width;
+        auto const height = dst.height;
+
+        assert(src.length == width * height + width * height / 2);
+
+        auto sy = src.begin;
+        auto suv = sy + width * height;
+
+        auto u = suv;
+        auto v = suv;
+
+        using PF = PixelFormat;
+
+        switch (format)
+        {
+        case PF::YV12:
+            u += width * height / 4;
+            break;
+
+        case PF::I420:
+        case PF::IYUV:
+            v += width * height / 4;
+            break;
+
+        default:
+            break;
+        }
+
+        auto const c_width = width / 2;
+
+        for (u32 h = y_begin; h < y_end; h++)
+        {
+            auto y = sy + h * width;
+            auto c = (h / 2) * c_width;
+
+            yv12_row_to_rgba<K>(y, u + c, v + c, img::row_begin(dst, h), width, ct);
+        }
+    }
+
+
+    template <Kernel K, class VIEW>
+    static void convert_to_rgba(SpanView<u8> const& src, VIEW const& dst, PixelFormat format, ColorTable const& ct)
+    {
+        using PF = PixelFormat;
+
+        switch (format)
+        {
+        case PF::YUYV:
+        case PF::YUNV:
+        case PF::YUY2:
+        case PF::YVYU:
+        case PF::UYVY:
+        case PF::Y422:
+        case PF::UYNV:
+        case PF::HDYC:
+            for_each_band(dst.height, 1, [&](u32 y_begin, u32 y_end)
+            {
+                yuyv_to_rgba<K>(src, dst, format, y_begin, y_end, ct);
+            });
+            break;
+
+        case PF::NV12:
+        case PF::NV21:
+            for_each_band(dst.height, 2, [&](u32 y_begin, u32 y_end)
+            {
+                nv12_to_rgba<K>(src, dst, format, y_begin, y_end, ct);
+            });
+            break;
+
+        case PF::P010:
+            for_each_band(dst.height, 2, [&](u32 y_begin, u32 y_end)
+            {
+                p010_to_rgba(src, dst, y_begin, y_end, ct);
+            });
+            break;
+        
+        case PF::YV12:
+        case PF::I420:
+        case PF::IYUV:
+            for_each_band(dst.height, 2, [&](u32 y_begin, u32 y_end)
+            {
+                yv12_to_rgba<K>(src, dst, format, y_begin, y_end, ct);
+            });
+            break;
+
+        default:
+            img::fill(dst, img::to_pixel(100));
+        }
+    }
+}
+
+
+/* to yuv planar */
+
+namespace convert
+{
+    static void yuyv_to_yuv(SpanView<u8> const& src, u32 width, u32 height, ViewYUV const& dst, PixelFormat format)
+    {
+        assert(src.length == width * height * 2);
+
+        auto yuyv = offset_yuyv(format);
+
+        img::View1<u32> v32{};
+        v32.width = width / 2;
+        v32.height = height;
+        v32.matrix_data_ = (u32*)src.begin;
+
+        if (height == dst.height)
+        {
+            for_each_band(dst.height, 1, [&](u32 y_begin, u32 y_end)
+            {
+                yuyv_to_planar_1_1(sub_rows(v32, y_begin, y_end), sub_rows(dst, y_begin, y_end), yuyv);
+            });
+        }
+        else
+        {
+            for_each_band(dst.height, 1, [&](u32 y_begin, u32 y_end)
+            {
+                yuyv_to_planar_2_1(sub_rows(v32, 2 * y_begin, 2 * y_end), sub_rows(dst, y_begin, y_end), yuyv);
+            });
+        }
+    }
+
+
+    static void nv12_to_yuv(SpanView<u8> const& src, u32 width, u32 height, ViewYUV const& dst, PixelFormat format)
+    { 
+        //                  |--- nv12 y ---| |------- nv12 uv ------|
+        assert(src.length == width * height + 2 * width * height / 4);
+
+        img::View1u8 src_y{};
+        src_y.width = width;
+        src_y.height = height;
+        src_y.matrix_data_ = src.begin;
+
+        img::View1<u16> src_uv{};
+        src_uv.width = width / 2;
+        src_uv.height = height / 2;
+        src_uv.matrix_data_ = (u16*)(src.begin + width * height);
+
+        auto uv = offset_uv(format);
+
+        if (height == dst.height)
+        {
+            for_each_band(dst.height, 2, [&](u32 y_begin, u32 y_end)
+            {
+                auto sy = sub_rows(src_y, y_begin, y_end);
+                auto suv = sub_rows(src_uv, y_begin / 2, y_end / 2);
+
+                nv12_to_planar_1_1(sy, suv, sub_rows(dst, y_begin, y_end), uv);
+            });
+        }
+        else
+        {
+            for_each_band(dst.height, 1, [&](u32 y_begin, u32 y_end)
+            {
+                auto sy = sub_rows(src_y, 2 * y_begin, 2 * y_end);
+                auto suv = sub_rows(src_uv, y_begin, y_end);
+
+                nv12_to_planar_2_1(sy, suv, sub_rows(dst, y_begin, y_end), uv);
+            });
+        }
+    }
+
+
+    static void yv12_to_yuv(SpanView<u8> const& src, u32 width, u32 height, ViewYUV const& dst, PixelFormat format)
+    { 
+        //                  |--- yv12 y ---| |--------- yv12 u --------| |--------- yv12 v --------|
+        assert(src.length == width * height + (width / 2) * (height / 2) + (width / 2) * (height / 2));
+
+        img::View1u8 src_y{};
+        src_y.width = width;
+        src_y.height = height;
+        src_y.matrix_data_ = src.begin;
+
+        img::View1u8 src_u{};
+        src_u.width = width / 2;
+        src_u.height = height / 2;
+        src_u.matrix_data_ = src.begin + width * height;
 
         auto src_v = src_u;
 
@@ -744,37 +2102,1118 @@ namespace convert
         switch (format)
         {
         case PF::YV12:
-            src_u.matrix_data_ += width * height / 4;
+            src_u.matrix_data_ += width * height / 4;
+            break;
+
+        case PF::I420:
+        case PF::IYUV:
+            src_v.matrix_data_ += width * height / 4;
+            break;
+        }
+
+        if (height == dst.height)
+        {
+            for_each_band(dst.height, 2, [&](u32 y_begin, u32 y_end)
+            {
+                auto sy = sub_rows(src_y, y_begin, y_end);
+                auto su = sub_rows(src_u, y_begin / 2, y_end / 2);
+                auto sv = sub_rows(src_v, y_begin / 2, y_end / 2);
+
+                yv12_to_planar_1_1(sy, su, sv, sub_rows(dst, y_begin, y_end));
+            });
+        }
+        else
+        {
+            for_each_band(dst.height, 1, [&](u32 y_begin, u32 y_end)
+            {
+                auto sy = sub_rows(src_y, 2 * y_begin, 2 * y_end);
+                auto su = sub_rows(src_u, y_begin, y_end);
+                auto sv = sub_rows(src_v, y_begin, y_end);
+
+                yv12_to_planar_2_1(sy, su, sv, sub_rows(dst, y_begin, y_end));
+            });
+        }
+    }
+}
+
+
+/* to yuv subsampled */
+
+namespace convert
+{
+    template <u32 SX, u32 SY>
+    static void yuyv_to_subsampled(SpanView<u8> const& src, SubsampledYUV<SX, SY> const& dst, PixelFormat format)
+    {
+        static_assert(SX == 2);
+
+        auto const width = dst.y.width;
+        auto const height = dst.y.height;
+        auto const pitch = 2 * width;
+
+        assert(src.length == width * height * 2);
+        assert(dst.u.width == width / SX);
+        assert(dst.u.height == height / SY);
+
+        auto yuyv = offset_yuyv(format);
+
+        for_each_band(height, SY, [&](u32 y_begin, u32 y_end)
+        {
+            for (u32 h = y_begin; h < y_end; h++)
+            {
+                auto s = src.begin + h * pitch;
+                auto dy = img::row_begin(dst.y, h);
+
+                for (u32 w = 0; w < width / 2; w++)
+                {
+                    dy[2 * w] = s[4 * w + yuyv.y1];
+                    dy[2 * w + 1] = s[4 * w + yuyv.y2];
+                }
+
+                if (h % SY || h / SY >= dst.u.height)
+                {
+                    continue;
+                }
+
+                auto du = img::row_begin(dst.u, h / SY);
+                auto dv = img::row_begin(dst.v, h / SY);
+
+                // 4:2:0 averages chroma of the row pair
+                auto s2 = SY == 2 ? s + pitch : s;
+
+                for (u32 w = 0; w < dst.u.width; w++)
+                {
+                    auto i = 4 * w;
+                    du[w] = (u8)(((u32)s[i + yuyv.u] + s2[i + yuyv.u] + 1) / 2);
+                    dv[w] = (u8)(((u32)s[i + yuyv.v] + s2[i + yuyv.v] + 1) / 2);
+                }
+            }
+        });
+    }
+
+
+    template <u32 SX, u32 SY>
+    static void yuv420_to_subsampled(u8* src_y, u8* src_u, u8* src_v, u32 c_step, u32 c_pitch, SubsampledYUV<SX, SY> const& dst)
+    {
+        static_assert(SX == 2);
+
+        auto const width = dst.y.width;
+        auto const height = dst.y.height;
+
+        assert(dst.u.width == width / SX);
+        assert(dst.u.height == height / SY);
+
+        for_each_band(height, 2, [&](u32 y_begin, u32 y_end)
+        {
+            for (u32 h = y_begin; h < y_end; h++)
+            {
+                auto sy = src_y + h * width;
+                auto dy = img::row_begin(dst.y, h);
+
+                for (u32 w = 0; w < width; w++)
+                {
+                    dy[w] = sy[w];
+                }
+
+                // 4:2:2 repeats each chroma row
+                if (h % SY || h / SY >= dst.u.height)
+                {
+                    continue;
+                }
+
+                auto c = (h / 2) * c_pitch;
+                auto su = src_u + c;
+                auto sv = src_v + c;
+
+                auto du = img::row_begin(dst.u, h / SY);
+                auto dv = img::row_begin(dst.v, h / SY);
+
+                for (u32 w = 0; w < dst.u.width; w++)
+                {
+                    du[w] = su[w * c_step];
+                    dv[w] = sv[w * c_step];
+                }
+            }
+        });
+    }
+
+
+    template <u32 SX, u32 SY>
+    static void to_subsampled(SpanView<u8> const& src, SubsampledYUV<SX, SY> const& dst, PixelFormat format)
+    {
+        using PF = PixelFormat;
+
+        auto const width = dst.y.width;
+        auto const height = dst.y.height;
+
+        auto sy = src.begin;
+        auto sc = sy + width * height;
+
+        switch (format)
+        {
+        case PF::YUYV:
+        case PF::YUNV:
+        case PF::YUY2:
+        case PF::YVYU:
+        case PF::UYVY:
+        case PF::Y422:
+        case PF::UYNV:
+        case PF::HDYC:
+            yuyv_to_subsampled(src, dst, format);
+            break;
+
+        case PF::NV12:
+        case PF::NV21:
+        {
+            assert(src.length == width * height + width * height / 2);
+
+            auto uv = offset_uv(format);
+            yuv420_to_subsampled(sy, sc + uv.u, sc + uv.v, 2, width, dst);
+        } break;
+
+        case PF::YV12:
+        case PF::I420:
+        case PF::IYUV:
+        {
+            assert(src.length == width * height + width * height / 2);
+
+            auto c_size = (width / 2) * (height / 2);
+            auto su = format == PF::YV12 ? sc + c_size : sc;
+            auto sv = format == PF::YV12 ? sc : sc + c_size;
+            yuv420_to_subsampled(sy, su, sv, 1, width / 2, dst);
+        } break;
+
+        default:
+            break;
+        }
+    }
+
+
+    template <u32 SX, u32 SY>
+    static void subsampled_to_rgba(SubsampledYUV<SX, SY> const& src, img::ImageView const& dst, ColorTable const& ct)
+    {
+        static_assert(SX == 2);
+
+        assert(src.y.width == dst.width);
+        assert(src.y.height == dst.height);
+
+        auto const width = dst.width;
+
+        for_each_band(dst.height, SY, [&](u32 y_begin, u32 y_end)
+        {
+            for (u32 h = y_begin; h < y_end; h++)
+            {
+                auto c = num::min(h / SY, src.u.height - 1);
+
+                auto y = img::row_begin(src.y, h);
+                auto u = img::row_begin(src.u, c);
+                auto v = img::row_begin(src.v, c);
+
+                yv12_row_to_rgba<Kernel::Fixed>(y, u, v, img::row_begin(dst, h), width, ct);
+            }
+        });
+    }
+}
+
+
+/* resample */
+
+namespace convert
+{
+    class FrameSource
+    {
+    public:
+        u8* data = nullptr;
+        u32 width = 0;
+        u32 height = 0;
+
+        PixelFormat format = PixelFormat::Invalid;
+
+        // full size yuv planes when there is no data, see resize_yuv
+        u8* planes[3] = { 0 };
+    };
+
+
+    static void yuyv_row_to_planar(u8* src, u8* dst_y, u8* dst_u, u8* dst_v, u32 width, OffsetYUYV yuyv)
+    {
+        u32 i = 0;
+
+#ifdef CONVERT_SIMD_128
+
+        auto sh = shuffle_yuyv(yuyv);
+
+        for (; i + 8 <= width; i += 8)
+        {
+            auto s = _mm_loadu_si128((i128*)(src + 2 * i));
+
+            store_u16_128(_mm_shuffle_epi8(s, sh.y), dst_y + i);
+            store_u16_128(_mm_shuffle_epi8(s, sh.u), dst_u + i);
+            store_u16_128(_mm_shuffle_epi8(s, sh.v), dst_v + i);
+        }
+
+#endif
+
+        for (; i < width; i++)
+        {
+            auto s = src + 4 * (i / 2);
+
+            dst_y[i] = s[i % 2 ? yuyv.y2 : yuyv.y1];
+            dst_u[i] = s[yuyv.u];
+            dst_v[i] = s[yuyv.v];
+        }
+    }
+
+
+    static void nv12_row_to_planar(u8* src_y, u8* src_uv, u8* dst_y, u8* dst_u, u8* dst_v, u32 width, OffsetUV uv)
+    {
+        u32 i = 0;
+
+#ifdef CONVERT_SIMD_128
+
+        auto sh = shuffle_nv12(uv, 0);
+
+        for (; i + 8 <= width; i += 8)
+        {
+            auto s = _mm_loadl_epi64((i128*)(src_uv + i));
+
+            _mm_storel_epi64((i128*)(dst_y + i), _mm_loadl_epi64((i128*)(src_y + i)));
+            store_u16_128(_mm_shuffle_epi8(s, sh.u), dst_u + i);
+            store_u16_128(_mm_shuffle_epi8(s, sh.v), dst_v + i);
+        }
+
+#endif
+
+        for (; i < width; i++)
+        {
+            auto s = src_uv + 2 * (i / 2);
+
+            dst_y[i] = src_y[i];
+            dst_u[i] = s[uv.u];
+            dst_v[i] = s[uv.v];
+        }
+    }
+
+
+    static void yv12_row_to_planar(u8* src_y, u8* src_u, u8* src_v, u8* dst_y, u8* dst_u, u8* dst_v, u32 width)
+    {
+        u32 i = 0;
+
+#ifdef CONVERT_SIMD_128
+
+        auto sh = shuffle_yv12(0);
+
+        for (; i + 8 <= width; i += 8)
+        {
+            _mm_storel_epi64((i128*)(dst_y + i), _mm_loadl_epi64((i128*)(src_y + i)));
+            store_u16_128(_mm_shuffle_epi8(load_u8x4_128(src_u + i / 2), sh), dst_u + i);
+            store_u16_128(_mm_shuffle_epi8(load_u8x4_128(src_v + i / 2), sh), dst_v + i);
+        }
+
+#endif
+
+        for (; i < width; i++)
+        {
+            dst_y[i] = src_y[i];
+            dst_u[i] = src_u[i / 2];
+            dst_v[i] = src_v[i / 2];
+        }
+    }
+
+
+    // one source row at full width, chroma repeated
+    static void decode_row(FrameSource const& src, u32 y, u8* dst_y, u8* dst_u, u8* dst_v)
+    {
+        using PF = PixelFormat;
+
+        auto const width = src.width;
+        auto const height = src.height;
+        auto const s = src.data;
+
+        if (!s)
+        {
+            auto offset = y * width;
+
+            span::copy_u8(src.planes[0] + offset, dst_y, width);
+            span::copy_u8(src.planes[1] + offset, dst_u, width);
+            span::copy_u8(src.planes[2] + offset, dst_v, width);
+            return;
+        }
+
+        switch (src.format)
+        {
+        case PF::YUYV:
+        case PF::YUNV:
+        case PF::YUY2:
+        case PF::YVYU:
+        case PF::UYVY:
+        case PF::Y422:
+        case PF::UYNV:
+        case PF::HDYC:
+            yuyv_row_to_planar(s + y * width * 2, dst_y, dst_u, dst_v, width, offset_yuyv(src.format));
+            break;
+
+        case PF::NV12:
+        case PF::NV21:
+            nv12_row_to_planar(s + y * width, s + width * height + (y / 2) * width, dst_y, dst_u, dst_v, width, offset_uv(src.format));
+            break;
+
+        case PF::P010:
+        {
+            auto sy = (u16*)s;
+            p010_row_to_planar<P010_SHIFT + 2>(sy + y * width, sy + width * height + (y / 2) * width, dst_y, dst_u, dst_v, width);
+        } break;
+
+        case PF::YV12:
+        case PF::I420:
+        case PF::IYUV:
+        {
+            auto c_size = (width / 2) * (height / 2);
+            auto c = s + width * height + (y / 2) * (width / 2);
+            auto u = src.format == PF::YV12 ? c + c_size : c;
+            auto v = src.format == PF::YV12 ? c : c + c_size;
+
+            yv12_row_to_planar(s + y * width, u, v, dst_y, dst_u, dst_v, width);
+        } break;
+
+        default:
+            break;
+        }
+    }
+}
+
+
+namespace convert
+{
+    class ResampleTap
+    {
+    public:
+        u32 first;
+        u32 count;
+    };
+
+
+    // weights in fxp::Q and summing to 1, stored as madd pairs
+    // pairs[p * len + i] holds the weights of taps 2p and 2p + 1 of output i, zero padded
+    class ResampleAxis
+    {
+    public:
+        MemoryBuffer<ResampleTap> taps;
+        MemoryBuffer<u32> pairs;
+
+        u32 len = 0;
+        u32 taps_max = 0;
+        u32 n_pairs = 0;
+    };
+
+
+    static void destroy_resample_axis(ResampleAxis& axis)
+    {
+        mb::destroy_buffer(axis.taps);
+        mb::destroy_buffer(axis.pairs);
+    }
+
+
+    static bool create_resample_axis(u32 src_len, u32 dst_len, Resample mode, ResampleAxis& axis)
+    {
+        constexpr u32 one = 1u << fxp::Q;
+
+        axis.len = dst_len;
+        axis.taps_max = mode == Resample::Area ? (src_len + dst_len - 1) / dst_len + 1 : 2;
+        axis.n_pairs = (axis.taps_max + 1) / 2;
+
+        if (!mb::create_buffer(axis.taps, dst_len, "resample taps") ||
+            !mb::create_buffer(axis.pairs, dst_len * axis.n_pairs, "resample weights"))
+        {
+            destroy_resample_axis(axis);
+            return false;
+        }
+
+        auto const set_weight = [&](u32 i, u32 k, u32 w)
+        {
+            auto& pair = axis.pairs.data_[(k / 2) * dst_len + i];
+            auto shift = 16 * (k % 2);
+
+            pair = (pair & ~(0xFFFFu << shift)) | (w << shift);
+        };
+
+        for (u32 i = 0; i < dst_len * axis.n_pairs; i++)
+        {
+            axis.pairs.data_[i] = 0;
+        }
+
+        for (u32 i = 0; i < dst_len; i++)
+        {
+            auto& tap = axis.taps.data_[i];
+
+            // positions in integer units so taps are exact
+            if (mode == Resample::Area)
+            {
+                // output i covers [i * src, (i + 1) * src), source j covers [j * dst, (j + 1) * dst)
+                u64 begin = (u64)i * src_len;
+                u64 end = begin + src_len;
+
+                tap.first = (u32)(begin / dst_len);
+                tap.count = (u32)((end - 1) / dst_len) - tap.first + 1;
+
+                u32 total = 0;
+                u32 w_max = 0;
+                u32 k_max = 0;
+
+                for (u32 k = 0; k < tap.count; k++)
+                {
+                    u64 j_begin = (u64)(tap.first + k) * dst_len;
+                    u64 overlap = num::min(end, j_begin + dst_len) - num::max(begin, j_begin);
+
+                    auto w = (u32)((overlap << fxp::Q) / src_len);
+                    set_weight(i, k, w);
+
+                    total += w;
+                    k_max = w > w_max ? k : k_max;
+                    w_max = num::max(w, w_max);
+                }
+
+                set_weight(i, k_max, w_max + one - total);
+            }
+            else
+            {
+                // sample center in units of 1 / (2 * dst)
+                i64 center = (i64)(2 * i + 1) * src_len - dst_len;
+                u64 pos = center < 0 ? 0 : (u64)center;
+                u64 unit = 2 * (u64)dst_len;
+
+                tap.first = (u32)(pos / unit);
+                tap.count = 2;
+
+                if (tap.first + 1 >= src_len)
+                {
+                    tap.first = src_len - 1;
+                    tap.count = 1;
+                }
+
+                auto w1 = tap.count == 2 ? (u32)(((pos % unit) << fxp::Q) / unit) : 0u;
+
+                set_weight(i, 0, one - w1);
+                set_weight(i, 1, w1);
+            }
+        }
+
+        return true;
+    }
+}
+
+
+namespace convert
+{
+    // decoded source rows, slot = row % n_rows
+    class RowCache
+    {
+    public:
+        u32 width = 0;
+        u32 n_rows = 0;
+
+        u32* row_ids = nullptr;
+
+        u8* y = nullptr;
+        u8* u = nullptr;
+        u8* v = nullptr;
+    };
+
+
+    static void cache_row(RowCache& cache, FrameSource const& src, u32 row)
+    {
+        auto slot = row % cache.n_rows;
+
+        if (cache.row_ids[slot] != row)
+        {
+            auto offset = slot * cache.width;
+
+            decode_row(src, row, cache.y + offset, cache.u + offset, cache.v + offset);
+            cache.row_ids[slot] = row;
+        }
+    }
+
+
+    // vertical results keep 6 fraction bits for the horizontal pass
+    constexpr u32 RESAMPLE_FRACTION = 6;
+    constexpr u32 RESAMPLE_SHIFT_V = fxp::Q - RESAMPLE_FRACTION;
+    constexpr u32 RESAMPLE_SHIFT_H = fxp::Q + RESAMPLE_FRACTION;
+
+
+#ifdef CONVERT_SIMD_256
+
+    CONVERT_TARGET_256
+    static u32 resample_rows_256(u8* const* rows, u32 const* weights, u32 w_stride, u32 n_pairs, u16* dst, u32 width)
+    {
+        u32 i = 0;
+
+        auto const half_256 = _mm256_set1_epi32(1 << (RESAMPLE_SHIFT_V - 1));
+
+        for (; i + 16 <= width; i += 16)
+        {
+            auto lo = half_256;
+            auto hi = half_256;
+
+            for (u32 p = 0; p < n_pairs; p++)
+            {
+                auto a = load_u8_256(rows[2 * p] + i);
+                auto b = load_u8_256(rows[2 * p + 1] + i);
+                auto w = _mm256_set1_epi32((i32)weights[p * w_stride]);
+
+                lo = _mm256_add_epi32(lo, _mm256_madd_epi16(_mm256_unpacklo_epi16(a, b), w));
+                hi = _mm256_add_epi32(hi, _mm256_madd_epi16(_mm256_unpackhi_epi16(a, b), w));
+            }
+
+            auto c16 = _mm256_packus_epi32(_mm256_srai_epi32(lo, RESAMPLE_SHIFT_V), _mm256_srai_epi32(hi, RESAMPLE_SHIFT_V));
+
+            _mm256_storeu_si256((i256*)(dst + i), c16);
+        }
+
+        return i;
+    }
+
+#endif
+
+
+    // rows has an even number of entries, weights has one pair per two rows
+    static void resample_rows(u8* const* rows, u32 const* weights, u32 w_stride, u32 n_pairs, u16* dst, u32 width)
+    {
+        u32 i = 0;
+
+#ifdef CONVERT_SIMD_256
+
+        if (use_simd_256())
+        {
+            i = resample_rows_256(rows, weights, w_stride, n_pairs, dst, width);
+        }
+
+#endif
+
+#ifdef CONVERT_SIMD_128
+
+        auto const half = _mm_set1_epi32(1 << (RESAMPLE_SHIFT_V - 1));
+
+        for (; i + 8 <= width; i += 8)
+        {
+            auto lo = half;
+            auto hi = half;
+
+            for (u32 p = 0; p < n_pairs; p++)
+            {
+                auto a = load_u8_128(rows[2 * p] + i);
+                auto b = load_u8_128(rows[2 * p + 1] + i);
+                auto w = _mm_set1_epi32((i32)weights[p * w_stride]);
+
+                lo = _mm_add_epi32(lo, _mm_madd_epi16(_mm_unpacklo_epi16(a, b), w));
+                hi = _mm_add_epi32(hi, _mm_madd_epi16(_mm_unpackhi_epi16(a, b), w));
+            }
+
+            auto c16 = _mm_packus_epi32(_mm_srai_epi32(lo, RESAMPLE_SHIFT_V), _mm_srai_epi32(hi, RESAMPLE_SHIFT_V));
+
+            _mm_storeu_si128((i128*)(dst + i), c16);
+        }
+
+#endif
+
+        for (; i < width; i++)
+        {
+            i32 acc = 1 << (RESAMPLE_SHIFT_V - 1);
+
+            for (u32 p = 0; p < n_pairs; p++)
+            {
+                auto w = weights[p * w_stride];
+
+                acc += (i16)(w & 0xFFFF) * rows[2 * p][i] + (i16)(w >> 16) * rows[2 * p + 1][i];
+            }
+
+            dst[i] = (u16)num::clamp(acc >> RESAMPLE_SHIFT_V, 0, 0xFFFF);
+        }
+    }
+
+
+    static inline i32 load_u16x2(u16* src)
+    {
+        return (i32)(src[0] | (u32)src[1] << 16);
+    }
+
+
+#ifdef CONVERT_SIMD_256
+
+    CONVERT_TARGET_256
+    static u32 resample_cols_256(u16* src, ResampleAxis const& axis, u8* dst)
+    {
+        auto const width = axis.len;
+        auto const taps = axis.taps.data_;
+
+        u32 i = 0;
+
+        auto const half_256 = _mm256_set1_epi32(1 << (RESAMPLE_SHIFT_H - 1));
+        auto const lanes = _mm256_setr_epi32(0, 2, 4, 6, 8, 10, 12, 14);
+
+        for (; i + 8 <= width; i += 8)
+        {
+            // tap pairs are adjacent u16 samples, one u32 gather per output
+            auto first = _mm256_i32gather_epi32((int const*)&taps[i].first, lanes, 4);
+            auto acc = half_256;
+
+            for (u32 p = 0; p < axis.n_pairs; p++)
+            {
+                auto idx = _mm256_add_epi32(first, _mm256_set1_epi32(2 * p));
+                auto s = _mm256_i32gather_epi32((int const*)src, idx, 2);
+                auto w = _mm256_loadu_si256((i256*)(axis.pairs.data_ + p * width + i));
+
+                acc = _mm256_add_epi32(acc, _mm256_madd_epi16(s, w));
+            }
+
+            auto c32 = _mm256_srai_epi32(acc, RESAMPLE_SHIFT_H);
+            auto c16 = _mm_packs_epi32(_mm256_castsi256_si128(c32), _mm256_extracti128_si256(c32, 1));
+
+            _mm_storel_epi64((i128*)(dst + i), _mm_packus_epi16(c16, c16));
+        }
+
+        return i;
+    }
+
+#endif
+
+
+    // src is padded with taps_max zero samples
+    static void resample_cols(u16* src, ResampleAxis const& axis, u8* dst)
+    {
+        auto const width = axis.len;
+        auto const taps = axis.taps.data_;
+
+        u32 i = 0;
+
+#ifdef CONVERT_SIMD_256
+
+        if (use_simd_256())
+        {
+            i = resample_cols_256(src, axis, dst);
+        }
+
+#endif
+
+#ifdef CONVERT_SIMD_128
+
+        auto const half = _mm_set1_epi32(1 << (RESAMPLE_SHIFT_H - 1));
+
+        for (; i + 4 <= width; i += 4)
+        {
+            auto acc = half;
+
+            for (u32 p = 0; p < axis.n_pairs; p++)
+            {
+                auto k = 2 * p;
+                auto s = _mm_setr_epi32(
+                    load_u16x2(src + taps[i].first + k),
+                    load_u16x2(src + taps[i + 1].first + k),
+                    load_u16x2(src + taps[i + 2].first + k),
+                    load_u16x2(src + taps[i + 3].first + k));
+
+                auto w = _mm_loadu_si128((i128*)(axis.pairs.data_ + p * width + i));
+
+                acc = _mm_add_epi32(acc, _mm_madd_epi16(s, w));
+            }
+
+            auto c32 = _mm_srai_epi32(acc, RESAMPLE_SHIFT_H);
+            auto c16 = _mm_packs_epi32(c32, c32);
+            auto c8 = _mm_packus_epi16(c16, c16);
+
+            auto c = (u32)_mm_cvtsi128_si32(c8);
+
+            dst[i] = (u8)c;
+            dst[i + 1] = (u8)(c >> 8);
+            dst[i + 2] = (u8)(c >> 16);
+            dst[i + 3] = (u8)(c >> 24);
+        }
+
+#endif
+
+        for (; i < width; i++)
+        {
+            auto s = src + taps[i].first;
+
+            i32 acc = 1 << (RESAMPLE_SHIFT_H - 1);
+
+            for (u32 p = 0; p < axis.n_pairs; p++)
+            {
+                auto w = axis.pairs.data_[p * width + i];
+
+                acc += (i16)(w & 0xFFFF) * s[2 * p] + (i16)(w >> 16) * s[2 * p + 1];
+            }
+
+            dst[i] = (u8)num::clamp(acc >> RESAMPLE_SHIFT_H, 0, 255);
+        }
+    }
+
+
+    template <class VIEW>
+    static void resize_to_rgba(FrameSource const& src, VIEW const& dst, Resample mode, ColorTable const& ct)
+    {
+        ResampleAxis ax{};
+        ResampleAxis ay{};
+
+        if (!create_resample_axis(src.width, dst.width, mode, ax) || !create_resample_axis(src.height, dst.height, mode, ay))
+        {
+            destroy_resample_axis(ax);
+            destroy_resample_axis(ay);
+            img::fill(dst, img::to_pixel(100));
+            return;
+        }
+
+        auto const src_w = src.width;
+        auto const dst_w = dst.width;
+
+        for_each_band(dst.height, 1, [&](u32 y_begin, u32 y_end)
+        {
+            // per band scratch, only source rows under the filter are decoded
+            RowCache cache{};
+            cache.width = src_w;
+            cache.n_rows = ay.taps_max;
+
+            auto n_cache = cache.n_rows * src_w;
+            auto n_col = src_w + 2 * ax.n_pairs;
+
+            img::Buffer8 buffer8{};
+            img::Buffer16 buffer16{};
+            MemoryBuffer<u32> buffer32{};
+            MemoryBuffer<u8*> rows{};
+
+            auto ok =
+                mb::create_buffer(buffer8, n_cache * 3 + dst_w * 3, "resample rows") &&
+                mb::create_buffer(buffer16, n_col, "resample cols") &&
+                mb::create_buffer(buffer32, cache.n_rows, "resample row ids") &&
+                mb::create_buffer(rows, 2 * ay.n_pairs, "resample row ptrs");
+
+            if (ok)
+            {
+                cache.y = buffer8.data_;
+                cache.u = cache.y + n_cache;
+                cache.v = cache.u + n_cache;
+                cache.row_ids = buffer32.data_;
+
+                u8* out[3] = { cache.v + n_cache, cache.v + n_cache + dst_w, cache.v + n_cache + 2 * dst_w };
+                u8* planes[3] = { cache.y, cache.u, cache.v };
+
+                auto col = buffer16.data_;
+
+                // zero weight taps past the row end read the padding
+                for (u32 i = src_w; i < n_col; i++)
+                {
+                    col[i] = 0;
+                }
+
+                for (u32 i = 0; i < cache.n_rows; i++)
+                {
+                    cache.row_ids[i] = (u32)-1;
+                }
+
+                for (u32 h = y_begin; h < y_end; h++)
+                {
+                    auto tap = ay.taps.data_[h];
+                    auto n_pairs = (tap.count + 1) / 2;
+
+                    for (u32 k = 0; k < tap.count; k++)
+                    {
+                        cache_row(cache, src, tap.first + k);
+                    }
+
+                    for (u32 ch = 0; ch < 3; ch++)
+                    {
+                        for (u32 k = 0; k < tap.count; k++)
+                        {
+                            rows.data_[k] = planes[ch] + ((tap.first + k) % cache.n_rows) * src_w;
+                        }
+
+                        // odd tap counts pair the last row with a zero weight
+                        rows.data_[2 * n_pairs - 1] = rows.data_[tap.count - 1];
+
+                        resample_rows(rows.data_, ay.pairs.data_ + h, ay.len, n_pairs, col, src_w);
+                        resample_cols(col, ax, out[ch]);
+                    }
+
+                    yuv_to_rgba_fixed(out[0], out[1], out[2], img::row_begin(dst, h), dst_w, ct);
+                }
+            }
+            else
+            {
+                for (u32 h = y_begin; h < y_end; h++)
+                {
+                    auto d = img::row_begin(dst, h);
+                    for (u32 x = 0; x < dst_w; x++)
+                    {
+                        d[x] = img::to_pixel(100);
+                    }
+                }
+            }
+
+            mb::destroy_buffer(buffer8);
+            mb::destroy_buffer(buffer16);
+            mb::destroy_buffer(buffer32);
+            mb::destroy_buffer(rows);
+        });
+
+        destroy_resample_axis(ax);
+        destroy_resample_axis(ay);
+    }
+
+
+    template <class VIEW>
+    static void resize_view(SpanView<u8> const& src, u32 src_width, u32 src_height, VIEW const& dst, PixelFormat format, Resample mode, ColorTable const& ct)
+    {
+        if (validate_format(src.length, src_width, src_height, format) == PixelFormat::Invalid || !dst.width || !dst.height)
+        {
+            img::fill(dst, img::to_pixel(100));
+            return;
+        }
+
+        if (src_width == dst.width && src_height == dst.height)
+        {
+            convert_to_rgba<Kernel::Fixed>(src, dst, format, ct);
+            return;
+        }
+
+        FrameSource fs{};
+        fs.data = src.begin;
+        fs.width = src_width;
+        fs.height = src_height;
+        fs.format = format;
+
+        resize_to_rgba(fs, dst, mode, ct);
+    }
+
+
+    template <class VIEW>
+    static void resize_yuv(ViewYUV const& src, VIEW const& dst, Resample mode, ColorTable const& ct)
+    {
+        if (!src.width || !src.height || !dst.width || !dst.height)
+        {
+            img::fill(dst, img::to_pixel(100));
+            return;
+        }
+
+        if (src.width == dst.width && src.height == dst.height)
+        {
+            yuv_to_rgba(src, dst, ct);
+            return;
+        }
+
+        FrameSource fs{};
+        fs.width = src.width;
+        fs.height = src.height;
+
+        for (u32 c = 0; c < 3; c++)
+        {
+            fs.planes[c] = src.channel_data[c];
+        }
+
+        resize_to_rgba(fs, dst, mode, ct);
+    }
+}
+
+
+/* api */
+
+namespace convert
+{
+    PixelFormat validate_format(u32 src_len, u32 width, u32 height, PixelFormat format)
+    {
+        using PF = PixelFormat;
+
+        u32 is_valid = 0;
+
+        switch (format)
+        {
+        case PF::YUYV:
+        case PF::YUNV:
+        case PF::YUY2:
+        case PF::YVYU:
+        case PF::UYVY:
+        case PF::Y422:
+        case PF::UYNV:
+        case PF::HDYC:
+            is_valid = src_len == width * height * 2;
+            break;
+        
+        case PF::NV12:
+        case PF::NV21:
+        case PF::YV12:
+        case PF::I420:
+        case PF::IYUV:
+            is_valid = src_len == width * height + width * height / 2;
+            break;
+
+        case PF::P010:
+            is_valid = src_len == p010_size(width, height);
+            break;
+
+        default:
+            break;
+        }
+
+        return (PF)(is_valid * (u32)format);
+    }
+    
+    
+    ColorTable make_color_table(ColorMatrix matrix, ColorRange range)
+    {
+        // R = Y + vr V
+        // G = Y + ug U + vg V
+        // B = Y + ub U
+        f32 vr = 0.0f;
+        f32 ug = 0.0f;
+        f32 vg = 0.0f;
+        f32 ub = 0.0f;
+
+        f32 c_offset = 128.0f;
+
+        auto const from_kr_kb = [&](f32 kr, f32 kb)
+        {
+            auto kg = 1.0f - kr - kb;
+
+            vr = 2.0f * (1.0f - kr);
+            ub = 2.0f * (1.0f - kb);
+            ug = -2.0f * kb * (1.0f - kb) / kg;
+            vg = -2.0f * kr * (1.0f - kr) / kg;
+        };
+
+        switch (matrix)
+        {
+        case ColorMatrix::BT601:
+            from_kr_kb(0.299f, 0.114f);
+            break;
+
+        case ColorMatrix::BT709:
+            from_kr_kb(0.2126f, 0.0722f);
+            break;
+
+        case ColorMatrix::BT2020:
+            from_kr_kb(0.2627f, 0.0593f);
+            break;
+
+        default:
+            vr = yuv::vr;
+            ug = yuv::ug;
+            vg = yuv::vg;
+            ub = yuv::ub;
+            c_offset = 127.5f;
+            break;
+        }
+
+        f32 y_offset = 0.0f;
+        f32 y_scale = 1.0f;
+        f32 c_scale = 1.0f;
+
+        if (range == ColorRange::Limited)
+        {
+            y_offset = 16.0f;
+            y_scale = 255.0f / 219.0f;
+            c_scale = 255.0f / 224.0f;
+        }
+
+        vr *= c_scale;
+        ug *= c_scale;
+        vg *= c_scale;
+        ub *= c_scale;
+
+        // chroma is doubled so its coefficients are at half scale
+        constexpr f32 y_one = (f32)(1 << fxp::Q);
+        constexpr f32 c_one = (f32)fxp::HALF;
+
+        ColorTable table{};
+
+        table.ky = (i16)num::round_to_signed<i32>(y_scale * y_one);
+        table.y_offset = (i16)y_offset;
+        table.c_offset2 = (i16)(2.0f * c_offset);
+        table.kvr = (i16)num::round_to_signed<i32>(vr * c_one);
+        table.kug = (i16)num::round_to_signed<i32>(ug * c_one);
+        table.kvg = (i16)num::round_to_signed<i32>(vg * c_one);
+        table.kub = (i16)num::round_to_signed<i32>(ub * c_one);
+
+        // same products as simd so both paths agree exactly
+        for (i32 i = 0; i < 256; i++)
+        {
+            auto c2 = 2 * i - table.c_offset2;
+
+            table.y[i] = table.ky * (i - table.y_offset) + fxp::HALF;
+            table.vr[i] = table.kvr * c2;
+            table.ug[i] = table.kug * c2;
+            table.vg[i] = table.kvg * c2;
+            table.ub[i] = table.kub * c2;
+        }
+
+        return table;
+    }
+
+
+    void convert_view(SpanView<u8> const& src, img::ImageView const& dst, PixelFormat format)
+    {
+        convert_view(src, dst, format, Kernel::Fixed);
+    }
+
+
+    void convert_view(SpanView<u8> const& src, img::ImageView const& dst, PixelFormat format, Kernel kernel)
+    {
+        auto& ct = default_color_table();
+
+        switch (kernel)
+        {
+        case Kernel::Fixed:
+            convert_to_rgba<Kernel::Fixed>(src, dst, format, ct);
+            break;
+
+        case Kernel::Float:
+            convert_to_rgba<Kernel::Float>(src, dst, format, ct);
             break;
+        }
+    }
+
+
+    void convert_view(SpanView<u8> const& src, img::ImageView const& dst, PixelFormat format, ColorTable const& table)
+    {
+        convert_to_rgba<Kernel::Fixed>(src, dst, format, table);
+    }
+
+
+    void convert_sub_view(SpanView<u8> const& src, img::SubView const& dst, PixelFormat format)
+    {
+        convert_to_rgba<Kernel::Fixed>(src, dst, format, default_color_table());
+    }
+
+
+    void convert_sub_view(SpanView<u8> const& src, img::SubView const& dst, PixelFormat format, ColorTable const& table)
+    {
+        convert_to_rgba<Kernel::Fixed>(src, dst, format, table);
+    }
+
+
+    void convert_resize(SpanView<u8> const& src, u32 src_width, u32 src_height, img::ImageView const& dst, PixelFormat format, Resample mode)
+    {
+        convert_resize(src, src_width, src_height, dst, format, mode, default_color_table());
+    }
+
+
+    void convert_resize(SpanView<u8> const& src, u32 src_width, u32 src_height, img::SubView const& dst, PixelFormat format, Resample mode)
+    {
+        convert_resize(src, src_width, src_height, dst, format, mode, default_color_table());
+    }
 
-        case PF::I420:
-        case PF::IYUV:
-            src_v.matrix_data_ += width * height / 4;
-            break;
-        }
 
-        if (height == dst.height)
-        {
-            yv12_to_planar_1_1(src_y, src_u, src_v, dst);
-        }
-        else
-        {
-            yv12_to_planar_2_1(src_y, src_u, src_v, dst);
-        }
+    void convert_resize(SpanView<u8> const& src, u32 src_width, u32 src_height, img::ImageView const& dst, PixelFormat format, Resample mode, ColorTable const& table)
+    {
+        resize_view(src, src_width, src_height, dst, format, mode, table);
     }
-}
 
 
-/* api */
+    void convert_resize(SpanView<u8> const& src, u32 src_width, u32 src_height, img::SubView const& dst, PixelFormat format, Resample mode, ColorTable const& table)
+    {
+        resize_view(src, src_width, src_height, dst, format, mode, table);
+    }
 
-namespace convert
-{
-    PixelFormat validate_format(u32 src_len, u32 width, u32 height, PixelFormat format)
+
+    void to_yuv(SpanView<u8> const& src, u32 width, u32 height, ViewYUV const& dst, PixelFormat format)
     {
         using PF = PixelFormat;
 
-        u32 is_valid = 0;
-
         switch (format)
         {
         case PF::YUYV:
@@ -785,184 +3224,378 @@ namespace convert
         case PF::Y422:
         case PF::UYNV:
         case PF::HDYC:
-            is_valid = src_len == width * height * 2;
+            yuyv_to_yuv(src, width, height, dst, format);
             break;
-        
+
         case PF::NV12:
         case PF::NV21:
+            nv12_to_yuv(src, width, height, dst, format);
+            break;
+
         case PF::P010:
+            p010_to_planar<P010_SHIFT + 2>(src, width, height, dst);
+            break;
+
         case PF::YV12:
         case PF::I420:
         case PF::IYUV:
-            is_valid = src_len == width * height + width * height / 2;
-            break;
-
-        default:
+            yv12_to_yuv(src, width, height, dst, format);
             break;
         }
+    }
 
-        return (PF)(is_valid * (u32)format);
+
+    void yuv_to_rgba(ViewYUV const& src, img::ImageView const& dst)
+    {
+        yuv_to_rgba(src, dst, Kernel::Fixed);
     }
-    
-    
-    void convert_view(SpanView<u8> const& src, img::ImageView const& dst, PixelFormat format)
+
+
+    void yuv_to_rgba(ViewYUV const& src, img::ImageView const& dst, Kernel kernel)
     {
-        using PF = PixelFormat;
+        assert(src.width == dst.width);
+        assert(src.height == dst.height);
 
-        switch (format)
+        auto const width = src.width;
+        auto& ct = default_color_table();
+
+        for_each_band(src.height, 1, [&](u32 y_begin, u32 y_end)
         {
-        case PF::YUYV:
-        case PF::YUNV:
-        case PF::YUY2:
-        case PF::YVYU:
-        case PF::UYVY:
-        case PF::Y422:
-        case PF::UYNV:
-        case PF::HDYC:
-            yuyv_to_rgba(src, dst, format);
-            break;
+            auto offset = y_begin * width;
+            auto len = (y_end - y_begin) * width;
 
-        case PF::NV12:
-        case PF::NV21:
-        case PF::P010:
-            nv12_to_rgba(src, dst, format);
-            break;
-        
-        case PF::YV12:
-        case PF::I420:
-        case PF::IYUV:
-            yv12_to_rgba(src, dst, format);
-            break;
+            auto y = src.channel_data[(u32)YUV::Y] + offset;
+            auto u = src.channel_data[(u32)YUV::U] + offset;
+            auto v = src.channel_data[(u32)YUV::V] + offset;
 
-        default:
-            img::fill(dst, img::to_pixel(100));
-        }
+            auto d = dst.matrix_data_ + offset;
+
+            switch (kernel)
+            {
+            case Kernel::Fixed:
+                yuv_to_rgba_fixed(y, u, v, d, len, ct);
+                break;
+
+            case Kernel::Float:
+                yuv_to_rgba(y, u, v, d, len);
+                break;
+            }
+        });
     }
 
 
-    void convert_sub_view(SpanView<u8> const& src, img::SubView const& dst, PixelFormat format)
+    void yuv_to_rgba(ViewYUV const& src, img::ImageView const& dst, ColorTable const& table)
     {
-        using PF = PixelFormat;
+        assert(src.width == dst.width);
+        assert(src.height == dst.height);
 
-        switch (format)
+        auto const width = src.width;
+
+        for_each_band(src.height, 1, [&](u32 y_begin, u32 y_end)
         {
-        case PF::YUYV:
-        case PF::YUNV:
-        case PF::YUY2:
-        case PF::YVYU:
-        case PF::UYVY:
-        case PF::Y422:
-        case PF::UYNV:
-        case PF::HDYC:
-            yuyv_to_rgba(src, dst, format);
-            break;
+            auto offset = y_begin * width;
+            auto len = (y_end - y_begin) * width;
 
-        case PF::NV12:
-        case PF::NV21:
-        case PF::P010:
-            nv12_to_rgba(src, dst, format);
-            break;
-        
-        case PF::YV12:
-        case PF::I420:
-        case PF::IYUV:
-            yv12_to_rgba(src, dst, format);
-            break;
+            auto y = src.channel_data[(u32)YUV::Y] + offset;
+            auto u = src.channel_data[(u32)YUV::U] + offset;
+            auto v = src.channel_data[(u32)YUV::V] + offset;
 
-        default:
-            img::fill(dst, img::to_pixel(100));
-        }
+            yuv_to_rgba_fixed(y, u, v, dst.matrix_data_ + offset, len, table);
+        });
     }
 
 
-    void to_yuv(SpanView<u8> const& src, u32 width, u32 height, ViewYUV const& dst, PixelFormat format)
+    void yuv_to_rgba(ViewYUV const& src, img::SubView const& dst)
+    {
+        yuv_to_rgba(src, dst, default_color_table());
+    }
+
+
+    void yuv_to_rgba(ViewYUV const& src, img::SubView const& dst, ColorTable const& table)
+    {
+        assert(src.width == dst.width);
+        assert(src.height == dst.height);
+
+        auto const width = src.width;
+
+        for_each_band(src.height, 1, [&](u32 y_begin, u32 y_end)
+        {
+            // dst rows are strided, one row at a time
+            for (u32 h = y_begin; h < y_end; h++)
+            {
+                auto offset = h * width;
+
+                auto y = src.channel_data[(u32)YUV::Y] + offset;
+                auto u = src.channel_data[(u32)YUV::U] + offset;
+                auto v = src.channel_data[(u32)YUV::V] + offset;
+
+                yuv_to_rgba_fixed(y, u, v, img::row_begin(dst, h), width, table);
+            }
+        });
+    }
+
+
+    void yuv_to_rgba(ViewYUV const& src, img::ImageView const& dst, Resample mode, ColorTable const& table)
+    {
+        resize_yuv(src, dst, mode, table);
+    }
+
+
+    void yuv_to_rgba(ViewYUV const& src, img::SubView const& dst, Resample mode, ColorTable const& table)
+    {
+        resize_yuv(src, dst, mode, table);
+    }
+
+
+    void to_yuv(SpanView<u8> const& src, u32 width, u32 height, ViewYUV16 const& dst, PixelFormat format)
     {
         using PF = PixelFormat;
 
         switch (format)
         {
-        case PF::YUYV:
-        case PF::YUNV:
-        case PF::YUY2:
-        case PF::YVYU:
-        case PF::UYVY:
-        case PF::Y422:
-        case PF::UYNV:
-        case PF::HDYC:
-            yuyv_to_yuv(src, width, height, dst, format);
-            break;
-
-        case PF::NV12:
-        case PF::NV21:
         case PF::P010:
-            nv12_to_yuv(src, width, height, dst, format);
+            p010_to_planar<P010_SHIFT>(src, width, height, dst);
             break;
 
-        case PF::YV12:
-        case PF::I420:
-        case PF::IYUV:
-            yv12_to_yuv(src, width, height, dst, format);
+        default:
+            assert(false && " *** 16 bit planar requires P010 *** ");
             break;
         }
     }
 
 
-    void yuv_to_rgba(ViewYUV const& src, img::ImageView const& dst)
+    void to_yuv(SpanView<u8> const& src, ViewYUV420 const& dst, PixelFormat format)
+    {
+        to_subsampled(src, dst, format);
+    }
+
+
+    void to_yuv(SpanView<u8> const& src, ViewYUV422 const& dst, PixelFormat format)
+    {
+        to_subsampled(src, dst, format);
+    }
+
+
+    void yuv_to_rgba(ViewYUV420 const& src, img::ImageView const& dst)
+    {
+        subsampled_to_rgba(src, dst, default_color_table());
+    }
+
+
+    void yuv_to_rgba(ViewYUV420 const& src, img::ImageView const& dst, ColorTable const& table)
+    {
+        subsampled_to_rgba(src, dst, table);
+    }
+
+
+    void yuv_to_rgba(ViewYUV422 const& src, img::ImageView const& dst)
+    {
+        subsampled_to_rgba(src, dst, default_color_table());
+    }
+
+
+    void yuv_to_rgba(ViewYUV422 const& src, img::ImageView const& dst, ColorTable const& table)
+    {
+        subsampled_to_rgba(src, dst, table);
+    }
+
+
+    void yuv_to_rgba(ViewYUV16 const& src, img::ImageView const& dst)
+    {
+        yuv_to_rgba(src, dst, ToneMap::Linear, default_color_table());
+    }
+
+
+    void yuv_to_rgba(ViewYUV16 const& src, img::ImageView const& dst, ToneMap tone)
+    {
+        yuv_to_rgba(src, dst, tone, default_color_table());
+    }
+
+
+    void yuv_to_rgba(ViewYUV16 const& src, img::ImageView const& dst, ToneMap tone, ColorTable const& table)
     {
         assert(src.width == dst.width);
         assert(src.height == dst.height);
 
-        auto len = src.width * src.height;
+        auto const width = src.width;
+        auto lut = tone_map_lut(tone);
+
+        for_each_band(src.height, 1, [&](u32 y_begin, u32 y_end)
+        {
+            auto offset = y_begin * width;
+            auto len = (y_end - y_begin) * width;
 
-        auto y = src.channel_data[(u32)YUV::Y];
-        auto u = src.channel_data[(u32)YUV::U];
-        auto v = src.channel_data[(u32)YUV::V];
+            auto y = src.channel_data[(u32)YUV::Y] + offset;
+            auto u = src.channel_data[(u32)YUV::U] + offset;
+            auto v = src.channel_data[(u32)YUV::V] + offset;
+
+            auto d = dst.matrix_data_ + offset;
+
+            if (lut)
+            {
+                yuv16_to_rgba_lut(y, u, v, d, len, lut, table);
+            }
+            else
+            {
+                yuv16_to_rgba_linear(y, u, v, d, len, table);
+            }
+        });
+    }
 
-        auto d = dst.matrix_data_;
 
-        yuv_to_rgba(y, u, v, d, len);
+    void yuv_to_rgb(ViewYUV const& src, img::ViewRGBu8 const& dst)
+    {
+        yuv_to_rgb(src, dst, Kernel::Fixed);
     }
 
 
-    void yuv_to_rgba(ViewYUV const& src, img::SubView const& dst)
+    void yuv_to_rgb(ViewYUV const& src, img::ViewRGBu8 const& dst, Kernel kernel)
     {
         assert(src.width == dst.width);
         assert(src.height == dst.height);
 
-        auto len = src.width;
+        auto const width = src.width;
+        auto& ct = default_color_table();
+
+        for_each_band(src.height, 1, [&](u32 y_begin, u32 y_end)
+        {
+            auto offset = y_begin * width;
+            auto len = (y_end - y_begin) * width;
+
+            auto y = src.channel_data[(u32)YUV::Y] + offset;
+            auto u = src.channel_data[(u32)YUV::U] + offset;
+            auto v = src.channel_data[(u32)YUV::V] + offset;
+
+            auto r = dst.channel_data[(u32)img::RGB::R] + offset;
+            auto g = dst.channel_data[(u32)img::RGB::G] + offset;
+            auto b = dst.channel_data[(u32)img::RGB::B] + offset;
+
+            switch (kernel)
+            {
+            case Kernel::Fixed:
+                yuv_to_rgb_fixed(y, u, v, r, g, b, len, ct);
+                break;
+
+            case Kernel::Float:
+                yuv_to_rgb(y, u, v, r, g, b, len);
+                break;
+            }
+        });
+    }
+
 
-        auto y = src.channel_data[(u32)YUV::Y];
-        auto u = src.channel_data[(u32)YUV::U];
-        auto v = src.channel_data[(u32)YUV::V];
+    void yuv_to_rgb(ViewYUV const& src, img::ViewRGBu8 const& dst, ColorTable const& table)
+    {
+        assert(src.width == dst.width);
+        assert(src.height == dst.height);
+
+        auto const width = src.width;
 
-        for (u32 h = 0; h < dst.height; y++)
+        for_each_band(src.height, 1, [&](u32 y_begin, u32 y_end)
         {
-            auto d = img::row_begin(dst, h);
-            yuv_to_rgba(y, u, v, d, len);
+            auto offset = y_begin * width;
+            auto len = (y_end - y_begin) * width;
 
-            y += len;
-            u += len;
-            v += len;
-        }
+            auto y = src.channel_data[(u32)YUV::Y] + offset;
+            auto u = src.channel_data[(u32)YUV::U] + offset;
+            auto v = src.channel_data[(u32)YUV::V] + offset;
+
+            auto r = dst.channel_data[(u32)img::RGB::R] + offset;
+            auto g = dst.channel_data[(u32)img::RGB::G] + offset;
+            auto b = dst.channel_data[(u32)img::RGB::B] + offset;
+
+            yuv_to_rgb_fixed(y, u, v, r, g, b, len, table);
+        });
     }
 
 
-    void yuv_to_rgb(ViewYUV const& src, img::ViewRGBu8 const& dst)
+    void yuv_to_rgb(ViewYUV const& src, img::SubViewRGBu8 const& dst)
+    {
+        yuv_to_rgb(src, dst, default_color_table());
+    }
+
+
+    void yuv_to_rgb(ViewYUV const& src, img::SubViewRGBu8 const& dst, ColorTable const& table)
     {
         assert(src.width == dst.width);
         assert(src.height == dst.height);
 
-        auto len = src.width * src.height;
+        auto const width = src.width;
+
+        for_each_band(src.height, 1, [&](u32 y_begin, u32 y_end)
+        {
+            for (u32 h = y_begin; h < y_end; h++)
+            {
+                auto s_offset = h * width;
+                auto d_offset = (u64)(dst.y_begin + h) * dst.channel_width + dst.x_begin;
 
-        auto y = src.channel_data[(u32)YUV::Y];
-        auto u = src.channel_data[(u32)YUV::U];
-        auto v = src.channel_data[(u32)YUV::V];
+                auto y = src.channel_data[(u32)YUV::Y] + s_offset;
+                auto u = src.channel_data[(u32)YUV::U] + s_offset;
+                auto v = src.channel_data[(u32)YUV::V] + s_offset;
 
-        auto r = dst.channel_data[(u32)img::RGB::R];
-        auto g = dst.channel_data[(u32)img::RGB::G];
-        auto b = dst.channel_data[(u32)img::RGB::B];
+                auto r = dst.channel_data[(u32)img::RGB::R] + d_offset;
+                auto g = dst.channel_data[(u32)img::RGB::G] + d_offset;
+                auto b = dst.channel_data[(u32)img::RGB::B] + d_offset;
+
+                yuv_to_rgb_fixed(y, u, v, r, g, b, width, table);
+            }
+        });
+    }
+
+
+    bool create_thread_pool(u32 n_threads, bool pin_to_cores)
+    {
+        auto& pool = thread_pool;
+
+        n_threads = num::clamp(n_threads, 1u, THREAD_COUNT_MAX);
+        auto n_cores = std::thread::hardware_concurrency();
+
+        bool pinned = true;
+
+        std::lock_guard<std::mutex> dispatch_lock(pool.dispatch_mtx);
+
+        ThreadPool::stop_workers(pool);
+
+        for (u32 id = 1; id < n_threads; id++)
+        {
+            u64 job_id = 0;
+            {
+                std::lock_guard<std::mutex> lock(pool.mtx);
+                pool.n_running++;
+                job_id = pool.job_id;
+            }
+
+            std::thread th(run_worker, id, job_id);
+
+            if (pin_to_cores && n_cores)
+            {
+                pinned &= pin_thread(th, id % n_cores);
+            }
+
+            th.detach();
+        }
+
+        pool.n_threads = n_threads;
+
+        return !pin_to_cores || pinned;
+    }
+
+
+    void destroy_thread_pool()
+    {
+        auto& pool = thread_pool;
+
+        std::lock_guard<std::mutex> dispatch_lock(pool.dispatch_mtx);
+
+        ThreadPool::stop_workers(pool);
+    }
+
+
+    bool enable_simd_256(bool enable)
+    {
+        simd_256_enabled() = enable && cpu_has_avx2();
 
-        yuv_to_rgb(y, u, v, r, g, b, len);
+        return simd_256_enabled();
     }
 }
 
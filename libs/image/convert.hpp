@@ -143,10 +143,81 @@ namespace convert
 
     PixelFormat validate_format(u32 src_len, u32 width, u32 height, PixelFormat format);
 
+
+    enum class Kernel : u32
+    {
+        Fixed = 0, // integer math, simd when available
+        Float      // reference
+    };
+
+
+    enum class ColorMatrix : u32
+    {
+        YUV = 0, // analog yuv, default
+        BT601,
+        BT709,
+        BT2020
+    };
+
+
+    enum class ColorRange : u32
+    {
+        Full = 0,
+        Limited // luma 16-235, chroma 16-240
+    };
+
+
+    class ColorTable
+    {
+    public:
+        // Q14 against (y - y_offset) and doubled chroma (2c - c_offset2)
+        i16 ky;
+        i16 y_offset;
+        i16 c_offset2;
+        i16 kvr;
+        i16 kug;
+        i16 kvg;
+        i16 kub;
+
+        // per sample products of the above for the scalar path
+        i32 y[256];
+        i32 vr[256];
+        i32 ug[256];
+        i32 vg[256];
+        i32 ub[256];
+    };
+
+
+    ColorTable make_color_table(ColorMatrix matrix, ColorRange range);
+
+
     void convert_view(SpanView<u8> const& src, img::ImageView const& dst, PixelFormat format);
 
+    void convert_view(SpanView<u8> const& src, img::ImageView const& dst, PixelFormat format, Kernel kernel);
+
+    void convert_view(SpanView<u8> const& src, img::ImageView const& dst, PixelFormat format, ColorTable const& table);
+
     void convert_sub_view(SpanView<u8> const& src, img::SubView const& dst, PixelFormat format);
 
+    void convert_sub_view(SpanView<u8> const& src, img::SubView const& dst, PixelFormat format, ColorTable const& table);
+
+
+    enum class Resample : u32
+    {
+        Bilinear = 0,
+        Area // box average, for downscaling
+    };
+
+
+    // decode, resample and pack rows in one pass, dst can be any size
+    void convert_resize(SpanView<u8> const& src, u32 src_width, u32 src_height, img::ImageView const& dst, PixelFormat format, Resample mode);
+
+    void convert_resize(SpanView<u8> const& src, u32 src_width, u32 src_height, img::SubView const& dst, PixelFormat format, Resample mode);
+
+    void convert_resize(SpanView<u8> const& src, u32 src_width, u32 src_height, img::ImageView const& dst, PixelFormat format, Resample mode, ColorTable const& table);
+
+    void convert_resize(SpanView<u8> const& src, u32 src_width, u32 src_height, img::SubView const& dst, PixelFormat format, Resample mode, ColorTable const& table);
+
 
     using ViewYUV = img::View3u8;
 
@@ -168,10 +239,118 @@ namespace convert
     void to_yuv(SpanView<u8> const& src, u32 width, u32 height, ViewYUV const& dst, PixelFormat format);
 
 
+    // chroma planes at 1 / SX width and 1 / SY height
+    template <u32 SX, u32 SY>
+    class SubsampledYUV
+    {
+    public:
+        img::View1u8 y;
+        img::View1u8 u;
+        img::View1u8 v;
+    };
+
+    using ViewYUV420 = SubsampledYUV<2, 2>;
+    using ViewYUV422 = SubsampledYUV<2, 1>;
+
+
+    inline ViewYUV420 make_view_yuv420(u32 width, u32 height, img::Buffer8& buffer)
+    {
+        ViewYUV420 view{};
+        view.y = img::make_view(width, height, buffer);
+        view.u = img::make_view(width / 2, height / 2, buffer);
+        view.v = img::make_view(width / 2, height / 2, buffer);
+
+        return view;
+    }
+
+
+    inline ViewYUV422 make_view_yuv422(u32 width, u32 height, img::Buffer8& buffer)
+    {
+        ViewYUV422 view{};
+        view.y = img::make_view(width, height, buffer);
+        view.u = img::make_view(width / 2, height, buffer);
+        view.v = img::make_view(width / 2, height, buffer);
+
+        return view;
+    }
+
+
+    // 10 bit samples, P010 only
+    using ViewYUV16 = img::View3<u16>;
+
+
+    inline ViewYUV16 make_view_yuv16(u32 width, u32 height, img::Buffer16& buffer)
+    {
+        return img::make_view_3(width, height, buffer);
+    }
+
+
+    void to_yuv(SpanView<u8> const& src, u32 width, u32 height, ViewYUV16 const& dst, PixelFormat format);
+
+
+    void to_yuv(SpanView<u8> const& src, ViewYUV420 const& dst, PixelFormat format);
+
+    void to_yuv(SpanView<u8> const& src, ViewYUV422 const& dst, PixelFormat format);
+
+
     void yuv_to_rgba(ViewYUV const& src, img::ImageView const& dst);
 
+    void yuv_to_rgba(ViewYUV const& src, img::ImageView const& dst, Kernel kernel);
+
+    void yuv_to_rgba(ViewYUV const& src, img::ImageView const& dst, ColorTable const& table);
+
+    // dst can be a tile of a larger image, src is the tile size
     void yuv_to_rgba(ViewYUV const& src, img::SubView const& dst);
 
+    void yuv_to_rgba(ViewYUV const& src, img::SubView const& dst, ColorTable const& table);
+
+    // resampled to dst, which can be any size
+    void yuv_to_rgba(ViewYUV const& src, img::ImageView const& dst, Resample mode, ColorTable const& table);
+
+    void yuv_to_rgba(ViewYUV const& src, img::SubView const& dst, Resample mode, ColorTable const& table);
+
+    void yuv_to_rgba(ViewYUV420 const& src, img::ImageView const& dst);
+
+    void yuv_to_rgba(ViewYUV420 const& src, img::ImageView const& dst, ColorTable const& table);
+
+    void yuv_to_rgba(ViewYUV422 const& src, img::ImageView const& dst);
+
+    void yuv_to_rgba(ViewYUV422 const& src, img::ImageView const& dst, ColorTable const& table);
+
+
+    // 10 bit to 8 bit narrowing of luma
+    enum class ToneMap : u32
+    {
+        Linear = 0,
+        Reinhard // compresses highlights
+    };
+
+
+    void yuv_to_rgba(ViewYUV16 const& src, img::ImageView const& dst);
+
+    void yuv_to_rgba(ViewYUV16 const& src, img::ImageView const& dst, ToneMap tone);
+
+    void yuv_to_rgba(ViewYUV16 const& src, img::ImageView const& dst, ToneMap tone, ColorTable const& table);
+
 
     void yuv_to_rgb(ViewYUV const& src, img::ViewRGBu8 const& dst);
+
+    void yuv_to_rgb(ViewYUV const& src, img::ViewRGBu8 const& dst, Kernel kernel);
+
+    void yuv_to_rgb(ViewYUV const& src, img::ViewRGBu8 const& dst, ColorTable const& table);
+
+    void yuv_to_rgb(ViewYUV const& src, img::SubViewRGBu8 const& dst);
+
+    void yuv_to_rgb(ViewYUV const& src, img::SubViewRGBu8 const& dst, ColorTable const& table);
+
+
+    // frames are split into row bands and converted on n_threads, including the calling thread
+    // create and destroy wait for a frame in flight, later frames convert on the calling thread until it is done
+    bool create_thread_pool(u32 n_threads, bool pin_to_cores);
+
+    void destroy_thread_pool();
+
+    // the 256 bit kernels are used when the cpu has AVX2, returns whether they are in use
+    // call while no conversions are running
+    bool enable_simd_256(bool enable);
 }
\ No newline at end of file
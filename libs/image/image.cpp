@@ -524,6 +524,16 @@ namespace image
     }
 
 
+    View3<u16> make_view_3(u32 width, u32 height, Buffer16& buffer)
+    {
+        View3<u16> view{};
+
+        make_view_n(view, width, height, buffer);
+
+        return view;
+    }
+
+
     View4u8 make_view_4(u32 width, u32 height, Buffer8& buffer)
     {
         View4u8 view{};
@@ -76,6 +76,7 @@ namespace image
 namespace image
 {
     using Buffer8 = MemoryBuffer<u8>;
+    using Buffer16 = MemoryBuffer<u16>;
     using Buffer32 = MemoryBuffer<Pixel>;
 
 
@@ -135,6 +136,14 @@ namespace image
 	}
 
 
+    inline Buffer16 create_buffer16(u32 n_pixels, cstr tag)
+	{
+		Buffer16 buffer;
+		mb::create_buffer(buffer, n_pixels, tag);
+		return buffer;
+	}
+
+
     inline Rect2Du32 make_rect(u32 width, u32 height)
     {
         Rect2Du32 range{};
@@ -463,6 +472,8 @@ namespace image
 {
     View3u8 make_view_3(u32 width, u32 height, Buffer8& buffer);
 
+    View3<u16> make_view_3(u32 width, u32 height, Buffer16& buffer);
+
     View4u8 make_view_4(u32 width, u32 height, Buffer8& buffer);
 }
 
@@ -496,7 +507,11 @@ namespace image
     {
         ChannelSubView2D<T, C> sub_view{};
 
-        sub_view.channel_data = view.channel_data;
+        for (u32 i = 0; i < C; i++)
+        {
+            sub_view.channel_data[i] = view.channel_data[i];
+        }
+
         sub_view.channel_width = view.width;
         sub_view.x_begin = range.x_begin;
         sub_view.y_begin = range.y_begin;
@@ -0,0 +1,244 @@
+#pragma once
+
+#include "../util/types.hpp"
+
+
+/* clock correlation */
+
+namespace camera_usb
+{
+    // frames in the fit, about two seconds at 30 fps
+    constexpr u32 CLOCK_SAMPLES = 64;
+
+    // frames before the fit is used
+    constexpr u32 CLOCK_SAMPLES_MIN = 8;
+
+    // a frame this far from the fit starts it over, the device clock jumped or the stream stalled
+    constexpr i64 CLOCK_RESET_NS = 50'000'000;
+
+
+    // one frame's source clock and when the host received the frame
+    class ClockSample
+    {
+    public:
+        // device ticks, unwrapped
+        i64 device = 0;
+
+        // steady clock
+        u64 host_ns = 0;
+    };
+
+
+    // least squares line through the last CLOCK_SAMPLES frames
+    // host_ns = anchor_host_ns + mean_host + ns_per_tick * (device - anchor_device - mean_device)
+    class ClockFit
+    {
+    public:
+        ClockSample samples[CLOCK_SAMPLES];
+        u32 n_samples = 0;
+        u32 next = 0;
+
+        // 32 bit SCR to 64 bits
+        b8 has_scr = 0;
+        u32 last_scr = 0;
+        i64 device = 0;
+
+        // the newest sample, the sums are taken relative to it
+        i64 anchor_device = 0;
+        u64 anchor_host_ns = 0;
+
+        f64 mean_device = 0.0;
+        f64 mean_host = 0.0;
+        f64 ns_per_tick = 0.0;
+
+        // the last frame received against the fit before it was added
+        b8 locked = 0;
+        i64 residual_ns = 0;
+
+        u64 resets = 0;
+    };
+}
+
+
+namespace camera_usb
+{
+namespace clocks
+{
+    inline void reset(ClockFit& fit)
+    {
+        fit.n_samples = 0;
+        fit.next = 0;
+
+        fit.has_scr = 0;
+        fit.ns_per_tick = 0.0;
+
+        fit.locked = 0;
+        fit.residual_ns = 0;
+
+        fit.resets = 0;
+    }
+
+
+    // the samples are dropped, the device clock starts over at scr
+    inline void restart(ClockFit& fit, u32 scr)
+    {
+        fit.n_samples = 0;
+        fit.next = 0;
+
+        fit.last_scr = scr;
+        fit.device = scr;
+
+        fit.locked = 0;
+        fit.resets++;
+    }
+
+
+    inline bool is_locked(ClockFit const& fit)
+    {
+        return fit.n_samples >= CLOCK_SAMPLES_MIN && fit.ns_per_tick > 0.0;
+    }
+
+
+    // host steady clock of a device tick, extrapolated past the window
+    inline u64 to_host_ns(ClockFit const& fit, i64 device)
+    {
+        auto x = (f64)(device - fit.anchor_device) - fit.mean_device;
+        auto y = fit.mean_host + fit.ns_per_tick * x;
+
+        return fit.anchor_host_ns + (u64)(i64)(y < 0.0 ? y - 0.5 : y + 0.5);
+    }
+
+
+    // the SCR wraps, each one follows the last by less than half the range
+    inline i64 unwrap(ClockFit& fit, u32 scr)
+    {
+        if (!fit.has_scr)
+        {
+            fit.has_scr = 1;
+            fit.device = scr;
+        }
+        else
+        {
+            fit.device += (i32)(scr - fit.last_scr);
+        }
+
+        fit.last_scr = scr;
+
+        return fit.device;
+    }
+
+
+    // centered sums, recomputed over the window so the fit does not drift with the clock
+    inline void refit(ClockFit& fit)
+    {
+        auto n = fit.n_samples;
+        auto& newest = fit.samples[(fit.next + CLOCK_SAMPLES - 1) % CLOCK_SAMPLES];
+
+        fit.anchor_device = newest.device;
+        fit.anchor_host_ns = newest.host_ns;
+
+        f64 sum_x = 0.0;
+        f64 sum_y = 0.0;
+
+        for (u32 i = 0; i < n; i++)
+        {
+            auto& s = fit.samples[i];
+            sum_x += (f64)(s.device - fit.anchor_device);
+            sum_y += (f64)(i64)(s.host_ns - fit.anchor_host_ns);
+        }
+
+        fit.mean_device = sum_x / n;
+        fit.mean_host = sum_y / n;
+
+        f64 sxx = 0.0;
+        f64 sxy = 0.0;
+
+        for (u32 i = 0; i < n; i++)
+        {
+            auto& s = fit.samples[i];
+            auto dx = (f64)(s.device - fit.anchor_device) - fit.mean_device;
+            auto dy = (f64)(i64)(s.host_ns - fit.anchor_host_ns) - fit.mean_host;
+
+            sxx += dx * dx;
+            sxy += dx * dy;
+        }
+
+        // a single tick value leaves the slope as it was
+        if (sxx > 0.0 && sxy > 0.0)
+        {
+            fit.ns_per_tick = sxy / sxx;
+        }
+    }
+
+
+    // a frame with a source clock reference, host_ns when it was received
+    inline void add_sample(ClockFit& fit, u32 scr, u64 host_ns)
+    {
+        auto newest = fit.n_samples ? fit.samples[(fit.next + CLOCK_SAMPLES - 1) % CLOCK_SAMPLES] : ClockSample{};
+
+        auto device = unwrap(fit, scr);
+
+        // the device did not update its clock since the last frame
+        if (fit.n_samples && device == newest.device)
+        {
+            fit.locked = 0;
+            return;
+        }
+
+        fit.locked = is_locked(fit);
+
+        if (fit.locked)
+        {
+            fit.residual_ns = (i64)(host_ns - to_host_ns(fit, device));
+        }
+
+        auto stale = fit.locked && (fit.residual_ns > CLOCK_RESET_NS || fit.residual_ns < -CLOCK_RESET_NS);
+        auto backwards = fit.n_samples && (device < newest.device || host_ns < newest.host_ns);
+
+        if (stale || backwards)
+        {
+            restart(fit, scr);
+            device = fit.device;
+        }
+
+        auto& s = fit.samples[fit.next];
+        s.device = device;
+        s.host_ns = host_ns;
+
+        fit.next = (fit.next + 1) % CLOCK_SAMPLES;
+        fit.n_samples += fit.n_samples < CLOCK_SAMPLES;
+
+        refit(fit);
+    }
+
+
+    // steady clock when the image was captured, from the frame's pts on the fitted device clock
+    // when the frame was received until the fit locks or if the device sends no pts and scr
+    inline u64 add_frame(ClockFit& fit, u32 pts, u32 scr, u64 host_ns)
+    {
+        if (!scr)
+        {
+            fit.locked = 0;
+            return host_ns;
+        }
+
+        add_sample(fit, scr, host_ns);
+
+        if (!pts || !is_locked(fit))
+        {
+            return host_ns;
+        }
+
+        // pts is sampled before scr, on the same clock
+        auto device = fit.device - (i32)(scr - pts);
+
+        return to_host_ns(fit, device);
+    }
+
+
+    inline f64 device_clock_hz(ClockFit const& fit)
+    {
+        return is_locked(fit) ? 1e9 / fit.ns_per_tick : 0.0;
+    }
+}
+}
@@ -0,0 +1,268 @@
+#pragma once
+
+#include "../util/types.hpp"
+
+
+/* camera hotplug */
+
+namespace camera_usb
+{
+    constexpr u32 HOTPLUG_SLOTS_MAX = 16;
+    constexpr u32 HOTPLUG_SCAN_MAX = 32;
+
+    // rescan period when the backend can't report arrivals and removals
+    constexpr u32 HOTPLUG_POLL_MS = 1000;
+
+
+    // a camera across reconnects
+    class DeviceKey
+    {
+    public:
+        u16 vendor_id = 0;
+        u16 product_id = 0;
+        char serial_number[32] = { 0 };
+
+        // bus and address while connected, changes when the device is replugged
+        u32 location = 0;
+    };
+
+
+    enum class SlotEvent : u8
+    {
+        None = 0,
+        Added,
+        Removed,
+        Reconnected
+    };
+
+
+    // slots are never reused, a camera keeps its id for the session
+    class DeviceSlot
+    {
+    public:
+        DeviceKey key;
+
+        b8 present = 0;
+
+        // entry in the latest scan, -1 when not present
+        int scan_index = -1;
+
+        SlotEvent event = SlotEvent::None;
+    };
+
+
+    class DeviceTable
+    {
+    public:
+        DeviceSlot slots[HOTPLUG_SLOTS_MAX];
+
+        u32 count = 0;
+    };
+}
+
+
+namespace camera_usb
+{
+namespace hotplug
+{
+    inline bool same_device(DeviceKey const& a, DeviceKey const& b)
+    {
+        if (a.vendor_id != b.vendor_id || a.product_id != b.product_id)
+        {
+            return false;
+        }
+
+        for (u32 i = 0; i < sizeof(a.serial_number); i++)
+        {
+            if (a.serial_number[i] != b.serial_number[i])
+            {
+                return false;
+            }
+
+            if (!a.serial_number[i])
+            {
+                break;
+            }
+        }
+
+        return true;
+    }
+
+
+    inline bool same_connection(DeviceKey const& a, DeviceKey const& b)
+    {
+        return a.location == b.location && same_device(a, b);
+    }
+
+
+    // present slot at the key's location, the serial number is not compared
+    // lets a scan skip reading string descriptors from devices it already knows
+    inline DeviceSlot const* find_connected(DeviceTable const& table, DeviceKey const& key)
+    {
+        for (u32 i = 0; i < table.count; i++)
+        {
+            auto& slot = table.slots[i];
+            if (slot.present && slot.key.location == key.location && slot.key.vendor_id == key.vendor_id && slot.key.product_id == key.product_id)
+            {
+                return &slot;
+            }
+        }
+
+        return nullptr;
+    }
+
+
+    // marks each slot's event from a fresh scan, returns the number of slots that changed
+    // healthy devices keep their slot and get SlotEvent::None
+    inline u32 update(DeviceTable& table, DeviceKey const* scan, u32 n_scan)
+    {
+        n_scan = n_scan < HOTPLUG_SCAN_MAX ? n_scan : HOTPLUG_SCAN_MAX;
+
+        b8 claimed[HOTPLUG_SCAN_MAX] = { 0 };
+
+        for (u32 i = 0; i < table.count; i++)
+        {
+            auto& slot = table.slots[i];
+            slot.event = SlotEvent::None;
+            slot.scan_index = -1;
+        }
+
+        // still connected
+        for (u32 i = 0; i < table.count; i++)
+        {
+            auto& slot = table.slots[i];
+            if (!slot.present)
+            {
+                continue;
+            }
+
+            for (u32 s = 0; s < n_scan; s++)
+            {
+                if (!claimed[s] && same_connection(slot.key, scan[s]))
+                {
+                    claimed[s] = 1;
+                    slot.scan_index = (int)s;
+                    break;
+                }
+            }
+
+            if (slot.scan_index < 0)
+            {
+                slot.present = 0;
+                slot.event = SlotEvent::Removed;
+            }
+        }
+
+        // back again, or new
+        for (u32 s = 0; s < n_scan; s++)
+        {
+            if (claimed[s])
+            {
+                continue;
+            }
+
+            DeviceSlot* match = nullptr;
+
+            for (u32 i = 0; i < table.count && !match; i++)
+            {
+                auto& slot = table.slots[i];
+                if (!slot.present && same_device(slot.key, scan[s]))
+                {
+                    match = &slot;
+                }
+            }
+
+            if (match)
+            {
+                // replugged between scans, the old connection is released first
+                match->event = SlotEvent::Reconnected;
+            }
+            else if (table.count < HOTPLUG_SLOTS_MAX)
+            {
+                match = table.slots + table.count++;
+                match->event = SlotEvent::Added;
+            }
+            else
+            {
+                continue;
+            }
+
+            claimed[s] = 1;
+            match->key = scan[s];
+            match->present = 1;
+            match->scan_index = (int)s;
+        }
+
+        u32 n_changed = 0;
+
+        for (u32 i = 0; i < table.count; i++)
+        {
+            n_changed += table.slots[i].event != SlotEvent::None;
+        }
+
+        return n_changed;
+    }
+
+
+    /*
+
+    backend.scan(DeviceKey* dst, u32 capacity) -> u32
+        every device connected now, may look up keys of connected slots in table
+
+    backend.remove(u32 slot)
+        stop using the device, keep its configuration
+
+    backend.add(u32 slot, u32 scan_index)
+    backend.reconnect(u32 slot, u32 scan_index)
+        take the device from the scan, reconnect releases what is left of the old connection
+
+    backend.end_scan()
+        release devices from the scan that were not taken
+
+    */
+
+
+    // returns the number of slots that changed
+    template <class BACKEND>
+    inline u32 rescan(DeviceTable& table, BACKEND& backend)
+    {
+        DeviceKey keys[HOTPLUG_SCAN_MAX];
+
+        auto n_scan = backend.scan(keys, HOTPLUG_SCAN_MAX);
+
+        auto n_changed = update(table, keys, n_scan);
+
+        // release before anything is reopened
+        for (u32 i = 0; i < table.count; i++)
+        {
+            if (table.slots[i].event == SlotEvent::Removed)
+            {
+                backend.remove(i);
+            }
+        }
+
+        for (u32 i = 0; i < table.count; i++)
+        {
+            auto& slot = table.slots[i];
+
+            switch (slot.event)
+            {
+            case SlotEvent::Added:
+                backend.add(i, (u32)slot.scan_index);
+                break;
+
+            case SlotEvent::Reconnected:
+                backend.reconnect(i, (u32)slot.scan_index);
+                break;
+
+            default:
+                break;
+            }
+        }
+
+        backend.end_scan();
+
+        return n_changed;
+    }
+}
+}
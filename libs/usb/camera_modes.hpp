@@ -0,0 +1,330 @@
+#pragma once
+
+#include "../image/convert.hpp"
+
+
+/* camera modes */
+
+namespace camera_usb
+{
+    constexpr u32 CAMERA_MODES_MAX = 128;
+
+
+    class CameraMode
+    {
+    public:
+        u32 width = 0;
+        u32 height = 0;
+
+        // 100ns units, as in the descriptors
+        u32 interval = 0;
+        u32 fps = 0;
+
+        convert::PixelFormat pixel_format = convert::PixelFormat::Unknown;
+        char format_code[5] = { 0 };
+
+        // native index for the backend
+        u32 index = 0;
+    };
+
+
+    class CameraModeList
+    {
+    public:
+        CameraMode list[CAMERA_MODES_MAX];
+
+        u32 count = 0;
+
+        // the device lists more modes than fit, extra frame intervals were dropped first, see add_mode
+        b8 truncated = 0;
+    };
+
+
+    enum class ModePolicy : u8
+    {
+        // fastest mode, at least width x height when given
+        MaxFps = 0,
+
+        // largest mode, at least fps when given
+        MaxResolution,
+
+        // width x height, and fps when given
+        Exact,
+
+        // fewest bytes per second, at least width x height and fps when given
+        MinBandwidth
+    };
+
+
+    class ModeRequest
+    {
+    public:
+        ModePolicy policy = ModePolicy::Exact;
+
+        u32 width = 640;
+        u32 height = 480;
+        u32 fps = 0;
+
+        // Unknown accepts any supported format, MJPG only when no uncompressed mode fits
+        convert::PixelFormat pixel_format = convert::PixelFormat::Unknown;
+    };
+}
+
+
+namespace camera_usb
+{
+namespace modes
+{
+    // 0 when the converter does not support the format
+    inline u32 bits_per_pixel(convert::PixelFormat format)
+    {
+        using PF = convert::PixelFormat;
+
+        switch (format)
+        {
+        case PF::YUYV:
+        case PF::YUNV:
+        case PF::YUY2:
+        case PF::YVYU:
+        case PF::UYVY:
+        case PF::Y422:
+        case PF::UYNV:
+        case PF::HDYC:
+            return 16;
+
+        case PF::NV12:
+        case PF::NV21:
+        case PF::YV12:
+        case PF::I420:
+        case PF::IYUV:
+            return 12;
+
+        case PF::P010:
+            return 24;
+
+        // compressed, a rough average for bandwidth
+        case PF::MJPG:
+            return 4;
+
+        default:
+            return 0;
+        }
+    }
+
+
+    inline bool is_compressed(convert::PixelFormat format)
+    {
+        return format == convert::PixelFormat::MJPG;
+    }
+
+
+    inline bool is_supported(CameraMode const& mode)
+    {
+        return bits_per_pixel(mode.pixel_format) && mode.width && mode.height && mode.interval;
+    }
+
+
+    inline u64 bytes_per_second(CameraMode const& mode)
+    {
+        auto bits = (u64)mode.width * mode.height * bits_per_pixel(mode.pixel_format);
+
+        return bits * 10'000'000 / (8 * (u64)mode.interval);
+    }
+
+
+    inline bool same_frame(CameraMode const& mode, u32 four_cc_bytes, u32 width, u32 height)
+    {
+        return (u32)mode.pixel_format == four_cc_bytes && mode.width == width && mode.height == height;
+    }
+
+
+    // the slowest interval of a format and size that has another, -1 when each has one
+    inline int find_extra_interval(CameraModeList const& modes)
+    {
+        int found = -1;
+
+        for (u32 i = 0; i < modes.count; i++)
+        {
+            auto& mode = modes.list[i];
+            auto fcc = (u32)mode.pixel_format;
+
+            if (found >= 0 && mode.interval <= modes.list[found].interval)
+            {
+                continue;
+            }
+
+            u32 n_intervals = 0;
+            for (u32 j = 0; j < modes.count && n_intervals < 2; j++)
+            {
+                n_intervals += same_frame(modes.list[j], fcc, mode.width, mode.height);
+            }
+
+            if (n_intervals > 1)
+            {
+                found = (int)i;
+            }
+        }
+
+        return found;
+    }
+
+
+    // a full list drops frame intervals before it drops a format or size
+    inline void add_mode(CameraModeList& modes, u32 four_cc_bytes, u32 width, u32 height, u32 interval, u32 index)
+    {
+        if (!interval)
+        {
+            return;
+        }
+
+        for (u32 i = 0; i < modes.count; i++)
+        {
+            if (same_frame(modes.list[i], four_cc_bytes, width, height) && modes.list[i].interval == interval)
+            {
+                return;
+            }
+        }
+
+        int slot = (int)modes.count;
+
+        if (modes.count >= CAMERA_MODES_MAX)
+        {
+            modes.truncated = 1;
+
+            int slowest = -1;
+            for (u32 i = 0; i < modes.count; i++)
+            {
+                auto& mode = modes.list[i];
+                if (same_frame(mode, four_cc_bytes, width, height) && (slowest < 0 || mode.interval > modes.list[slowest].interval))
+                {
+                    slowest = (int)i;
+                }
+            }
+
+            // a known format and size only replaces its own slowest interval, even when it is the only one
+            slot = slowest >= 0 ? slowest : find_extra_interval(modes);
+
+            if (slot < 0 || (slowest >= 0 && interval >= modes.list[slot].interval))
+            {
+                return;
+            }
+        }
+        else
+        {
+            modes.count++;
+        }
+
+        auto& mode = modes.list[slot];
+
+        mode.width = width;
+        mode.height = height;
+        mode.interval = interval;
+        mode.fps = 10'000'000 / interval;
+        mode.pixel_format = (convert::PixelFormat)four_cc_bytes;
+        mode.index = index;
+
+        convert::u32_to_fcc(four_cc_bytes, mode.format_code);
+    }
+
+
+    inline bool meets_request(CameraMode const& mode, ModeRequest const& request)
+    {
+        using MP = ModePolicy;
+
+        if (!is_supported(mode))
+        {
+            return false;
+        }
+
+        if (request.pixel_format != convert::PixelFormat::Unknown && mode.pixel_format != request.pixel_format)
+        {
+            return false;
+        }
+
+        auto area_ok = mode.width >= request.width && mode.height >= request.height;
+        auto fps_ok = !request.fps || mode.fps >= request.fps;
+
+        switch (request.policy)
+        {
+        case MP::MaxFps:
+            return area_ok;
+
+        case MP::MaxResolution:
+            return fps_ok;
+
+        case MP::Exact:
+            return mode.width == request.width && mode.height == request.height && (!request.fps || mode.fps == request.fps);
+
+        case MP::MinBandwidth:
+            return area_ok && fps_ok;
+        }
+
+        return false;
+    }
+
+
+    // true when a is a better pick than b
+    inline bool is_better(CameraMode const& a, CameraMode const& b, ModePolicy policy)
+    {
+        using MP = ModePolicy;
+
+        auto area_a = (u64)a.width * a.height;
+        auto area_b = (u64)b.width * b.height;
+
+        switch (policy)
+        {
+        case MP::MaxFps:
+            return a.interval != b.interval ? a.interval < b.interval : area_a > area_b;
+
+        case MP::MaxResolution:
+            return area_a != area_b ? area_a > area_b : a.interval < b.interval;
+
+        case MP::Exact:
+            return a.interval < b.interval;
+
+        case MP::MinBandwidth:
+            return bytes_per_second(a) < bytes_per_second(b);
+        }
+
+        return false;
+    }
+
+
+    // decoding costs latency and cpu, a request has to name MJPG to prefer it
+    inline bool is_preferred(CameraMode const& a, CameraMode const& b, ModeRequest const& request)
+    {
+        auto compressed_a = is_compressed(a.pixel_format);
+        auto compressed_b = is_compressed(b.pixel_format);
+
+        if (request.pixel_format == convert::PixelFormat::Unknown && compressed_a != compressed_b)
+        {
+            return compressed_b;
+        }
+
+        return is_better(a, b, request.policy);
+    }
+
+
+    // index into modes.list, -1 when nothing matches
+    inline int select_mode(CameraModeList const& modes, ModeRequest const& request)
+    {
+        int selected = -1;
+
+        for (u32 i = 0; i < modes.count; i++)
+        {
+            auto& mode = modes.list[i];
+            if (!meets_request(mode, request))
+            {
+                continue;
+            }
+
+            if (selected < 0 || is_preferred(mode, modes.list[selected], request))
+            {
+                selected = (int)i;
+            }
+        }
+
+        return selected;
+    }
+}
+}
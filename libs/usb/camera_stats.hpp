@@ -0,0 +1,303 @@
+#pragma once
+
+#include "../util/types.hpp"
+
+#include <atomic>
+#include <chrono>
+#include <cmath>
+
+
+/* camera stats */
+
+namespace camera_usb
+{
+    constexpr u32 CONVERT_HIST_BINS = 16;
+
+    // the last bin holds everything slower
+    constexpr f32 CONVERT_HIST_BIN_MS = 0.5f;
+
+
+    class CameraStats
+    {
+    public:
+        // rates over the last window
+        f32 fps = 0.0f;
+        f32 sensor_fps = 0.0f;
+        f32 usb_bytes_per_sec = 0.0f;
+
+        // capture_time_finished to conversion done
+        f32 latency_ms = 0.0f;
+        f32 latency_max_ms = 0.0f;
+
+        f32 convert_ms = 0.0f;
+        u32 convert_hist[CONVERT_HIST_BINS] = { 0 };
+
+        f32 window_sec = 0.0f;
+
+        // frames received against the fitted device clock, see ClockFit
+        f32 clock_jitter_ms = 0.0f;
+        f32 clock_jitter_max_ms = 0.0f;
+
+        // fitted rate of the device's source clock, 0 when not fitted
+        f64 device_clock_hz = 0.0;
+
+        // totals since the camera was opened
+        u64 frames = 0;
+
+        // frames the stream completed but nobody took
+        u64 dropped_transfer = 0;
+
+        // frames taken but never read, see OverflowPolicy
+        u64 dropped_consumer = 0;
+
+        // the device clock jumped and the fit started over
+        u64 clock_resets = 0;
+    };
+
+
+    // one frame as seen by the capture thread
+    class FrameStats
+    {
+    public:
+        u32 dropped = 0;
+        u32 consumer_dropped = 0;
+
+        // system clock
+        u64 capture_ns = 0;
+
+        u64 bytes = 0;
+        f64 convert_ms = 0.0;
+
+        // see ClockFit, residual_ns is set when clock_locked
+        b8 clock_locked = 0;
+        i64 clock_residual_ns = 0;
+        f64 device_clock_hz = 0.0;
+        u64 clock_resets = 0;
+    };
+
+
+    // lock-free triple buffer, one writer and one reader
+    template <class T>
+    class Snapshot
+    {
+    public:
+        static constexpr u32 DIRTY = 4;
+
+        T buffers[3];
+
+        // index of the spare buffer, DIRTY when it is newer than the reader's
+        std::atomic<u32> middle = 1;
+
+        u32 back = 0;
+        u32 front = 2;
+    };
+
+
+    class StatsCollector
+    {
+    public:
+        Snapshot<CameraStats> snapshot;
+
+        // capture thread only
+        CameraStats current;
+
+        u64 window_start_ns = 0;
+        u32 window_frames = 0;
+        u32 window_sensor_frames = 0;
+        u64 window_bytes = 0;
+
+        f64 latency_total_ms = 0.0;
+        f64 convert_total_ms = 0.0;
+
+        u32 window_clock_frames = 0;
+        f64 clock_square_total_ms = 0.0;
+    };
+}
+
+
+namespace camera_usb
+{
+namespace stats
+{
+    namespace chr = std::chrono;
+
+    constexpr u64 WINDOW_NS = 1'000'000'000;
+
+
+    template <class T>
+    inline void write(Snapshot<T>& snap, T const& value)
+    {
+        snap.buffers[snap.back] = value;
+        snap.back = snap.middle.exchange(snap.back | Snapshot<T>::DIRTY) & 3;
+    }
+
+
+    template <class T>
+    inline T const& read(Snapshot<T>& snap)
+    {
+        if (snap.middle.load() & Snapshot<T>::DIRTY)
+        {
+            snap.front = snap.middle.exchange(snap.front) & 3;
+        }
+
+        return snap.buffers[snap.front];
+    }
+
+
+    inline u64 steady_ns()
+    {
+        return (u64)chr::duration_cast<chr::nanoseconds>(chr::steady_clock::now().time_since_epoch()).count();
+    }
+
+
+    inline u64 system_ns()
+    {
+        return (u64)chr::duration_cast<chr::nanoseconds>(chr::system_clock::now().time_since_epoch()).count();
+    }
+
+
+    inline void reset_window(StatsCollector& s, u64 now_ns)
+    {
+        s.window_start_ns = now_ns;
+        s.window_frames = 0;
+        s.window_sensor_frames = 0;
+        s.window_bytes = 0;
+
+        s.latency_total_ms = 0.0;
+        s.convert_total_ms = 0.0;
+
+        s.window_clock_frames = 0;
+        s.clock_square_total_ms = 0.0;
+
+        s.current.latency_max_ms = 0.0f;
+        s.current.clock_jitter_max_ms = 0.0f;
+
+        for (u32 i = 0; i < CONVERT_HIST_BINS; i++)
+        {
+            s.current.convert_hist[i] = 0;
+        }
+    }
+
+
+    // capture thread, no reader may be waiting on a window from before
+    inline void reset(StatsCollector& s)
+    {
+        s.current = {};
+        reset_window(s, 0);
+
+        write(s.snapshot, s.current);
+    }
+
+
+    inline void publish(StatsCollector& s, u64 now_ns)
+    {
+        auto& c = s.current;
+
+        auto sec = (f64)(now_ns - s.window_start_ns) / 1e9;
+        auto n = s.window_frames ? (f64)s.window_frames : 1.0;
+
+        c.window_sec = (f32)sec;
+        c.fps = (f32)(s.window_frames / sec);
+        c.sensor_fps = (f32)(s.window_sensor_frames / sec);
+        c.usb_bytes_per_sec = (f32)(s.window_bytes / sec);
+        c.latency_ms = (f32)(s.latency_total_ms / n);
+        c.convert_ms = (f32)(s.convert_total_ms / n);
+
+        // root mean square
+        auto n_clock = s.window_clock_frames ? (f64)s.window_clock_frames : 1.0;
+        c.clock_jitter_ms = (f32)std::sqrt(s.clock_square_total_ms / n_clock);
+
+        write(s.snapshot, c);
+
+        reset_window(s, now_ns);
+    }
+
+
+    inline void count_frame(StatsCollector& s, FrameStats const& frame)
+    {
+        auto& c = s.current;
+
+        c.dropped_transfer += frame.dropped;
+        c.dropped_consumer += frame.consumer_dropped;
+
+        s.window_sensor_frames += 1 + frame.dropped;
+        s.window_bytes += frame.bytes;
+
+        c.device_clock_hz = frame.device_clock_hz;
+        c.clock_resets = frame.clock_resets;
+
+        if (frame.clock_locked)
+        {
+            auto jitter_ms = std::abs((f64)frame.clock_residual_ns) / 1e6;
+
+            s.window_clock_frames++;
+            s.clock_square_total_ms += jitter_ms * jitter_ms;
+            c.clock_jitter_max_ms = jitter_ms > c.clock_jitter_max_ms ? (f32)jitter_ms : c.clock_jitter_max_ms;
+        }
+    }
+
+
+    inline void end_frame(StatsCollector& s, u64 now_ns)
+    {
+        if (now_ns - s.window_start_ns >= WINDOW_NS)
+        {
+            publish(s, now_ns);
+        }
+    }
+
+
+    // capture thread, after the frame is converted
+    inline void add_frame(StatsCollector& s, FrameStats const& frame)
+    {
+        auto now_ns = steady_ns();
+        if (!s.window_start_ns)
+        {
+            reset_window(s, now_ns);
+        }
+
+        auto& c = s.current;
+
+        count_frame(s, frame);
+
+        c.frames++;
+        s.window_frames++;
+
+        if (frame.capture_ns)
+        {
+            auto latency_ms = (f64)((i64)(system_ns() - frame.capture_ns)) / 1e6;
+
+            s.latency_total_ms += latency_ms;
+            c.latency_max_ms = latency_ms > c.latency_max_ms ? (f32)latency_ms : c.latency_max_ms;
+        }
+
+        s.convert_total_ms += frame.convert_ms;
+
+        auto bin = (u32)(frame.convert_ms / CONVERT_HIST_BIN_MS);
+        c.convert_hist[bin < CONVERT_HIST_BINS ? bin : CONVERT_HIST_BINS - 1]++;
+
+        end_frame(s, now_ns);
+    }
+
+
+    // capture thread, a frame taken from the stream and dropped without converting
+    inline void add_dropped_frame(StatsCollector& s, FrameStats const& frame)
+    {
+        auto now_ns = steady_ns();
+        if (!s.window_start_ns)
+        {
+            reset_window(s, now_ns);
+        }
+
+        count_frame(s, frame);
+
+        end_frame(s, now_ns);
+    }
+
+
+    // capture thread, latest published fps
+    inline f32 window_fps(StatsCollector const& s)
+    {
+        return s.current.fps;
+    }
+}
+}
@@ -0,0 +1,586 @@
+#pragma once
+
+#include "camera_modes.hpp"
+
+#include <cstring>
+#include <cstdio>
+#include <cstdlib>
+
+
+/* synthetic cameras */
+
+namespace camera_usb
+{
+    constexpr u32 SYNTHETIC_CAMERAS_MAX = 16;
+
+    // frame index bits across the top of a TestPattern::Counter frame
+    constexpr u32 SYNTHETIC_COUNTER_BITS = 24;
+
+    // MJPG frames are encoded once and repeat, counters count modulo this
+    constexpr u32 SYNTHETIC_JPEG_CYCLE = 30;
+
+    // device clock of the payload headers, as UVC 1.1 cameras report
+    constexpr u32 SYNTHETIC_CLOCK_HZ = 48'000'000;
+
+
+    enum class TestPattern : u8
+    {
+        // ramps scrolling diagonally
+        Gradient = 0,
+
+        // the frame index in blocks over a moving bar
+        Counter,
+
+        // new random bytes every frame, worst case for MJPG
+        Noise
+    };
+
+
+    class SyntheticCamera
+    {
+    public:
+        // a format the synthetic stream sends, see synthetic::stream_format
+        convert::PixelFormat pixel_format = convert::PixelFormat::YUY2;
+
+        u32 width = 640;
+        u32 height = 480;
+        u32 fps = 30;
+
+        TestPattern pattern = TestPattern::Gradient;
+    };
+
+
+    class SyntheticConfig
+    {
+    public:
+        SyntheticCamera cameras[SYNTHETIC_CAMERAS_MAX];
+        u32 count = 0;
+
+        // each frame arrives up to jitter_us early or late
+        u32 jitter_us = 0;
+
+        // chance a frame is never sent
+        f32 drop_rate = 0.0f;
+    };
+
+
+    // when each frame of a camera is due, repeatable from the seed
+    class SyntheticClock
+    {
+    public:
+        u64 interval_ns = 0;
+        u64 jitter_ns = 0;
+        u32 drop_threshold = 0;
+        u32 rng = 1;
+
+        u64 next_index = 0;
+        u64 last_due_ns = 0;
+    };
+}
+
+
+namespace camera_usb
+{
+namespace synthetic
+{
+    namespace cvt = convert;
+
+    using PF = cvt::PixelFormat;
+
+
+    inline u32 next_random(u32& state)
+    {
+        // xorshift32, never 0 from a non zero state
+        state ^= state << 13;
+        state ^= state >> 17;
+        state ^= state << 5;
+
+        return state;
+    }
+
+
+    // the format a camera streams for a requested one, Unknown when it can't be sent
+    // aliases stream as the fourcc libuvc knows, as cameras report them
+    inline PF stream_format(PF format)
+    {
+        switch (format)
+        {
+        case PF::YUYV:
+        case PF::YUNV:
+        case PF::YUY2:
+            return PF::YUY2;
+
+        case PF::UYVY:
+        case PF::Y422:
+        case PF::UYNV:
+        case PF::HDYC:
+            return PF::UYVY;
+
+        case PF::NV12:
+        case PF::P010:
+        case PF::MJPG:
+            return format;
+
+        default:
+            return PF::Unknown;
+        }
+    }
+
+
+    // the uncompressed frame a camera draws, MJPG is encoded from YUY2
+    inline PF raw_format(SyntheticCamera const& cam)
+    {
+        return cam.pixel_format == PF::MJPG ? PF::YUY2 : cam.pixel_format;
+    }
+
+
+    inline u32 raw_frame_bytes(SyntheticCamera const& cam)
+    {
+        return cam.width * cam.height * modes::bits_per_pixel(raw_format(cam)) / 8;
+    }
+
+
+    // scratch for draw_frame
+    inline u32 scratch_bytes(SyntheticCamera const& cam)
+    {
+        return 12 * cam.width;
+    }
+
+
+    // the row read_counter reads, in the middle of the counter blocks
+    inline u32 counter_row(u32 height)
+    {
+        auto band = height / 8 > 8 ? height / 8 : 8;
+        return band / 2;
+    }
+
+
+    // frame index from the luma of counter_row, bits are blocks brighter than mid gray
+    inline u64 read_counter(u8 const* luma_row, u32 width)
+    {
+        auto block = width / SYNTHETIC_COUNTER_BITS;
+
+        u64 value = 0;
+        for (u32 b = 0; b < SYNTHETIC_COUNTER_BITS; b++)
+        {
+            if (luma_row[b * block + block / 2] > 128)
+            {
+                value |= 1ull << b;
+            }
+        }
+
+        return value;
+    }
+}
+}
+
+
+/* parse */
+
+namespace camera_usb
+{
+namespace synthetic
+{
+    // mixed modes for a camera count, sized for load tests
+    constexpr SyntheticCamera PRESETS[] = {
+        { PF::YUY2, 640, 480, 30, TestPattern::Counter },
+        { PF::NV12, 1280, 720, 30, TestPattern::Gradient },
+        { PF::MJPG, 1920, 1080, 30, TestPattern::Counter },
+        { PF::UYVY, 640, 480, 60, TestPattern::Noise },
+        { PF::YUY2, 1280, 720, 10, TestPattern::Gradient },
+        { PF::P010, 1280, 720, 30, TestPattern::Counter },
+        { PF::MJPG, 1280, 720, 60, TestPattern::Gradient },
+        { PF::NV12, 1920, 1080, 15, TestPattern::Noise },
+    };
+
+
+    inline bool is_valid(SyntheticCamera const& cam)
+    {
+        // counter blocks at least 2 pixels wide, chroma rows and pairs whole
+        return stream_format(cam.pixel_format) != PF::Unknown &&
+            cam.width >= 2 * SYNTHETIC_COUNTER_BITS && cam.height >= 16 &&
+            cam.width % 2 == 0 && cam.height % 2 == 0 &&
+            cam.width <= 4096 && cam.height <= 4096 &&
+            cam.fps && cam.fps <= 240;
+    }
+
+
+    // "NV12:1280x720@30", optionally ":gradient", ":counter" or ":noise" and "*n" for n cameras
+    inline bool parse_entry(cstr entry, SyntheticConfig& config)
+    {
+        char fcc[5] = { 0 };
+        char pattern[16] = { 0 };
+
+        SyntheticCamera cam{};
+        u32 count = 1;
+
+        auto n = sscanf(entry, "%4[^:]:%ux%u@%u:%15[a-z]", fcc, &cam.width, &cam.height, &cam.fps, pattern);
+        if (n < 4)
+        {
+            return false;
+        }
+
+        cam.pixel_format = stream_format(cvt::fcc_to_pf(fcc));
+
+        if (!strcmp(pattern, "counter"))
+        {
+            cam.pattern = TestPattern::Counter;
+        }
+        else if (!strcmp(pattern, "noise"))
+        {
+            cam.pattern = TestPattern::Noise;
+        }
+        else if (pattern[0] && strcmp(pattern, "gradient"))
+        {
+            return false;
+        }
+
+        auto repeat = strchr(entry, '*');
+        if (repeat)
+        {
+            count = (u32)atoi(repeat + 1);
+        }
+
+        if (!is_valid(cam) || !count)
+        {
+            return false;
+        }
+
+        for (u32 i = 0; i < count && config.count < SYNTHETIC_CAMERAS_MAX; i++)
+        {
+            config.cameras[config.count++] = cam;
+        }
+
+        return true;
+    }
+
+
+    // comma separated entries, a number alone adds that many cameras from PRESETS
+    inline bool parse_cameras(cstr text, SyntheticConfig& config)
+    {
+        constexpr u32 n_presets = sizeof(PRESETS) / sizeof(PRESETS[0]);
+
+        config.count = 0;
+
+        char entry[64];
+
+        while (*text)
+        {
+            auto end = strchr(text, ',');
+            u32 len = end ? (u32)(end - text) : (u32)strlen(text);
+
+            if (!len || len >= sizeof(entry))
+            {
+                return false;
+            }
+
+            memcpy(entry, text, len);
+            entry[len] = 0;
+
+            char* num_end = nullptr;
+            auto n = strtoul(entry, &num_end, 10);
+
+            if (!*num_end)
+            {
+                for (u32 i = 0; i < n && config.count < SYNTHETIC_CAMERAS_MAX; i++)
+                {
+                    config.cameras[config.count++] = PRESETS[i % n_presets];
+                }
+            }
+            else if (!parse_entry(entry, config))
+            {
+                return false;
+            }
+
+            text += end ? len + 1 : len;
+        }
+
+        return config.count > 0;
+    }
+}
+}
+
+
+/* draw */
+
+namespace camera_usb
+{
+namespace synthetic
+{
+    // bytes per pixel of the luma plane and of the chroma plane, 0 for packed formats
+    inline u32 luma_bytes(PF format)
+    {
+        switch (format)
+        {
+        case PF::NV12: return 1;
+        default: return 2;
+        }
+    }
+
+
+    inline u32 chroma_bytes(PF format)
+    {
+        switch (format)
+        {
+        case PF::NV12: return 1;
+        case PF::P010: return 2;
+        default: return 0;
+        }
+    }
+
+
+    // a row in the frame's layout from 8 bit samples, u and v once per pixel pair
+    inline void emit_row(PF format, u8 const* y, u8 const* u, u8 const* v, u32 n_pixels, u8* luma, u8* chroma)
+    {
+        auto luma16 = (u16*)luma;
+        auto chroma16 = (u16*)chroma;
+
+        for (u32 p = 0; p < n_pixels / 2; p++)
+        {
+            auto y0 = y[2 * p];
+            auto y1 = y[2 * p + 1];
+
+            switch (format)
+            {
+            case PF::UYVY:
+                luma[4 * p + 0] = u[p];
+                luma[4 * p + 1] = y0;
+                luma[4 * p + 2] = v[p];
+                luma[4 * p + 3] = y1;
+                break;
+
+            case PF::NV12:
+                luma[2 * p] = y0;
+                luma[2 * p + 1] = y1;
+                chroma[2 * p] = u[p];
+                chroma[2 * p + 1] = v[p];
+                break;
+
+            case PF::P010:
+                // 10 bits in the high bits
+                luma16[2 * p] = (u16)(y0 << 8);
+                luma16[2 * p + 1] = (u16)(y1 << 8);
+                chroma16[2 * p] = (u16)(u[p] << 8);
+                chroma16[2 * p + 1] = (u16)(v[p] << 8);
+                break;
+
+            default:
+                luma[4 * p + 0] = y0;
+                luma[4 * p + 1] = u[p];
+                luma[4 * p + 2] = y1;
+                luma[4 * p + 3] = v[p];
+                break;
+            }
+        }
+    }
+
+
+    class FramePlanes
+    {
+    public:
+        u8* luma = nullptr;
+        u8* chroma = nullptr;
+
+        u32 luma_row_bytes = 0;
+        u32 chroma_row_bytes = 0;
+    };
+
+
+    inline FramePlanes make_planes(PF format, u32 width, u32 height, u8* dst)
+    {
+        FramePlanes planes{};
+        planes.luma = dst;
+        planes.luma_row_bytes = width * luma_bytes(format);
+        planes.chroma = dst + (size_t)height * planes.luma_row_bytes;
+        planes.chroma_row_bytes = width * chroma_bytes(format);
+
+        return planes;
+    }
+
+
+    // rows are copied from one template twice the width, shifted by the frame and row
+    inline void draw_gradient(SyntheticCamera const& cam, PF format, u64 index, u8* scratch, u8* dst)
+    {
+        auto w = cam.width;
+        auto h = cam.height;
+
+        auto y = scratch;
+        auto u = y + 2 * w;
+        auto v = u + w;
+        auto luma = v + w;
+        auto chroma = luma + 4 * w;
+
+        for (u32 i = 0; i < 2 * w; i++)
+        {
+            y[i] = (u8)(16 + (i % w) * 219 / w);
+        }
+
+        for (u32 p = 0; p < w; p++)
+        {
+            auto c = (p % (w / 2)) * 224 / (w / 2);
+            u[p] = (u8)(16 + c);
+            v[p] = (u8)(240 - c);
+        }
+
+        emit_row(format, y, u, v, 2 * w, luma, chroma);
+
+        auto planes = make_planes(format, w, h, dst);
+        auto lb = luma_bytes(format);
+        auto cb = chroma_bytes(format);
+
+        auto const shift = [&](u32 row) { return (u32)((index * 8 + row) % w) & ~1u; };
+
+        for (u32 r = 0; r < h; r++)
+        {
+            memcpy(planes.luma + (size_t)r * planes.luma_row_bytes, luma + shift(r) * lb, planes.luma_row_bytes);
+        }
+
+        for (u32 r = 0; cb && r < h / 2; r++)
+        {
+            memcpy(planes.chroma + (size_t)r * planes.chroma_row_bytes, chroma + shift(2 * r) * cb, planes.chroma_row_bytes);
+        }
+    }
+
+
+    // a band of counter blocks over a gray field with a moving bar, neutral chroma
+    inline void draw_counter(SyntheticCamera const& cam, PF format, u64 index, u8* scratch, u8* dst)
+    {
+        auto w = cam.width;
+        auto h = cam.height;
+
+        auto band_y = scratch;
+        auto body_y = band_y + w;
+        auto uv = body_y + w;
+        auto band = uv + w;
+        auto body = band + 2 * w;
+        auto chroma = body + 2 * w;
+
+        auto block = w / SYNTHETIC_COUNTER_BITS;
+        auto bar = (u32)((index * 8) % (w - 16)) & ~1u;
+
+        for (u32 x = 0; x < w; x++)
+        {
+            auto b = x / block;
+            auto bit = b < SYNTHETIC_COUNTER_BITS && ((index >> b) & 1);
+
+            band_y[x] = bit ? 235 : 16;
+            body_y[x] = x >= bar && x < bar + 16 ? 235 : 64;
+            uv[x] = 128;
+        }
+
+        emit_row(format, band_y, uv, uv, w, band, chroma);
+        emit_row(format, body_y, uv, uv, w, body, chroma);
+
+        auto planes = make_planes(format, w, h, dst);
+        auto band_rows = 2 * counter_row(h);
+
+        for (u32 r = 0; r < h; r++)
+        {
+            memcpy(planes.luma + (size_t)r * planes.luma_row_bytes, r < band_rows ? band : body, planes.luma_row_bytes);
+        }
+
+        for (u32 r = 0; r < h / 2 && planes.chroma_row_bytes; r++)
+        {
+            memcpy(planes.chroma + (size_t)r * planes.chroma_row_bytes, chroma, planes.chroma_row_bytes);
+        }
+    }
+
+
+    inline void draw_noise(SyntheticCamera const& cam, PF format, u64 index, u8* dst)
+    {
+        auto bytes = raw_frame_bytes(cam);
+
+        u32 state = (u32)(index * 0x9E3779B9u) | 1;
+
+        u32 i = 0;
+        for (; i + 4 <= bytes; i += 4)
+        {
+            auto r = next_random(state);
+
+            // P010 samples keep the low 6 bits clear
+            if (format == PF::P010)
+            {
+                r &= 0xFFC0'FFC0;
+            }
+
+            memcpy(dst + i, &r, 4);
+        }
+
+        for (; i < bytes; i++)
+        {
+            dst[i] = (u8)next_random(state);
+        }
+    }
+
+
+    // raw_frame_bytes to dst in raw_format, scratch holds scratch_bytes
+    inline void draw_frame(SyntheticCamera const& cam, u64 index, u8* scratch, u8* dst)
+    {
+        auto format = raw_format(cam);
+
+        switch (cam.pattern)
+        {
+        case TestPattern::Counter:
+            draw_counter(cam, format, index, scratch, dst);
+            break;
+
+        case TestPattern::Noise:
+            draw_noise(cam, format, index, dst);
+            break;
+
+        default:
+            draw_gradient(cam, format, index, scratch, dst);
+            break;
+        }
+    }
+}
+}
+
+
+/* clock */
+
+namespace camera_usb
+{
+namespace synthetic
+{
+    inline void start_clock(SyntheticClock& clock, SyntheticConfig const& config, SyntheticCamera const& cam, u32 seed)
+    {
+        // a frame always arrives eventually
+        auto drop_rate = config.drop_rate < 0.9f ? config.drop_rate : 0.9f;
+        drop_rate = drop_rate > 0.0f ? drop_rate : 0.0f;
+
+        clock.interval_ns = 1'000'000'000ull / cam.fps;
+        clock.jitter_ns = (u64)config.jitter_us * 1000;
+        clock.drop_threshold = (u32)(drop_rate * 4294967295.0f);
+        clock.rng = seed ? seed : 1;
+
+        clock.next_index = 0;
+        clock.last_due_ns = 0;
+    }
+
+
+    // index of the next frame sent and when it arrives, dropped frames are skipped
+    // frames stay in order however large the jitter
+    inline u64 next_frame(SyntheticClock& clock, u64& due_ns)
+    {
+        auto index = clock.next_index++;
+
+        while (clock.drop_threshold && next_random(clock.rng) < clock.drop_threshold)
+        {
+            index = clock.next_index++;
+        }
+
+        auto due = (i64)(index * clock.interval_ns);
+
+        if (clock.jitter_ns)
+        {
+            due += (i64)(next_random(clock.rng) % (2 * clock.jitter_ns + 1)) - (i64)clock.jitter_ns;
+        }
+
+        due_ns = due > (i64)clock.last_due_ns ? (u64)due : clock.last_due_ns;
+        clock.last_due_ns = due_ns;
+
+        return index;
+    }
+}
+}
@@ -1,15 +1,18 @@
 #pragma once
 
-#include "../image/image.hpp"
+#include "../image/convert.hpp"
+#include "frame_ring.hpp"
+#include "camera_stats.hpp"
+#include "camera_modes.hpp"
+#include "camera_hotplug.hpp"
+
+#include <atomic>
 
 
 /* constants */
 
 namespace camera_usb
 {
-    constexpr u32 WIDTH_MAX = 640;
-    constexpr u32 HEIGHT_MAX = 480;
-
     namespace img = image;
 }
 
@@ -38,6 +41,26 @@ namespace camera_usb
 
 namespace camera_usb
 {
+    // written by a camera's stream thread while the ui reads it, copies take the current value
+    template <typename T>
+    class SharedValue
+    {
+    public:
+        std::atomic<T> value_;
+
+        SharedValue() : value_(T{}) {}
+        SharedValue(T value) : value_(value) {}
+        SharedValue(SharedValue const& other) : value_(other.load()) {}
+
+        SharedValue& operator = (SharedValue const& other) { value_.store(other.load()); return *this; }
+        SharedValue& operator = (T value) { value_.store(value); return *this; }
+
+        operator T () const { return load(); }
+
+        T load() const { return value_.load(); }
+    };
+
+
     class Camera
     {
     public:
@@ -45,7 +68,7 @@ namespace camera_usb
 
 		u32 frame_width = 0;
 		u32 frame_height = 0;
-		u32 fps = 0;
+		SharedValue<u32> fps = 0;
 
         StringView format;
 
@@ -55,13 +78,55 @@ namespace camera_usb
 
         StringView label;
 
-        CameraStatus status = CameraStatus::Inactive;
-        b8 busy = 0;
+        SharedValue<CameraStatus> status = CameraStatus::Inactive;
+        SharedValue<b8> busy = 0;
 
         bool is_open() const { return status >= CameraStatus::Open; }
     };
 
 
+    enum class GrabStatus : u8
+    {
+        Ok = 0,
+        Timeout,
+        Error
+    };
+
+
+    class GrabResult
+    {
+    public:
+        GrabStatus status = GrabStatus::Error;
+
+        u64 sequence = 0;
+        u64 timestamp_ns = 0;
+
+        // steady clock when the image was captured, see clocks::add_frame
+        // 0 on windows, timestamp_ns is the sample time
+        u64 capture_ns = 0;
+
+        // device clock from the payload headers, 0 if not sent
+        u32 pts = 0;
+        u32 scr = 0;
+        u16 sof = 0;
+
+        // frames missed since the previous grab
+        u32 dropped = 0;
+
+        bool ok() const { return status == GrabStatus::Ok; }
+    };
+
+
+    enum class DecodeOrder : u8
+    {
+        // every frame, published in capture order
+        InOrder = 0,
+
+        // compressed frames still waiting are replaced by newer ones
+        LatestOnly
+    };
+
+
     class CameraList
     {
     public:
@@ -78,17 +143,58 @@ namespace camera_usb
     using planar_cb = std::function<void(img::View3u8 const&)>;
 
 
+    // recordings in CAMERA_REPLAY, separated by ':', are listed after the usb cameras
+    // CAMERA_REPLAY_RATE=0 replays them as fast as possible
+    // CAMERA_SYNTHETIC lists test pattern cameras instead of the usb cameras, see read_synthetic_config
     CameraList enumerate_cameras();
 
     void close(CameraList& cameras);
 
+    // rescans when a device arrives or leaves, or every HOTPLUG_POLL_MS without hotplug events
+    // removed cameras become Inactive, returning cameras reopen with their last mode and stream
+    // call from the thread that opens and streams cameras, true when the list changed
+    bool update_cameras(CameraList& cameras);
+
+    // the camera arrived in a new slot in the last update_cameras, it has no mode to restore and needs open_camera
+    bool is_new_camera(Camera const& camera);
+
+    // unplugs or replugs a CAMERA_SYNTHETIC camera, update_cameras sees it like a usb device
+    bool plug_synthetic_camera(u32 index, bool plugged);
+
     bool open_camera(Camera& camera);
 
+    // every format, frame size and frame interval the device reports
+    CameraModeList enumerate_modes(Camera const& camera);
+
+    // buffers are sized from the negotiated mode
+    bool open_camera(Camera& camera, ModeRequest const& request);
+
+    // BT.601 limited range after open_camera, full range for MJPG
+    void set_color_space(Camera& camera, convert::ColorMatrix matrix, convert::ColorRange range);
+
+    // for converting the camera's YUV frames, see read_frame
+    convert::ColorTable const& get_color_table(Camera const& camera);
+
+    // writes the raw payloads of an open camera to path, replay them with CAMERA_REPLAY
+    // returns false on Windows
+    bool start_recording(Camera& camera, cstr path);
+
+    // returns the number of payloads written, closing the camera also stops recording
+    u64 stop_recording(Camera& camera);
+
+    // MJPG frames with restart markers decode in stripes on n_threads, call before streaming
+    void set_decode_threads(Camera& camera, u32 n_threads);
+
     void grab_image(Camera& camera, img::ImageView const& dst);
+
+    // decode into a tile of a larger image
+    void grab_image(Camera& camera, img::SubView const& dst);
     
 
     void stream_camera(Camera& camera, img::ImageView const& dst, bool_fn const& stream_condition);
 
+    void stream_camera(Camera& camera, img::SubView const& dst, bool_fn const& stream_condition);
+
     void stream_camera(Camera& camera, grab_cb const& on_grab, bool_fn const& stream_condition);
 
 
@@ -96,8 +202,68 @@ namespace camera_usb
 
     void grab_planar_yuv(Camera& camera, img::View3u8 const& dst);
 
+    // 10 bit P010 cameras
+    void grab_planar_yuv(Camera& camera, img::View3<u16> const& dst);
+
+
+    // wait at most timeout_us for a new frame, 0 does not wait
+    GrabResult grab_image(Camera& camera, img::ImageView const& dst, u32 timeout_us);
+
+    GrabResult grab_image(Camera& camera, img::SubView const& dst, u32 timeout_us);
+
+    GrabResult grab_planar_yuv(Camera& camera, img::View3u8 const& dst, u32 timeout_us);
+
+    GrabResult grab_planar_yuv(Camera& camera, img::View3<u16> const& dst, u32 timeout_us);
+
+    // only takes a frame that has already arrived
+    GrabResult try_grab_image(Camera& camera, img::ImageView const& dst);
+
+    GrabResult try_grab_image(Camera& camera, img::SubView const& dst);
+
+    GrabResult try_grab_planar_yuv(Camera& camera, img::View3u8 const& dst);
+
+    GrabResult try_grab_planar_yuv(Camera& camera, img::View3<u16> const& dst);
+
     
     void stream_planar_rgb(Camera& camera, planar_cb const& proc, bool_fn const& stream_condition);
 
     void stream_planar_yuv(Camera& camera, planar_cb const& proc, bool_fn const& stream_condition);
+
+
+    // each camera streams on its own thread, callbacks run on that thread
+    bool start_stream(Camera& camera, grab_cb const& on_grab);
+
+    bool start_stream_planar_rgb(Camera& camera, planar_cb const& proc);
+
+    bool start_stream_planar_yuv(Camera& camera, planar_cb const& proc);
+
+    void stop_stream(Camera& camera);
+
+
+    // capture converts into a ring of capacity frames and never waits on the reader
+    // unless policy is OverflowPolicy::Block, stop with stop_stream
+    bool start_stream_ring(Camera& camera, u32 capacity, OverflowPolicy policy);
+
+    // MJPG cameras decode on the pool when one is running, the workers never wait on a reader
+    // with OverflowPolicy::Block the capture thread waits instead once every decode job is held
+    bool start_stream_ring(Camera& camera, u32 capacity, OverflowPolicy policy, DecodeOrder order);
+
+    // one reader per camera, the frame is valid until the next read or release_frame
+    bool read_frame(Camera& camera, FrameYUV& frame);
+
+    // skips to the newest frame
+    bool read_latest_frame(Camera& camera, FrameYUV& frame);
+
+    void release_frame(Camera& camera);
+
+
+    // one reader, the latest window published by the capture thread
+    CameraStats get_stats(Camera const& camera);
+
+
+    // n_workers MJPG decoders shared by all ring streams, each with its own decoder state
+    // create before starting streams and destroy after stopping them
+    bool create_decode_pool(u32 n_workers);
+
+    void destroy_decode_pool();
 }
\ No newline at end of file
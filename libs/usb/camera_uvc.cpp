@@ -5,13 +5,24 @@
 #endif
 
 #include "camera_usb.hpp"
+#include "camera_synthetic.hpp"
+#include "camera_clock.hpp"
+#include "uvc_payload.hpp"
 #include "libuvc3.hpp"
 #include "../image/convert.hpp"
 #include "../qsprintf/qsprintf.hpp"
 #include "../util/numeric.hpp"
 #include "../util/stopwatch.hpp"
 
+#include <atomic>
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+#include <vector>
+
 #include <cassert>
+#include <cstdlib>
+#include <cstring>
 
 namespace num = numeric;
 
@@ -23,6 +34,22 @@ namespace camera_usb
 
     constexpr u8 DEVICE_COUNT_MAX = 16;
 
+    // recordings listed in CAMERA_REPLAY, see uvc::opt::open_replay
+    constexpr u32 REPLAY_DEVICES_MAX = 8;
+    constexpr u32 REPLAY_PATH_MAX = 256;
+
+    // synthetic cameras instead of usb cameras, CAMERA_SYNTHETIC overrides it
+#ifdef CAMERA_USB_SYNTHETIC
+    constexpr cstr SYNTHETIC_DEFAULT = CAMERA_USB_SYNTHETIC;
+#else
+    constexpr cstr SYNTHETIC_DEFAULT = nullptr;
+#endif
+
+    constexpr int SYNTHETIC_JPEG_QUALITY = 80;
+
+    // blocking grabs give up so a quiet camera can't hang a stream
+    constexpr i32 GRAB_TIMEOUT_US = 1'000'000;
+
 
     class DeviceConfigUVC
     {
@@ -38,6 +65,108 @@ namespace camera_usb
     };
 
 
+    constexpr u32 DECODE_JOBS_MAX = 8;
+    constexpr u32 DECODE_WORKERS_MAX = 16;
+
+
+    enum class DecodeState : u8
+    {
+        Free = 0,
+        Filling,
+        Queued,
+        Decoding,
+        Done
+    };
+
+
+    class DecodeJob
+    {
+    public:
+        DecodeState state = DecodeState::Free;
+
+        // capture order, outputs are published in this order
+        u64 index = 0;
+
+        // data points into DecodeQueue::jpeg_data
+        uvc::frame jpeg = {};
+
+        // a spare from the device's ring, traded for a ring slot when published
+        FrameYUV out;
+        b8 ok = 0;
+    };
+
+
+    // compressed frames waiting for the pool, guarded by the pool mutex
+    class DecodeQueue
+    {
+    public:
+        DecodeJob jobs[DECODE_JOBS_MAX];
+        u32 n_jobs = 0;
+
+        img::Buffer8 jpeg_data;
+
+        // bytes per job
+        u32 jpeg_capacity = 0;
+
+        u64 next_index = 0;
+        DecodeOrder order = DecodeOrder::InOrder;
+
+        // one worker at a time writes to the ring
+        b8 publishing = 0;
+
+        // capture thread, see grab_and_queue_frame_ring
+        u64 ring_dropped = 0;
+    };
+
+
+    using stream_fn = std::function<void(Camera&, bool_fn const&)>;
+
+
+    // payloads of one synthetic camera, see next_synthetic_payload
+    class SyntheticSource
+    {
+    public:
+        SyntheticCamera camera;
+        SyntheticClock clock;
+
+        u32 fid = 0;
+
+        // draw scratch, then the YUY2 frame MJPG cameras encode
+        img::Buffer8 scratch;
+
+        // encoded on first use, the same for every stream of the camera
+        u8* jpegs[SYNTHETIC_JPEG_CYCLE] = { 0 };
+        u32 jpeg_bytes[SYNTHETIC_JPEG_CYCLE] = { 0 };
+
+        // left out of scans, see plug_synthetic_camera
+        b8 unplugged = 0;
+    };
+
+
+    // restored when the device comes back, see update_cameras
+    class DeviceSetup
+    {
+    public:
+        b8 open = 0;
+        ModeRequest request;
+
+        b8 has_color_space = 0;
+        cvt::ColorMatrix matrix = cvt::ColorMatrix::BT601;
+        cvt::ColorRange range = cvt::ColorRange::Limited;
+
+        // empty when not streaming
+        stream_fn stream;
+
+        b8 ring = 0;
+        u32 ring_capacity = 0;
+        OverflowPolicy ring_policy = OverflowPolicy::DropOldest;
+        DecodeOrder ring_order = DecodeOrder::InOrder;
+
+        // reopen failed, retried on the next poll
+        b8 pending = 0;
+    };
+
+
     class DeviceUVC
     {
     public:
@@ -49,6 +178,13 @@ namespace camera_usb
         uvc::stream_handle* h_stream = nullptr;
         //uvc::frame_desc* p_frame_desc = nullptr;
 
+        // a recording instead of a usb device, points into DeviceListUVC::replay_paths
+        cstr replay_path = nullptr;
+        f32 replay_rate = 1.0f;
+
+        // or a test pattern, points into DeviceListUVC::synthetic_sources
+        SyntheticSource* synthetic = nullptr;
+
         char product_id[5] = { 0 };
         char vendor_id[5] = { 0 };
         char serial_number[32] = { 0 };
@@ -60,23 +196,79 @@ namespace camera_usb
         Stopwatch grab_sw;
         f32 grab_ms;
 
+        // each device owns its buffers so cameras can stream at the same time
+        img::Buffer32 data32;
+        img::Buffer8 data8;
+
         img::ImageView rgba;
         img::View3u8 view3;
+
+        cvt::ColorTable color_table;
+
+        // see start_stream
+        std::thread stream_thread;
+        std::atomic<bool> stream_on = false;
+
+        // set while stop_stream_thread joins, a waiting borrow_frame gives up within a frame
+        std::atomic<bool> stopping = false;
+
+        // see start_stream_ring
+        FrameRing ring;
+
+        // MJPG cameras, kept for the life of the stream
+        uvc::opt::jpeg_decoder* jpeg = nullptr;
+        u32 jpeg_threads = 1;
+
+        // MJPG ring streams when the decode pool is running
+        DecodeQueue decode;
+
+        // see borrow_frame
+        u32 last_sequence = 0;
+        u64 frame_count = 0;
+        u64 last_bytes_received = 0;
+
+        // restarts with each stream
+        ClockFit clock;
+
+        StatsCollector stats;
+        Stopwatch convert_sw;
+
+        DeviceSetup setup;
     };
 
 
+    static_assert(DEVICE_COUNT_MAX == HOTPLUG_SLOTS_MAX);
+
+
     class DeviceListUVC
     {
     public:
         uvc::context* context = nullptr;
+
+        // latest scan, see ScanUVC
         uvc::device** device_list = nullptr;
 
         DeviceUVC devices[DEVICE_COUNT_MAX] = { 0 };
 
         u32 count = 0;
 
-        img::Buffer32 data32;
-        img::Buffer8 data8;
+        // devices index the same as slots
+        DeviceTable table;
+
+        // -1 when libusb has no hotplug support, then the list is polled
+        int hotplug_handle = -1;
+        std::atomic<bool> changed = false;
+
+        u64 last_poll_ns = 0;
+
+        // scanned after the usb devices, read once when the context is created
+        char replay_paths[REPLAY_DEVICES_MAX][REPLAY_PATH_MAX] = { 0 };
+        u32 n_replay = 0;
+        f32 replay_rate = 1.0f;
+
+        // replace the usb devices when there are any, read with the replay paths
+        SyntheticConfig synthetic;
+        SyntheticSource synthetic_sources[SYNTHETIC_CAMERAS_MAX];
     };
 }
 
@@ -103,6 +295,18 @@ vendor and product ID of your webcams.
     {
 #ifndef NDEBUG
 
+    // recordings and synthetic cameras need no permissions
+    u32 n_usb = 0;
+    for (u32 i = 0; i < list.count; i++)
+    {
+        n_usb += !list.devices[i].replay_path && !list.devices[i].synthetic;
+    }
+
+    if (!n_usb)
+    {
+        return;
+    }
+
     printf(
         "\n********** LINUX PERMISSIONS MESSAGE **********\n\n"
         "Libuvc requires RW permissions for opening capturing devices, so you must create the following .rules file:\n\n"
@@ -115,6 +319,11 @@ vendor and product ID of your webcams.
     for (u32 i = 0; i < list.count; i++)
     {
         auto& cam = list.devices[i];
+        if (cam.replay_path || cam.synthetic)
+        {
+            continue;
+        }
+
         printf(fmt, cam.vendor_id, cam.product_id);
     }
 
@@ -132,8 +341,28 @@ vendor and product ID of your webcams.
 
 namespace camera_usb
 {
+    static bool open_synthetic(SyntheticSource& source, uvc::device_handle** h_device);
+
+
     static bool open_device(DeviceUVC& device)
     {
+        if (device.synthetic)
+        {
+            return open_synthetic(*device.synthetic, &device.h_device);
+        }
+
+        if (device.replay_path)
+        {
+            auto res = uvc::opt::open_replay(device.replay_path, &device.h_device);
+            if (res != uvc::UVC_SUCCESS)
+            {
+                return false;
+            }
+
+            uvc::opt::set_replay_rate(device.h_device, device.replay_rate, 1);
+            return true;
+        }
+
         assert(device.p_device && "No device to open");
 
         auto res = uvc::uvc_open(device.p_device, &device.h_device);
@@ -152,47 +381,22 @@ namespace camera_usb
     }
 
 
-    static uvc::opt::FrameFormat get_frame_format(DeviceUVC const& device)
+    static void read_device_modes(DeviceUVC const& device, CameraModeList& modes)
     {
-        using PF = cvt::PixelFormat;
+        // sized from the descriptors, add_mode decides what to keep when they do not fit
+        auto n = uvc::opt::list_frame_formats(device.h_device, nullptr, 0);
 
-        constexpr u32 N = 14;
+        std::vector<uvc::opt::FrameFormat> formats(n);
+        n = num::min(uvc::opt::list_frame_formats(device.h_device, formats.data(), n), n);
 
-        PF formats[N] {
-            PF::YUYV,
-            PF::YUNV,
-            PF::YUY2,
-            PF::YVYU,
-            PF::UYVY,
-            PF::Y422,
-            PF::UYNV,
-            PF::HDYC,
-            PF::NV12,
-            PF::NV21,
-            PF::YV12,
-            PF::I420,
-            PF::IYUV,
-            PF::P010
-        };
-
-        uvc::opt::FrameFormat ff;
-        ff.interval = 0;
+        modes.count = 0;
+        modes.truncated = 0;
 
-        for (u32 i = 0; i < N; i++)
+        for (u32 i = 0; i < n; i++)
         {
-            auto format = uvc::opt::find_frame_format_by_wh(device.h_device, (u32)formats[i], 640, 480);
-            if (!format.ok)
-            {
-                continue;
-            }
-
-            if (!ff.interval || format.interval < ff.interval)
-            {
-                ff = format;
-            }
+            auto& ff = formats[i];
+            modes::add_mode(modes, ff.four_cc_bytes, ff.width, ff.height, ff.interval, i);
         }
-
-        return ff;        
     }
     
     
@@ -236,8 +440,15 @@ namespace camera_usb
         }
 
         auto res = uvc::uvc_stream_open_ctrl(device.h_device, &device.h_stream, &device.ctrl);
-        
-        return res == uvc::UVC_SUCCESS;
+        if (res != uvc::UVC_SUCCESS)
+        {
+            return false;
+        }
+
+        // as few transfers in flight as lose no frames, LIBUVC_NUM_TRANSFER_BUFS at most
+        uvc::opt::set_stream_transfers(device.h_stream, 0, 0, 1);
+
+        return true;
     }
 
 
@@ -283,10 +494,8 @@ namespace camera_usb
 
 namespace camera_usb
 {
-    static bool read_device_config(DeviceUVC& device)
-    {        
-        using FF = uvc::frame_format;
-
+    static bool read_device_config(DeviceUVC& device, ModeRequest const& request)
+    {
         if (!device.h_device)
         {
             assert(false && "Device not open");
@@ -295,19 +504,22 @@ namespace camera_usb
 
         auto& config = device.config;
 
-        auto format = get_frame_format(device);
+        CameraModeList modes;
+        read_device_modes(device, modes);
 
-        if (!format.ok)
+        auto selected = modes::select_mode(modes, request);
+        if (selected < 0)
         {
             return false;
         }
 
-        // this may break if camera does not support dimensions
-        config.frame_width = format.width;
-        config.frame_height = format.height;
-        config.fps = 10'000'000 / format.interval;
+        auto& mode = modes.list[selected];
+
+        config.frame_width = mode.width;
+        config.frame_height = mode.height;
+        config.fps = mode.fps;
 
-        cvt::u32_to_fcc(format.four_cc_bytes, config.format_code);
+        cvt::u32_to_fcc((u32)mode.pixel_format, config.format_code);
 
         config.pixel_format = cvt::fcc_to_pf(config.format_code);        
 
@@ -315,272 +527,1564 @@ namespace camera_usb
     }
     
     
-    static bool read_device_properties(DeviceUVC& device)
+    static void set_device_properties(DeviceUVC& device, DeviceKey const& key)
     {
-        uvc::device_descriptor* desc;
-
-        auto res = uvc::uvc_get_device_descriptor(device.p_device, &desc);
-        if (res != uvc::UVC_SUCCESS)
-        {
-            assert(false && "Could not find device");
-            return false;
-        }
-
-        qsnprintf(device.product_id, 5, "%04x", desc->idProduct);
-        qsnprintf(device.vendor_id, 5, "%04x", desc->idVendor);
-        qsnprintf(device.serial_number, 32, "%s", desc->serialNumber);        
-            
-        uvc::uvc_free_device_descriptor(desc);
-
-        qsnprintf(device.label, 32, "%c", 'A');
+        qsnprintf(device.product_id, 5, "%04x", key.product_id);
+        qsnprintf(device.vendor_id, 5, "%04x", key.vendor_id);
+        qsnprintf(device.serial_number, 32, "%s", key.serial_number);
 
-        return true;
+        qsnprintf(device.label, 32, "%c", 'A' + device.device_id);
     }
 }
 
 
-/* enumerate */
+/*  */
 
 namespace camera_usb
 {
-    static bool enumerate_devices(DeviceListUVC& list)
+    // fails when a returning camera is not ready yet, restore_device retries it
+    static bool open_device_stream(DeviceUVC& device, ModeRequest const& request)
     {
-        auto res = uvc::uvc_init(&list.context, NULL);
-        if (res != uvc::UVC_SUCCESS)
+        if (!open_device(device))
         {
-            //print_uvc_error(res, "uvc_init");
-            uvc::uvc_exit(list.context);
             return false;
         }
 
-        res = uvc::uvc_get_device_list(list.context, &list.device_list);
-        if (res != uvc::UVC_SUCCESS)
+        if (!read_device_config(device, request))
         {
-            //print_uvc_error(res, "uvc_get_device_list");
-            uvc::uvc_exit(list.context);
+            close_device(device);
             return false;
         }
 
-        if (!list.device_list[0])
+        if (!open_stream(device))
         {
-            uvc::uvc_exit(list.context);
+            close_device(device);
             return false;
         }
 
-        list.count = 0;
-        for (int i = 0; list.device_list[i]; ++i) 
-        {
-            auto& device = list.devices[list.count];
-
-            device.device_id = i;
-            device.p_device = list.device_list[i];           
+        return true;
+    }
 
-            read_device_properties(device);
 
-            ++list.count;
+    static bool start_device_stream(DeviceUVC& device)
+    {
+        if (!start_stream_single_frame(device))
+        {
+            assert(false && "Could not start stream");
+            return false;
         }
 
-        if (list.count)
+        // recordings and synthetic cameras have no controls
+        if (!device.replay_path && !device.synthetic)
         {
-            print_device_permissions_msg(list);
+            enable_exposure_mode(device);
         }
 
-        return list.count > 0;
+        return true;
     }
 
 
-    static void close_devices(DeviceListUVC& list)
+    static void close_device_stream(DeviceUVC& device)
     {
-        for (int i = 0; i < list.count; ++i)
-        {
-            auto& device = list.devices[i];
-            close_stream(device);
-            close_device(device);
-            uvc::uvc_unref_device(device.p_device);
-            device.p_device = nullptr;
-        }
+        close_stream(device);
+    }
 
-        if (list.device_list)
-        {
-            uvc::uvc_free_device_list(list.device_list, 0);
-        }
 
-        if (list.context)
-        {
-            uvc::uvc_exit(list.context);
-        }
+    static void convert_frame_rgba(SpanView<u8> const& src, img::ImageView const& dst, cvt::PixelFormat format, cvt::ColorTable const& table)
+    {
+        cvt::convert_view(src, dst, format, table);
     }
-}
 
 
-/*  */
+    static void convert_frame_rgba(SpanView<u8> const& src, img::SubView const& dst, cvt::PixelFormat format, cvt::ColorTable const& table)
+    {
+        cvt::convert_sub_view(src, dst, format, table);
+    }
 
-namespace camera_usb
-{
-    static bool open_device_stream(DeviceUVC& device)
+
+    // waits one frame interval at a time, an unplugged camera's stream thread stops within a frame
+    static uvc::uvc_error_t wait_borrow_frame(DeviceUVC& device, uvc::frame** frame, i32 timeout_us)
     {
-        if (!open_device(device))
+        if (timeout_us < 0)
         {
-            assert(false && "Could not open device");
-            return false;
+            return uvc::uvc_stream_borrow_frame(device.h_stream, frame, timeout_us);
         }
 
-        if (!read_device_config(device))
-        {
-            assert(false && "Error getting device configuration");
-            close_device(device);
-            return false;
-        }
+        auto fps = device.config.fps ? device.config.fps : 30u;
+        auto slice_us = (i32)(1'000'000 / fps);
 
-        if (!open_stream(device))
+        auto res = uvc::UVC_ERROR_TIMEOUT;
+
+        for (i32 waited_us = 0; !timeout_us || waited_us < timeout_us; waited_us += slice_us)
         {
-            assert(false && "Could not open stream");
-            return false;
+            auto wait_us = timeout_us ? num::min(slice_us, timeout_us - waited_us) : slice_us;
+
+            res = uvc::uvc_stream_borrow_frame(device.h_stream, frame, wait_us);
+            if (res != uvc::UVC_ERROR_TIMEOUT || device.stopping)
+            {
+                break;
+            }
         }
 
-        return true;
+        return res;
     }
 
 
-    static bool start_device_stream(DeviceUVC& device)
+    // timeout_us: 0 waits for a frame, -1 polls
+    static uvc::frame* borrow_frame(DeviceUVC& device, i32 timeout_us, GrabResult& result)
     {
-        if (!start_stream_single_frame(device))
+        uvc::frame* frame = nullptr;
+
+        auto res = wait_borrow_frame(device, &frame, timeout_us);
+        if (res == uvc::UVC_ERROR_TIMEOUT)
         {
-            assert(false && "Could not start stream");
-            return false;
+            result.status = GrabStatus::Timeout;
+            return nullptr;
         }
 
-        enable_exposure_mode(device);
+        if (res != uvc::UVC_SUCCESS || !frame)
+        {
+            result.status = GrabStatus::Error;
+            return nullptr;
+        }
 
-        return true;
-    }
+        auto& time = frame->capture_time_finished;
 
+        result.status = GrabStatus::Ok;
+        result.sequence = frame->sequence;
+        result.timestamp_ns = (u64)time.tv_sec * 1'000'000'000 + (u64)time.tv_nsec;
+        result.pts = frame->pts;
+        result.scr = frame->scr;
+        result.sof = frame->sof;
+        result.capture_ns = clocks::add_frame(device.clock, frame->pts, frame->scr, frame->capture_steady_ns);
 
-    static void close_device_stream(DeviceUVC& device)
-    {
-        close_stream(device);
+        // gaps in the stream's sequence are frames nobody took
+        result.dropped = device.frame_count ? frame->sequence - device.last_sequence - 1 : 0;
+
+        device.last_sequence = frame->sequence;
+        device.frame_count++;
+
+        device.convert_sw.start();
+
+        return frame;
     }
 
 
-    static bool grab_and_convert_frame_rgba(DeviceUVC& device, img::ImageView const& dst)
+    static FrameStats frame_stats(DeviceUVC& device, uvc::frame* frame, GrabResult const& result, u32 consumer_dropped)
     {
-        uvc::frame* frame;
-
-        auto res = uvc::uvc_stream_get_frame(device.h_stream, &frame);
-        if (res != uvc::UVC_SUCCESS)
-        {  
-            return false;
-        }
+        FrameStats fs{};
+        fs.dropped = result.dropped;
+        fs.consumer_dropped = consumer_dropped;
+        fs.capture_ns = result.timestamp_ns;
+        fs.bytes = frame->bytes_received - device.last_bytes_received;
+        fs.convert_ms = device.convert_sw.get_time_milli();
 
-        auto span = span::make_view(frame->data, frame->data_bytes);
+        fs.clock_locked = device.clock.locked;
+        fs.clock_residual_ns = device.clock.residual_ns;
+        fs.device_clock_hz = clocks::device_clock_hz(device.clock);
+        fs.clock_resets = device.clock.resets;
 
-        auto format = device.config.pixel_format;
-        auto w = device.config.frame_width;
-        auto h = device.config.frame_height;
+        device.last_bytes_received = frame->bytes_received;
 
-        cvt::to_yuv(span, w, h, device.view3, format);
-        cvt::yuv_to_rgba(device.view3, dst);
-        
-        return res == uvc::UVC_SUCCESS;
+        return fs;
     }
 
 
-    static bool grab_and_convert_frame_rgb(DeviceUVC& device, img::View3u8 const& dst)
+    // after conversion
+    static void return_frame(DeviceUVC& device, uvc::frame* frame, GrabResult const& result, u32 consumer_dropped)
     {
-        uvc::frame* frame;
-
-        auto res = uvc::uvc_stream_get_frame(device.h_stream, &frame);
-        if (res != uvc::UVC_SUCCESS)
-        {  
-            return false;
-        }
+        stats::add_frame(device.stats, frame_stats(device, frame, result, consumer_dropped));
 
-        auto span = span::make_view(frame->data, frame->data_bytes);
+        uvc::uvc_stream_return_frame(device.h_stream, frame);
+    }
 
-        auto format = device.config.pixel_format;
-        auto w = device.config.frame_width;
-        auto h = device.config.frame_height;
 
-        cvt::to_yuv(span, w, h, device.view3, format);
-        cvt::yuv_to_rgb(device.view3, dst);
+    static void drop_frame(DeviceUVC& device, uvc::frame* frame, GrabResult const& result, u32 consumer_dropped)
+    {
+        stats::add_dropped_frame(device.stats, frame_stats(device, frame, result, consumer_dropped));
 
-        return res == uvc::UVC_SUCCESS;
+        uvc::uvc_stream_return_frame(device.h_stream, frame);
     }
 
 
-    static bool grab_and_convert_frame_yuv(DeviceUVC& device, img::View3u8 const& dst)
+    static bool is_mjpeg(DeviceUVC const& device)
     {
-        uvc::frame* frame;
+        return device.config.pixel_format == cvt::PixelFormat::MJPG;
+    }
 
-        auto res = uvc::uvc_stream_get_frame(device.h_stream, &frame);
-        if (res != uvc::UVC_SUCCESS)
-        {  
+
+    static bool decode_mjpeg_rgba(DeviceUVC& device, uvc::frame* frame, img::Pixel* dst, u32 width, u32 height, u32 stride)
+    {
+        if (width != frame->width || height != frame->height)
+        {
+            assert(false && "MJPG decodes the full frame");
             return false;
         }
 
-        auto span = span::make_view(frame->data, frame->data_bytes);
-
-        auto format = device.config.pixel_format;
-        auto w = device.config.frame_width;
-        auto h = device.config.frame_height;
-
-        cvt::to_yuv(span, w, h, dst, format);
+        auto res = uvc::opt::mjpeg_decode_rgba(device.jpeg, frame, (u8*)dst, stride * sizeof(img::Pixel));
 
         return res == uvc::UVC_SUCCESS;
     }
-}
 
 
-/* static devices */
+    static bool create_planar_view(DeviceUVC& device);
 
-namespace camera_usb
-{
-    DeviceListUVC uvc_list;
-}
 
+    static bool is_frame_size(DeviceUVC const& device, u32 width, u32 height)
+    {
+        return width == device.config.frame_width && height == device.config.frame_height;
+    }
 
-/* api */
 
-namespace camera_usb
-{
-    CameraList enumerate_cameras()
+    // dst is any size, MJPG decodes the full frame to yuv first
+    template <class VIEW>
+    static bool resize_frame(DeviceUVC& device, uvc::frame* frame, VIEW const& dst)
     {
-        CameraList cameras;
-        cameras.status = ConnectionStatus::Connecting;
+        auto const w = device.config.frame_width;
+        auto const h = device.config.frame_height;
 
-        auto n_pixels = WIDTH_MAX * HEIGHT_MAX;
+        // downscaling averages, upscaling interpolates
+        auto mode = dst.width < w || dst.height < h ? cvt::Resample::Area : cvt::Resample::Bilinear;
 
-        uvc_list.data32 = img::create_buffer32(n_pixels, "uvc data32");
-        if (!uvc_list.data32.ok)
+        if (is_mjpeg(device))
         {
-            cameras.count = 0;
-            cameras.status = ConnectionStatus::Disconnected;
-            return cameras;
-        }
+            if (!create_planar_view(device))
+            {
+                return false;
+            }
 
-        uvc_list.data8 = img::create_buffer8(3 * n_pixels, "uvc data8");
-        if (!uvc_list.data8.ok)
+            auto& ch = device.view3.channel_data;
+            if (uvc::opt::mjpeg_decode_yuv(device.jpeg, frame, ch[0], ch[1], ch[2]) != uvc::UVC_SUCCESS)
+            {
+                return false;
+            }
+
+            cvt::yuv_to_rgba(device.view3, dst, mode, device.color_table);
+            return true;
+        }
+
+        auto span = span::make_view(frame->data, frame->data_bytes);
+
+        cvt::convert_resize(span, w, h, dst, device.config.pixel_format, mode, device.color_table);
+
+        return true;
+    }
+
+
+    static bool convert_frame(DeviceUVC& device, uvc::frame* frame, img::ImageView const& dst)
+    {
+        if (!is_frame_size(device, dst.width, dst.height))
+        {
+            return resize_frame(device, frame, dst);
+        }
+
+        if (is_mjpeg(device))
+        {
+            return decode_mjpeg_rgba(device, frame, dst.matrix_data_, dst.width, dst.height, dst.width);
+        }
+
+        auto span = span::make_view(frame->data, frame->data_bytes);
+
+        convert_frame_rgba(span, dst, device.config.pixel_format, device.color_table);
+
+        return true;
+    }
+
+
+    static bool convert_frame(DeviceUVC& device, uvc::frame* frame, img::SubView const& dst)
+    {
+        if (!is_frame_size(device, dst.width, dst.height))
+        {
+            return resize_frame(device, frame, dst);
+        }
+
+        if (is_mjpeg(device))
+        {
+            return decode_mjpeg_rgba(device, frame, img::row_begin(dst, 0), dst.width, dst.height, dst.matrix_width);
+        }
+
+        auto span = span::make_view(frame->data, frame->data_bytes);
+
+        convert_frame_rgba(span, dst, device.config.pixel_format, device.color_table);
+
+        return true;
+    }
+
+
+    static bool convert_frame(DeviceUVC& device, uvc::frame* frame, img::View3u8 const& dst)
+    {
+        if (is_mjpeg(device))
+        {
+            // raw YCbCr, no color conversion
+            auto& ch = dst.channel_data;
+            auto res = uvc::opt::mjpeg_decode_yuv(device.jpeg, frame, ch[0], ch[1], ch[2]);
+
+            return res == uvc::UVC_SUCCESS;
+        }
+
+        auto span = span::make_view(frame->data, frame->data_bytes);
+
+        cvt::to_yuv(span, device.config.frame_width, device.config.frame_height, dst, device.config.pixel_format);
+
+        return true;
+    }
+
+
+    static bool convert_frame(DeviceUVC& device, uvc::frame* frame, img::View3<u16> const& dst)
+    {
+        if (is_mjpeg(device))
+        {
+            assert(false && "MJPG is 8 bit");
+            return false;
+        }
+
+        auto span = span::make_view(frame->data, frame->data_bytes);
+
+        cvt::to_yuv(span, device.config.frame_width, device.config.frame_height, dst, device.config.pixel_format);
+
+        return true;
+    }
+
+
+    template <class VIEW>
+    static GrabResult grab_and_convert_frame_rgba(DeviceUVC& device, VIEW const& dst, i32 timeout_us)
+    {
+        GrabResult result{};
+
+        auto frame = borrow_frame(device, timeout_us, result);
+        if (!frame)
+        {  
+            return result;
+        }
+
+        if (!convert_frame(device, frame, dst))
+        {
+            result.status = GrabStatus::Error;
+        }
+        
+        return_frame(device, frame, result, 0);
+
+        return result;
+    }
+
+
+    static GrabResult grab_and_convert_frame_rgb(DeviceUVC& device, img::View3u8 const& dst, i32 timeout_us)
+    {
+        GrabResult result{};
+
+        auto frame = borrow_frame(device, timeout_us, result);
+        if (!frame)
+        {  
+            return result;
+        }
+
+        if (convert_frame(device, frame, device.view3))
+        {
+            cvt::yuv_to_rgb(device.view3, dst, device.color_table);
+        }
+        else
+        {
+            result.status = GrabStatus::Error;
+        }
+
+        return_frame(device, frame, result, 0);
+
+        return result;
+    }
+
+
+    template <typename T>
+    static GrabResult grab_and_convert_frame_yuv(DeviceUVC& device, img::View3<T> const& dst, i32 timeout_us)
+    {
+        GrabResult result{};
+
+        auto frame = borrow_frame(device, timeout_us, result);
+        if (!frame)
+        {  
+            return result;
+        }
+
+        if (!convert_frame(device, frame, dst))
+        {
+            result.status = GrabStatus::Error;
+        }
+
+        return_frame(device, frame, result, 0);
+
+        return result;
+    }
+
+
+    // converts straight into the next ring slot, dropped frames are not converted
+    static GrabResult grab_and_convert_frame_ring(DeviceUVC& device, bool_fn const& is_on, i32 timeout_us)
+    {
+        GrabResult result{};
+
+        auto frame = borrow_frame(device, timeout_us, result);
+        if (!frame)
+        {  
+            return result;
+        }
+
+        auto n_dropped = device.ring.n_dropped.load();
+
+        auto slot = ring::begin_write(device.ring, is_on);
+
+        auto consumer_dropped = (u32)(device.ring.n_dropped.load() - n_dropped);
+
+        if (!slot)
+        {
+            drop_frame(device, frame, result, consumer_dropped);
+            return result;
+        }
+
+        if (!convert_frame(device, frame, slot->view))
+        {
+            // the slot is not published, it is written again next frame
+            result.status = GrabStatus::Error;
+            drop_frame(device, frame, result, consumer_dropped);
+            return result;
+        }
+
+        slot->sequence = result.sequence;
+        slot->timestamp_ns = result.timestamp_ns;
+        slot->capture_ns = result.capture_ns;
+
+        ring::end_write(device.ring);
+
+        return_frame(device, frame, result, consumer_dropped);
+
+        return result;
+    }
+}
+
+
+/* static devices */
+
+namespace camera_usb
+{
+    DeviceListUVC uvc_list;
+}
+
+
+/* decode pool */
+
+namespace camera_usb
+{
+    class DecodeTask
+    {
+    public:
+        DeviceUVC* device = nullptr;
+        DecodeJob* job = nullptr;
+    };
+
+
+    class DecodePool
+    {
+    public:
+        std::thread workers[DECODE_WORKERS_MAX];
+        u32 n_workers = 0;
+
+        // queued jobs, oldest first
+        static constexpr u32 TASKS_MAX = DEVICE_COUNT_MAX * DECODE_JOBS_MAX;
+
+        DecodeTask tasks[TASKS_MAX];
+        u32 task_begin = 0;
+        u32 n_tasks = 0;
+
+        bool stop = false;
+
+        std::mutex mtx;
+        std::condition_variable cv_task;
+        std::condition_variable cv_free;
+
+        // workers must be joined before the pool is destroyed
+        ~DecodePool();
+    };
+
+
+    static DecodePool decode_pool;
+
+
+    static void push_task(DecodePool& pool, DecodeTask const& task)
+    {
+        assert(pool.n_tasks < DecodePool::TASKS_MAX);
+
+        pool.tasks[(pool.task_begin + pool.n_tasks) % DecodePool::TASKS_MAX] = task;
+        pool.n_tasks++;
+    }
+
+
+    static DecodeTask pop_task(DecodePool& pool)
+    {
+        auto task = pool.tasks[pool.task_begin];
+
+        pool.task_begin = (pool.task_begin + 1) % DecodePool::TASKS_MAX;
+        pool.n_tasks--;
+
+        return task;
+    }
+
+
+    // a queued job taken back before it is decoded
+    static void remove_task(DecodePool& pool, DecodeJob* job)
+    {
+        u32 n = 0;
+
+        for (u32 i = 0; i < pool.n_tasks; i++)
+        {
+            auto& task = pool.tasks[(pool.task_begin + i) % DecodePool::TASKS_MAX];
+            if (task.job != job)
+            {
+                pool.tasks[(pool.task_begin + n) % DecodePool::TASKS_MAX] = task;
+                n++;
+            }
+        }
+
+        pool.n_tasks = n;
+    }
+
+
+    // lowest index still in flight, nullptr unless it is decoded
+    static DecodeJob* next_decoded(DecodeQueue& queue)
+    {
+        DecodeJob* next = nullptr;
+
+        for (u32 i = 0; i < queue.n_jobs; i++)
+        {
+            auto& job = queue.jobs[i];
+            if (job.state != DecodeState::Free && (!next || job.index < next->index))
+            {
+                next = &job;
+            }
+        }
+
+        return next && next->state == DecodeState::Done ? next : nullptr;
+    }
+
+
+    // lock is held on entry and exit, the ring is written without it
+    // never waits on the reader, a job that finds a Block ring full stays Done for the next publish
+    static void publish_decoded(DecodePool& pool, DeviceUVC& device, std::unique_lock<std::mutex>& lock)
+    {
+        auto& queue = device.decode;
+        if (queue.publishing)
+        {
+            // the other worker picks up this job
+            return;
+        }
+
+        queue.publishing = 1;
+
+        auto const is_on = [&device](){ return device.stream_on.load(); };
+
+        while (auto job = next_decoded(queue))
+        {
+            if (job->ok && is_on() && !ring::can_write(device.ring))
+            {
+                // retried when a job finishes or the capture thread waits for one, see take_job
+                break;
+            }
+
+            lock.unlock();
+
+            if (job->ok)
+            {
+                ring::swap_write(device.ring, job->out, is_on);
+            }
+
+            lock.lock();
+
+            job->state = DecodeState::Free;
+            pool.cv_free.notify_all();
+        }
+
+        queue.publishing = 0;
+        pool.cv_free.notify_all();
+    }
+
+
+    static void run_decode_worker(DecodePool& pool)
+    {
+        // each worker reuses its own decoder state
+        auto jpeg = uvc::opt::create_jpeg_decoder();
+
+        std::unique_lock<std::mutex> lock(pool.mtx);
+
+        while (true)
+        {
+            pool.cv_task.wait(lock, [&](){ return pool.stop || pool.n_tasks; });
+            if (pool.stop)
+            {
+                break;
+            }
+
+            auto task = pop_task(pool);
+            auto& job = *task.job;
+
+            job.state = DecodeState::Decoding;
+
+            lock.unlock();
+
+            auto& ch = job.out.view.channel_data;
+            auto res = jpeg ? uvc::opt::mjpeg_decode_yuv(jpeg, &job.jpeg, ch[0], ch[1], ch[2]) : uvc::UVC_ERROR_NO_MEM;
+
+            lock.lock();
+
+            job.ok = res == uvc::UVC_SUCCESS;
+            job.state = DecodeState::Done;
+
+            publish_decoded(pool, *task.device, lock);
+        }
+
+        lock.unlock();
+
+        uvc::opt::destroy_jpeg_decoder(jpeg);
+    }
+
+
+    // lock is held, nullptr when the pool or the stream stops
+    // with OverflowPolicy::Block the capture thread waits here for the reader, not the workers
+    static DecodeJob* take_job(DecodePool& pool, DeviceUVC& device, bool_fn const& is_on, std::unique_lock<std::mutex>& lock)
+    {
+        auto& queue = device.decode;
+
+        while (!pool.stop && pool.n_workers && is_on())
+        {
+            // decoded jobs held back by a full ring, the reader does not signal when it catches up
+            publish_decoded(pool, device, lock);
+
+            if (queue.order == DecodeOrder::LatestOnly)
+            {
+                // at most one is waiting, it is stale now
+                for (u32 i = 0; i < queue.n_jobs; i++)
+                {
+                    if (queue.jobs[i].state == DecodeState::Queued)
+                    {
+                        return queue.jobs + i;
+                    }
+                }
+            }
+
+            for (u32 i = 0; i < queue.n_jobs; i++)
+            {
+                if (queue.jobs[i].state == DecodeState::Free)
+                {
+                    return queue.jobs + i;
+                }
+            }
+
+            auto const held = next_decoded(queue) != nullptr;
+            pool.cv_free.wait_for(lock, std::chrono::milliseconds(held ? 1 : 100));
+        }
+
+        return nullptr;
+    }
+
+
+    // the compressed frame is copied out so the stream gets its buffer back right away
+    static GrabResult grab_and_queue_frame_ring(DeviceUVC& device, bool_fn const& is_on, i32 timeout_us)
+    {
+        auto& pool = decode_pool;
+        auto& queue = device.decode;
+
+        GrabResult result{};
+
+        auto frame = borrow_frame(device, timeout_us, result);
+        if (!frame)
+        {  
+            return result;
+        }
+
+        std::unique_lock<std::mutex> lock(pool.mtx);
+
+        auto job = frame->data_bytes > queue.jpeg_capacity ? nullptr : take_job(pool, device, is_on, lock);
+        if (!job)
+        {
+            lock.unlock();
+
+            result.status = GrabStatus::Error;
+            drop_frame(device, frame, result, 0);
+            return result;
+        }
+
+        if (job->state == DecodeState::Queued)
+        {
+            // replaced before decoding
+            remove_task(pool, job);
+            device.ring.n_dropped++;
+        }
+
+        // claimed in capture order, the workers leave it alone until it is queued
+        job->state = DecodeState::Filling;
+        job->index = queue.next_index++;
+
+        lock.unlock();
+
+        span::copy_u8(frame->data, (u8*)job->jpeg.data, frame->data_bytes);
+
+        job->jpeg.data_bytes = frame->data_bytes;
+        job->jpeg.width = frame->width;
+        job->jpeg.height = frame->height;
+
+        job->out.sequence = result.sequence;
+        job->out.timestamp_ns = result.timestamp_ns;
+        job->out.capture_ns = result.capture_ns;
+
+        lock.lock();
+
+        if (pool.stop || !pool.n_workers)
+        {
+            job->state = DecodeState::Free;
+            pool.cv_free.notify_all();
+        }
+        else
+        {
+            job->state = DecodeState::Queued;
+
+            push_task(pool, { &device, job });
+            pool.cv_task.notify_one();
+        }
+
+        lock.unlock();
+
+        // drops by the workers show up with a later frame
+        auto ring_dropped = device.ring.n_dropped.load();
+        auto consumer_dropped = (u32)(ring_dropped - queue.ring_dropped);
+        queue.ring_dropped = ring_dropped;
+
+        return_frame(device, frame, result, consumer_dropped);
+
+        return result;
+    }
+
+
+    static void destroy_decode_queue(DeviceUVC& device)
+    {
+        auto& queue = device.decode;
+
+        mb::destroy_buffer(queue.jpeg_data);
+
+        for (u32 i = 0; i < queue.n_jobs; i++)
+        {
+            queue.jobs[i] = {};
+        }
+
+        queue.n_jobs = 0;
+    }
+
+
+    static_assert(DECODE_JOBS_MAX <= RING_SPARES_MAX);
+
+
+    // one decoding per worker, one waiting and one being filled
+    static u32 decode_job_count(DeviceUVC const& device)
+    {
+        if (!is_mjpeg(device) || !decode_pool.n_workers)
+        {
+            return 0;
+        }
+
+        return num::min(decode_pool.n_workers + 2, DECODE_JOBS_MAX);
+    }
+
+
+    // the jobs decode into the ring's spares, create the ring first
+    static bool create_decode_queue(DeviceUVC& device, DecodeOrder order)
+    {
+        destroy_decode_queue(device);
+
+        auto& queue = device.decode;
+
+        auto n_jobs = num::min(decode_job_count(device), device.ring.n_spares);
+        auto capacity = device.ctrl.dwMaxVideoFrameSize;
+
+        if (!n_jobs)
+        {
+            return false;
+        }
+
+        queue.jpeg_data = img::create_buffer8(n_jobs * capacity, "decode jpeg");
+        if (!queue.jpeg_data.ok)
+        {
+            destroy_decode_queue(device);
+            return false;
+        }
+
+        for (u32 i = 0; i < n_jobs; i++)
+        {
+            auto& job = queue.jobs[i];
+            job.jpeg.data = queue.jpeg_data.data_ + i * capacity;
+            job.out.view = device.ring.spares[i];
+        }
+
+        queue.n_jobs = n_jobs;
+        queue.jpeg_capacity = capacity;
+        queue.next_index = 0;
+        queue.order = order;
+        queue.publishing = 0;
+        queue.ring_dropped = 0;
+
+        return true;
+    }
+
+
+    // after the capture thread has stopped
+    static void drain_decode_queue(DeviceUVC& device)
+    {
+        auto& pool = decode_pool;
+        auto& queue = device.decode;
+
+        std::unique_lock<std::mutex> lock(pool.mtx);
+
+        // jobs held back by a full ring, the stream is off so they are dropped
+        publish_decoded(pool, device, lock);
+
+        pool.cv_free.wait(lock, [&]()
+        {
+            for (u32 i = 0; i < queue.n_jobs; i++)
+            {
+                if (queue.jobs[i].state != DecodeState::Free)
+                {
+                    return false;
+                }
+            }
+
+            return !queue.publishing;
+        });
+    }
+
+
+    static void stop_decode_pool(DecodePool& pool)
+    {
+        {
+            std::lock_guard<std::mutex> lock(pool.mtx);
+            pool.stop = true;
+        }
+
+        pool.cv_task.notify_all();
+
+        for (u32 i = 0; i < pool.n_workers; i++)
+        {
+            pool.workers[i].join();
+        }
+
+        std::lock_guard<std::mutex> lock(pool.mtx);
+
+        // queued jobs are never decoded, and nothing after them is published
+        pool.n_tasks = 0;
+
+        for (u32 i = 0; i < DEVICE_COUNT_MAX; i++)
+        {
+            auto& queue = uvc_list.devices[i].decode;
+            for (u32 j = 0; j < queue.n_jobs; j++)
+            {
+                queue.jobs[j].state = DecodeState::Free;
+            }
+        }
+
+        pool.n_workers = 0;
+        pool.stop = false;
+
+        pool.cv_free.notify_all();
+    }
+
+
+    DecodePool::~DecodePool()
+    {
+        stop_decode_pool(*this);
+    }
+}
+
+
+
+/* device buffers */
+
+namespace camera_usb
+{
+    static void destroy_device_buffers(DeviceUVC& device)
+    {
+        mb::destroy_buffer(device.data32);
+        mb::destroy_buffer(device.data8);
+        ring::destroy(device.ring);
+
+        uvc::opt::destroy_jpeg_decoder(device.jpeg);
+        device.jpeg = nullptr;
+
+        destroy_decode_queue(device);
+
+        device.rgba = {};
+        device.view3 = {};
+    }
+
+
+    static bool create_rgba_view(DeviceUVC& device)
+    {
+        if (device.rgba.matrix_data_)
+        {
+            return true;
+        }
+
+        auto w = device.config.frame_width;
+        auto h = device.config.frame_height;
+
+        device.data32 = img::create_buffer32(w * h, "uvc data32");
+        if (!device.data32.ok)
+        {
+            return false;
+        }
+
+        device.rgba = img::make_view(w, h, device.data32);
+
+        return device.rgba.matrix_data_ != nullptr;
+    }
+
+
+    static bool create_planar_view(DeviceUVC& device)
+    {
+        if (device.view3.channel_data[0])
+        {
+            return true;
+        }
+
+        auto w = device.config.frame_width;
+        auto h = device.config.frame_height;
+
+        device.data8 = img::create_buffer8(3 * w * h, "uvc data8");
+        if (!device.data8.ok)
+        {
+            return false;
+        }
+
+        device.view3 = convert::make_view_yuv(w, h, device.data8);
+
+        return device.view3.channel_data[2] != nullptr;
+    }
+}
+
+
+/* grab rgba */
+
+namespace camera_usb
+{
+    // rolling window from the stats, the configured fps until the first window is done
+    static void update_fps(Camera& camera, DeviceUVC const& device)
+    {
+        auto fps = stats::window_fps(device.stats);
+        if (fps > 0.0f)
+        {
+            camera.fps = num::round_to_unsigned<u32>(fps);
+        }
+    }
+
+
+    // dst is the whole image or a tile of a shared one
+    template <class VIEW>
+    static void grab_rgba(Camera& camera, VIEW const& dst)
+    {
+        camera.busy = 1;
+        auto& device = uvc_list.devices[camera.id];
+        
+        device.grab_sw.start();
+
+        if (!grab_and_convert_frame_rgba(device, dst, GRAB_TIMEOUT_US).ok())
+        {
+            img::fill(dst, img::to_pixel(0, 0, 255));
+        }
+
+        device.grab_ms = device.grab_sw.get_time_milli();
+        update_fps(camera, device);
+
+        camera.busy = 0;
+    }
+
+
+    template <class VIEW>
+    static void stream_rgba(Camera& camera, VIEW const& dst, bool_fn const& stream_condition)
+    {
+        camera.busy = 1;
+        auto& device = uvc_list.devices[camera.id];
+
+        auto c_status = camera.status;
+
+        camera.status = CameraStatus::Streaming;
+
+        while (stream_condition())
+        {
+            device.grab_sw.start();
+            if (!grab_and_convert_frame_rgba(device, dst, GRAB_TIMEOUT_US).ok())
+            {
+                img::fill(dst, img::to_pixel(0, 0, 255));
+            }
+
+            device.grab_ms = device.grab_sw.get_time_milli();
+            update_fps(camera, device);
+        }
+
+        camera.busy = 0;
+        camera.status = c_status;
+    }
+}
+
+
+/* timed grab */
+
+namespace camera_usb
+{
+    // public timeouts of 0 poll
+    static i32 to_uvc_timeout(u32 timeout_us)
+    {
+        constexpr u32 MAX = 0x7FFF'FFFF;
+
+        return timeout_us ? (i32)num::min(timeout_us, MAX) : -1;
+    }
+
+
+    template <class VIEW>
+    static GrabResult grab_rgba_timed(Camera& camera, VIEW const& dst, i32 timeout_us)
+    {
+        if (!camera.is_open())
+        {
+            return {};
+        }
+
+        auto& device = uvc_list.devices[camera.id];
+
+        return grab_and_convert_frame_rgba(device, dst, timeout_us);
+    }
+
+
+    template <typename T>
+    static GrabResult grab_yuv_timed(Camera& camera, img::View3<T> const& dst, i32 timeout_us)
+    {
+        if (!camera.is_open())
+        {
+            return {};
+        }
+
+        auto& device = uvc_list.devices[camera.id];
+
+        return grab_and_convert_frame_yuv(device, dst, timeout_us);
+    }
+}
+
+
+/* stream threads */
+
+namespace camera_usb
+{
+    static void stop_stream_thread(DeviceUVC& device)
+    {
+        device.stream_on = false;
+
+        if (device.stream_thread.joinable())
+        {
+            device.stopping = true;
+            device.stream_thread.join();
+            device.stopping = false;
+        }
+
+        drain_decode_queue(device);
+    }
+
+
+    // runs a blocking stream function on the device's own thread
+    static bool start_stream_thread(Camera& camera, stream_fn const& stream)
+    {
+        if (!camera.is_open())
+        {
+            return false;
+        }
+
+        auto& device = uvc_list.devices[camera.id];
+        if (device.stream_on)
+        {
+            return false;
+        }
+
+        stop_stream_thread(device);
+
+        device.stream_on = true;
+        device.setup.stream = stream;
+
+        auto const is_on = [&device](){ return device.stream_on.load(); };
+
+        device.stream_thread = std::thread([&camera, &device, stream, is_on]()
+        {
+            stream(camera, is_on);
+
+            // stream may end on its own, allow a restart
+            device.stream_on = false;
+        });
+
+        return true;
+    }
+}
+
+
+/* replay */
+
+namespace camera_usb
+{
+    // CAMERA_REPLAY="a.uvcr:b.uvcr" lists recordings as cameras
+    // CAMERA_REPLAY_RATE=0 replays them as fast as possible, 1 with the recorded timing
+    static void read_replay_paths(DeviceListUVC& list)
+    {
+        list.n_replay = 0;
+
+        cstr paths = getenv("CAMERA_REPLAY");
+        if (!paths)
+        {
+            return;
+        }
+
+        cstr rate = getenv("CAMERA_REPLAY_RATE");
+        list.replay_rate = rate ? (f32)atof(rate) : 1.0f;
+
+        while (*paths && list.n_replay < REPLAY_DEVICES_MAX)
+        {
+            cstr end = strchr(paths, ':');
+            u32 len = end ? (u32)(end - paths) : (u32)strlen(paths);
+
+            if (len && len < REPLAY_PATH_MAX)
+            {
+                auto dst = list.replay_paths[list.n_replay++];
+                memcpy(dst, paths, len);
+                dst[len] = 0;
+            }
+
+            paths += end ? len + 1 : len;
+        }
+    }
+
+
+    static DeviceKey replay_key(DeviceListUVC const& list, u32 index)
+    {
+        DeviceKey key{};
+
+        // above any usb bus and address
+        key.location = 0xFFFF'0000 | index;
+
+        cstr path = list.replay_paths[index];
+        cstr name = strrchr(path, '/');
+        qsnprintf(key.serial_number, 32, "%s", name ? name + 1 : path);
+
+        return key;
+    }
+}
+
+
+/* synthetic */
+
+namespace camera_usb
+{
+    // CAMERA_SYNTHETIC="16" or "NV12:1280x720@30:counter*4,MJPG:1920x1080@30", see synthetic::parse_cameras
+    // CAMERA_SYNTHETIC_JITTER_US and CAMERA_SYNTHETIC_DROP set the frame timing of all of them
+    static void read_synthetic_config(DeviceListUVC& list)
+    {
+        auto& config = list.synthetic;
+        config = {};
+
+        cstr cameras = getenv("CAMERA_SYNTHETIC");
+        cameras = cameras ? cameras : SYNTHETIC_DEFAULT;
+
+        if (!cameras || !synthetic::parse_cameras(cameras, config))
+        {
+            config.count = 0;
+            return;
+        }
+
+        cstr jitter = getenv("CAMERA_SYNTHETIC_JITTER_US");
+        config.jitter_us = jitter ? (u32)atoi(jitter) : 0;
+
+        cstr drop = getenv("CAMERA_SYNTHETIC_DROP");
+        config.drop_rate = drop ? (f32)atof(drop) : 0.0f;
+
+        for (u32 i = 0; i < config.count; i++)
+        {
+            list.synthetic_sources[i].camera = config.cameras[i];
+            list.synthetic_sources[i].unplugged = 0;
+        }
+    }
+
+
+    static DeviceKey synthetic_key(u32 index)
+    {
+        DeviceKey key{};
+
+        // below the replay locations
+        key.location = 0xFFFE'0000 | index;
+
+        qsnprintf(key.serial_number, 32, "synthetic-%u", index);
+
+        return key;
+    }
+
+
+    static void destroy_synthetic_source(SyntheticSource& source)
+    {
+        mb::destroy_buffer(source.scratch);
+
+        for (u32 i = 0; i < SYNTHETIC_JPEG_CYCLE; i++)
+        {
+            if (source.jpegs[i])
+            {
+                mem::free(source.jpegs[i]);
+                source.jpegs[i] = nullptr;
+            }
+
+            source.jpeg_bytes[i] = 0;
+        }
+    }
+
+
+    static u32 max_frame_bytes(SyntheticCamera const& cam)
+    {
+        auto bytes = synthetic::raw_frame_bytes(cam);
+
+        // noise compresses badly
+        return cam.pixel_format == cvt::PixelFormat::MJPG ? bytes * 3 / 2 : bytes;
+    }
+
+
+    static u32 encode_synthetic_jpeg(SyntheticSource& source, u64 index, u8* dst, u32 capacity)
+    {
+        auto& cam = source.camera;
+        auto slot = (u32)(index % SYNTHETIC_JPEG_CYCLE);
+
+        if (!source.jpegs[slot])
+        {
+            auto yuyv = source.scratch.data_ + synthetic::scratch_bytes(cam);
+            synthetic::draw_frame(cam, slot, source.scratch.data_, yuyv);
+
+            auto bytes = uvc::opt::mjpeg_encode_yuyv(yuyv, cam.width, cam.height, dst, capacity, SYNTHETIC_JPEG_QUALITY);
+            if (!bytes)
+            {
+                return 0;
+            }
+
+            source.jpegs[slot] = mem::malloc<u8>(bytes, "synthetic jpeg");
+            if (!source.jpegs[slot])
+            {
+                return 0;
+            }
+
+            memcpy(source.jpegs[slot], dst, bytes);
+            source.jpeg_bytes[slot] = bytes;
+
+            return bytes;
+        }
+
+        auto bytes = source.jpeg_bytes[slot];
+        if (bytes > capacity)
+        {
+            return 0;
+        }
+
+        memcpy(dst, source.jpegs[slot], bytes);
+
+        return bytes;
+    }
+
+
+    // one bulk payload per frame, drawn straight into the stream's payload buffer
+    static u32 next_synthetic_payload(void* user, u8* dst, u32 capacity, u64* due_ns)
+    {
+        constexpr u32 HEADER_BYTES = payload::HEADER_BYTES;
+
+        auto& source = *(SyntheticSource*)user;
+        auto& cam = source.camera;
+
+        if (capacity <= HEADER_BYTES)
+        {
+            return 0;
+        }
+
+        auto index = synthetic::next_frame(source.clock, *due_ns);
+
+        u32 bytes = 0;
+
+        if (cam.pixel_format == cvt::PixelFormat::MJPG)
+        {
+            bytes = encode_synthetic_jpeg(source, index, dst + HEADER_BYTES, capacity - HEADER_BYTES);
+        }
+        else if (synthetic::raw_frame_bytes(cam) <= capacity - HEADER_BYTES)
+        {
+            bytes = synthetic::raw_frame_bytes(cam);
+            synthetic::draw_frame(cam, index, source.scratch.data_, dst + HEADER_BYTES);
+        }
+
+        if (!bytes)
+        {
+            return 0;
+        }
+
+        // presentation at the ideal frame time, source clock and usb frame number when sent
+        auto pts = (u32)(index * SYNTHETIC_CLOCK_HZ / cam.fps);
+        auto scr = (u32)(*due_ns * (SYNTHETIC_CLOCK_HZ / 1'000'000) / 1000);
+        auto sof = (u32)(*due_ns / 1'000'000);
+
+        payload::write_header(dst, source.fid, true, pts, scr, sof);
+
+        source.fid ^= 1;
+
+        return HEADER_BYTES + bytes;
+    }
+
+
+    // each open starts the camera's frames over, seeded by its slot so runs repeat
+    static bool open_synthetic(SyntheticSource& source, uvc::device_handle** h_device)
+    {
+        auto& list = uvc_list;
+        auto& cam = source.camera;
+
+        if (!source.scratch.ok)
+        {
+            auto bytes = synthetic::scratch_bytes(cam);
+            if (cam.pixel_format == cvt::PixelFormat::MJPG)
+            {
+                bytes += synthetic::raw_frame_bytes(cam);
+            }
+
+            source.scratch = img::create_buffer8(bytes, "synthetic scratch");
+            if (!source.scratch.ok)
+            {
+                return false;
+            }
+        }
+
+        auto index = (u32)(&source - list.synthetic_sources);
+
+        synthetic::start_clock(source.clock, list.synthetic, cam, index + 1);
+        source.fid = 0;
+
+        uvc::opt::PayloadSource payloads{};
+        payloads.four_cc_bytes = (u32)cam.pixel_format;
+        payloads.bits_per_pixel = (u8)modes::bits_per_pixel(cam.pixel_format);
+        payloads.width = cam.width;
+        payloads.height = cam.height;
+        payloads.interval = 10'000'000 / cam.fps;
+        payloads.max_frame_bytes = max_frame_bytes(cam);
+        payloads.max_payload_bytes = payload::HEADER_BYTES + payloads.max_frame_bytes;
+        payloads.next = next_synthetic_payload;
+        payloads.user = &source;
+
+        return uvc::opt::open_payload_source(payloads, h_device) == uvc::UVC_SUCCESS;
+    }
+}
+
+
+/* hotplug */
+
+namespace camera_usb
+{
+    static void on_hotplug(void* user)
+    {
+        auto& list = *(DeviceListUVC*)user;
+        list.changed = true;
+    }
+
+
+    static bool read_device_key(uvc::device* p_device, DeviceTable const& table, DeviceKey& key)
+    {
+        key = {};
+        key.location = (u32)uvc::uvc_get_bus_number(p_device) << 8 | uvc::uvc_get_device_address(p_device);
+
+        if (!uvc::opt::get_device_ids(p_device, key.vendor_id, key.product_id))
+        {
+            return false;
+        }
+
+        // reading the serial number opens the device
+        auto known = hotplug::find_connected(table, key);
+        if (known)
+        {
+            key = known->key;
+            return true;
+        }
+
+        uvc::device_descriptor* desc;
+
+        auto res = uvc::uvc_get_device_descriptor(p_device, &desc);
+        if (res != uvc::UVC_SUCCESS)
+        {
+            return false;
+        }
+
+        if (desc->serialNumber)
+        {
+            qsnprintf(key.serial_number, 32, "%s", desc->serialNumber);
+        }
+
+        uvc::uvc_free_device_descriptor(desc);
+
+        return true;
+    }
+
+
+    // stop using the device but keep its setup and buffers, a reader may still hold a ring frame
+    static void release_device(DeviceUVC& device)
+    {
+        stop_stream_thread(device);
+        close_stream(device);
+        close_device(device);
+
+        if (device.p_device)
+        {
+            uvc::uvc_unref_device(device.p_device);
+            device.p_device = nullptr;
+        }
+    }
+
+
+    static void take_device(DeviceUVC& device, uvc::device* p_device)
+    {
+        uvc::uvc_ref_device(p_device);
+        device.p_device = p_device;
+    }
+
+
+    // reopen and restart the stream as they were before the device left
+    static bool restore_device(Camera& camera, DeviceUVC& device)
+    {
+        auto& setup = device.setup;
+
+        setup.pending = 0;
+
+        if (!setup.open)
         {
-            mb::destroy_buffer(uvc_list.data32);
-            cameras.count = 0;
-            cameras.status = ConnectionStatus::Disconnected;
-            return cameras;
+            return true;
         }
 
-        if (!enumerate_devices(uvc_list))
+        // open_camera overwrites the setup
+        auto saved = setup;
+
+        if (!open_camera(camera, saved.request))
         {
-            mb::destroy_buffer(uvc_list.data32);
-            mb::destroy_buffer(uvc_list.data8);
-            cameras.count = 0;
-            cameras.status = ConnectionStatus::Disconnected;
-            return cameras;
+            setup = saved;
+            setup.pending = 1;
+            return false;
         }
 
-        cameras.count = uvc_list.count;
-        for (u32 i = 0; i < cameras.count; i++)
+        if (saved.has_color_space)
         {
-            auto& camera = cameras.list[i];
-            auto& device = uvc_list.devices[i];
+            set_color_space(camera, saved.matrix, saved.range);
+        }
+
+        if (saved.ring)
+        {
+            return start_stream_ring(camera, saved.ring_capacity, saved.ring_policy, saved.ring_order);
+        }
+
+        if (saved.stream)
+        {
+            return start_stream_thread(camera, saved.stream);
+        }
+
+        return true;
+    }
+
+
+    // hotplug::rescan backend on libuvc
+    class ScanUVC
+    {
+    public:
+        DeviceListUVC& list;
+        CameraList& cameras;
+
+        // the scan list is indexed by scan position, skipped devices leave gaps
+        uvc::device* scanned[HOTPLUG_SCAN_MAX] = { 0 };
+        cstr replayed[HOTPLUG_SCAN_MAX] = { 0 };
+        SyntheticSource* synthesized[HOTPLUG_SCAN_MAX] = { 0 };
+
+
+        u32 scan_replay(DeviceKey* dst, u32 n, u32 capacity)
+        {
+            for (u32 i = 0; i < list.n_replay && n < capacity; i++)
+            {
+                dst[n] = replay_key(list, i);
+                replayed[n++] = list.replay_paths[i];
+            }
+
+            return n;
+        }
+
+
+        u32 scan_synthetic(DeviceKey* dst, u32 capacity)
+        {
+            u32 n = 0;
+            for (u32 i = 0; i < list.synthetic.count && n < capacity; i++)
+            {
+                if (list.synthetic_sources[i].unplugged)
+                {
+                    continue;
+                }
+
+                dst[n] = synthetic_key(i);
+                synthesized[n++] = list.synthetic_sources + i;
+            }
+
+            return n;
+        }
+
+
+        u32 scan(DeviceKey* dst, u32 capacity)
+        {
+            if (list.synthetic.count)
+            {
+                return scan_replay(dst, scan_synthetic(dst, capacity), capacity);
+            }
+
+            auto res = uvc::uvc_get_device_list(list.context, &list.device_list);
+            if (res != uvc::UVC_SUCCESS)
+            {
+                list.device_list = nullptr;
+
+                // nothing changes when the bus can't be read
+                u32 n = 0;
+                for (u32 i = 0; i < list.table.count && n < capacity; i++)
+                {
+                    auto& slot = list.table.slots[i];
+                    if (slot.present)
+                    {
+                        dst[n++] = slot.key;
+                    }
+                }
+
+                return n;
+            }
+
+            u32 n = 0;
+            for (u32 i = 0; list.device_list[i] && n < capacity; i++)
+            {
+                if (read_device_key(list.device_list[i], list.table, dst[n]))
+                {
+                    scanned[n++] = list.device_list[i];
+                }
+            }
+
+            return scan_replay(dst, n, capacity);
+        }
+
+
+        void remove(u32 slot)
+        {
+            release_device(list.devices[slot]);
+
+            auto& camera = cameras.list[slot];
+            camera.status = CameraStatus::Inactive;
+            camera.busy = 0;
+        }
+
+
+        void add(u32 slot, u32 scan_index)
+        {
+            auto& device = list.devices[slot];
+            auto& camera = cameras.list[slot];
+
+            device.device_id = (int)slot;
+            take_scanned(device, scan_index);
+            set_device_properties(device, list.table.slots[slot].key);
 
             camera.id = device.device_id;
             camera.status = CameraStatus::Active;
@@ -591,6 +2095,167 @@ namespace camera_usb
             camera.label = span::to_string_view(device.label);
 
             camera.format = span::to_string_view("XXXX");
+
+            list.count = list.table.count;
+            cameras.count = list.table.count;
+        }
+
+
+        void reconnect(u32 slot, u32 scan_index)
+        {
+            auto& device = list.devices[slot];
+            auto& camera = cameras.list[slot];
+
+            release_device(device);
+            take_scanned(device, scan_index);
+
+            camera.status = CameraStatus::Active;
+
+            restore_device(camera, device);
+        }
+
+
+        void take_scanned(DeviceUVC& device, u32 scan_index)
+        {
+            device.replay_path = replayed[scan_index];
+            device.replay_rate = list.replay_rate;
+            device.synthetic = synthesized[scan_index];
+
+            if (scanned[scan_index])
+            {
+                take_device(device, scanned[scan_index]);
+            }
+        }
+
+
+        void end_scan()
+        {
+            if (list.device_list)
+            {
+                // devices that were taken hold their own reference
+                uvc::uvc_free_device_list(list.device_list, 1);
+                list.device_list = nullptr;
+            }
+        }
+    };
+
+
+    static bool has_present_device(DeviceListUVC const& list)
+    {
+        for (u32 i = 0; i < list.table.count; i++)
+        {
+            if (list.table.slots[i].present)
+            {
+                return true;
+            }
+        }
+
+        return false;
+    }
+
+
+    static void retry_pending(DeviceListUVC& list, CameraList& cameras)
+    {
+        for (u32 i = 0; i < list.table.count; i++)
+        {
+            auto& device = list.devices[i];
+            if (list.table.slots[i].present && device.setup.pending)
+            {
+                restore_device(cameras.list[i], device);
+            }
+        }
+    }
+}
+
+
+/* enumerate */
+
+namespace camera_usb
+{
+    static bool enumerate_devices(DeviceListUVC& list, CameraList& cameras)
+    {
+        if (!list.context)
+        {
+            auto res = uvc::uvc_init(&list.context, NULL);
+            if (res != uvc::UVC_SUCCESS)
+            {
+                //print_uvc_error(res, "uvc_init");
+                uvc::uvc_exit(list.context);
+                list.context = nullptr;
+                return false;
+            }
+
+            read_replay_paths(list);
+            read_synthetic_config(list);
+
+            // synthetic cameras are the only cameras
+            if (!list.synthetic.count)
+            {
+                list.hotplug_handle = uvc::opt::register_hotplug(list.context, on_hotplug, &list);
+            }
+        }
+
+        // the context stays up without devices so update_cameras can find them later
+        ScanUVC backend{ list, cameras };
+        hotplug::rescan(list.table, backend);
+
+        list.changed = false;
+        list.last_poll_ns = stats::steady_ns();
+
+        if (list.count)
+        {
+            print_device_permissions_msg(list);
+        }
+
+        return has_present_device(list);
+    }
+
+
+    static void close_devices(DeviceListUVC& list)
+    {
+        for (u32 i = 0; i < list.count; ++i)
+        {
+            auto& device = list.devices[i];
+            release_device(device);
+            device.setup = {};
+        }
+
+        list.table = {};
+        list.count = 0;
+
+        for (u32 i = 0; i < list.synthetic.count; i++)
+        {
+            destroy_synthetic_source(list.synthetic_sources[i]);
+        }
+
+        if (list.context)
+        {
+            if (list.hotplug_handle >= 0)
+            {
+                uvc::opt::deregister_hotplug(list.context, list.hotplug_handle);
+                list.hotplug_handle = -1;
+            }
+
+            uvc::uvc_exit(list.context);
+            list.context = nullptr;
+        }
+    }
+}
+
+
+/* api */
+
+namespace camera_usb
+{
+    CameraList enumerate_cameras()
+    {
+        CameraList cameras;
+        cameras.status = ConnectionStatus::Connecting;
+
+        if (!enumerate_devices(uvc_list, cameras))
+        {
+            cameras.status = ConnectionStatus::Disconnected;
+            return cameras;
         }
 
         cameras.status = ConnectionStatus::Connected;
@@ -601,8 +2266,14 @@ namespace camera_usb
 
     void close(CameraList& cameras)
     {
-        mb::destroy_buffer(uvc_list.data32);
-        mb::destroy_buffer(uvc_list.data8);
+        for (u32 i = 0; i < uvc_list.count; i++)
+        {
+            auto& device = uvc_list.devices[i];
+
+            stop_stream_thread(device);
+            destroy_device_buffers(device);
+        }
+
         close_devices(uvc_list);
 
         for (u32 i = 0; i < cameras.count; i++)
@@ -612,16 +2283,147 @@ namespace camera_usb
             camera.status = CameraStatus::Inactive;
         }
     }
+
+
+    bool update_cameras(CameraList& cameras)
+    {
+        auto& list = uvc_list;
+        if (!list.context)
+        {
+            return false;
+        }
+
+        if (list.hotplug_handle >= 0)
+        {
+            uvc::opt::handle_events_nowait(list.context);
+        }
+
+        auto now_ns = stats::steady_ns();
+        auto poll = now_ns - list.last_poll_ns >= (u64)HOTPLUG_POLL_MS * 1'000'000;
+
+        // without hotplug events every poll is a rescan
+        auto changed = list.changed.exchange(false) || (poll && list.hotplug_handle < 0);
+
+        u32 n_changed = 0;
+
+        if (changed)
+        {
+            ScanUVC backend{ list, cameras };
+            n_changed = hotplug::rescan(list.table, backend);
+        }
+
+        if (poll)
+        {
+            list.last_poll_ns = now_ns;
+            retry_pending(list, cameras);
+        }
+
+        cameras.status = has_present_device(list) ? ConnectionStatus::Connected : ConnectionStatus::Disconnected;
+
+        return n_changed > 0;
+    }
+
+
+    bool is_new_camera(Camera const& camera)
+    {
+        auto& table = uvc_list.table;
+        if (camera.id < 0 || (u32)camera.id >= table.count)
+        {
+            return false;
+        }
+
+        return table.slots[camera.id].event == SlotEvent::Added;
+    }
+
+
+    bool plug_synthetic_camera(u32 index, bool plugged)
+    {
+        auto& list = uvc_list;
+        if (!list.context || index >= list.synthetic.count)
+        {
+            return false;
+        }
+
+        list.synthetic_sources[index].unplugged = !plugged;
+        list.changed = true;
+
+        return true;
+    }
   
     
     bool open_camera(Camera& camera)
     {
+        // 640 x 480 at the fastest rate
+        return open_camera(camera, ModeRequest{});
+    }
+
+
+    CameraModeList enumerate_modes(Camera const& camera)
+    {
+        CameraModeList modes;
+
+        if (camera.id < 0)
+        {
+            return modes;
+        }
+
+        auto& device = uvc_list.devices[camera.id];
+
+        // open just long enough to read the descriptors
+        auto is_open = device.h_device != nullptr;
+        if (!is_open && !open_device(device))
+        {
+            return modes;
+        }
+
+        read_device_modes(device, modes);
+
+        if (!is_open)
+        {
+            close_device(device);
+        }
+
+        return modes;
+    }
+
+
+    // the stream and device are closed, the camera is left Active
+    static bool fail_open_camera(Camera& camera, DeviceUVC& device)
+    {
+        close_stream(device);
+        close_device(device);
+
+        camera.status = CameraStatus::Active;
+        camera.busy = 0;
+
+        return false;
+    }
+
+
+    bool open_camera(Camera& camera, ModeRequest const& request)
+    {
+        if (camera.id < 0 || camera.status == CameraStatus::Inactive)
+        {
+            return false;
+        }
+
+        auto& device = uvc_list.devices[camera.id];
+
+        // opening again changes the mode, the running stream and its buffers go first
+        if (camera.is_open() || device.h_device)
+        {
+            stop_stream_thread(device);
+            close_stream(device);
+            close_device(device);
+
+            camera.status = CameraStatus::Active;
+        }
+
         camera.busy = 1;
 
-        auto& device = uvc_list.devices[camera.id];
-        if (!open_device_stream(device))
-        {        
-            camera.busy = 0;    
+        if (!open_device_stream(device, request))
+        {
+            camera.busy = 0;
             return false;
         }
         
@@ -633,75 +2435,126 @@ namespace camera_usb
 
         if (!start_device_stream(device))
         {
-            camera.busy = 0;
-            return false;
+            return fail_open_camera(camera, device);
         }
 
-        // only one at a time
-        auto& buffer32 = uvc_list.data32;
-        auto& buffer8 = uvc_list.data8;
-        auto w = camera.frame_width;
-        auto h = camera.frame_height;
-        mb::reset_buffer(buffer32);
-        mb::reset_buffer(buffer8);
-        device.rgba = img::make_view(w, h, buffer32);
-        device.view3 = convert::make_view_yuv(w, h, buffer8);
+        device.frame_count = 0;
+        device.last_bytes_received = 0;
+        stats::reset(device.stats);
+        clocks::reset(device.clock);
+
+        // rgba and planar views are created on first use, see stream_camera
+        destroy_device_buffers(device);
+
+        // uvc default, see set_color_space
+        device.color_table = cvt::make_color_table(cvt::ColorMatrix::BT601, cvt::ColorRange::Limited);
 
-        if (!buffer32.ok || !buffer8.ok)
+        if (is_mjpeg(device))
         {
-            camera.busy = 0;
-            return false;
+            // JFIF is full range
+            device.color_table = cvt::make_color_table(cvt::ColorMatrix::BT601, cvt::ColorRange::Full);
+
+            device.jpeg = uvc::opt::create_jpeg_decoder();
+            if (!device.jpeg)
+            {
+                return fail_open_camera(camera, device);
+            }
+
+            uvc::opt::set_jpeg_threads(device.jpeg, device.jpeg_threads);
         }
 
         camera.status = CameraStatus::Open;
         camera.busy = 0;
 
+        device.setup = {};
+        device.setup.open = 1;
+        device.setup.request = request;
+
         return true;
     }
 
 
-    void grab_image(Camera& camera, img::ImageView const& dst)
+    void set_color_space(Camera& camera, convert::ColorMatrix matrix, convert::ColorRange range)
     {
-        camera.busy = 1;
         auto& device = uvc_list.devices[camera.id];
-        
-        device.grab_sw.start();
+        device.color_table = cvt::make_color_table(matrix, range);
 
-        if (!grab_and_convert_frame_rgba(device, dst))
-        {
-            img::fill(dst, img::to_pixel(0, 0, 255));
-        }
+        device.setup.has_color_space = 1;
+        device.setup.matrix = matrix;
+        device.setup.range = range;
+    }
 
-        device.grab_ms = device.grab_sw.get_time_milli();
-        camera.fps = num::round_to_unsigned<u32>(1000.0 / device.grab_ms);
 
-        camera.busy = 0;
+    convert::ColorTable const& get_color_table(Camera const& camera)
+    {
+        return uvc_list.devices[camera.id].color_table;
     }
 
 
-    void stream_camera(Camera& camera, img::ImageView const& dst, bool_fn const& stream_condition)
+    bool start_recording(Camera& camera, cstr path)
     {
-        camera.busy = 1;
+        if (!camera.is_open())
+        {
+            return false;
+        }
+
         auto& device = uvc_list.devices[camera.id];
+        if (!device.h_stream)
+        {
+            return false;
+        }
 
-        auto c_status = camera.status;
+        return uvc::opt::start_recording(device.h_stream, path);
+    }
 
-        camera.status = CameraStatus::Streaming;
 
-        while (stream_condition())
+    u64 stop_recording(Camera& camera)
+    {
+        if (camera.id < 0)
         {
-            device.grab_sw.start();
-            if (!grab_and_convert_frame_rgba(device, dst))
-            {
-                img::fill(dst, img::to_pixel(0, 0, 255));
-            }
+            return 0;
+        }
 
-            device.grab_ms = device.grab_sw.get_time_milli();
-            camera.fps = num::round_to_unsigned<u32>(1000.0 / device.grab_ms);
+        auto& device = uvc_list.devices[camera.id];
+        if (!device.h_stream)
+        {
+            return 0;
         }
 
-        camera.busy = 0;
-        camera.status = c_status;
+        return uvc::opt::stop_recording(device.h_stream);
+    }
+
+
+    void set_decode_threads(Camera& camera, u32 n_threads)
+    {
+        auto& device = uvc_list.devices[camera.id];
+
+        device.jpeg_threads = n_threads;
+        uvc::opt::set_jpeg_threads(device.jpeg, n_threads);
+    }
+
+
+    void grab_image(Camera& camera, img::ImageView const& dst)
+    {
+        grab_rgba(camera, dst);
+    }
+
+
+    void grab_image(Camera& camera, img::SubView const& dst)
+    {
+        grab_rgba(camera, dst);
+    }
+
+
+    void stream_camera(Camera& camera, img::ImageView const& dst, bool_fn const& stream_condition)
+    {
+        stream_rgba(camera, dst, stream_condition);
+    }
+
+
+    void stream_camera(Camera& camera, img::SubView const& dst, bool_fn const& stream_condition)
+    {
+        stream_rgba(camera, dst, stream_condition);
     }
 
 
@@ -710,6 +2563,13 @@ namespace camera_usb
         camera.busy = 1;
         auto& device = uvc_list.devices[camera.id];
 
+        // only this path converts into device.rgba
+        if (!create_rgba_view(device))
+        {
+            camera.busy = 0;
+            return;
+        }
+
         auto c_status = camera.status;
 
         camera.status = CameraStatus::Streaming;
@@ -717,13 +2577,13 @@ namespace camera_usb
         while (stream_condition())
         {
             device.grab_sw.start();
-            if (grab_and_convert_frame_rgba(device, device.rgba))
+            if (grab_and_convert_frame_rgba(device, device.rgba, GRAB_TIMEOUT_US).ok())
             {
                 on_grab(device.rgba);
             }
 
             device.grab_ms = device.grab_sw.get_time_milli();
-            camera.fps = num::round_to_unsigned<u32>(1000.0 / device.grab_ms);
+            update_fps(camera, device);
         }
 
         camera.busy = 0;
@@ -735,16 +2595,22 @@ namespace camera_usb
     {
         camera.busy = 1;
         auto& device = uvc_list.devices[camera.id];
+
+        if (!create_planar_view(device))
+        {
+            camera.busy = 0;
+            return;
+        }
         
         device.grab_sw.start();
 
-        if (!grab_and_convert_frame_rgb(device, dst))
+        if (!grab_and_convert_frame_rgb(device, dst, GRAB_TIMEOUT_US).ok())
         {
             
         }
 
         device.grab_ms = device.grab_sw.get_time_milli();
-        camera.fps = num::round_to_unsigned<u32>(1000.0 / device.grab_ms);
+        update_fps(camera, device);
 
         camera.busy = 0;
     }
@@ -757,23 +2623,96 @@ namespace camera_usb
         
         device.grab_sw.start();
 
-        if (!grab_and_convert_frame_yuv(device, dst))
+        if (!grab_and_convert_frame_yuv(device, dst, GRAB_TIMEOUT_US).ok())
+        {
+            
+        }
+
+        device.grab_ms = device.grab_sw.get_time_milli();
+        update_fps(camera, device);
+
+        camera.busy = 0;
+    }
+
+
+    void grab_planar_yuv(Camera& camera, img::View3<u16> const& dst)
+    {
+        camera.busy = 1;
+        auto& device = uvc_list.devices[camera.id];
+        
+        device.grab_sw.start();
+
+        if (!grab_and_convert_frame_yuv(device, dst, GRAB_TIMEOUT_US).ok())
         {
             
         }
 
         device.grab_ms = device.grab_sw.get_time_milli();
-        camera.fps = num::round_to_unsigned<u32>(1000.0 / device.grab_ms);
+        update_fps(camera, device);
 
         camera.busy = 0;
     }
 
 
+    GrabResult grab_image(Camera& camera, img::ImageView const& dst, u32 timeout_us)
+    {
+        return grab_rgba_timed(camera, dst, to_uvc_timeout(timeout_us));
+    }
+
+
+    GrabResult grab_image(Camera& camera, img::SubView const& dst, u32 timeout_us)
+    {
+        return grab_rgba_timed(camera, dst, to_uvc_timeout(timeout_us));
+    }
+
+
+    GrabResult grab_planar_yuv(Camera& camera, img::View3u8 const& dst, u32 timeout_us)
+    {
+        return grab_yuv_timed(camera, dst, to_uvc_timeout(timeout_us));
+    }
+
+
+    GrabResult grab_planar_yuv(Camera& camera, img::View3<u16> const& dst, u32 timeout_us)
+    {
+        return grab_yuv_timed(camera, dst, to_uvc_timeout(timeout_us));
+    }
+
+
+    GrabResult try_grab_image(Camera& camera, img::ImageView const& dst)
+    {
+        return grab_rgba_timed(camera, dst, -1);
+    }
+
+
+    GrabResult try_grab_image(Camera& camera, img::SubView const& dst)
+    {
+        return grab_rgba_timed(camera, dst, -1);
+    }
+
+
+    GrabResult try_grab_planar_yuv(Camera& camera, img::View3u8 const& dst)
+    {
+        return grab_yuv_timed(camera, dst, -1);
+    }
+
+
+    GrabResult try_grab_planar_yuv(Camera& camera, img::View3<u16> const& dst)
+    {
+        return grab_yuv_timed(camera, dst, -1);
+    }
+
+
     void stream_planar_rgb(Camera& camera, planar_cb const& proc, bool_fn const& stream_condition)
     {
         camera.busy = 1;
         auto& device = uvc_list.devices[camera.id];
 
+        if (!create_planar_view(device))
+        {
+            camera.busy = 0;
+            return;
+        }
+
         auto c_status = camera.status;
 
         camera.status = CameraStatus::Streaming;
@@ -781,13 +2720,13 @@ namespace camera_usb
         while (stream_condition())
         {
             device.grab_sw.start();
-            if (grab_and_convert_frame_rgb(device, device.view3))
+            if (grab_and_convert_frame_rgb(device, device.view3, GRAB_TIMEOUT_US).ok())
             {
                 proc(device.view3);
             }
 
             device.grab_ms = device.grab_sw.get_time_milli();
-            camera.fps = num::round_to_unsigned<u32>(1000.0 / device.grab_ms);
+            update_fps(camera, device);
         }
 
         camera.busy = 0;
@@ -800,6 +2739,12 @@ namespace camera_usb
         camera.busy = 1;
         auto& device = uvc_list.devices[camera.id];
 
+        if (!create_planar_view(device))
+        {
+            camera.busy = 0;
+            return;
+        }
+
         auto c_status = camera.status;
 
         camera.status = CameraStatus::Streaming;
@@ -807,18 +2752,195 @@ namespace camera_usb
         while (stream_condition())
         {
             device.grab_sw.start();
-            if (grab_and_convert_frame_yuv(device, device.view3))
+            if (grab_and_convert_frame_yuv(device, device.view3, GRAB_TIMEOUT_US).ok())
             {
                 proc(device.view3);
             }
 
             device.grab_ms = device.grab_sw.get_time_milli();
-            camera.fps = num::round_to_unsigned<u32>(1000.0 / device.grab_ms);
+            update_fps(camera, device);
         }
 
         camera.busy = 0;
         camera.status = c_status;
     }
+
+
+    bool start_stream(Camera& camera, grab_cb const& on_grab)
+    {
+        return start_stream_thread(camera, [on_grab](Camera& c, bool_fn const& is_on){ stream_camera(c, on_grab, is_on); });
+    }
+
+
+    bool start_stream_planar_rgb(Camera& camera, planar_cb const& proc)
+    {
+        return start_stream_thread(camera, [proc](Camera& c, bool_fn const& is_on){ stream_planar_rgb(c, proc, is_on); });
+    }
+
+
+    bool start_stream_planar_yuv(Camera& camera, planar_cb const& proc)
+    {
+        return start_stream_thread(camera, [proc](Camera& c, bool_fn const& is_on){ stream_planar_yuv(c, proc, is_on); });
+    }
+
+
+    void stop_stream(Camera& camera)
+    {
+        auto& device = uvc_list.devices[camera.id];
+
+        stop_stream_thread(device);
+
+        device.setup.stream = nullptr;
+        device.setup.ring = 0;
+    }
+
+
+    bool start_stream_ring(Camera& camera, u32 capacity, OverflowPolicy policy)
+    {
+        return start_stream_ring(camera, capacity, policy, DecodeOrder::InOrder);
+    }
+
+
+    bool start_stream_ring(Camera& camera, u32 capacity, OverflowPolicy policy, DecodeOrder order)
+    {
+        if (!camera.is_open())
+        {
+            return false;
+        }
+
+        auto& device = uvc_list.devices[camera.id];
+        if (device.stream_on)
+        {
+            return false;
+        }
+
+        auto w = device.config.frame_width;
+        auto h = device.config.frame_height;
+
+        destroy_decode_queue(device);
+
+        auto n_jobs = decode_job_count(device);
+
+        if (!ring::create(device.ring, capacity, w, h, policy, n_jobs))
+        {
+            return false;
+        }
+
+        if (n_jobs && !create_decode_queue(device, order))
+        {
+            return false;
+        }
+
+        auto const stream = [](Camera& c, bool_fn const& is_on)
+        {
+            auto& device = uvc_list.devices[c.id];
+
+            auto c_status = c.status;
+
+            c.busy = 1;
+            c.status = CameraStatus::Streaming;
+
+            while (is_on())
+            {
+                device.grab_sw.start();
+
+                if (device.decode.n_jobs)
+                {
+                    grab_and_queue_frame_ring(device, is_on, GRAB_TIMEOUT_US);
+                }
+                else
+                {
+                    grab_and_convert_frame_ring(device, is_on, GRAB_TIMEOUT_US);
+                }
+
+                device.grab_ms = device.grab_sw.get_time_milli();
+                update_fps(c, device);
+            }
+
+            c.busy = 0;
+            c.status = c_status;
+        };
+
+        if (!start_stream_thread(camera, stream))
+        {
+            return false;
+        }
+
+        auto& setup = device.setup;
+        setup.ring = 1;
+        setup.ring_capacity = capacity;
+        setup.ring_policy = policy;
+        setup.ring_order = order;
+
+        return true;
+    }
+
+
+    bool read_frame(Camera& camera, FrameYUV& frame)
+    {
+        auto slot = ring::read(uvc_list.devices[camera.id].ring, false);
+        if (!slot)
+        {
+            return false;
+        }
+
+        frame = *slot;
+
+        return true;
+    }
+
+
+    bool read_latest_frame(Camera& camera, FrameYUV& frame)
+    {
+        auto slot = ring::read(uvc_list.devices[camera.id].ring, true);
+        if (!slot)
+        {
+            return false;
+        }
+
+        frame = *slot;
+
+        return true;
+    }
+
+
+    void release_frame(Camera& camera)
+    {
+        ring::release(uvc_list.devices[camera.id].ring);
+    }
+
+
+    CameraStats get_stats(Camera const& camera)
+    {
+        return stats::read(uvc_list.devices[camera.id].stats.snapshot);
+    }
+
+
+    bool create_decode_pool(u32 n_workers)
+    {
+        auto& pool = decode_pool;
+
+        stop_decode_pool(pool);
+
+        n_workers = num::min(n_workers, DECODE_WORKERS_MAX);
+
+        std::lock_guard<std::mutex> lock(pool.mtx);
+
+        for (u32 i = 0; i < n_workers; i++)
+        {
+            pool.workers[i] = std::thread([&pool](){ run_decode_worker(pool); });
+        }
+
+        pool.n_workers = n_workers;
+
+        return n_workers > 0;
+    }
+
+
+    void destroy_decode_pool()
+    {
+        stop_decode_pool(decode_pool);
+    }
 }
 
 #define LIBUVC_IMPLEMENTATION
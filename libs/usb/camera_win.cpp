@@ -6,9 +6,16 @@
 
 #include "camera_usb.hpp"
 #include "../image/convert.hpp"
+#include "../qsprintf/qsprintf.hpp"
 #include "../util/numeric.hpp"
 #include "../util/stopwatch.hpp"
 
+#include <atomic>
+#include <thread>
+
+#include <cstdlib>
+#include <cstring>
+
 #ifndef NOMINMAX
 #define NOMINMAX
 #endif
@@ -16,6 +23,7 @@
 #include <Windows.h>
 #include <mfapi.h>
 #include <mfidl.h>
+#include <mferror.h>
 #include <Mfreadwrite.h>
 #include <Shlwapi.h>
 
@@ -46,6 +54,9 @@ namespace w32
         DWORD size_bytes = 0;
 
         bool is_locked = false;
+
+        // the device is gone, see update_cameras
+        bool device_lost = false;
     };
 
 
@@ -63,6 +74,19 @@ namespace w32
     };
 
 
+    class NativeType
+    {
+    public:
+        UINT32 width = 0;
+        UINT32 height = 0;
+
+        // 100ns units
+        UINT32 interval = 0;
+
+        UINT32 four_cc_bytes = 0;
+    };
+
+
     template <typename T>
     class DataResult
     {
@@ -113,8 +137,15 @@ namespace w32
             &frame.timestamp, 
             &sample);
 
-        if (FAILED(hr))
+        if (FAILED(hr) || (frame.flags & MF_SOURCE_READERF_ERROR))
+        {
+            frame.device_lost = hr == MF_E_VIDEO_RECORDING_DEVICE_INVALIDATED || (frame.flags & MF_SOURCE_READERF_ERROR);
+            return result;
+        }
+
+        if (!sample)
         {
+            // a stream tick has no sample
             return result;
         }
 
@@ -214,6 +245,73 @@ namespace w32
     }
         
 
+    // video capture devices connected now, release each one and CoTaskMemFree the list
+    static bool enum_devices(Device_p*& list, UINT32& count)
+    {
+        list = nullptr;
+        count = 0;
+
+        IMFAttributes* p_attr = nullptr;
+
+        HRESULT hr = MFCreateAttributes(&p_attr, 1);
+        if (FAILED(hr))
+        {
+            return false;
+        }
+
+        hr = p_attr->SetGUID(
+            MF_DEVSOURCE_ATTRIBUTE_SOURCE_TYPE,
+            MF_DEVSOURCE_ATTRIBUTE_SOURCE_TYPE_VIDCAP_GUID
+        );
+
+        if (FAILED(hr))
+        {
+            release(p_attr);
+            return false;
+        }
+
+        hr = MFEnumDeviceSources(p_attr, &list, &count);
+        release(p_attr);
+
+        if (FAILED(hr))
+        {
+            list = nullptr;
+            count = 0;
+            return false;
+        }
+
+        return true;
+    }
+
+
+    // "\\?\usb#vid_046d&pid_0825&mi_00#...", the same for a device until it moves to another port
+    // lower case ascii, truncated to capacity
+    static bool get_symbolic_link(Device_p device, char* dst, UINT32 capacity)
+    {
+        WCHAR* link = nullptr;
+        UINT32 len = 0;
+
+        HRESULT hr = device->GetAllocatedString(MF_DEVSOURCE_ATTRIBUTE_SOURCE_TYPE_VIDCAP_SYMBOLIC_LINK, &link, &len);
+        if (FAILED(hr))
+        {
+            return false;
+        }
+
+        UINT32 i = 0;
+        for (; i < len && i + 1 < capacity; i++)
+        {
+            auto c = link[i];
+            dst[i] = (c >= L'A' && c <= L'Z') ? (char)(c - L'A' + 'a') : (c < 128 ? (char)c : '_');
+        }
+
+        dst[i] = 0;
+
+        CoTaskMemFree(link);
+
+        return true;
+    }
+
+
     static DataResult<FrameFormat> get_frame_format(SourceReader_p reader)
     {
         DataResult<FrameFormat> result{};
@@ -298,6 +396,80 @@ namespace w32
 }
 
 
+namespace w32
+{
+    // false after the last type
+    static bool get_native_type(SourceReader_p reader, DWORD index, NativeType& type)
+    {
+        IMFMediaType* media_type = nullptr;
+
+        HRESULT hr = reader->GetNativeMediaType(MF_SOURCE_READER_FIRST_VIDEO_STREAM, index, &media_type);
+        if (FAILED(hr))
+        {
+            return false;
+        }
+
+        type = {};
+
+        Bytes8 fps;
+        GUID sub_type;
+
+        hr = MFGetAttributeSize(media_type, MF_MT_FRAME_SIZE, &type.width, &type.height);
+        if (SUCCEEDED(hr))
+        {
+            hr = media_type->GetUINT64(MF_MT_FRAME_RATE, &fps.val64);
+        }
+
+        if (SUCCEEDED(hr))
+        {
+            hr = media_type->GetGUID(MF_MT_SUBTYPE, &sub_type);
+        }
+
+        release(media_type);
+
+        // unreadable types are listed empty so the indices stay in step
+        if (FAILED(hr) || !fps.hi32)
+        {
+            return true;
+        }
+
+        type.interval = (UINT32)(10'000'000ull * fps.lo32 / fps.hi32);
+        type.four_cc_bytes = sub_type.Data1;
+
+        return true;
+    }
+
+
+    // MJPG is decoded to YUY2 by the reader's decoder
+    static bool set_native_type(SourceReader_p reader, DWORD index)
+    {
+        IMFMediaType* media_type = nullptr;
+
+        HRESULT hr = reader->GetNativeMediaType(MF_SOURCE_READER_FIRST_VIDEO_STREAM, index, &media_type);
+        if (FAILED(hr))
+        {
+            return false;
+        }
+
+        GUID sub_type;
+        hr = media_type->GetGUID(MF_MT_SUBTYPE, &sub_type);
+        if (SUCCEEDED(hr) && sub_type == MFVideoFormat_MJPG)
+        {
+            hr = media_type->SetGUID(MF_MT_SUBTYPE, MFVideoFormat_YUY2);
+        }
+
+        if (SUCCEEDED(hr))
+        {
+            hr = reader->SetCurrentMediaType(MF_SOURCE_READER_FIRST_VIDEO_STREAM, NULL, media_type);
+        }
+
+        release(media_type);
+
+        return SUCCEEDED(hr);
+    }
+}
+
+
 namespace camera_usb
 {
     namespace img = image;
@@ -305,6 +477,36 @@ namespace camera_usb
 
     constexpr u8 DEVICE_COUNT_MAX = 16;
 
+    // blocking grabs give up so a quiet camera can't hang a stream
+    constexpr i32 GRAB_TIMEOUT_US = 1'000'000;
+
+    constexpr u32 SYMBOLIC_LINK_MAX = 256;
+
+    using stream_fn = std::function<void(Camera&, bool_fn const&)>;
+
+
+    // restored when the device comes back, see update_cameras
+    class DeviceSetup
+    {
+    public:
+        b8 open = 0;
+        ModeRequest request;
+
+        b8 has_color_space = 0;
+        cvt::ColorMatrix matrix = cvt::ColorMatrix::BT601;
+        cvt::ColorRange range = cvt::ColorRange::Limited;
+
+        // empty when not streaming
+        stream_fn stream;
+
+        b8 ring = 0;
+        u32 ring_capacity = 0;
+        OverflowPolicy ring_policy = OverflowPolicy::DropOldest;
+
+        // reopen failed, retried on the next poll
+        b8 pending = 0;
+    };
+
 
     class DeviceW32
     {
@@ -317,27 +519,62 @@ namespace camera_usb
 
         w32::Sample_p p_sample = nullptr;
 
+        char product_id[5] = { 0 };
+        char vendor_id[5] = { 0 };
+        char serial_number[32] = { 0 };
+
+        char label[32] = { 0 };
+
+        // set by the stream thread when the source reader reports the device gone
+        std::atomic<bool> lost = false;
+
         w32::FrameFormat format;
 
         Stopwatch grab_sw;
         f32 grab_ms;
 
+        // each device owns its buffers so cameras can stream at the same time
+        img::Buffer32 data32;
+        img::Buffer8 data8;
+
         img::ImageView rgba;
         img::View3u8 view3;
+
+        cvt::ColorTable color_table;
+
+        // see start_stream
+        std::thread stream_thread;
+        std::atomic<bool> stream_on = false;
+
+        // see start_stream_ring
+        FrameRing ring;
+        u64 sequence = 0;
+
+        StatsCollector stats;
+        Stopwatch convert_sw;
+
+        DeviceSetup setup;
     };
 
 
     class DeviceListW32
     {
     public:
+        b8 started = 0;
+
+        // latest scan, see ScanW32
         w32::Device_p* device_list = nullptr;
+        UINT32 n_scanned = 0;
 
         DeviceW32 devices[DEVICE_COUNT_MAX] = { 0 };
 
         u32 count = 0;
 
-        img::Buffer32 data32;
-        img::Buffer8 data8;
+        // devices index the same as slots
+        DeviceTable table;
+
+        // Media Foundation sends no arrival or removal without a window, the list is polled
+        u64 last_poll_ns = 0;
     };
 }
 
@@ -346,215 +583,981 @@ namespace camera_usb
 
 namespace camera_usb
 {
+    // the device stays in the list and can be opened again
     static void close_device(DeviceW32& device)
     {
         w32::release(device.p_source);
         w32::release(device.p_reader);
-        w32::release(device.p_device);
     }
 
 
     static bool open_device(DeviceW32& device)
     {
-        return w32::activate(device.p_device, device.p_source, device.p_reader);
+        // removed devices are released, see update_cameras
+        return device.p_device && w32::activate(device.p_device, device.p_source, device.p_reader);
     }
 
 
-    static bool read_device_format(DeviceW32& device)
+    static void read_device_modes(DeviceW32 const& device, CameraModeList& modes)
     {
-        auto result = w32::get_frame_format(device.p_reader);
-        if (!result.success)
+        modes.count = 0;
+        modes.truncated = 0;
+
+        w32::NativeType type;
+
+        for (DWORD i = 0; w32::get_native_type(device.p_reader, i, type); i++)
         {
-            return false;
+            modes::add_mode(modes, type.four_cc_bytes, type.width, type.height, type.interval, (u32)i);
         }
-
-        device.format = result.data;
-        return true;
     }
 
 
-    static bool grab_and_convert_frame_rgba(DeviceW32& device, img::ImageView const& dst)
+    static bool select_device_mode(DeviceW32& device, ModeRequest const& request)
     {
-        auto result = w32::read_frame(device.p_reader, device.p_sample);
-        if (!result.success)
+        CameraModeList modes;
+        read_device_modes(device, modes);
+
+        auto selected = modes::select_mode(modes, request);
+        if (selected < 0)
         {
             return false;
         }
 
-        auto& frame = result.data;
-        auto span = span::make_view((u8*)frame.data, frame.size_bytes);
-
-        auto format = device.format.pixel_format;
-        auto w = device.format.width;
-        auto h = device.format.height;
-
-        cvt::to_yuv(span, w, h, device.view3, format);
-        cvt::yuv_to_rgba(device.view3, dst);
-
-        w32::release(frame);
-        w32::release(device.p_sample);
-
-        return true;
+        return w32::set_native_type(device.p_reader, modes.list[selected].index);
     }
 
 
-    static bool grab_and_convert_frame_rgb(DeviceW32& device, img::View3u8 const& dst)
+    static bool read_device_format(DeviceW32& device)
     {
-        auto result = w32::read_frame(device.p_reader, device.p_sample);
+        auto result = w32::get_frame_format(device.p_reader);
         if (!result.success)
         {
             return false;
         }
 
-        auto& frame = result.data;
-        auto span = span::make_view((u8*)frame.data, frame.size_bytes);
+        device.format = result.data;
+        return true;
+    }
 
-        auto format = device.format.pixel_format;
-        auto w = device.format.width;
-        auto h = device.format.height;
 
-        cvt::to_yuv(span, w, h, device.view3, format);
-        cvt::yuv_to_rgb(device.view3, dst);
+    static void convert_frame_rgba(SpanView<u8> const& src, img::ImageView const& dst, cvt::PixelFormat format, cvt::ColorTable const& table)
+    {
+        cvt::convert_view(src, dst, format, table);
+    }
 
-        w32::release(frame);
-        w32::release(device.p_sample);
 
-        return true;
+    static void convert_frame_rgba(SpanView<u8> const& src, img::SubView const& dst, cvt::PixelFormat format, cvt::ColorTable const& table)
+    {
+        cvt::convert_sub_view(src, dst, format, table);
     }
 
 
-    static bool grab_and_convert_frame_yuv(DeviceW32& device, img::View3u8 const& dst)
+    // the synchronous source reader has no timeout, it waits for the next sample
+    static bool read_device_frame(DeviceW32& device, w32::Frame& frame, GrabResult& result)
     {
-        auto result = w32::read_frame(device.p_reader, device.p_sample);
-        if (!result.success)
+        auto read = w32::read_frame(device.p_reader, device.p_sample);
+        if (!read.success)
         {
+            if (read.data.device_lost)
+            {
+                device.lost = true;
+            }
+
+            w32::release(device.p_sample);
+
+            result.status = GrabStatus::Error;
             return false;
         }
 
-        auto& frame = result.data;
-        auto span = span::make_view((u8*)frame.data, frame.size_bytes);
+        frame = read.data;
 
-        auto format = device.format.pixel_format;
-        auto w = device.format.width;
-        auto h = device.format.height;
+        // sample time is in 100ns units, no payload clock is exposed
+        result.status = GrabStatus::Ok;
+        result.sequence = device.sequence++;
+        result.timestamp_ns = (u64)frame.timestamp * 100;
 
-        cvt::to_yuv(span, w, h, dst, format);
+        // a stream tick marks a gap in the samples
+        result.dropped = (frame.flags & MF_SOURCE_READERF_STREAMTICK) ? 1 : 0;
 
-        w32::release(frame);
-        w32::release(device.p_sample);
+        device.convert_sw.start();
 
         return true;
     }
-}
-
 
-/* device setup */
 
-namespace camera_usb
-{
-    static bool read_device_properties(DeviceW32& device)
+    static FrameStats frame_stats(DeviceW32& device, w32::Frame const& frame, GrabResult const& result, u32 consumer_dropped)
     {
-        // TODO
-        return true;
+        // sample time is not on the system clock, no latency
+        FrameStats fs{};
+        fs.dropped = result.dropped;
+        fs.consumer_dropped = consumer_dropped;
+        fs.bytes = frame.size_bytes;
+        fs.convert_ms = device.convert_sw.get_time_milli();
+
+        return fs;
     }
 
 
-    static bool connect_device(DeviceW32& device)
+    // after conversion
+    static void release_device_frame(DeviceW32& device, w32::Frame& frame, GrabResult const& result, u32 consumer_dropped)
     {
-        if (!open_device(device))
-        {
-            assert(false && "Could not open device");
-            return false;
-        }
-
-        if (!read_device_format(device))
-        {
-            assert(false && "Error getting device configuration");
-            close_device(device);
-            return false;
-        }
+        stats::add_frame(device.stats, frame_stats(device, frame, result, consumer_dropped));
 
-        return true;
+        w32::release(frame);
+        w32::release(device.p_sample);
     }
-}
 
 
-/* enumerate */
+    static void drop_device_frame(DeviceW32& device, w32::Frame& frame, GrabResult const& result, u32 consumer_dropped)
+    {
+        stats::add_dropped_frame(device.stats, frame_stats(device, frame, result, consumer_dropped));
 
-namespace camera_usb
-{
-    static bool enumerate_devices(DeviceListW32& list)
+        w32::release(frame);
+        w32::release(device.p_sample);
+    }
+
+
+    template <class VIEW>
+    static GrabResult grab_and_convert_frame_rgba(DeviceW32& device, VIEW const& dst, i32 timeout_us)
     {
-        if (!w32::init())
+        GrabResult result{};
+        w32::Frame frame{};
+
+        if (!read_device_frame(device, frame, result))
         {
-            return false;
+            return result;
         }
 
-        HRESULT hr = S_OK;
+        auto span = span::make_view((u8*)frame.data, frame.size_bytes);
 
-        IMFAttributes* p_attr = nullptr;
+        auto format = device.format.pixel_format;
+        auto w = device.format.width;
+        auto h = device.format.height;
 
-        hr = MFCreateAttributes(&p_attr, 1);
-        if (FAILED(hr))
+        if (dst.width == w && dst.height == h)
         {
-            return false;
+            convert_frame_rgba(span, dst, format, device.color_table);
         }
-
-        hr = p_attr->SetGUID(
-            MF_DEVSOURCE_ATTRIBUTE_SOURCE_TYPE,
-            MF_DEVSOURCE_ATTRIBUTE_SOURCE_TYPE_VIDCAP_GUID
-        );
-
-        if (FAILED(hr))
+        else
         {
-            w32::release(p_attr);
-            return false;
+            // downscaling averages, upscaling interpolates
+            auto mode = dst.width < w || dst.height < h ? cvt::Resample::Area : cvt::Resample::Bilinear;
+            cvt::convert_resize(span, w, h, dst, format, mode, device.color_table);
         }
 
-        u32 n_devices = 0;
+        release_device_frame(device, frame, result, 0);
 
-        hr = MFEnumDeviceSources(p_attr, &list.device_list, &n_devices);
-        w32::release(p_attr);
+        return result;
+    }
 
-        if (FAILED(hr) || !n_devices)
-        {      
-            return false;
-        }
 
-        list.count = n_devices;
-        assert(n_devices <= DEVICE_COUNT_MAX);
+    static GrabResult grab_and_convert_frame_rgb(DeviceW32& device, img::View3u8 const& dst, i32 timeout_us)
+    {
+        GrabResult result{};
+        w32::Frame frame{};
 
-        for (u32 i = 0; i < n_devices; ++i)
+        if (!read_device_frame(device, frame, result))
         {
-            auto& device = list.devices[i];
-
-            device.p_device = list.device_list[i];
-            device.device_id = i;
+            return result;
         }
 
-        return list.count > 0;
-    }
-
+        auto span = span::make_view((u8*)frame.data, frame.size_bytes);
 
-    static void close_devices(DeviceListW32& list)
+        auto format = device.format.pixel_format;
+        auto w = device.format.width;
+        auto h = device.format.height;
+
+        cvt::to_yuv(span, w, h, device.view3, format);
+        cvt::yuv_to_rgb(device.view3, dst, device.color_table);
+
+        release_device_frame(device, frame, result, 0);
+
+        return result;
+    }
+
+
+    template <typename T>
+    static GrabResult grab_and_convert_frame_yuv(DeviceW32& device, img::View3<T> const& dst, i32 timeout_us)
+    {
+        GrabResult result{};
+        w32::Frame frame{};
+
+        if (!read_device_frame(device, frame, result))
+        {
+            return result;
+        }
+
+        auto span = span::make_view((u8*)frame.data, frame.size_bytes);
+
+        auto format = device.format.pixel_format;
+        auto w = device.format.width;
+        auto h = device.format.height;
+
+        cvt::to_yuv(span, w, h, dst, format);
+
+        release_device_frame(device, frame, result, 0);
+
+        return result;
+    }
+
+
+    // converts straight into the next ring slot, dropped frames are not converted
+    static GrabResult grab_and_convert_frame_ring(DeviceW32& device, bool_fn const& is_on, i32 timeout_us)
+    {
+        GrabResult result{};
+        w32::Frame frame{};
+
+        if (!read_device_frame(device, frame, result))
+        {
+            return result;
+        }
+
+        auto n_dropped = device.ring.n_dropped.load();
+
+        auto slot = ring::begin_write(device.ring, is_on);
+
+        auto consumer_dropped = (u32)(device.ring.n_dropped.load() - n_dropped);
+
+        if (!slot)
+        {
+            drop_device_frame(device, frame, result, consumer_dropped);
+            return result;
+        }
+
+        auto span = span::make_view((u8*)frame.data, frame.size_bytes);
+
+        auto format = device.format.pixel_format;
+        auto w = device.format.width;
+        auto h = device.format.height;
+
+        cvt::to_yuv(span, w, h, slot->view, format);
+
+        slot->sequence = result.sequence;
+        slot->timestamp_ns = result.timestamp_ns;
+
+        ring::end_write(device.ring);
+
+        release_device_frame(device, frame, result, consumer_dropped);
+
+        return result;
+    }
+}
+
+
+/* device setup */
+
+namespace camera_usb
+{
+    static void set_device_properties(DeviceW32& device, DeviceKey const& key)
+    {
+        qsnprintf(device.product_id, 5, "%04x", key.product_id);
+        qsnprintf(device.vendor_id, 5, "%04x", key.vendor_id);
+        qsnprintf(device.serial_number, 32, "%s", key.serial_number);
+
+        qsnprintf(device.label, 32, "%c", 'A' + device.device_id);
+    }
+
+
+    static bool connect_device(DeviceW32& device, ModeRequest const& request)
+    {
+        if (!open_device(device))
+        {
+            assert(false && "Could not open device");
+            return false;
+        }
+
+        if (!select_device_mode(device, request))
+        {
+            assert(false && "No device mode for request");
+            close_device(device);
+            return false;
+        }
+
+        if (!read_device_format(device))
+        {
+            assert(false && "Error getting device configuration");
+            close_device(device);
+            return false;
+        }
+
+        return true;
+    }
+}
+
+
+/* static devices */
+
+namespace camera_usb
+{
+    static DeviceListW32 w32_list;
+}
+
+
+/* device buffers */
+
+namespace camera_usb
+{
+    static void destroy_device_buffers(DeviceW32& device)
+    {
+        mb::destroy_buffer(device.data32);
+        mb::destroy_buffer(device.data8);
+        ring::destroy(device.ring);
+
+        device.rgba = {};
+        device.view3 = {};
+    }
+
+
+    static bool create_rgba_view(DeviceW32& device)
+    {
+        if (device.rgba.matrix_data_)
+        {
+            return true;
+        }
+
+        auto w = device.format.width;
+        auto h = device.format.height;
+
+        device.data32 = img::create_buffer32(w * h, "w32 data32");
+        if (!device.data32.ok)
+        {
+            return false;
+        }
+
+        device.rgba = img::make_view(w, h, device.data32);
+
+        return device.rgba.matrix_data_ != nullptr;
+    }
+
+
+    static bool create_planar_view(DeviceW32& device)
+    {
+        if (device.view3.channel_data[0])
+        {
+            return true;
+        }
+
+        auto w = device.format.width;
+        auto h = device.format.height;
+
+        device.data8 = img::create_buffer8(3 * w * h, "w32 data8");
+        if (!device.data8.ok)
+        {
+            return false;
+        }
+
+        device.view3 = convert::make_view_yuv(w, h, device.data8);
+
+        return device.view3.channel_data[2] != nullptr;
+    }
+}
+
+
+/* grab rgba */
+
+namespace camera_usb
+{
+    // rolling window from the stats, the configured fps until the first window is done
+    static void update_fps(Camera& camera, DeviceW32 const& device)
+    {
+        auto fps = stats::window_fps(device.stats);
+        if (fps > 0.0f)
+        {
+            camera.fps = num::round_to_unsigned<u32>(fps);
+        }
+    }
+
+
+    // dst is the whole image or a tile of a shared one
+    template <class VIEW>
+    static void grab_rgba(Camera& camera, VIEW const& dst)
+    {
+        camera.busy = 1;
+        auto& device = w32_list.devices[camera.id];
+        
+        device.grab_sw.start();
+
+        if (!grab_and_convert_frame_rgba(device, dst, GRAB_TIMEOUT_US).ok())
+        {
+            img::fill(dst, img::to_pixel(0, 0, 255));
+        }
+
+        device.grab_ms = device.grab_sw.get_time_milli();
+        update_fps(camera, device);
+
+        camera.busy = 0;
+    }
+
+
+    template <class VIEW>
+    static void stream_rgba(Camera& camera, VIEW const& dst, bool_fn const& stream_condition)
+    {
+        camera.busy = 1;
+        auto& device = w32_list.devices[camera.id];
+
+        auto c_status = camera.status;
+
+        camera.status = CameraStatus::Streaming;
+
+        while (stream_condition())
+        {
+            device.grab_sw.start();
+            if (!grab_and_convert_frame_rgba(device, dst, GRAB_TIMEOUT_US).ok())
+            {
+                img::fill(dst, img::to_pixel(0, 0, 255));
+            }
+
+            device.grab_ms = device.grab_sw.get_time_milli();
+            update_fps(camera, device);
+        }
+
+        camera.busy = 0;
+        camera.status = c_status;
+    }
+}
+
+
+/* timed grab */
+
+namespace camera_usb
+{
+    // public timeouts of 0 poll
+    // the source reader is synchronous, timed and try grabs wait for the next sample
+    static i32 to_device_timeout(u32 timeout_us)
+    {
+        constexpr u32 MAX = 0x7FFF'FFFF;
+
+        return timeout_us ? (i32)num::min(timeout_us, MAX) : -1;
+    }
+
+
+    template <class VIEW>
+    static GrabResult grab_rgba_timed(Camera& camera, VIEW const& dst, i32 timeout_us)
+    {
+        if (!camera.is_open())
+        {
+            return {};
+        }
+
+        auto& device = w32_list.devices[camera.id];
+
+        return grab_and_convert_frame_rgba(device, dst, timeout_us);
+    }
+
+
+    template <typename T>
+    static GrabResult grab_yuv_timed(Camera& camera, img::View3<T> const& dst, i32 timeout_us)
+    {
+        if (!camera.is_open())
+        {
+            return {};
+        }
+
+        auto& device = w32_list.devices[camera.id];
+
+        return grab_and_convert_frame_yuv(device, dst, timeout_us);
+    }
+}
+
+
+/* stream threads */
+
+namespace camera_usb
+{
+    static void stop_stream_thread(DeviceW32& device)
+    {
+        device.stream_on = false;
+
+        if (device.stream_thread.joinable())
+        {
+            device.stream_thread.join();
+        }
+    }
+
+
+    // runs a blocking stream function on the device's own thread
+    static bool start_stream_thread(Camera& camera, stream_fn const& stream)
+    {
+        if (!camera.is_open())
+        {
+            return false;
+        }
+
+        auto& device = w32_list.devices[camera.id];
+        if (device.stream_on)
+        {
+            return false;
+        }
+
+        stop_stream_thread(device);
+
+        device.stream_on = true;
+        device.setup.stream = stream;
+
+        auto const is_on = [&device](){ return device.stream_on.load(); };
+
+        device.stream_thread = std::thread([&camera, &device, stream, is_on]()
+        {
+            stream(camera, is_on);
+
+            // stream may end on its own, allow a restart
+            device.stream_on = false;
+        });
+
+        return true;
+    }
+
+
+    bool start_stream(Camera& camera, grab_cb const& on_grab)
+    {
+        return start_stream_thread(camera, [on_grab](Camera& c, bool_fn const& is_on){ stream_camera(c, on_grab, is_on); });
+    }
+
+
+    bool start_stream_planar_rgb(Camera& camera, planar_cb const& proc)
+    {
+        return start_stream_thread(camera, [proc](Camera& c, bool_fn const& is_on){ stream_planar_rgb(c, proc, is_on); });
+    }
+
+
+    bool start_stream_planar_yuv(Camera& camera, planar_cb const& proc)
+    {
+        return start_stream_thread(camera, [proc](Camera& c, bool_fn const& is_on){ stream_planar_yuv(c, proc, is_on); });
+    }
+
+
+    void stop_stream(Camera& camera)
+    {
+        auto& device = w32_list.devices[camera.id];
+
+        stop_stream_thread(device);
+
+        device.setup.stream = nullptr;
+        device.setup.ring = 0;
+    }
+
+
+    bool start_stream_ring(Camera& camera, u32 capacity, OverflowPolicy policy)
+    {
+        if (!camera.is_open())
+        {
+            return false;
+        }
+
+        auto& device = w32_list.devices[camera.id];
+        if (device.stream_on)
+        {
+            return false;
+        }
+
+        auto w = device.format.width;
+        auto h = device.format.height;
+
+        if (!ring::create(device.ring, capacity, w, h, policy))
+        {
+            return false;
+        }
+
+        auto const stream = [](Camera& c, bool_fn const& is_on)
+        {
+            auto& device = w32_list.devices[c.id];
+
+            auto c_status = c.status;
+
+            c.busy = 1;
+            c.status = CameraStatus::Streaming;
+
+            while (is_on())
+            {
+                device.grab_sw.start();
+                grab_and_convert_frame_ring(device, is_on, GRAB_TIMEOUT_US);
+
+                device.grab_ms = device.grab_sw.get_time_milli();
+                update_fps(c, device);
+            }
+
+            c.busy = 0;
+            c.status = c_status;
+        };
+
+        if (!start_stream_thread(camera, stream))
+        {
+            return false;
+        }
+
+        auto& setup = device.setup;
+        setup.ring = 1;
+        setup.ring_capacity = capacity;
+        setup.ring_policy = policy;
+
+        return true;
+    }
+
+
+    bool read_frame(Camera& camera, FrameYUV& frame)
+    {
+        auto slot = ring::read(w32_list.devices[camera.id].ring, false);
+        if (!slot)
+        {
+            return false;
+        }
+
+        frame = *slot;
+
+        return true;
+    }
+
+
+    bool read_latest_frame(Camera& camera, FrameYUV& frame)
+    {
+        auto slot = ring::read(w32_list.devices[camera.id].ring, true);
+        if (!slot)
+        {
+            return false;
+        }
+
+        frame = *slot;
+
+        return true;
+    }
+
+
+    void release_frame(Camera& camera)
+    {
+        ring::release(w32_list.devices[camera.id].ring);
+    }
+
+
+    CameraStats get_stats(Camera const& camera)
+    {
+        return stats::read(w32_list.devices[camera.id].stats.snapshot);
+    }
+
+
+    bool start_stream_ring(Camera& camera, u32 capacity, OverflowPolicy policy, DecodeOrder order)
+    {
+        // the source reader decodes MJPG, see w32::set_native_type
+        return start_stream_ring(camera, capacity, policy);
+    }
+
+
+    bool create_decode_pool(u32 n_workers)
+    {
+        return false;
+    }
+
+
+    void destroy_decode_pool()
+    {
+
+    }
+}
+
+
+/* hotplug */
+
+namespace camera_usb
+{
+    // "vid_046d" in the symbolic link, 0 when it is not a usb device
+    static u16 read_link_id(cstr link, cstr tag)
+    {
+        auto id = strstr(link, tag);
+        if (!id)
+        {
+            return 0;
+        }
+
+        return (u16)strtoul(id + strlen(tag), nullptr, 16);
+    }
+
+
+    // Media Foundation has no serial number, a hash of the symbolic link stands in for it
+    // a lost device gets a new location so the rescan reconnects it
+    static bool read_device_key(DeviceListW32 const& list, w32::Device_p p_device, DeviceKey& key)
+    {
+        char link[SYMBOLIC_LINK_MAX];
+
+        if (!w32::get_symbolic_link(p_device, link, SYMBOLIC_LINK_MAX))
+        {
+            return false;
+        }
+
+        key = {};
+        key.vendor_id = read_link_id(link, "vid_");
+        key.product_id = read_link_id(link, "pid_");
+
+        // fnv-1a
+        u64 hash = 14695981039346656037ull;
+        for (auto c = link; *c; c++)
+        {
+            hash = (hash ^ (u8)*c) * 1099511628211ull;
+        }
+
+        qsnprintf(key.serial_number, 32, "%016llx", (unsigned long long)hash);
+
+        for (u32 i = 0; i < list.table.count; i++)
+        {
+            auto& slot = list.table.slots[i];
+            if (slot.present && list.devices[i].lost && hotplug::same_device(slot.key, key))
+            {
+                key.location = slot.key.location + 1;
+            }
+        }
+
+        return true;
+    }
+
+
+    // stop using the device but keep its setup and buffers, a reader may still hold a ring frame
+    static void release_device(DeviceW32& device)
+    {
+        stop_stream_thread(device);
+        close_device(device);
+        w32::release(device.p_device);
+    }
+
+
+    static void take_device(DeviceW32& device, w32::Device_p p_device)
+    {
+        p_device->AddRef();
+        device.p_device = p_device;
+        device.lost = false;
+    }
+
+
+    // reopen and restart the stream as they were before the device left
+    static bool restore_device(Camera& camera, DeviceW32& device)
+    {
+        auto& setup = device.setup;
+
+        setup.pending = 0;
+
+        if (!setup.open)
+        {
+            return true;
+        }
+
+        // open_camera overwrites the setup
+        auto saved = setup;
+
+        if (!open_camera(camera, saved.request))
+        {
+            setup = saved;
+            setup.pending = 1;
+            return false;
+        }
+
+        if (saved.has_color_space)
+        {
+            set_color_space(camera, saved.matrix, saved.range);
+        }
+
+        if (saved.ring)
+        {
+            return start_stream_ring(camera, saved.ring_capacity, saved.ring_policy);
+        }
+
+        if (saved.stream)
+        {
+            return start_stream_thread(camera, saved.stream);
+        }
+
+        return true;
+    }
+
+
+    // hotplug::rescan backend on Media Foundation
+    class ScanW32
+    {
+    public:
+        DeviceListW32& list;
+        CameraList& cameras;
+
+        // the scan list is indexed by scan position, skipped devices leave gaps
+        w32::Device_p scanned[HOTPLUG_SCAN_MAX] = { 0 };
+
+
+        u32 scan(DeviceKey* dst, u32 capacity)
+        {
+            if (!w32::enum_devices(list.device_list, list.n_scanned))
+            {
+                // nothing changes when the devices can't be listed
+                u32 n = 0;
+                for (u32 i = 0; i < list.table.count && n < capacity; i++)
+                {
+                    auto& slot = list.table.slots[i];
+                    if (slot.present)
+                    {
+                        dst[n++] = slot.key;
+                    }
+                }
+
+                return n;
+            }
+
+            u32 n = 0;
+            for (u32 i = 0; i < list.n_scanned && n < capacity; i++)
+            {
+                if (read_device_key(list, list.device_list[i], dst[n]))
+                {
+                    scanned[n++] = list.device_list[i];
+                }
+            }
+
+            return n;
+        }
+
+
+        void remove(u32 slot)
+        {
+            release_device(list.devices[slot]);
+
+            auto& camera = cameras.list[slot];
+            camera.status = CameraStatus::Inactive;
+            camera.busy = 0;
+        }
+
+
+        void add(u32 slot, u32 scan_index)
+        {
+            auto& device = list.devices[slot];
+            auto& camera = cameras.list[slot];
+
+            device.device_id = (int)slot;
+            take_device(device, scanned[scan_index]);
+            set_device_properties(device, list.table.slots[slot].key);
+
+            camera.id = device.device_id;
+            camera.status = CameraStatus::Active;
+
+            camera.vendor = span::to_string_view(device.vendor_id);
+            camera.product = span::to_string_view(device.product_id);
+            camera.serial_number = span::to_string_view(device.serial_number);
+            camera.label = span::to_string_view(device.label);
+
+            camera.format = span::to_string_view("XXXX");
+
+            list.count = list.table.count;
+            cameras.count = list.table.count;
+        }
+
+
+        void reconnect(u32 slot, u32 scan_index)
+        {
+            auto& device = list.devices[slot];
+            auto& camera = cameras.list[slot];
+
+            release_device(device);
+            take_device(device, scanned[scan_index]);
+
+            camera.status = CameraStatus::Active;
+
+            restore_device(camera, device);
+        }
+
+
+        void end_scan()
+        {
+            // devices that were taken hold their own reference
+            for (u32 i = 0; i < list.n_scanned; i++)
+            {
+                w32::release(list.device_list[i]);
+            }
+
+            CoTaskMemFree(list.device_list);
+
+            list.device_list = nullptr;
+            list.n_scanned = 0;
+        }
+    };
+
+
+    static bool has_present_device(DeviceListW32 const& list)
     {
-        for (int i = 0; i < list.count; ++i)
+        for (u32 i = 0; i < list.table.count; i++)
         {
-            auto& device = list.devices[i];
-            close_device(device);            
+            if (list.table.slots[i].present)
+            {
+                return true;
+            }
+        }
+
+        return false;
+    }
+
+
+    static bool has_lost_device(DeviceListW32 const& list)
+    {
+        for (u32 i = 0; i < list.table.count; i++)
+        {
+            if (list.table.slots[i].present && list.devices[i].lost)
+            {
+                return true;
+            }
         }
 
-        CoTaskMemFree(list.device_list);
-        w32::shutdown();
+        return false;
+    }
+
+
+    static void retry_pending(DeviceListW32& list, CameraList& cameras)
+    {
+        for (u32 i = 0; i < list.table.count; i++)
+        {
+            auto& device = list.devices[i];
+            if (list.table.slots[i].present && device.setup.pending)
+            {
+                restore_device(cameras.list[i], device);
+            }
+        }
     }
 }
 
 
-/* static devices */
+/* enumerate */
 
 namespace camera_usb
 {
-    static DeviceListW32 w32_list;
+    static bool enumerate_devices(DeviceListW32& list, CameraList& cameras)
+    {
+        if (!list.started)
+        {
+            if (!w32::init())
+            {
+                return false;
+            }
+
+            list.started = 1;
+        }
+
+        // Media Foundation stays up without devices so update_cameras can find them later
+        ScanW32 backend{ list, cameras };
+        hotplug::rescan(list.table, backend);
+
+        list.last_poll_ns = stats::steady_ns();
+
+        return has_present_device(list);
+    }
+
+
+    static void close_devices(DeviceListW32& list)
+    {
+        for (u32 i = 0; i < list.count; ++i)
+        {
+            auto& device = list.devices[i];
+            release_device(device);
+            device.setup = {};
+        }
+
+        list.table = {};
+        list.count = 0;
+
+        if (list.started)
+        {
+            w32::shutdown();
+            list.started = 0;
+        }
+    }
 }
 
 
@@ -567,78 +1570,135 @@ namespace camera_usb
         CameraList cameras{};
         cameras.status = ConnectionStatus::Connecting;
 
-        auto n_pixels = WIDTH_MAX * HEIGHT_MAX;        
-        w32_list.data32 = img::create_buffer32(4 * n_pixels, "w32 data32");
-        if (!w32_list.data32.ok)
+        if (!enumerate_devices(w32_list, cameras))
         {
-            cameras.count = 0;
             cameras.status = ConnectionStatus::Disconnected;
             return cameras;
         }
 
-        w32_list.data8 = img::create_buffer8(3 * n_pixels, "w32 data8");
-        if (!w32_list.data8.ok)
-        {
-            mb::destroy_buffer(w32_list.data32);
-            cameras.count = 0;
-            cameras.status = ConnectionStatus::Disconnected;
-            return cameras;
-        }
+        cameras.status = ConnectionStatus::Connected;
 
-        if (!enumerate_devices(w32_list))
+        return cameras;
+    }
+
+
+    void close(CameraList& cameras)
+    {
+        for (u32 i = 0; i < w32_list.count; i++)
         {
-            mb::destroy_buffer(w32_list.data32);
-            mb::destroy_buffer(w32_list.data8);
-            cameras.count = 0;
-            cameras.status = ConnectionStatus::Disconnected;
-            return cameras;
+            auto& device = w32_list.devices[i];
+
+            stop_stream_thread(device);
+            destroy_device_buffers(device);
         }
 
-        cameras.count = w32_list.count;
+        close_devices(w32_list);
+
         for (u32 i = 0; i < cameras.count; i++)
         {
             auto& camera = cameras.list[i];
-            auto& device = w32_list.devices[i];
+            camera.id = -1;
+            camera.status = CameraStatus::Inactive;
+        }
+    }
 
-            camera.id = device.device_id;
-            camera.status = CameraStatus::Active;
 
-            // TODO
-            camera.vendor = span::to_string_view("XXXX");
-            camera.product = span::to_string_view("XXXX");
-            camera.serial_number = span::to_string_view("XXXX");
-            camera.label = span::to_string_view("XXXX");
+    bool update_cameras(CameraList& cameras)
+    {
+        auto& list = w32_list;
+        if (!list.started)
+        {
+            return false;
+        }
 
-            camera.format = span::to_string_view("XXXX");
+        auto now_ns = stats::steady_ns();
+        auto poll = now_ns - list.last_poll_ns >= (u64)HOTPLUG_POLL_MS * 1'000'000;
+
+        // every poll is a rescan, a stream that lost its device rescans right away
+        auto changed = poll || has_lost_device(list);
+
+        u32 n_changed = 0;
+
+        if (changed)
+        {
+            ScanW32 backend{ list, cameras };
+            n_changed = hotplug::rescan(list.table, backend);
         }
 
-        cameras.status = ConnectionStatus::Connected;
+        if (poll)
+        {
+            list.last_poll_ns = now_ns;
+            retry_pending(list, cameras);
+        }
 
-        return cameras;
+        cameras.status = has_present_device(list) ? ConnectionStatus::Connected : ConnectionStatus::Disconnected;
+
+        return n_changed > 0;
     }
 
 
-    void close(CameraList& cameras)
+    bool is_new_camera(Camera const& camera)
     {
-        mb::destroy_buffer(w32_list.data32);
-        mb::destroy_buffer(w32_list.data8);
-        close_devices(w32_list);
-
-        for (u32 i = 0; i < cameras.count; i++)
+        auto& table = w32_list.table;
+        if (camera.id < 0 || (u32)camera.id >= table.count)
         {
-            auto& camera = cameras.list[i];
-            camera.id = -1;
-            camera.status = CameraStatus::Inactive;
+            return false;
         }
+
+        return table.slots[camera.id].event == SlotEvent::Added;
+    }
+
+
+    bool plug_synthetic_camera(u32 index, bool plugged)
+    {
+        // no synthetic cameras on Media Foundation
+        return false;
     }
 
 
     bool open_camera(Camera& camera)
+    {
+        // 640 x 480 at the fastest rate
+        return open_camera(camera, ModeRequest{});
+    }
+
+
+    CameraModeList enumerate_modes(Camera const& camera)
+    {
+        CameraModeList modes;
+
+        if (camera.id < 0)
+        {
+            return modes;
+        }
+
+        auto& device = w32_list.devices[camera.id];
+
+        // activate just long enough to read the native types
+        auto is_open = device.p_reader != nullptr;
+        if (!is_open && !open_device(device))
+        {
+            return modes;
+        }
+
+        read_device_modes(device, modes);
+
+        if (!is_open)
+        {
+            w32::release(device.p_source);
+            w32::release(device.p_reader);
+        }
+
+        return modes;
+    }
+
+
+    bool open_camera(Camera& camera, ModeRequest const& request)
     {
         camera.busy = 1;
 
         auto& device = w32_list.devices[camera.id];
-        if (!connect_device(device))
+        if (!connect_device(device, request))
         {        
             camera.busy = 0;    
             return false;
@@ -651,71 +1711,83 @@ namespace camera_usb
         
         camera.format = span::to_string_view(format.format_code);
 
-        // only one at a time
-        auto& buffer32 = w32_list.data32;
-        auto& buffer8 = w32_list.data8;
-        auto w = camera.frame_width;
-        auto h = camera.frame_height;
-        mb::reset_buffer(buffer32);
-        mb::reset_buffer(buffer8);
-        device.rgba = img::make_view(w, h, buffer32);
-        device.view3 = convert::make_view_yuv(w, h, buffer8);
+        device.sequence = 0;
+        stats::reset(device.stats);
 
-        if (!buffer32.ok || !buffer8.ok)
-        {
-            camera.busy = 0;
-            return false;
-        }
+        // rgba and planar views are created on first use, see stream_camera
+        destroy_device_buffers(device);
+
+        // uvc default, see set_color_space
+        device.color_table = cvt::make_color_table(cvt::ColorMatrix::BT601, cvt::ColorRange::Limited);
 
         camera.status = CameraStatus::Open;
         camera.busy = 0;
 
+        device.setup = {};
+        device.setup.open = 1;
+        device.setup.request = request;
+
         return true;
     }
 
 
-    void grab_image(Camera& camera, img::ImageView const& dst)
+    void set_color_space(Camera& camera, convert::ColorMatrix matrix, convert::ColorRange range)
     {
-        camera.busy = 1;
         auto& device = w32_list.devices[camera.id];
-        
-        device.grab_sw.start();
+        device.color_table = cvt::make_color_table(matrix, range);
 
-        if (!grab_and_convert_frame_rgba(device, dst))
-        {
-            img::fill(dst, img::to_pixel(0, 0, 255));
-        }
+        device.setup.has_color_space = 1;
+        device.setup.matrix = matrix;
+        device.setup.range = range;
+    }
 
-        device.grab_ms = device.grab_sw.get_time_milli();
-        camera.fps = num::round_to_unsigned<u32>(1000.0 / device.grab_ms);
 
-        camera.busy = 0;
+    convert::ColorTable const& get_color_table(Camera const& camera)
+    {
+        return w32_list.devices[camera.id].color_table;
     }
 
 
-    void stream_camera(Camera& camera, img::ImageView const& dst, bool_fn const& stream_condition)
+    bool start_recording(Camera& camera, cstr path)
     {
-        camera.busy = 1;
-        auto& device = w32_list.devices[camera.id];
+        // not supported on Media Foundation, its samples are frames, not usb payloads
+        return false;
+    }
 
-        auto c_status = camera.status;
 
-        camera.status = CameraStatus::Streaming;
+    u64 stop_recording(Camera& camera)
+    {
+        return 0;
+    }
 
-        while (stream_condition())
-        {
-            device.grab_sw.start();
-            if (!grab_and_convert_frame_rgba(device, dst))
-            {
-                img::fill(dst, img::to_pixel(0, 0, 255));
-            }
 
-            device.grab_ms = device.grab_sw.get_time_milli();
-            camera.fps = num::round_to_unsigned<u32>(1000.0 / device.grab_ms);
-        }
+    void set_decode_threads(Camera& camera, u32 n_threads)
+    {
+        // the source reader's decoder manages its own threads
+    }
 
-        camera.busy = 0;
-        camera.status = c_status;
+
+    void grab_image(Camera& camera, img::ImageView const& dst)
+    {
+        grab_rgba(camera, dst);
+    }
+
+
+    void grab_image(Camera& camera, img::SubView const& dst)
+    {
+        grab_rgba(camera, dst);
+    }
+
+
+    void stream_camera(Camera& camera, img::ImageView const& dst, bool_fn const& stream_condition)
+    {
+        stream_rgba(camera, dst, stream_condition);
+    }
+
+
+    void stream_camera(Camera& camera, img::SubView const& dst, bool_fn const& stream_condition)
+    {
+        stream_rgba(camera, dst, stream_condition);
     }
 
 
@@ -724,6 +1796,13 @@ namespace camera_usb
         camera.busy = 1;
         auto& device = w32_list.devices[camera.id];
 
+        // only this path converts into device.rgba
+        if (!create_rgba_view(device))
+        {
+            camera.busy = 0;
+            return;
+        }
+
         auto c_status = camera.status;
 
         camera.status = CameraStatus::Streaming;
@@ -731,13 +1810,13 @@ namespace camera_usb
         while (stream_condition())
         {
             device.grab_sw.start();
-            if (grab_and_convert_frame_rgba(device, device.rgba))
+            if (grab_and_convert_frame_rgba(device, device.rgba, GRAB_TIMEOUT_US).ok())
             {
                 on_grab(device.rgba);
             }
 
             device.grab_ms = device.grab_sw.get_time_milli();
-            camera.fps = num::round_to_unsigned<u32>(1000.0 / device.grab_ms);
+            update_fps(camera, device);
         }
 
         camera.busy = 0;
@@ -749,16 +1828,22 @@ namespace camera_usb
     {
         camera.busy = 1;
         auto& device = w32_list.devices[camera.id];
+
+        if (!create_planar_view(device))
+        {
+            camera.busy = 0;
+            return;
+        }
         
         device.grab_sw.start();
 
-        if (!grab_and_convert_frame_rgb(device, dst))
+        if (!grab_and_convert_frame_rgb(device, dst, GRAB_TIMEOUT_US).ok())
         {
             
         }
 
         device.grab_ms = device.grab_sw.get_time_milli();
-        camera.fps = num::round_to_unsigned<u32>(1000.0 / device.grab_ms);
+        update_fps(camera, device);
 
         camera.busy = 0;
     }
@@ -771,23 +1856,96 @@ namespace camera_usb
         
         device.grab_sw.start();
 
-        if (!grab_and_convert_frame_yuv(device, dst))
+        if (!grab_and_convert_frame_yuv(device, dst, GRAB_TIMEOUT_US).ok())
+        {
+            
+        }
+
+        device.grab_ms = device.grab_sw.get_time_milli();
+        update_fps(camera, device);
+
+        camera.busy = 0;
+    }
+
+
+    void grab_planar_yuv(Camera& camera, img::View3<u16> const& dst)
+    {
+        camera.busy = 1;
+        auto& device = w32_list.devices[camera.id];
+        
+        device.grab_sw.start();
+
+        if (!grab_and_convert_frame_yuv(device, dst, GRAB_TIMEOUT_US).ok())
         {
             
         }
 
         device.grab_ms = device.grab_sw.get_time_milli();
-        camera.fps = num::round_to_unsigned<u32>(1000.0 / device.grab_ms);
+        update_fps(camera, device);
 
         camera.busy = 0;
     }
 
 
+    GrabResult grab_image(Camera& camera, img::ImageView const& dst, u32 timeout_us)
+    {
+        return grab_rgba_timed(camera, dst, to_device_timeout(timeout_us));
+    }
+
+
+    GrabResult grab_image(Camera& camera, img::SubView const& dst, u32 timeout_us)
+    {
+        return grab_rgba_timed(camera, dst, to_device_timeout(timeout_us));
+    }
+
+
+    GrabResult grab_planar_yuv(Camera& camera, img::View3u8 const& dst, u32 timeout_us)
+    {
+        return grab_yuv_timed(camera, dst, to_device_timeout(timeout_us));
+    }
+
+
+    GrabResult grab_planar_yuv(Camera& camera, img::View3<u16> const& dst, u32 timeout_us)
+    {
+        return grab_yuv_timed(camera, dst, to_device_timeout(timeout_us));
+    }
+
+
+    GrabResult try_grab_image(Camera& camera, img::ImageView const& dst)
+    {
+        return grab_rgba_timed(camera, dst, -1);
+    }
+
+
+    GrabResult try_grab_image(Camera& camera, img::SubView const& dst)
+    {
+        return grab_rgba_timed(camera, dst, -1);
+    }
+
+
+    GrabResult try_grab_planar_yuv(Camera& camera, img::View3u8 const& dst)
+    {
+        return grab_yuv_timed(camera, dst, -1);
+    }
+
+
+    GrabResult try_grab_planar_yuv(Camera& camera, img::View3<u16> const& dst)
+    {
+        return grab_yuv_timed(camera, dst, -1);
+    }
+
+
     void stream_planar_rgb(Camera& camera, planar_cb const& proc, bool_fn const& stream_condition)
     {
         camera.busy = 1;
         auto& device = w32_list.devices[camera.id];
 
+        if (!create_planar_view(device))
+        {
+            camera.busy = 0;
+            return;
+        }
+
         auto c_status = camera.status;
 
         camera.status = CameraStatus::Streaming;
@@ -795,13 +1953,13 @@ namespace camera_usb
         while (stream_condition())
         {
             device.grab_sw.start();
-            if (grab_and_convert_frame_rgb(device, device.view3))
+            if (grab_and_convert_frame_rgb(device, device.view3, GRAB_TIMEOUT_US).ok())
             {
                 proc(device.view3);
             }
 
             device.grab_ms = device.grab_sw.get_time_milli();
-            camera.fps = num::round_to_unsigned<u32>(1000.0 / device.grab_ms);
+            update_fps(camera, device);
         }
 
         camera.busy = 0;
@@ -814,6 +1972,12 @@ namespace camera_usb
         camera.busy = 1;
         auto& device = w32_list.devices[camera.id];
 
+        if (!create_planar_view(device))
+        {
+            camera.busy = 0;
+            return;
+        }
+
         auto c_status = camera.status;
 
         camera.status = CameraStatus::Streaming;
@@ -821,13 +1985,13 @@ namespace camera_usb
         while (stream_condition())
         {
             device.grab_sw.start();
-            if (grab_and_convert_frame_yuv(device, device.view3))
+            if (grab_and_convert_frame_yuv(device, device.view3, GRAB_TIMEOUT_US).ok())
             {
                 proc(device.view3);
             }
 
             device.grab_ms = device.grab_sw.get_time_milli();
-            camera.fps = num::round_to_unsigned<u32>(1000.0 / device.grab_ms);
+            update_fps(camera, device);
         }
 
         camera.busy = 0;
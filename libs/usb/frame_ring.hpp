@@ -0,0 +1,275 @@
+#pragma once
+
+#include "../image/convert.hpp"
+
+#include <atomic>
+#include <thread>
+
+
+/* frame ring */
+
+namespace camera_usb
+{
+    enum class OverflowPolicy : u8
+    {
+        DropOldest = 0,
+        DropNewest,
+        Block
+    };
+
+
+    class FrameYUV
+    {
+    public:
+        convert::ViewYUV view;
+
+        // sequence counts every frame captured, gaps are dropped frames
+        u64 sequence = 0;
+        u64 timestamp_ns = 0;
+
+        // see GrabResult::capture_ns
+        u64 capture_ns = 0;
+    };
+
+
+    constexpr u32 RING_CAPACITY_MAX = 16;
+
+    // frames decoded outside the ring, see swap_write
+    constexpr u32 RING_SPARES_MAX = 8;
+
+
+    // single producer (capture thread), single consumer
+    // positions only increase, slot = position % n_slots
+    class FrameRing
+    {
+    public:
+        static constexpr u64 NO_FRAME = (u64)-1;
+
+        // one more slot than capacity, the consumer holds one while reading
+        FrameYUV slots[RING_CAPACITY_MAX + 1];
+        u32 n_slots = 0;
+
+        // same size as the slots, traded with them by swap_write
+        convert::ViewYUV spares[RING_SPARES_MAX];
+        u32 n_spares = 0;
+
+        OverflowPolicy policy = OverflowPolicy::DropOldest;
+
+        image::Buffer8 data;
+
+        std::atomic<u64> write_pos = 0;
+        std::atomic<u64> read_pos = 0;
+        std::atomic<u64> held_pos = NO_FRAME;
+
+        std::atomic<u64> n_dropped = 0;
+    };
+}
+
+
+namespace camera_usb
+{
+namespace ring
+{
+    inline void destroy(FrameRing& ring)
+    {
+        mb::destroy_buffer(ring.data);
+
+        for (u32 i = 0; i < ring.n_slots; i++)
+        {
+            ring.slots[i] = {};
+        }
+
+        ring.n_slots = 0;
+
+        for (u32 i = 0; i < ring.n_spares; i++)
+        {
+            ring.spares[i] = {};
+        }
+
+        ring.n_spares = 0;
+    }
+
+
+    inline bool create(FrameRing& ring, u32 capacity, u32 width, u32 height, OverflowPolicy policy, u32 n_spares = 0)
+    {
+        assert(capacity && capacity <= RING_CAPACITY_MAX);
+        assert(n_spares <= RING_SPARES_MAX);
+
+        capacity = capacity < 1 ? 1 : capacity;
+        capacity = capacity > RING_CAPACITY_MAX ? RING_CAPACITY_MAX : capacity;
+
+        n_spares = n_spares > RING_SPARES_MAX ? RING_SPARES_MAX : n_spares;
+
+        destroy(ring);
+
+        auto n_slots = capacity + 1;
+
+        ring.data = image::create_buffer8((n_slots + n_spares) * 3 * width * height, "frame ring");
+        if (!ring.data.ok)
+        {
+            return false;
+        }
+
+        for (u32 i = 0; i < n_slots; i++)
+        {
+            ring.slots[i].view = convert::make_view_yuv(width, height, ring.data);
+        }
+
+        for (u32 i = 0; i < n_spares; i++)
+        {
+            ring.spares[i] = convert::make_view_yuv(width, height, ring.data);
+        }
+
+        ring.n_spares = n_spares;
+
+        ring.n_slots = n_slots;
+        ring.policy = policy;
+
+        ring.write_pos = 0;
+        ring.read_pos = 0;
+        ring.held_pos = FrameRing::NO_FRAME;
+        ring.n_dropped = 0;
+
+        return true;
+    }
+
+
+    // producer, nullptr when the frame is to be dropped
+    // is_on ends waiting with OverflowPolicy::Block
+    template <class FN>
+    inline FrameYUV* begin_write(FrameRing& ring, FN const& is_on)
+    {
+        u64 const n = ring.n_slots;
+        u64 const capacity = n - 1;
+
+        auto w = ring.write_pos.load(std::memory_order_relaxed);
+
+        for (;;)
+        {
+            auto r = ring.read_pos.load(std::memory_order_acquire);
+            if (w - r < capacity)
+            {
+                break;
+            }
+
+            switch (ring.policy)
+            {
+            case OverflowPolicy::DropNewest:
+                ring.n_dropped++;
+                return nullptr;
+
+            case OverflowPolicy::Block:
+                if (!is_on())
+                {
+                    return nullptr;
+                }
+                std::this_thread::yield();
+                break;
+
+            case OverflowPolicy::DropOldest:
+                // races the consumer for the oldest frame, either way it is gone
+                if (ring.read_pos.compare_exchange_strong(r, r + 1))
+                {
+                    ring.n_dropped++;
+                }
+                break;
+            }
+        }
+
+        // after dropping a full lap the slot may still be held by the consumer
+        auto h = ring.held_pos.load();
+        if (h != FrameRing::NO_FRAME && (w - h) % n == 0)
+        {
+            ring.n_dropped++;
+            return nullptr;
+        }
+
+        return ring.slots + (w % n);
+    }
+
+
+    // producer, false while a OverflowPolicy::Block ring is full, begin_write would wait
+    inline bool can_write(FrameRing& ring)
+    {
+        if (ring.policy != OverflowPolicy::Block)
+        {
+            return true;
+        }
+
+        auto w = ring.write_pos.load(std::memory_order_relaxed);
+        auto r = ring.read_pos.load(std::memory_order_acquire);
+
+        return w - r < ring.n_slots - 1;
+    }
+
+
+    // producer, publishes the slot from begin_write
+    inline void end_write(FrameRing& ring)
+    {
+        auto w = ring.write_pos.load(std::memory_order_relaxed);
+
+        ring.write_pos.store(w + 1, std::memory_order_release);
+    }
+
+
+    // producer, publishes a frame that was written into a spare without copying it
+    // frame takes the slot's buffer in exchange, false when the frame is dropped
+    template <class FN>
+    inline bool swap_write(FrameRing& ring, FrameYUV& frame, FN const& is_on)
+    {
+        auto slot = begin_write(ring, is_on);
+        if (!slot)
+        {
+            return false;
+        }
+
+        auto view = slot->view;
+
+        *slot = frame;
+        frame.view = view;
+
+        end_write(ring);
+
+        return true;
+    }
+
+
+    // consumer, oldest or newest complete frame
+    // the frame stays valid until the next read or release
+    inline FrameYUV* read(FrameRing& ring, bool latest)
+    {
+        if (!ring.n_slots)
+        {
+            return nullptr;
+        }
+
+        auto r = ring.read_pos.load(std::memory_order_acquire);
+
+        for (;;)
+        {
+            auto w = ring.write_pos.load(std::memory_order_acquire);
+            if (r == w)
+            {
+                ring.held_pos = FrameRing::NO_FRAME;
+                return nullptr;
+            }
+
+            auto pos = latest ? w - 1 : r;
+
+            // publish before taking it so the producer never writes into it
+            ring.held_pos = pos;
+
+            if (ring.read_pos.compare_exchange_weak(r, pos + 1))
+            {
+                return ring.slots + (pos % ring.n_slots);
+            }
+        }
+    }
+
+
+    inline void release(FrameRing& ring)
+    {
+        ring.held_pos = FrameRing::NO_FRAME;
+    }
+}
+}
@@ -7,7 +7,7 @@
 
 //#define LIBUVC_IMPLEMENTATION
 
-//#define LIBUVC_HAS_JPEG 1
+#define LIBUVC_HAS_JPEG 1
 
 #ifndef  NDEBUG
 //#define UVC_DEBUGGING
@@ -528,6 +528,19 @@ namespace uvc
         /** Estimate of system time when the device finished receiving the image */
         timespec capture_time_finished;
 
+        /** Steady clock time in nanoseconds, taken with capture_time_finished */
+        uint64_t capture_steady_ns;
+
+        /** Presentation time stamp and source clock reference from the payload headers, 0 if not sent */
+        uint32_t pts;
+        uint32_t scr;
+
+        /** USB frame number sent with the source clock reference (11 bits) */
+        uint16_t sof;
+
+        /** Payload bytes the stream received up to this frame, headers included */
+        uint64_t bytes_received;
+
         /** Handle on the device that produced the image.
          * @warning You must not call any uvc_* functions during a callback. */
         uvc_device_handle_t *source;
@@ -698,6 +711,11 @@ namespace uvc
     uvc_error_t uvc_stream_get_frame2(uvc_stream_handle_t *strmh, uvc_frame_desc_t *frame_desc, uvc_frame_t **frame);
 
 
+    uvc_error_t uvc_stream_borrow_frame(uvc_stream_handle_t *strmh, uvc_frame_t **frame, int32_t timeout_us);
+
+    void uvc_stream_return_frame(uvc_stream_handle_t *strmh, uvc_frame_t *frame);
+
+
     uvc_error_t uvc_stream_stop(uvc_stream_handle_t *strmh);
     void uvc_stream_close(uvc_stream_handle_t *strmh);
 
@@ -877,6 +895,7 @@ namespace uvc
     using frame_format = uvc_frame_format;
 
     using u8 = uint8_t;
+    using u16 = uint16_t;
     using u32 = uint32_t;
 }
 
@@ -900,6 +919,10 @@ namespace opt
 
     FrameFormat find_frame_format_by_wh(uvc_device_handle *devh, u32 four_cc_bytes, u32 width, u32 height);
 
+    // every format, size and interval, returns the number written
+    // returns the number of modes the descriptors list, writes at most capacity of them
+    u32 list_frame_formats(uvc_device_handle *devh, FrameFormat* dst, u32 capacity);
+
 
 
     uvc_format_desc* find_format_desc(uvc_device_handle *devh, u32 four_cc_bytes);
@@ -912,9 +935,119 @@ namespace opt
         int fps);
 
 
+    using hotplug_cb = void(*)(void* user);
+
+    // cb runs on whichever thread handles libusb events, returns -1 when hotplug is not supported
+    int register_hotplug(uvc_context* ctx, hotplug_cb cb, void* user);
+
+    void deregister_hotplug(uvc_context* ctx, int handle);
+
+    // delivers pending hotplug events when no stream is running the event thread
+    void handle_events_nowait(uvc_context* ctx);
+
+    // from the cached device descriptor, the device is not opened
+    bool get_device_ids(uvc_device* dev, u16& vendor_id, u16& product_id);
+
+
+    class TransferTuning
+    {
+    public:
+        // most transfers the stream may have, and packets in each isochronous one
+        u32 n_transfers = 0;
+        u32 packets_per_transfer = 0;
+
+        // transfers in flight now, and the fewest that have not lost a frame
+        u32 depth = 0;
+        u32 depth_floor = 0;
+
+        uint64_t incomplete_frames = 0;
+        uint64_t packet_errors = 0;
+
+        // bulk frames received in place, see set_bulk_scatter
+        b8 scatter = 0;
+        uint64_t scatter_frames = 0;
+    };
+
+    // before uvc_stream_start, 0 keeps the LIBUVC_NUM_TRANSFER_BUFS and LIBUVC_DEFAULT_ISO_PACKETS defaults
+    // auto_tune keeps as few transfers in flight as lose no frames, at most n_transfers
+    void set_stream_transfers(stream_handle* strmh, u32 n_transfers, u32 packets_per_transfer, b8 auto_tune);
+
+    TransferTuning get_stream_transfers(stream_handle* strmh);
+
+    // before uvc_stream_start, on by default
+    // bulk streams with payloads of a whole frame receive into frame buffers instead of copying
+    void set_bulk_scatter(stream_handle* strmh, b8 on);
+
+
+    // writes every payload the stream receives, headers included, until stop_recording or uvc_stream_close
+    b8 start_recording(stream_handle* strmh, const char* path);
+
+    // returns the number of payloads written
+    uint64_t stop_recording(stream_handle* strmh);
+
+    // a device that plays a recording through the stream functions, close it with uvc_close
+    // it has the one format and frame of the recording and no controls
+    error open_replay(const char* path, device_handle** devh);
+
+    // before uvc_stream_start, rate 1 keeps the recorded timing and 0 replays as fast as possible
+    void set_replay_rate(device_handle* devh, float rate, b8 loop);
+
+
+    // writes the next payload, header included, to dst and returns its length, 0 ends the stream
+    // due_ns is when the payload arrives, counted from the start of the stream
+    using payload_cb = u32(*)(void* user, u8* dst, u32 capacity, u64* due_ns);
+
+
+    class PayloadSource
+    {
+    public:
+        // a format the stream functions know, MJPG or an uncompressed GUID
+        u32 four_cc_bytes = 0;
+        u8 bits_per_pixel = 0;
+
+        u32 width = 0;
+        u32 height = 0;
+
+        // 100 ns units
+        u32 interval = 0;
+
+        u32 max_frame_bytes = 0;
+        u32 max_payload_bytes = 0;
+
+        payload_cb next = nullptr;
+        void* user = nullptr;
+    };
+
+    // a replay device whose payloads come from source.next on the stream's thread, user must outlive it
+    // paced by set_replay_rate, it never loops
+    error open_payload_source(PayloadSource const& source, device_handle** devh);
+
+
 #ifdef LIBUVC_HAS_JPEG
-    error mjpeg2rgba(frame* in, u8* out);
-    error mjpeg2gray(frame* in, u8* out);
+    // one-shot conversions, frames with restart markers decode in stripes when n_threads > 1
+    error mjpeg2rgba(frame* in, u8* out, u32 n_threads = 1);
+    error mjpeg2gray(frame* in, u8* out, u32 n_threads = 1);
+
+
+    class jpeg_decoder;
+
+    // one per stream, reused for every frame
+    jpeg_decoder* create_jpeg_decoder();
+
+    void destroy_jpeg_decoder(jpeg_decoder* decoder);
+
+    // rows are stride bytes apart
+    error mjpeg_decode_rgba(jpeg_decoder* decoder, frame* in, u8* out, u32 stride);
+
+    // full size planes, subsampled chroma is repeated
+    error mjpeg_decode_yuv(jpeg_decoder* decoder, frame* in, u8* y, u8* u, u8* v);
+
+    // frames with restart markers decode in stripes on n_threads, serial otherwise
+    // the decoder keeps n_threads - 1 workers until the count changes or it is destroyed
+    void set_jpeg_threads(jpeg_decoder* decoder, u32 n_threads);
+
+    // YUYV to a baseline 4:2:2 jpeg with a restart marker every MCU row, returns its size, 0 if it doesn't fit
+    u32 mjpeg_encode_yuyv(u8 const* yuyv, u32 width, u32 height, u8* dst, u32 capacity, int quality);
 #endif  
 
 }}
@@ -934,6 +1067,7 @@ namespace opt
 #include <setjmp.h>
 
 #include <chrono>
+#include <thread>
 
 #ifdef LIBUVC_HAS_JPEG
 #include <jpeglib.h>
@@ -1016,6 +1150,24 @@ namespace uvc
     }
 
 
+    // false when timed out
+    static bool mutex_wait(mutex_t& mtx, int32_t timeout_us)
+    {
+        ::timespec ts;
+        clock_gettime(CLOCK_REALTIME, &ts);
+
+        ts.tv_sec += timeout_us / 1000000;
+        ts.tv_nsec += (timeout_us % 1000000) * 1000;
+        if (ts.tv_nsec >= 1000000000)
+        {
+            ts.tv_sec++;
+            ts.tv_nsec -= 1000000000;
+        }
+
+        return pthread_cond_timedwait(&mtx.cond, &mtx.mutex, &ts) != ETIMEDOUT;
+    }
+
+
     static void mutex_unlock(mutex_t& mtx)
     {
         pthread_mutex_unlock(&mtx.mutex);
@@ -1027,12 +1179,20 @@ namespace uvc
         pthread_cond_broadcast(&mtx.cond);
         pthread_mutex_unlock(&mtx.mutex);
     }
+
+
+    // mutex is held
+    static void mutex_broadcast(mutex_t& mtx)
+    {
+        pthread_cond_broadcast(&mtx.cond);
+    }
 }
 
 
 /* memory */
 
 #include "mem_uvc.hpp"
+#include "../span/span.hpp"
 
 
 /* utlist.h */
@@ -1987,7 +2147,8 @@ namespace uvc
   transfers. A better approach may be to make the transfer thread FIFO
   scheduled (if we have root).
   Default number of transfer buffers can be overwritten by defining
-  this macro.
+  this macro. It is also the most a stream can have, see
+  uvc::opt::set_stream_transfers.
  */
 #ifndef LIBUVC_NUM_TRANSFER_BUFS
 #if defined(__APPLE__) && defined(__MACH__)
@@ -1997,8 +2158,40 @@ namespace uvc
 #endif
 #endif
 
+/* Isochronous packets per transfer when not set on the stream, and the
+  most that can be set. usbfs rejects transfers with more than 128.
+ */
+#ifndef LIBUVC_DEFAULT_ISO_PACKETS
+#define LIBUVC_DEFAULT_ISO_PACKETS 32
+#endif
+
+#define LIBUVC_MAX_ISO_PACKETS 128
+
+/* Transfer queue auto-tuning, see _uvc_tune_frame. The depth grows at once
+  when a frame is lost and shrinks by one after clean windows of frames.
+ */
+#define LIBUVC_TUNE_MIN_DEPTH 2
+#define LIBUVC_TUNE_WINDOW_FRAMES 30
+#define LIBUVC_TUNE_SHRINK_WINDOWS 4
+
+/* Number of frames that can be borrowed at once with uvc_stream_borrow_frame.
+  Each one is a full frame buffer lent to the caller instead of copied.
+  Can be overwritten by defining this macro.
+ */
+#ifndef LIBUVC_NUM_FRAME_BUFS
+#define LIBUVC_NUM_FRAME_BUFS 3
+#endif
+
 #define LIBUVC_XFER_META_BUF_SIZE (4 * 1024)
 
+/* Frame buffers keep room in front of the image data. A bulk transfer that
+  starts a frame can then receive its payload header and image data straight
+  into a frame buffer, see _uvc_process_bulk_transfer.
+  Payloads with other header sizes are copied.
+ */
+#define LIBUVC_FRAME_HEADROOM 64
+#define LIBUVC_BULK_HEADER_BYTES 12
+
 
     struct uvc_stream_handle
     {
@@ -2017,22 +2210,71 @@ namespace uvc
         uint32_t seq, hold_seq;
         uint32_t pts, hold_pts;
         uint32_t last_scr, hold_last_scr;
+        uint16_t last_sof, hold_last_sof;
         size_t got_bytes, hold_bytes;
         uint8_t *outbuf, *holdbuf;
+        uint64_t bytes_received, hold_bytes_received;
         
         mutex_t cb_mutex;
 
         uint32_t last_polled_seq;
         
         struct libusb_transfer *transfers[LIBUVC_NUM_TRANSFER_BUFS];
+        /* as allocated, scatter transfers trade theirs for other frame buffers */
         uint8_t *transfer_bufs[LIBUVC_NUM_TRANSFER_BUFS];
+
+        /* set before uvc_stream_start, 0 for the defaults */
+        int n_transfers;
+        int packets_per_transfer;
+        uint8_t auto_tune;
+
+        /* transfer layout picked by uvc_stream_start */
+        uint8_t xfer_iso;
+        uint8_t xfer_endpoint;
+        int xfer_packets;
+        size_t xfer_packet_bytes;
+        size_t xfer_size;
+
+        /* transfers kept in flight, guarded by cb_mutex.
+         * depth_floor is the lowest depth that has not lost a frame */
+        int depth;
+        int depth_floor;
+        uint8_t frame_incomplete;
+        uint32_t tune_frames, tune_clean_windows;
+        uint64_t incomplete_frames, packet_errors;
+
+        /* uncompressed formats, 0 when frames vary in size */
+        size_t frame_bytes;
+
+        /* bulk transfers receive into frame buffers, see _uvc_process_bulk_transfer.
+         * bulk_scatter is the setting, xfer_scatter is set by uvc_stream_start */
+        uint8_t bulk_scatter;
+        uint8_t xfer_scatter;
+        uint64_t scatter_frames;
+
         struct uvc_frame frame;
         enum uvc_frame_format frame_format;
         struct timespec capture_time_finished;
+        uint64_t capture_steady_ns;
 
         /* raw metadata buffer if available */
         uint8_t *meta_outbuf, *meta_holdbuf;
         size_t meta_got_bytes, meta_hold_bytes;
+
+        /* frames lent by uvc_stream_borrow_frame, data is NULL when not lent.
+         * the hold buffer is lent and replaced with a spare */
+        struct uvc_frame lent_frames[LIBUVC_NUM_FRAME_BUFS];
+        uint8_t *spare_bufs[LIBUVC_NUM_FRAME_BUFS];
+        int n_spare_bufs;
+        size_t frame_buf_bytes;
+
+        /* payloads written as received, see uvc::opt::start_recording.
+         * the file is guarded by record_mutex, recording is checked without it */
+        uint8_t recording;
+        mutex_t record_mutex;
+        FILE *record_file;
+        uint64_t record_start_ns;
+        uint64_t record_payloads;
     };
 
 
@@ -2060,6 +2302,8 @@ namespace uvc
         /** Whether the camera is an iSight that sends one header per frame */
         uint8_t is_isight;
         uint32_t claimed;
+        /** Set when the device is a recording, see uvc::opt::open_replay */
+        struct uvc_replay *replay;
     };
 
     /** Context within which we communicate with devices */
@@ -2087,6 +2331,13 @@ namespace uvc
     void uvc_start_handler_thread(uvc_context_t *ctx);
     uvc_error_t uvc_claim_if(uvc_device_handle_t *devh, int idx);
     uvc_error_t uvc_release_if(uvc_device_handle_t *devh, int idx);
+
+    void _uvc_record_payload(uvc_stream_handle_t *strmh, uint8_t *payload, size_t payload_len);
+    void _uvc_stop_recording(uvc_stream_handle_t *strmh);
+    uvc_error_t _uvc_replay_query_ctrl(uvc_device_handle_t *devh, uvc_stream_ctrl_t *ctrl);
+    uvc_error_t _uvc_replay_start(uvc_stream_handle_t *strmh);
+    void _uvc_replay_stop(uvc_stream_handle_t *strmh);
+    void _uvc_replay_close(uvc_device_handle_t *devh);
     
 }
 
@@ -2244,6 +2495,9 @@ namespace uvc
         size_t len;
         uvc_error_t err;
 
+        if (devh->replay)
+            return _uvc_replay_query_ctrl(devh, ctrl);
+
         memset(buf, 0, sizeof(buf));
 
         if (devh->info->ctrl_if.bcdUVC >= 0x0110)
@@ -2728,7 +2982,251 @@ namespace uvc
 
         return res;
     }
-    
+
+
+
+    /** @internal
+     * @brief Allocate a frame buffer of strmh->frame_buf_bytes after LIBUVC_FRAME_HEADROOM bytes
+     */
+    uint8_t *_uvc_alloc_frame_buf(uvc_stream_handle_t *strmh, const char *tag)
+    {
+        uint8_t *base = uvc_malloc<uint8_t>(LIBUVC_FRAME_HEADROOM + strmh->frame_buf_bytes, tag);
+
+        return base ? base + LIBUVC_FRAME_HEADROOM : NULL;
+    }
+
+    void _uvc_free_frame_buf(uint8_t *buf)
+    {
+        if (buf)
+            uvc_free(buf - LIBUVC_FRAME_HEADROOM);
+    }
+
+
+
+    void LIBUSB_CALL _uvc_stream_callback(struct libusb_transfer *transfer);
+
+    /** @internal
+     * @brief Allocate a transfer into an empty slot, using the layout picked by uvc_stream_start
+     *
+     * Scatter transfers receive into a frame buffer of their own, the payload header
+     * goes into its headroom.
+     */
+    struct libusb_transfer *_uvc_alloc_transfer(uvc_stream_handle_t *strmh, int id)
+    {
+        struct libusb_transfer *transfer;
+        uint8_t *buf;
+
+        transfer = libusb_alloc_transfer(strmh->xfer_iso ? strmh->xfer_packets : 0);
+        if (!transfer)
+            return NULL;
+
+        if (strmh->xfer_scatter)
+        {
+            buf = _uvc_alloc_frame_buf(strmh, "strmh->transfer_bufs");
+            buf = buf ? buf - LIBUVC_BULK_HEADER_BYTES : NULL;
+        }
+        else
+        {
+            buf = uvc_malloc<uint8_t>(strmh->xfer_size, "strmh->transfer_bufs");
+        }
+
+        if (!buf)
+        {
+            libusb_free_transfer(transfer);
+            return NULL;
+        }
+
+        strmh->transfer_bufs[id] = buf;
+
+        if (strmh->xfer_iso)
+        {
+            libusb_fill_iso_transfer(
+                transfer, strmh->devh->usb_devh, strmh->xfer_endpoint,
+                strmh->transfer_bufs[id],
+                strmh->xfer_size, strmh->xfer_packets, _uvc_stream_callback, (void *)strmh, 5000);
+
+            libusb_set_iso_packet_lengths(transfer, strmh->xfer_packet_bytes);
+        }
+        else
+        {
+            libusb_fill_bulk_transfer(
+                transfer, strmh->devh->usb_devh, strmh->xfer_endpoint,
+                strmh->transfer_bufs[id],
+                strmh->xfer_size, _uvc_stream_callback, (void *)strmh, 5000);
+        }
+
+        strmh->transfers[id] = transfer;
+
+        return transfer;
+    }
+
+    /** @internal
+     * must be called with stream cb lock held!
+     */
+    void _uvc_free_transfer(uvc_stream_handle_t *strmh, int id)
+    {
+        struct libusb_transfer *transfer = strmh->transfers[id];
+
+        if (strmh->xfer_scatter)
+            _uvc_free_frame_buf(transfer->buffer + LIBUVC_BULK_HEADER_BYTES);
+        else
+            uvc_free(transfer->buffer);
+
+        libusb_free_transfer(transfer);
+        strmh->transfers[id] = NULL;
+        strmh->transfer_bufs[id] = NULL;
+    }
+
+    /** @internal
+     * must be called with stream cb lock held!
+     */
+    int _uvc_count_transfers(uvc_stream_handle_t *strmh)
+    {
+        int i, n = 0;
+
+        for (i = 0; i < LIBUVC_NUM_TRANSFER_BUFS; i++)
+        {
+            n += strmh->transfers[i] != NULL;
+        }
+
+        return n;
+    }
+
+    /** @internal
+     * @brief Transfers to start with: enough to cover one frame, plus one
+     *
+     * Isochronous transfers last packets * service interval whatever the payload,
+     * so they cover the frame interval. Bulk transfers carry up to
+     * dwMaxPayloadTransferSize each, so they cover the frame size.
+     */
+    int _uvc_initial_depth(uvc_stream_handle_t *strmh)
+    {
+        uvc_stream_ctrl_t *ctrl = &strmh->cur_ctrl;
+        size_t depth;
+
+        if (strmh->xfer_iso)
+        {
+            size_t service_100ns = libusb_get_device_speed(strmh->devh->dev->usb_dev) >= LIBUSB_SPEED_HIGH ? 1250 : 10000;
+            size_t transfer_100ns = strmh->xfer_packets * service_100ns;
+
+            depth = (ctrl->dwFrameInterval + transfer_100ns - 1) / transfer_100ns;
+        }
+        else
+        {
+            depth = (ctrl->dwMaxVideoFrameSize + strmh->xfer_size - 1) / strmh->xfer_size;
+        }
+
+        depth += 1;
+
+        if (depth < LIBUVC_TUNE_MIN_DEPTH)
+            depth = LIBUVC_TUNE_MIN_DEPTH;
+
+        if (depth > (size_t)strmh->n_transfers)
+            depth = strmh->n_transfers;
+
+        return (int)depth;
+    }
+
+    /** @internal
+     * @brief Count a finished frame toward the transfer depth
+     *
+     * A lost frame grows the depth by half at once and marks the old depth as too
+     * shallow. Clean windows of frames shrink it by one, never to a depth that lost one.
+     * must be called with stream cb lock held!
+     */
+    void _uvc_tune_frame(uvc_stream_handle_t *strmh, uint8_t lost)
+    {
+        int grow;
+
+        if (lost)
+            strmh->incomplete_frames++;
+
+        if (!strmh->auto_tune)
+            return;
+
+        if (lost)
+        {
+            grow = strmh->depth / 2 > 1 ? strmh->depth / 2 : 1;
+
+            strmh->depth_floor = strmh->depth + 1;
+            strmh->depth += grow;
+
+            if (strmh->depth_floor > strmh->n_transfers)
+                strmh->depth_floor = strmh->n_transfers;
+
+            if (strmh->depth > strmh->n_transfers)
+                strmh->depth = strmh->n_transfers;
+
+            strmh->tune_frames = 0;
+            strmh->tune_clean_windows = 0;
+            return;
+        }
+
+        if (++strmh->tune_frames < LIBUVC_TUNE_WINDOW_FRAMES)
+            return;
+
+        strmh->tune_frames = 0;
+
+        if (++strmh->tune_clean_windows < LIBUVC_TUNE_SHRINK_WINDOWS)
+            return;
+
+        strmh->tune_clean_windows = 0;
+
+        if (strmh->depth > strmh->depth_floor)
+            strmh->depth--;
+    }
+
+    /** @internal
+     * @brief Free or add transfers until depth are in flight
+     *
+     * @return 0 if the completed transfer was freed and must not be resubmitted
+     */
+    int _uvc_adjust_transfers(uvc_stream_handle_t *strmh, struct libusb_transfer *transfer)
+    {
+        int i, n, keep = 1;
+
+        mutex_lock(strmh->cb_mutex);
+
+        n = _uvc_count_transfers(strmh);
+
+        if (n > strmh->depth)
+        {
+            for (i = 0; i < LIBUVC_NUM_TRANSFER_BUFS; i++)
+            {
+                if (strmh->transfers[i] == transfer)
+                {
+                    _uvc_free_transfer(strmh, i);
+                    keep = 0;
+                    break;
+                }
+            }
+        }
+        else if (strmh->running)
+        {
+            for (i = 0; i < LIBUVC_NUM_TRANSFER_BUFS && n < strmh->depth; i++)
+            {
+                if (strmh->transfers[i])
+                    continue;
+
+                if (!_uvc_alloc_transfer(strmh, i))
+                    break;
+
+                if (libusb_submit_transfer(strmh->transfers[i]) < 0)
+                {
+                    _uvc_free_transfer(strmh, i);
+                    break;
+                }
+
+                n++;
+            }
+        }
+
+        /* uvc_stream_stop may be waiting on freed transfers */
+        mutex_unlock_broadcast(strmh->cb_mutex);
+
+        return keep;
+    }
+
 
     /** @internal
      * @brief Swap the working buffer with the presented buffer and notify consumers
@@ -2740,9 +3238,19 @@ namespace uvc
         mutex_lock(strmh->cb_mutex);
 
         auto time = chr::system_clock::now().time_since_epoch();
+        auto steady = chr::steady_clock::now().time_since_epoch();
 
-        strmh->capture_time_finished.tv_nsec = (long)chr::duration_cast<chr::nanoseconds>(time).count();
-        strmh->capture_time_finished.tv_sec = (long)chr::duration_cast<chr::seconds>(time).count();
+        auto sec = chr::duration_cast<chr::seconds>(time);
+
+        strmh->capture_time_finished.tv_sec = (long)sec.count();
+        strmh->capture_time_finished.tv_nsec = (long)chr::duration_cast<chr::nanoseconds>(time - sec).count();
+        strmh->capture_steady_ns = (uint64_t)chr::duration_cast<chr::nanoseconds>(steady).count();
+
+        /* the stream may start partway into the first frame */
+        if (strmh->seq > 1)
+            _uvc_tune_frame(strmh, strmh->frame_incomplete || strmh->got_bytes < strmh->frame_bytes);
+
+        strmh->frame_incomplete = 0;
 
         /* swap the buffers */
         tmp_buf = strmh->holdbuf;
@@ -2750,8 +3258,10 @@ namespace uvc
         strmh->holdbuf = strmh->outbuf;
         strmh->outbuf = tmp_buf;
         strmh->hold_last_scr = strmh->last_scr;
+        strmh->hold_last_sof = strmh->last_sof;
         strmh->hold_pts = strmh->pts;
         strmh->hold_seq = strmh->seq;
+        strmh->hold_bytes_received = strmh->bytes_received;
 
         /* swap metadata buffer */
         tmp_buf = strmh->meta_holdbuf;
@@ -2765,6 +3275,7 @@ namespace uvc
         strmh->got_bytes = 0;
         strmh->meta_got_bytes = 0;
         strmh->last_scr = 0;
+        strmh->last_sof = 0;
         strmh->pts = 0;
     }
 
@@ -2793,6 +3304,8 @@ namespace uvc
         if (payload_len == 0)
             return;
 
+        strmh->bytes_received += payload_len;
+
         /* Certain iSight cameras have strange behavior: They send header
          * information in a packet with no image data, and then the following
          * packets have only image data, with no more headers until the next frame.
@@ -2847,6 +3360,7 @@ namespace uvc
                 /* The frame ID bit was flipped, but we have image data sitting
                    around from prior transfers. This means the camera didn't send
                    an EOF for the last transfer of the previous frame. */
+                strmh->frame_incomplete = 1;
                 _uvc_swap_buffers(strmh);
             }
 
@@ -2860,8 +3374,8 @@ namespace uvc
 
             if (header_info & (1 << 3))
             {
-                /** @todo read the SOF token counter */
                 strmh->last_scr = DW_TO_INT(payload + variable_offset);
+                strmh->last_sof = SW_TO_SHORT(payload + variable_offset + 4) & 0x7FF;
                 variable_offset += 6;
             }
 
@@ -2880,7 +3394,9 @@ namespace uvc
         {
             if (strmh->got_bytes + data_len > strmh->cur_ctrl.dwMaxVideoFrameSize)
                 data_len = strmh->cur_ctrl.dwMaxVideoFrameSize - strmh->got_bytes; /* Avoid overflow. */
-            memcpy(strmh->outbuf + strmh->got_bytes, payload + header_len, data_len);
+            /* scatter transfers receive the data in place, see _uvc_process_bulk_transfer */
+            if (payload + header_len != strmh->outbuf + strmh->got_bytes)
+                memcpy(strmh->outbuf + strmh->got_bytes, payload + header_len, data_len);
             strmh->got_bytes += data_len;
             if (header_info & (1 << 1) || strmh->got_bytes == strmh->cur_ctrl.dwMaxVideoFrameSize)
             {
@@ -2891,50 +3407,169 @@ namespace uvc
     }
 
     /** @internal
-     * @brief Stream transfer callback
-     *
-     * Processes stream, places frames into buffer, signals listeners
-     * (such as user callback thread and any polling thread) on new frame
+     * @brief Process a bulk transfer
      *
-     * @param transfer Active transfer
+     * A scatter transfer that starts a frame already holds the image data at the
+     * start of its frame buffer. That buffer becomes the out buffer and the transfer
+     * takes the old out buffer for its next payload, so the frame is not copied.
+     * Payloads that continue a frame are copied as before.
      */
-    void LIBUSB_CALL _uvc_stream_callback(struct libusb_transfer *transfer)
+    void _uvc_process_bulk_transfer(uvc_stream_handle_t *strmh, struct libusb_transfer *transfer)
     {
-        uvc_stream_handle_t *strmh = (uvc_stream_handle_t *)transfer->user_data;
+        uint8_t *payload = transfer->buffer;
+        size_t payload_len = transfer->actual_length;
 
-        int resubmit = 1;
+        _uvc_record_payload(strmh, payload, payload_len);
 
-        switch (transfer->status)
+        if (strmh->xfer_scatter && payload_len > LIBUVC_BULK_HEADER_BYTES &&
+            payload[0] == LIBUVC_BULK_HEADER_BYTES && !(payload[1] & 0x40))
         {
-        case LIBUSB_TRANSFER_COMPLETED:
-            if (transfer->num_iso_packets == 0)
+            if (strmh->got_bytes != 0 && strmh->fid != (payload[1] & 1))
             {
-                /* This is a bulk mode transfer, so it just has one payload transfer */
-                _uvc_process_payload(strmh, transfer->buffer, transfer->actual_length);
+                /* no EOF for the last frame, publish it before its buffer is traded */
+                strmh->frame_incomplete = 1;
+                _uvc_swap_buffers(strmh);
             }
-            else
+
+            if (strmh->got_bytes == 0)
             {
-                /* This is an isochronous mode transfer, so each packet has a payload transfer */
-                int packet_id;
+                transfer->buffer = strmh->outbuf - LIBUVC_BULK_HEADER_BYTES;
+                strmh->outbuf = payload + LIBUVC_BULK_HEADER_BYTES;
+                strmh->scatter_frames++;
+            }
+        }
 
-                for (packet_id = 0; packet_id < transfer->num_iso_packets; ++packet_id)
-                {
-                    uint8_t *pktbuf;
-                    struct libusb_iso_packet_descriptor *pkt;
+        _uvc_process_payload(strmh, payload, payload_len);
+    }
 
-                    pkt = transfer->iso_packet_desc + packet_id;
+    /** @internal
+     * @brief Process the packets of an isochronous transfer
+     *
+     * The packet headers are read in one pass. Packets that only continue the
+     * current frame (same frame id, no EOF, error or metadata, room left) are then
+     * copied straight into the out buffer, anything else goes through
+     * _uvc_process_payload. Bad packets are kept in order so the error marks the
+     * frame that lost them.
+     */
+    void _uvc_process_iso_transfer(uvc_stream_handle_t *strmh, struct libusb_transfer *transfer)
+    {
+        struct iso_payload
+        {
+            uint8_t *data;
+            size_t len;
+            size_t header_len;
+            uint8_t info;
+            uint8_t plain;
+            uint8_t bad;
+        };
 
-                    if (pkt->status != 0)
-                    {
-                        UVC_DEBUG("bad packet (isochronous transfer); status: %d", pkt->status);
-                        continue;
-                    }
+        struct iso_payload payloads[LIBUVC_MAX_ISO_PACKETS];
 
-                    pktbuf = libusb_get_iso_packet_buffer_simple(transfer, packet_id);
+        int first, packet_id, i, n;
 
-                    _uvc_process_payload(strmh, pktbuf, pkt->actual_length);
-                }
-            }
+        for (first = 0; first < transfer->num_iso_packets; first += LIBUVC_MAX_ISO_PACKETS)
+        {
+            n = 0;
+
+            for (packet_id = first; packet_id < transfer->num_iso_packets && packet_id < first + LIBUVC_MAX_ISO_PACKETS; ++packet_id)
+            {
+                struct libusb_iso_packet_descriptor *pkt = transfer->iso_packet_desc + packet_id;
+
+                if (pkt->status != 0)
+                {
+                    UVC_DEBUG("bad packet (isochronous transfer); status: %d", pkt->status);
+                    payloads[n++].bad = 1;
+                    continue;
+                }
+
+                if (pkt->actual_length == 0)
+                    continue;
+
+                struct iso_payload *p = payloads + n++;
+
+                p->bad = 0;
+                p->data = libusb_get_iso_packet_buffer_simple(transfer, packet_id);
+                p->len = pkt->actual_length;
+
+                _uvc_record_payload(strmh, p->data, p->len);
+                p->header_len = p->data[0];
+                p->info = p->len > 1 ? p->data[1] : 0;
+                p->plain = !strmh->devh->is_isight &&
+                           p->header_len >= 2 && p->header_len < p->len &&
+                           !(p->info & 0x42) &&
+                           p->header_len == 2u + ((p->info & UVC_STREAM_PTS) ? 4u : 0u) + ((p->info & UVC_STREAM_SCR) ? 6u : 0u);
+            }
+
+            for (i = 0; i < n; i++)
+            {
+                struct iso_payload *p = payloads + i;
+
+                if (p->bad)
+                {
+                    strmh->packet_errors++;
+                    strmh->frame_incomplete = 1;
+                    continue;
+                }
+
+                size_t data_len = p->len - p->header_len;
+
+                if (!p->plain || strmh->fid != (p->info & 1) ||
+                    strmh->got_bytes + data_len >= strmh->cur_ctrl.dwMaxVideoFrameSize)
+                {
+                    _uvc_process_payload(strmh, p->data, p->len);
+                    continue;
+                }
+
+                strmh->bytes_received += p->len;
+
+                if (p->info & (1 << 2))
+                    strmh->pts = DW_TO_INT(p->data + 2);
+
+                if (p->info & (1 << 3))
+                {
+                    uint8_t *scr = p->data + ((p->info & (1 << 2)) ? 6 : 2);
+                    strmh->last_scr = DW_TO_INT(scr);
+                    strmh->last_sof = SW_TO_SHORT(scr + 4) & 0x7FF;
+                }
+
+                span::copy_u8(p->data + p->header_len, strmh->outbuf + strmh->got_bytes, data_len);
+                strmh->got_bytes += data_len;
+            }
+        }
+    }
+
+    /** @internal
+     * @brief Stream transfer callback
+     *
+     * Processes stream, places frames into buffer, signals listeners
+     * (such as user callback thread and any polling thread) on new frame
+     *
+     * @param transfer Active transfer
+     */
+    void LIBUSB_CALL _uvc_stream_callback(struct libusb_transfer *transfer)
+    {
+        uvc_stream_handle_t *strmh = (uvc_stream_handle_t *)transfer->user_data;
+
+        int resubmit = 1;
+
+        switch (transfer->status)
+        {
+        case LIBUSB_TRANSFER_COMPLETED:
+            if (transfer->num_iso_packets == 0)
+            {
+                /* This is a bulk mode transfer, so it just has one payload transfer */
+                _uvc_process_bulk_transfer(strmh, transfer);
+            }
+            else
+            {
+                /* This is an isochronous mode transfer, so each packet has a payload transfer */
+                _uvc_process_iso_transfer(strmh, transfer);
+            }
+
+            if (strmh->auto_tune && strmh->running && !_uvc_adjust_transfers(strmh, transfer))
+            {
+                resubmit = 0;
+            }
             
             break;
         case LIBUSB_TRANSFER_CANCELLED:
@@ -2951,9 +3586,7 @@ namespace uvc
                 if (strmh->transfers[i] == transfer)
                 {
                     UVC_DEBUG("Freeing transfer %d (%p)", i, transfer);
-                    uvc_free(transfer->buffer);
-                    libusb_free_transfer(transfer);
-                    strmh->transfers[i] = NULL;
+                    _uvc_free_transfer(strmh, i);
                     break;
                 }
             }
@@ -2972,6 +3605,7 @@ namespace uvc
         case LIBUSB_TRANSFER_STALL:
         case LIBUSB_TRANSFER_OVERFLOW:
             UVC_DEBUG("retrying transfer, status = %d", transfer->status);
+            strmh->frame_incomplete = 1;
             break;
         }
 
@@ -2991,9 +3625,7 @@ namespace uvc
                         if (strmh->transfers[i] == transfer)
                         {
                             UVC_DEBUG("Freeing failed transfer %d (%p)", i, transfer);
-                            uvc_free(transfer->buffer);
-                            libusb_free_transfer(transfer);
-                            strmh->transfers[i] = NULL;
+                            _uvc_free_transfer(strmh, i);
                             break;
                         }
                     }
@@ -3016,9 +3648,7 @@ namespace uvc
                     if (strmh->transfers[i] == transfer)
                     {
                         UVC_DEBUG("Freeing orphan transfer %d (%p)", i, transfer);
-                        uvc_free(transfer->buffer);
-                        libusb_free_transfer(transfer);
-                        strmh->transfers[i] = NULL;
+                        _uvc_free_transfer(strmh, i);
                         break;
                     }
                 }
@@ -3140,13 +3770,27 @@ namespace uvc
         // Set up the streaming status and data space
         strmh->running = 0;
 
-        strmh->outbuf = uvc_malloc<uint8_t>(ctrl->dwMaxVideoFrameSize, "uvc strmh->outbuf");
-        strmh->holdbuf = uvc_malloc<uint8_t>(ctrl->dwMaxVideoFrameSize, "uvc strmh->holdbuf");
+        /* frame buffers also take whole bulk payloads, see _uvc_process_bulk_transfer */
+        strmh->frame_buf_bytes = ctrl->dwMaxVideoFrameSize;
+        if (strmh->frame_buf_bytes < ctrl->dwMaxPayloadTransferSize)
+            strmh->frame_buf_bytes = ctrl->dwMaxPayloadTransferSize;
+
+        strmh->bulk_scatter = 1;
+
+        strmh->outbuf = _uvc_alloc_frame_buf(strmh, "uvc strmh->outbuf");
+        strmh->holdbuf = _uvc_alloc_frame_buf(strmh, "uvc strmh->holdbuf");
 
         strmh->meta_outbuf = uvc_malloc<uint8_t>(LIBUVC_XFER_META_BUF_SIZE, "strmh->meta_outbuf");
         strmh->meta_holdbuf = uvc_malloc<uint8_t>(LIBUVC_XFER_META_BUF_SIZE, "strmh->meta_holdbuf");
+
+        for (int i = 0; i < LIBUVC_NUM_FRAME_BUFS; i++)
+        {
+            strmh->spare_bufs[i] = _uvc_alloc_frame_buf(strmh, "uvc strmh->spare_bufs");
+        }
+        strmh->n_spare_bufs = LIBUVC_NUM_FRAME_BUFS;
         
         mutex_init(strmh->cb_mutex);
+        mutex_init(strmh->record_mutex);
 
         DL_APPEND(devh->streams, strmh);
 
@@ -3184,8 +3828,8 @@ namespace uvc
         uvc_error_t ret;
         /* Total amount of data per transfer */
         size_t total_transfer_size = 0;
-        struct libusb_transfer *transfer;
         int transfer_id;
+        int n_alloc;
 
         ctrl = &strmh->cur_ctrl;
 
@@ -3202,6 +3846,16 @@ namespace uvc
         strmh->fid = 0;
         strmh->pts = 0;
         strmh->last_scr = 0;
+        strmh->last_sof = 0;
+
+        if (strmh->n_transfers <= 0 || strmh->n_transfers > LIBUVC_NUM_TRANSFER_BUFS)
+            strmh->n_transfers = LIBUVC_NUM_TRANSFER_BUFS;
+
+        strmh->frame_incomplete = 0;
+        strmh->tune_frames = 0;
+        strmh->tune_clean_windows = 0;
+        strmh->incomplete_frames = 0;
+        strmh->packet_errors = 0;
 
         frame_desc = uvc_find_frame_desc_stream(strmh, ctrl->bFormatIndex, ctrl->bFrameIndex);
         if (!frame_desc)
@@ -3218,6 +3872,21 @@ namespace uvc
             goto fail;
         }
 
+        strmh->frame_bytes = 0;
+        if (format_desc->bDescriptorSubtype == UVC_VS_FORMAT_UNCOMPRESSED)
+            strmh->frame_bytes = (size_t)frame_desc->wWidth * frame_desc->wHeight * format_desc->bBitsPerPixel / 8;
+
+        /* a recording has no endpoint, its payloads are fed from a thread */
+        if (strmh->devh->replay)
+        {
+            ret = _uvc_replay_start(strmh);
+            if (ret != UVC_SUCCESS)
+                goto fail;
+
+            UVC_EXIT(ret);
+            return ret;
+        }
+
         // Get the interface that provides the chosen format and frame configuration
         interface_id = strmh->stream_if->bInterfaceNumber;
         interface = &strmh->devh->info->config->interface[interface_id];
@@ -3287,9 +3956,14 @@ namespace uvc
                                     endpoint_bytes_per_packet - 1) /
                                     endpoint_bytes_per_packet;
 
-            /* But keep a reasonable limit: Otherwise we start dropping data */
-            if (packets_per_transfer > 32)
-                packets_per_transfer = 32;
+            /* But keep a reasonable limit: Otherwise we start dropping data.
+             * Streams may ask for more or fewer, see uvc::opt::set_stream_transfers */
+            size_t max_packets = strmh->packets_per_transfer > 0 ? (size_t)strmh->packets_per_transfer : LIBUVC_DEFAULT_ISO_PACKETS;
+            if (max_packets > LIBUVC_MAX_ISO_PACKETS)
+                max_packets = LIBUVC_MAX_ISO_PACKETS;
+
+            if (packets_per_transfer > max_packets)
+                packets_per_transfer = max_packets;
 
             total_transfer_size = packets_per_transfer * endpoint_bytes_per_packet;
 
@@ -3310,39 +3984,47 @@ namespace uvc
                 goto fail;
             }
 
-            /* Set up the transfers */
-            for (transfer_id = 0; transfer_id < LIBUVC_NUM_TRANSFER_BUFS; ++transfer_id)
-            {
-                transfer = libusb_alloc_transfer(packets_per_transfer);
-                strmh->transfers[transfer_id] = transfer;
-                strmh->transfer_bufs[transfer_id] = uvc_malloc<uint8_t>(total_transfer_size, "strmh->transfer_bufs");
-
-                libusb_fill_iso_transfer(
-                    transfer, strmh->devh->usb_devh, format_desc->parent->bEndpointAddress,
-                    strmh->transfer_bufs[transfer_id],
-                    total_transfer_size, packets_per_transfer, _uvc_stream_callback, (void *)strmh, 5000);
-
-                libusb_set_iso_packet_lengths(transfer, endpoint_bytes_per_packet);
-            }
+            strmh->xfer_iso = 1;
+            strmh->xfer_packets = (int)packets_per_transfer;
+            strmh->xfer_packet_bytes = endpoint_bytes_per_packet;
+            strmh->xfer_size = total_transfer_size;
         }
         else
         {
-            for (transfer_id = 0; transfer_id < LIBUVC_NUM_TRANSFER_BUFS;
-                 ++transfer_id)
+            strmh->xfer_iso = 0;
+            strmh->xfer_packets = 0;
+            strmh->xfer_packet_bytes = 0;
+            strmh->xfer_size = strmh->cur_ctrl.dwMaxPayloadTransferSize;
+        }
+
+        /* Scatter only when a payload can hold a whole frame, the transfers then need
+         * no more memory than before and every frame is received in place */
+        strmh->xfer_scatter = !strmh->xfer_iso && strmh->bulk_scatter && !strmh->devh->is_isight &&
+                              strmh->xfer_size >= strmh->cur_ctrl.dwMaxVideoFrameSize &&
+                              strmh->xfer_size <= strmh->frame_buf_bytes;
+        strmh->scatter_frames = 0;
+
+        strmh->xfer_endpoint = format_desc->parent->bEndpointAddress;
+
+        /* Auto-tuned streams start shallow and only allocate what is in flight */
+        strmh->depth = strmh->auto_tune ? _uvc_initial_depth(strmh) : strmh->n_transfers;
+        strmh->depth_floor = LIBUVC_TUNE_MIN_DEPTH < strmh->depth ? LIBUVC_TUNE_MIN_DEPTH : strmh->depth;
+
+        n_alloc = strmh->depth;
+
+        /* Set up the transfers */
+        for (transfer_id = 0; transfer_id < n_alloc; ++transfer_id)
+        {
+            if (!_uvc_alloc_transfer(strmh, transfer_id))
             {
-                transfer = libusb_alloc_transfer(0);
-                strmh->transfers[transfer_id] = transfer;
-                strmh->transfer_bufs[transfer_id] = uvc_malloc<uint8_t>(strmh->cur_ctrl.dwMaxPayloadTransferSize, "strmh->transfer_bufs");
-                libusb_fill_bulk_transfer(transfer, strmh->devh->usb_devh,
-                                          format_desc->parent->bEndpointAddress,
-                                          strmh->transfer_bufs[transfer_id],
-                                          strmh->cur_ctrl.dwMaxPayloadTransferSize, _uvc_stream_callback,
-                                          (void *)strmh, 5000);
+                n_alloc = transfer_id;
+                break;
             }
         }
-        
 
-        for (transfer_id = 0; transfer_id < LIBUVC_NUM_TRANSFER_BUFS;
+        ret = UVC_SUCCESS;
+
+        for (transfer_id = 0; transfer_id < n_alloc;
              transfer_id++)
         {
             ret = (uvc_error_t)libusb_submit_transfer(strmh->transfers[transfer_id]);
@@ -3355,11 +4037,9 @@ namespace uvc
 
         if (ret != UVC_SUCCESS && transfer_id >= 0)
         {
-            for (; transfer_id < LIBUVC_NUM_TRANSFER_BUFS; transfer_id++)
+            for (; transfer_id < n_alloc; transfer_id++)
             {
-                uvc_free(strmh->transfers[transfer_id]->buffer);
-                libusb_free_transfer(strmh->transfers[transfer_id]);
-                strmh->transfers[transfer_id] = 0;
+                _uvc_free_transfer(strmh, transfer_id);
             }
             ret = UVC_SUCCESS;
         }
@@ -3374,12 +4054,11 @@ namespace uvc
 
 
     /** @internal
-     * @brief Populate the fields of a frame to be handed to user code
+     * @brief Populate the fields of a frame except its image data
      * must be called with stream cb lock held!
      */
-    void _uvc_populate_frame(uvc_stream_handle_t *strmh)
+    void _uvc_populate_frame_info(uvc_stream_handle_t *strmh, uvc_frame_t *frame)
     {
-        uvc_frame_t *frame = &strmh->frame;
         uvc_frame_desc_t *frame_desc;
 
         /** @todo this stuff that hits the main config cache should really happen
@@ -3422,15 +4101,13 @@ namespace uvc
 
         frame->sequence = strmh->hold_seq;
         frame->capture_time_finished = strmh->capture_time_finished;
+        frame->capture_steady_ns = strmh->capture_steady_ns;
+        frame->pts = strmh->hold_pts;
+        frame->scr = strmh->hold_last_scr;
+        frame->sof = strmh->hold_last_sof;
+        frame->bytes_received = strmh->hold_bytes_received;
 
-        /* copy the image data from the hold buffer to the frame (unnecessary extra buf?) */
-        if (frame->data_capacity < strmh->hold_bytes)
-        {
-            frame->data = uvc_realloc(frame->data, strmh->hold_bytes);
-            frame->data_capacity = strmh->hold_bytes;
-        }
-        frame->data_bytes = strmh->hold_bytes;
-        memcpy(frame->data, strmh->holdbuf, frame->data_bytes);
+        frame->metadata_bytes = 0;
 
         if (!strmh->meta_hold_bytes)
         {
@@ -3444,47 +4121,192 @@ namespace uvc
         }
         frame->metadata_bytes = strmh->meta_hold_bytes;
         memcpy(frame->metadata, strmh->meta_holdbuf, frame->metadata_bytes);
-    }  
+    }
+
+
+    /** @internal
+     * @brief Populate the fields of a frame to be handed to user code
+     * must be called with stream cb lock held!
+     */
+    void _uvc_populate_frame(uvc_stream_handle_t *strmh)
+    {
+        uvc_frame_t *frame = &strmh->frame;
+
+        _uvc_populate_frame_info(strmh, frame);
+
+        /* copy the image data from the hold buffer to the frame,
+         * see uvc_stream_borrow_frame to avoid it */
+        if (frame->data_capacity < strmh->hold_bytes)
+        {
+            frame->data = uvc_realloc(frame->data, strmh->hold_bytes);
+            frame->data_capacity = strmh->hold_bytes;
+        }
+        frame->data_bytes = strmh->hold_bytes;
+        memcpy(frame->data, strmh->holdbuf, frame->data_bytes);
+    }
+
+
+    /** @internal
+     * @brief Lend the hold buffer as a frame and put a spare in its place
+     * must be called with stream cb lock held and a spare available!
+     */
+    uvc_frame_t *_uvc_lend_frame(uvc_stream_handle_t *strmh)
+    {
+        uvc_frame_t *frame = NULL;
+
+        for (int i = 0; i < LIBUVC_NUM_FRAME_BUFS; i++)
+        {
+            if (!strmh->lent_frames[i].data)
+            {
+                frame = &strmh->lent_frames[i];
+                break;
+            }
+        }
+
+        _uvc_populate_frame_info(strmh, frame);
+
+        frame->data = strmh->holdbuf;
+        frame->data_bytes = strmh->hold_bytes;
+        frame->data_capacity = strmh->frame_buf_bytes;
+
+        strmh->holdbuf = strmh->spare_bufs[--strmh->n_spare_bufs];
+        strmh->hold_bytes = 0;
+
+        return frame;
+    }
+
+
+    /** @internal
+     * @brief Wait for a frame newer than the last one polled
+     * must be called with stream cb lock held!
+     *
+     * @param timeout_us 0 waits until a frame arrives or the stream stops, -1 does not wait
+     * @return UVC_ERROR_TIMEOUT if no frame arrived in time, UVC_ERROR_INTERRUPTED if the stream stopped
+     */
+    uvc_error_t _uvc_wait_for_frame(uvc_stream_handle_t *strmh, int32_t timeout_us)
+    {
+        auto const has_frame = [strmh]() { return strmh->last_polled_seq < strmh->hold_seq; };
+
+        if (has_frame())
+            return UVC_SUCCESS;
+
+        if (timeout_us < 0)
+            return UVC_ERROR_TIMEOUT;
+
+        auto const end = chr::steady_clock::now() + chr::microseconds(timeout_us);
+
+        /* wakes up on every frame and on stop, or spuriously */
+        while (!has_frame() && strmh->running)
+        {
+            if (timeout_us == 0)
+            {
+                mutex_wait(strmh->cb_mutex);
+                continue;
+            }
+
+            auto remaining = chr::duration_cast<chr::microseconds>(end - chr::steady_clock::now()).count();
+            if (remaining <= 0 || !mutex_wait(strmh->cb_mutex, (int32_t)remaining))
+                break;
+        }
+
+        if (has_frame())
+            return UVC_SUCCESS;
+
+        return strmh->running ? UVC_ERROR_TIMEOUT : UVC_ERROR_INTERRUPTED;
+    }
 
 
     /** Poll for a frame
      * @ingroup streaming
      *
+     * Waits until a frame arrives or the stream stops.
+     *
      * @param devh UVC device
      * @param[out] frame Location to store pointer to captured frame (NULL on error)
      */
     uvc_error_t uvc_stream_get_frame(uvc_stream_handle_t *strmh, uvc_frame_t **frame)
     {
+        *frame = NULL;
+
         if (!strmh->running)
             return UVC_ERROR_INVALID_PARAM;
             
         mutex_lock(strmh->cb_mutex);
 
-        if (strmh->last_polled_seq < strmh->hold_seq)
+        auto ret = _uvc_wait_for_frame(strmh, 0);
+        if (ret == UVC_SUCCESS)
         {
             _uvc_populate_frame(strmh);
             *frame = &strmh->frame;
             strmh->last_polled_seq = strmh->hold_seq;
         }
-        else
-        {
-            mutex_wait(strmh->cb_mutex);
+        
+        mutex_unlock(strmh->cb_mutex);
+
+        return ret;
+    }
 
-            if (strmh->last_polled_seq < strmh->hold_seq)
+
+    /** Borrow the newest frame without copying it
+     * @ingroup streaming
+     *
+     * The frame's data is the stream's own buffer, give it back with uvc_stream_return_frame.
+     * At most LIBUVC_NUM_FRAME_BUFS frames can be borrowed at once.
+     *
+     * @param strmh UVC stream handle
+     * @param[out] frame Location to store pointer to captured frame (NULL if none arrived)
+     * @param timeout_us 0 waits until a frame arrives or the stream stops, -1 only takes a frame already waiting
+     * @return UVC_ERROR_TIMEOUT if no frame arrived in time, UVC_ERROR_BUSY if every frame buffer is already borrowed
+     */
+    uvc_error_t uvc_stream_borrow_frame(uvc_stream_handle_t *strmh, uvc_frame_t **frame, int32_t timeout_us)
+    {
+        *frame = NULL;
+
+        if (!strmh->running)
+            return UVC_ERROR_INVALID_PARAM;
+
+        mutex_lock(strmh->cb_mutex);
+
+        auto ret = _uvc_wait_for_frame(strmh, timeout_us);
+        if (ret == UVC_SUCCESS)
+        {
+            if (strmh->n_spare_bufs > 0)
             {
-                _uvc_populate_frame(strmh);
-                *frame = &strmh->frame;
+                *frame = _uvc_lend_frame(strmh);
                 strmh->last_polled_seq = strmh->hold_seq;
             }
             else
             {
-                *frame = NULL;
+                ret = UVC_ERROR_BUSY;
             }
         }
-        
+
         mutex_unlock(strmh->cb_mutex);
 
-        return UVC_SUCCESS;
+        return ret;
+    }
+
+
+    /** Give back a frame from uvc_stream_borrow_frame
+     * @ingroup streaming
+     *
+     * @param strmh UVC stream handle
+     * @param frame Borrowed frame, its data must not be used after this
+     */
+    void uvc_stream_return_frame(uvc_stream_handle_t *strmh, uvc_frame_t *frame)
+    {
+        if (!frame || !frame->data)
+            return;
+
+        mutex_lock(strmh->cb_mutex);
+
+        strmh->spare_bufs[strmh->n_spare_bufs++] = frame->data;
+
+        frame->data = NULL;
+        frame->data_bytes = 0;
+        frame->data_capacity = 0;
+
+        mutex_unlock(strmh->cb_mutex);
     }
                                     
 
@@ -3519,7 +4341,11 @@ namespace uvc
         if (!strmh->running)
             return UVC_ERROR_INVALID_PARAM;
 
-        strmh->running = 0;
+        /* the replay thread polls it */
+        __atomic_store_n(&strmh->running, 0, __ATOMIC_RELEASE);
+
+        if (strmh->devh->replay)
+            _uvc_replay_stop(strmh);
         
         mutex_lock(strmh->cb_mutex);
 
@@ -3570,13 +4396,33 @@ namespace uvc
         if (strmh->frame.data)
             uvc_free(strmh->frame.data);
 
-        uvc_free(strmh->outbuf);
-        uvc_free(strmh->holdbuf);
+        _uvc_free_frame_buf(strmh->outbuf);
+        _uvc_free_frame_buf(strmh->holdbuf);
 
         uvc_free(strmh->meta_outbuf);
         uvc_free(strmh->meta_holdbuf);
+
+        /* frames still borrowed are invalid from here */
+        for (int i = 0; i < LIBUVC_NUM_FRAME_BUFS; i++)
+        {
+            uvc_frame_t *lent = &strmh->lent_frames[i];
+
+            if (lent->data)
+                _uvc_free_frame_buf(lent->data);
+
+            if (lent->metadata)
+                uvc_free(lent->metadata);
+        }
+
+        for (int i = 0; i < strmh->n_spare_bufs; i++)
+        {
+            _uvc_free_frame_buf(strmh->spare_bufs[i]);
+        }
         
+        _uvc_stop_recording(strmh);
+
         mutex_destroy(strmh->cb_mutex);
+        mutex_destroy(strmh->record_mutex);
 
         DL_DELETE(strmh->devh->streams, strmh);
         uvc_free(strmh);
@@ -3585,43 +4431,390 @@ namespace uvc
 }
 
 
-/* init.c */
+/* replay.c */
 
 namespace uvc
 {
     /** @internal
-     * @brief Event handler thread
-     * There's one of these per UVC context.
-     * @todo We shouldn't run this if we don't own the USB context
-     */
-    thread_ret_t _uvc_handle_events(void *arg)
-    {
-        uvc_context_t *ctx = (uvc_context_t *)arg;
+     * @brief Start of a payload recording, see uvc::opt::start_recording
+     *
+     * Each payload follows as a _uvc_replay_record and its bytes, headers included.
+     * Fields are in host byte order.
+     */
+    struct _uvc_replay_header
+    {
+        uint8_t magic[4];
+        uint32_t version;
+        /** Format and frame the stream was opened with */
+        uint8_t guidFormat[16];
+        uint8_t bDescriptorSubtype;
+        uint8_t bBitsPerPixel;
+        uint16_t reserved;
+        uint32_t width;
+        uint32_t height;
+        uint32_t dwFrameInterval;
+        uint32_t dwMaxVideoFrameSize;
+        uint32_t dwMaxPayloadTransferSize;
+    };
 
-        while (!ctx->kill_handler_thread)
-            libusb_handle_events_completed(ctx->usb_ctx, &ctx->kill_handler_thread);
+    struct _uvc_replay_record
+    {
+        /** Since the first payload of the recording */
+        uint64_t time_ns;
+        uint32_t length;
+        uint32_t reserved;
+    };
 
-        //return NULL; // return value ignored
-        return (thread_ret_t)0;
-    }
+    static const uint8_t _uvc_replay_magic[4] = { 'U', 'V', 'C', 'R' };
+    static const uint32_t _uvc_replay_version = 1;
 
-    /** @brief Initializes the UVC context
-     * @ingroup init
-     *
-     * @note If you provide your own USB context, you must handle
-     * libusb event processing using a function such as libusb_handle_events.
+    /** @internal
+     * @brief A recording opened as a device
      *
-     * @param[out] pctx The location where the context reference should be stored.
-     * @param[in]  usb_ctx Optional USB context to use
-     * @return Error opening context or UVC_SUCCESS
+     * The descriptors hold the one format and frame of the recording so the
+     * stream functions find them as on a camera.
      */
-    uvc_error_t uvc_init(uvc_context_t **pctx, struct libusb_context *usb_ctx)
+    struct uvc_replay
     {
-        uvc_error_t ret = UVC_SUCCESS;
-        uvc_context_t *ctx = uvc_malloc<uvc_context_t>("uvc ctx");
+        FILE *file;
+        struct _uvc_replay_header header;
 
-        if (usb_ctx == NULL)
-        {
+        uvc_device_info_t info;
+        uvc_streaming_interface_t stream_if;
+        uvc_format_desc_t format;
+        uvc_frame_desc_t frame;
+        uint32_t intervals[2];
+
+        /** 1 plays at the recorded times, 0 as fast as possible */
+        float rate;
+        uint8_t loop;
+
+        /** Payloads from the caller instead of a file, see uvc::opt::open_payload_source */
+        uint32_t (*source)(void *user, uint8_t *dst, uint32_t capacity, uint64_t *due_ns);
+        void *source_user;
+
+        uvc_stream_handle_t *strmh;
+        thread_t thread;
+        uint8_t *buf;
+        size_t buf_bytes;
+    };
+
+
+    static uint64_t _uvc_steady_ns()
+    {
+        return (uint64_t)chr::duration_cast<chr::nanoseconds>(chr::steady_clock::now().time_since_epoch()).count();
+    }
+
+    /** @internal
+     * @brief Write a payload to the stream's recording, if there is one
+     */
+    void _uvc_record_payload(uvc_stream_handle_t *strmh, uint8_t *payload, size_t payload_len)
+    {
+        struct _uvc_replay_record record;
+
+        if (!__atomic_load_n(&strmh->recording, __ATOMIC_ACQUIRE) || payload_len == 0)
+            return;
+
+        mutex_lock(strmh->record_mutex);
+
+        if (strmh->record_file)
+        {
+            uint64_t now_ns = _uvc_steady_ns();
+
+            if (!strmh->record_payloads)
+                strmh->record_start_ns = now_ns;
+
+            record.time_ns = now_ns - strmh->record_start_ns;
+            record.length = (uint32_t)payload_len;
+            record.reserved = 0;
+
+            if (fwrite(&record, sizeof(record), 1, strmh->record_file) != 1 ||
+                fwrite(payload, 1, payload_len, strmh->record_file) != payload_len)
+            {
+                UVC_DEBUG("recording failed, stopping it");
+                fclose(strmh->record_file);
+                strmh->record_file = NULL;
+                strmh->recording = 0;
+            }
+            else
+            {
+                strmh->record_payloads++;
+            }
+        }
+
+        mutex_unlock(strmh->record_mutex);
+    }
+
+    void _uvc_stop_recording(uvc_stream_handle_t *strmh)
+    {
+        mutex_lock(strmh->record_mutex);
+
+        __atomic_store_n(&strmh->recording, 0, __ATOMIC_RELEASE);
+
+        if (strmh->record_file)
+        {
+            fclose(strmh->record_file);
+            strmh->record_file = NULL;
+        }
+
+        mutex_unlock(strmh->record_mutex);
+    }
+
+    /** @internal
+     * @brief Answer a stream control request from the recording
+     *
+     * The format, frame and interval are kept, they were found in the
+     * recording's descriptors.
+     */
+    uvc_error_t _uvc_replay_query_ctrl(uvc_device_handle_t *devh, uvc_stream_ctrl_t *ctrl)
+    {
+        struct _uvc_replay_header *header = &devh->replay->header;
+
+        ctrl->dwMaxVideoFrameSize = header->dwMaxVideoFrameSize;
+        ctrl->dwMaxPayloadTransferSize = header->dwMaxPayloadTransferSize;
+
+        return UVC_SUCCESS;
+    }
+
+    /** @internal
+     * @brief Read the next payload into the replay buffer
+     * @return payload length, 0 at the end of the recording or on error
+     */
+    static size_t _uvc_replay_read(struct uvc_replay *replay, uint64_t *time_ns)
+    {
+        struct _uvc_replay_record record;
+        uint32_t len;
+
+        if (replay->source)
+        {
+            len = replay->source(replay->source_user, replay->buf, (uint32_t)replay->buf_bytes, time_ns);
+            return len <= replay->buf_bytes ? len : 0;
+        }
+
+        if (fread(&record, sizeof(record), 1, replay->file) != 1 || !record.length)
+            return 0;
+
+        if (record.length > replay->buf_bytes)
+        {
+            replay->buf = uvc_realloc(replay->buf, record.length);
+            replay->buf_bytes = replay->buf ? record.length : 0;
+
+            if (!replay->buf)
+                return 0;
+        }
+
+        if (fread(replay->buf, 1, record.length, replay->file) != record.length)
+            return 0;
+
+        *time_ns = record.time_ns;
+        return record.length;
+    }
+
+    /** @internal
+     * @brief Feed the recorded payloads to the stream until it stops
+     *
+     * Payloads go through _uvc_process_payload as if they came from transfers.
+     * A looping replay starts over one frame interval after the last payload.
+     * A payload source ends the stream when it returns no payload.
+     */
+    static thread_ret_t _uvc_replay_thread(void *arg)
+    {
+        uvc_stream_handle_t *strmh = (uvc_stream_handle_t *)arg;
+        struct uvc_replay *replay = strmh->devh->replay;
+
+        uint64_t const interval_ns = (uint64_t)replay->header.dwFrameInterval * 100;
+
+        uint64_t start_ns = _uvc_steady_ns();
+        uint64_t lap_ns = 0;
+        uint64_t time_ns = 0;
+        uint64_t last_ns = 0;
+        uint64_t n_lap = 0;
+        size_t len;
+
+        if (replay->file)
+            fseek(replay->file, sizeof(struct _uvc_replay_header), SEEK_SET);
+
+        while (__atomic_load_n(&strmh->running, __ATOMIC_ACQUIRE))
+        {
+            len = _uvc_replay_read(replay, &time_ns);
+            if (!len)
+            {
+                if (!replay->file || !replay->loop || !n_lap)
+                    break;
+
+                fseek(replay->file, sizeof(struct _uvc_replay_header), SEEK_SET);
+                lap_ns += last_ns + interval_ns;
+                n_lap = 0;
+                continue;
+            }
+
+            n_lap++;
+            last_ns = time_ns;
+
+            if (replay->rate > 0.0f)
+            {
+                auto due_ns = start_ns + (uint64_t)((lap_ns + time_ns) / replay->rate);
+                std::this_thread::sleep_until(chr::steady_clock::time_point(chr::nanoseconds(due_ns)));
+            }
+
+            _uvc_process_payload(strmh, replay->buf, len);
+        }
+
+        return (thread_ret_t)0;
+    }
+
+    uvc_error_t _uvc_replay_start(uvc_stream_handle_t *strmh)
+    {
+        struct uvc_replay *replay = strmh->devh->replay;
+
+        if (replay->strmh)
+            return UVC_ERROR_BUSY;
+
+        replay->strmh = strmh;
+        thread_create(replay->thread, _uvc_replay_thread, (void *)strmh);
+
+        return UVC_SUCCESS;
+    }
+
+    /** @internal
+     * must be called after strmh->running is cleared
+     */
+    void _uvc_replay_stop(uvc_stream_handle_t *strmh)
+    {
+        struct uvc_replay *replay = strmh->devh->replay;
+
+        if (replay->strmh != strmh)
+            return;
+
+        thread_join(replay->thread);
+        replay->strmh = NULL;
+    }
+
+    void _uvc_replay_close(uvc_device_handle_t *devh)
+    {
+        struct uvc_replay *replay = devh->replay;
+
+        if (devh->streams)
+            uvc_stop_streaming(devh);
+
+        if (replay->file)
+            fclose(replay->file);
+
+        if (replay->buf)
+            uvc_free(replay->buf);
+
+        uvc_free(replay);
+        uvc_free(devh);
+    }
+
+    /** @internal
+     * @brief Format GUID for a fourcc, from the format table
+     * @return 0 if the stream functions don't know the format
+     */
+    static uint8_t _uvc_replay_find_guid(uint32_t four_cc_bytes, uint8_t guid[16])
+    {
+        struct format_table_entry *format;
+        int fmt;
+
+        for (fmt = 0; fmt < UVC_FRAME_FORMAT_COUNT; ++fmt)
+        {
+            format = _get_format_entry((enum uvc_frame_format)fmt);
+            if (!format || format->abstract_fmt)
+                continue;
+
+            if (!memcmp(format->guid, &four_cc_bytes, 4))
+            {
+                memcpy(guid, format->guid, 16);
+                return 1;
+            }
+        }
+
+        return 0;
+    }
+
+    /** @internal
+     * @brief Descriptors for the one format and frame of the recording
+     */
+    static void _uvc_replay_make_descs(struct uvc_replay *replay)
+    {
+        struct _uvc_replay_header *header = &replay->header;
+
+        uvc_device_info_t *info = &replay->info;
+        uvc_streaming_interface_t *stream_if = &replay->stream_if;
+        uvc_format_desc_t *format = &replay->format;
+        uvc_frame_desc_t *frame = &replay->frame;
+
+        info->ctrl_if.bcdUVC = 0x0110;
+        info->ctrl_if.parent = info;
+        DL_APPEND(info->stream_ifs, stream_if);
+
+        stream_if->parent = info;
+        stream_if->bInterfaceNumber = 1;
+        DL_APPEND(stream_if->format_descs, format);
+
+        format->parent = stream_if;
+        format->bDescriptorSubtype = (enum uvc_vs_desc_subtype)header->bDescriptorSubtype;
+        format->bFormatIndex = 1;
+        format->bNumFrameDescriptors = 1;
+        memcpy(format->guidFormat, header->guidFormat, sizeof(format->guidFormat));
+        format->bBitsPerPixel = header->bBitsPerPixel;
+        format->bDefaultFrameIndex = 1;
+        DL_APPEND(format->frame_descs, frame);
+
+        /* frame subtypes follow their format's */
+        frame->parent = format;
+        frame->bDescriptorSubtype = (enum uvc_vs_desc_subtype)(header->bDescriptorSubtype + 1);
+        frame->bFrameIndex = 1;
+        frame->wWidth = (uint16_t)header->width;
+        frame->wHeight = (uint16_t)header->height;
+        frame->dwMaxVideoFrameBufferSize = header->dwMaxVideoFrameSize;
+        frame->dwDefaultFrameInterval = header->dwFrameInterval;
+        frame->bFrameIntervalType = 1;
+
+        replay->intervals[0] = header->dwFrameInterval;
+        replay->intervals[1] = 0;
+        frame->intervals = replay->intervals;
+    }
+}
+
+
+/* init.c */
+
+namespace uvc
+{
+    /** @internal
+     * @brief Event handler thread
+     * There's one of these per UVC context.
+     * @todo We shouldn't run this if we don't own the USB context
+     */
+    thread_ret_t _uvc_handle_events(void *arg)
+    {
+        uvc_context_t *ctx = (uvc_context_t *)arg;
+
+        while (!ctx->kill_handler_thread)
+            libusb_handle_events_completed(ctx->usb_ctx, &ctx->kill_handler_thread);
+
+        //return NULL; // return value ignored
+        return (thread_ret_t)0;
+    }
+
+    /** @brief Initializes the UVC context
+     * @ingroup init
+     *
+     * @note If you provide your own USB context, you must handle
+     * libusb event processing using a function such as libusb_handle_events.
+     *
+     * @param[out] pctx The location where the context reference should be stored.
+     * @param[in]  usb_ctx Optional USB context to use
+     * @return Error opening context or UVC_SUCCESS
+     */
+    uvc_error_t uvc_init(uvc_context_t **pctx, struct libusb_context *usb_ctx)
+    {
+        uvc_error_t ret = UVC_SUCCESS;
+        uvc_context_t *ctx = uvc_malloc<uvc_context_t>("uvc ctx");
+
+        if (usb_ctx == NULL)
+        {
             ret = (uvc_error_t)libusb_init(&ctx->usb_ctx);
             ctx->own_usb_ctx = 1;
             if (ret != UVC_SUCCESS)
@@ -5085,6 +6278,13 @@ namespace uvc
 
         UVC_ENTER();
 
+        /* nothing to claim on a recording */
+        if (devh->replay)
+        {
+            UVC_EXIT(ret);
+            return ret;
+        }
+
         if (devh->claimed & (1 << idx))
         {
             UVC_DEBUG("attempt to claim already-claimed interface %d\n", idx);
@@ -5886,6 +7086,14 @@ namespace uvc
     void uvc_close(uvc_device_handle_t *devh)
     {
         UVC_ENTER();
+
+        if (devh->replay)
+        {
+            _uvc_replay_close(devh);
+            UVC_EXIT_VOID();
+            return;
+        }
+
         uvc_context_t *ctx = devh->dev->ctx;
 
         if (devh->streams)
@@ -8827,6 +10035,7 @@ namespace uvc
         out->sequence = in->sequence;
         out->capture_time = in->capture_time;
         out->capture_time_finished = in->capture_time_finished;
+        out->capture_steady_ns = in->capture_steady_ns;
         out->source = in->source;
 
         memcpy(out->data, in->data, in->data_bytes);
@@ -8902,6 +10111,7 @@ namespace uvc
         out->sequence = in->sequence;
         out->capture_time = in->capture_time;
         out->capture_time_finished = in->capture_time_finished;
+        out->capture_steady_ns = in->capture_steady_ns;
         out->source = in->source;
 
         uint8_t *pyuv = (uint8_t *)in->data;
@@ -8962,6 +10172,7 @@ namespace uvc
         out->sequence = in->sequence;
         out->capture_time = in->capture_time;
         out->capture_time_finished = in->capture_time_finished;
+        out->capture_steady_ns = in->capture_steady_ns;
         out->source = in->source;
 
         uint8_t *pyuv = (uint8_t *)in->data;
@@ -9005,6 +10216,7 @@ namespace uvc
         out->sequence = in->sequence;
         out->capture_time = in->capture_time;
         out->capture_time_finished = in->capture_time_finished;
+        out->capture_steady_ns = in->capture_steady_ns;
         out->source = in->source;
 
         uint8_t *pyuv = (uint8_t *)in->data;
@@ -9048,6 +10260,7 @@ namespace uvc
         out->sequence = in->sequence;
         out->capture_time = in->capture_time;
         out->capture_time_finished = in->capture_time_finished;
+        out->capture_steady_ns = in->capture_steady_ns;
         out->source = in->source;
 
         uint8_t *pyuv = (uint8_t *)in->data;
@@ -9107,6 +10320,7 @@ namespace uvc
         out->sequence = in->sequence;
         out->capture_time = in->capture_time;
         out->capture_time_finished = in->capture_time_finished;
+        out->capture_steady_ns = in->capture_steady_ns;
         out->source = in->source;
 
         uint8_t *pyuv = (uint8_t *)in->data;
@@ -9166,6 +10380,7 @@ namespace uvc
         out->sequence = in->sequence;
         out->capture_time = in->capture_time;
         out->capture_time_finished = in->capture_time_finished;
+        out->capture_steady_ns = in->capture_steady_ns;
         out->source = in->source;
 
         uint8_t *pyuv = (uint8_t *)in->data;
@@ -9400,6 +10615,7 @@ namespace uvc
         out->sequence = in->sequence;
         out->capture_time = in->capture_time;
         out->capture_time_finished = in->capture_time_finished;
+        out->capture_steady_ns = in->capture_steady_ns;
         out->source = in->source;
 
         return uvc_mjpeg_convert(in, out);
@@ -9426,6 +10642,7 @@ namespace uvc
         out->sequence = in->sequence;
         out->capture_time = in->capture_time;
         out->capture_time_finished = in->capture_time_finished;
+        out->capture_steady_ns = in->capture_steady_ns;
         out->source = in->source;
 
         return uvc_mjpeg_convert(in, out);
@@ -9557,6 +10774,65 @@ namespace opt
     }
 
 
+    u32 list_frame_formats(uvc_device_handle *devh, FrameFormat* dst, u32 capacity)
+    {
+        u32 count = 0;
+
+        auto const add = [&](u32 four_cc_bytes, uvc_frame_desc_t* frame, u32 interval)
+        {
+            if (!interval)
+            {
+                return;
+            }
+
+            if (count < capacity)
+            {
+                auto& ff = dst[count];
+                ff.four_cc_bytes = four_cc_bytes;
+                ff.width = frame->wWidth;
+                ff.height = frame->wHeight;
+                ff.interval = interval;
+                ff.ok = 1;
+            }
+
+            count++;
+        };
+
+        uvc_streaming_interface* stream_if;
+        DL_FOREACH(devh->info->stream_ifs, stream_if)
+        {
+            uvc_format_desc* format;
+            DL_FOREACH(stream_if->format_descs, format)
+            {
+                auto four_cc_bytes = *(u32*)(format->fourccFormat);
+
+                uvc_frame_desc_t *frame;
+                DL_FOREACH(format->frame_descs, frame)
+                {
+                    if (frame->intervals)
+                    {
+                        for (u32* interval = frame->intervals; *interval; ++interval)
+                        {
+                            add(four_cc_bytes, frame, *interval);
+                        }
+                    }
+                    else
+                    {
+                        // continuous range, report the ends
+                        add(four_cc_bytes, frame, frame->dwMinFrameInterval);
+                        if (frame->dwMaxFrameInterval != frame->dwMinFrameInterval)
+                        {
+                            add(four_cc_bytes, frame, frame->dwMaxFrameInterval);
+                        }
+                    }
+                }
+            }
+        }
+
+        return count;
+    }
+
+
     uvc_error_t uvc_get_stream_ctrl_format_size(
         uvc_device_handle_t *devh,
         uvc_stream_ctrl_t *ctrl,
@@ -9634,139 +10910,1341 @@ namespace opt
     found:
         return uvc_probe_stream_ctrl(devh, ctrl);
     }
-    
-
-#ifdef LIBUVC_HAS_JPEG
 
-    enum class jpeg_out_format : int
-    {
-        UNKNOWN,
-        RGB8,
-        RGBA8,
-        GRAY8
-    };
 
-    class jpeg_info_t
+    class hotplug_entry
     {
     public:
-        struct jpeg_decompress_struct dinfo;
-        struct error_mgr jerr;
+        hotplug_cb cb = nullptr;
+        void* user = nullptr;
 
-        u32 out_step = 0;
+        libusb_hotplug_callback_handle handle = 0;
     };
-    
 
-    static bool setup_jpeg(jpeg_info_t& jinfo, frame* jframe, jpeg_out_format out_format)
-    {
-        auto& jerr = jinfo.jerr;
-        auto& dinfo = jinfo.dinfo;
 
-        auto const fail = [&]()
-        {
-            jpeg_destroy_decompress(&dinfo);
-            return false;
-        };
+    constexpr u32 HOTPLUG_ENTRIES_MAX = 4;
 
-        jerr.super.error_exit = _error_exit;
-        if (setjmp(jerr.jmp))
+    static hotplug_entry hotplug_entries[HOTPLUG_ENTRIES_MAX];
+
+
+    // any event rescans, the device and event are not needed
+    static int LIBUSB_CALL on_hotplug(libusb_context*, libusb_device*, libusb_hotplug_event, void* user_data)
+    {
+        auto entry = (hotplug_entry*)user_data;
+        if (entry->cb)
+        {
+            entry->cb(entry->user);
+        }
+
+        // stay registered
+        return 0;
+    }
+
+
+    int register_hotplug(uvc_context* ctx, hotplug_cb cb, void* user)
+    {
+        if (!libusb_has_capability(LIBUSB_CAP_HAS_HOTPLUG))
+        {
+            return -1;
+        }
+
+        hotplug_entry* entry = nullptr;
+        for (u32 i = 0; i < HOTPLUG_ENTRIES_MAX && !entry; i++)
+        {
+            if (!hotplug_entries[i].cb)
+            {
+                entry = hotplug_entries + i;
+            }
+        }
+
+        if (!entry)
+        {
+            return -1;
+        }
+
+        entry->cb = cb;
+        entry->user = user;
+
+        auto events = (libusb_hotplug_event)(LIBUSB_HOTPLUG_EVENT_DEVICE_ARRIVED | LIBUSB_HOTPLUG_EVENT_DEVICE_LEFT);
+        auto any = LIBUSB_HOTPLUG_MATCH_ANY;
+
+        auto res = libusb_hotplug_register_callback(
+            ctx->usb_ctx, events, (libusb_hotplug_flag)0, any, any, any, on_hotplug, entry, &entry->handle);
+        
+        if (res != LIBUSB_SUCCESS)
+        {
+            *entry = {};
+            return -1;
+        }
+
+        return (int)entry->handle;
+    }
+
+
+    void deregister_hotplug(uvc_context* ctx, int handle)
+    {
+        for (u32 i = 0; i < HOTPLUG_ENTRIES_MAX; i++)
+        {
+            auto& entry = hotplug_entries[i];
+            if (entry.cb && (int)entry.handle == handle)
+            {
+                libusb_hotplug_deregister_callback(ctx->usb_ctx, entry.handle);
+                entry = {};
+            }
+        }
+    }
+
+
+    void handle_events_nowait(uvc_context* ctx)
+    {
+        ::timeval tv = { 0, 0 };
+
+        libusb_handle_events_timeout_completed(ctx->usb_ctx, &tv, nullptr);
+    }
+
+
+    bool get_device_ids(uvc_device* dev, u16& vendor_id, u16& product_id)
+    {
+        libusb_device_descriptor desc;
+        if (libusb_get_device_descriptor(dev->usb_dev, &desc) != LIBUSB_SUCCESS)
+        {
+            return false;
+        }
+
+        vendor_id = desc.idVendor;
+        product_id = desc.idProduct;
+
+        return true;
+    }
+
+
+    void set_stream_transfers(stream_handle* strmh, u32 n_transfers, u32 packets_per_transfer, b8 auto_tune)
+    {
+        if (strmh->running)
+        {
+            return;
+        }
+
+        strmh->n_transfers = n_transfers < LIBUVC_NUM_TRANSFER_BUFS ? (int)n_transfers : LIBUVC_NUM_TRANSFER_BUFS;
+        strmh->packets_per_transfer = packets_per_transfer < LIBUVC_MAX_ISO_PACKETS ? (int)packets_per_transfer : LIBUVC_MAX_ISO_PACKETS;
+        strmh->auto_tune = auto_tune;
+    }
+
+
+    void set_bulk_scatter(stream_handle* strmh, b8 on)
+    {
+        if (strmh->running)
+        {
+            return;
+        }
+
+        strmh->bulk_scatter = on;
+    }
+
+
+    b8 start_recording(stream_handle* strmh, const char* path)
+    {
+        _uvc_replay_header header = {};
+
+        auto frame_desc = uvc_find_frame_desc_stream(strmh, strmh->cur_ctrl.bFormatIndex, strmh->cur_ctrl.bFrameIndex);
+        if (!frame_desc)
+        {
+            return 0;
+        }
+
+        auto format_desc = frame_desc->parent;
+
+        memcpy(header.magic, _uvc_replay_magic, sizeof(header.magic));
+        header.version = _uvc_replay_version;
+        memcpy(header.guidFormat, format_desc->guidFormat, sizeof(header.guidFormat));
+        header.bDescriptorSubtype = (u8)format_desc->bDescriptorSubtype;
+        header.bBitsPerPixel = format_desc->bBitsPerPixel;
+        header.width = frame_desc->wWidth;
+        header.height = frame_desc->wHeight;
+        header.dwFrameInterval = strmh->cur_ctrl.dwFrameInterval;
+        header.dwMaxVideoFrameSize = strmh->cur_ctrl.dwMaxVideoFrameSize;
+        header.dwMaxPayloadTransferSize = strmh->cur_ctrl.dwMaxPayloadTransferSize;
+
+        _uvc_stop_recording(strmh);
+
+        auto file = fopen(path, "wb");
+        if (!file)
+        {
+            return 0;
+        }
+
+        if (fwrite(&header, sizeof(header), 1, file) != 1)
+        {
+            fclose(file);
+            return 0;
+        }
+
+        mutex_lock(strmh->record_mutex);
+
+        strmh->record_file = file;
+        strmh->record_payloads = 0;
+        __atomic_store_n(&strmh->recording, 1, __ATOMIC_RELEASE);
+
+        mutex_unlock(strmh->record_mutex);
+
+        return 1;
+    }
+
+
+    uint64_t stop_recording(stream_handle* strmh)
+    {
+        _uvc_stop_recording(strmh);
+
+        return strmh->record_payloads;
+    }
+
+
+    error open_replay(const char* path, device_handle** devh)
+    {
+        *devh = NULL;
+
+        auto file = fopen(path, "rb");
+        if (!file)
+        {
+            return UVC_ERROR_NOT_FOUND;
+        }
+
+        auto replay = uvc_malloc<uvc_replay>("uvc replay");
+        auto handle = uvc_malloc<uvc_device_handle_t>("uvc replay devh");
+        if (!replay || !handle)
+        {
+            if (replay)
+                uvc_free(replay);
+            if (handle)
+                uvc_free(handle);
+            fclose(file);
+            return UVC_ERROR_NO_MEM;
+        }
+
+        auto& header = replay->header;
+
+        auto ok = fread(&header, sizeof(header), 1, file) == 1 &&
+            !memcmp(header.magic, _uvc_replay_magic, sizeof(header.magic)) &&
+            header.version == _uvc_replay_version &&
+            header.width && header.height && header.dwFrameInterval && header.dwMaxVideoFrameSize;
+
+        if (!ok)
+        {
+            uvc_free(replay);
+            uvc_free(handle);
+            fclose(file);
+            return UVC_ERROR_NOT_SUPPORTED;
+        }
+
+        replay->file = file;
+        replay->rate = 1.0f;
+        replay->loop = 1;
+
+        _uvc_replay_make_descs(replay);
+
+        handle->info = &replay->info;
+        handle->replay = replay;
+
+        *devh = handle;
+
+        return UVC_SUCCESS;
+    }
+
+
+    void set_replay_rate(device_handle* devh, float rate, b8 loop)
+    {
+        if (!devh->replay || devh->replay->strmh)
+        {
+            return;
+        }
+
+        devh->replay->rate = rate > 0.0f ? rate : 0.0f;
+        devh->replay->loop = loop;
+    }
+
+
+    error open_payload_source(PayloadSource const& source, device_handle** devh)
+    {
+        *devh = NULL;
+
+        if (!source.next || !source.width || !source.height || !source.interval || !source.max_payload_bytes)
+        {
+            return UVC_ERROR_INVALID_PARAM;
+        }
+
+        auto replay = uvc_malloc<uvc_replay>("uvc payload source");
+        auto handle = uvc_malloc<uvc_device_handle_t>("uvc payload source devh");
+        auto buf = uvc_malloc<u8>(source.max_payload_bytes, "uvc payload source buf");
+        if (!replay || !handle || !buf)
+        {
+            if (replay)
+                uvc_free(replay);
+            if (handle)
+                uvc_free(handle);
+            if (buf)
+                uvc_free(buf);
+            return UVC_ERROR_NO_MEM;
+        }
+
+        auto& header = replay->header;
+
+        if (!_uvc_replay_find_guid(source.four_cc_bytes, header.guidFormat))
+        {
+            uvc_free(replay);
+            uvc_free(handle);
+            uvc_free(buf);
+            return UVC_ERROR_NOT_SUPPORTED;
+        }
+
+        auto mjpeg = !memcmp(&source.four_cc_bytes, "MJPG", 4);
+
+        memcpy(header.magic, _uvc_replay_magic, sizeof(header.magic));
+        header.version = _uvc_replay_version;
+        header.bDescriptorSubtype = mjpeg ? UVC_VS_FORMAT_MJPEG : UVC_VS_FORMAT_UNCOMPRESSED;
+        header.bBitsPerPixel = source.bits_per_pixel;
+        header.width = source.width;
+        header.height = source.height;
+        header.dwFrameInterval = source.interval;
+        header.dwMaxVideoFrameSize = source.max_frame_bytes;
+        header.dwMaxPayloadTransferSize = source.max_payload_bytes;
+
+        replay->rate = 1.0f;
+        replay->source = source.next;
+        replay->source_user = source.user;
+        replay->buf = buf;
+        replay->buf_bytes = source.max_payload_bytes;
+
+        _uvc_replay_make_descs(replay);
+
+        handle->info = &replay->info;
+        handle->replay = replay;
+
+        *devh = handle;
+
+        return UVC_SUCCESS;
+    }
+
+
+    TransferTuning get_stream_transfers(stream_handle* strmh)
+    {
+        TransferTuning tuning;
+
+        mutex_lock(strmh->cb_mutex);
+
+        tuning.n_transfers = (u32)strmh->n_transfers;
+        tuning.packets_per_transfer = (u32)strmh->xfer_packets;
+        tuning.depth = (u32)_uvc_count_transfers(strmh);
+        tuning.depth_floor = (u32)strmh->depth_floor;
+        tuning.incomplete_frames = strmh->incomplete_frames;
+        tuning.packet_errors = strmh->packet_errors;
+        tuning.scatter = strmh->xfer_scatter;
+        tuning.scatter_frames = strmh->scatter_frames;
+
+        mutex_unlock(strmh->cb_mutex);
+
+        return tuning;
+    }
+    
+
+#ifdef LIBUVC_HAS_JPEG
+
+    constexpr u32 JPEG_BATCH_ROWS = 16;
+    constexpr u32 JPEG_STRIPES_MAX = 16;
+
+
+    class jpeg_stripe_worker
+    {
+    public:
+        jpeg_decoder* decoder = nullptr;
+        thread_t thread;
+
+        // decodes stripe id of each job
+        u32 id = 0;
+        u64 job_id = 0;
+    };
+
+
+    class jpeg_decoder
+    {
+    public:
+        struct jpeg_decompress_struct dinfo;
+        struct error_mgr jerr;
+
+        // raw decode scratch, one iMCU row of each component
+        u8* raw_data = nullptr;
+        u32 raw_bytes = 0;
+
+        // intra-frame decode, stripe 0 uses this decoder
+        u32 n_threads = 0;
+        jpeg_decoder* stripe_decoders[JPEG_STRIPES_MAX];
+
+        // a standalone jpeg per stripe
+        u8* stripe_data = nullptr;
+        u32 stripe_bytes = 0;
+
+        // stripes 1.. decode on workers started by the first striped frame, see decode_stripes
+        jpeg_stripe_worker workers[JPEG_STRIPES_MAX];
+        u32 n_workers = 0;
+
+        mutex_t worker_mtx;
+
+        // the current job, guarded by worker_mtx
+        void (*run_stripe)(void* ctx, u32 stripe);
+        void* stripe_ctx;
+        u64 job_id = 0;
+        u32 n_remaining = 0;
+        b8 stop_workers = 0;
+    };
+
+
+    static thread_ret_t run_stripe_worker(void* user)
+    {
+        auto& worker = *(jpeg_stripe_worker*)user;
+        auto& decoder = *worker.decoder;
+        auto& mtx = decoder.worker_mtx;
+
+        mutex_lock(mtx);
+
+        while (true)
+        {
+            while (!decoder.stop_workers && decoder.job_id == worker.job_id)
+            {
+                mutex_wait(mtx);
+            }
+
+            if (decoder.stop_workers)
+            {
+                break;
+            }
+
+            worker.job_id = decoder.job_id;
+
+            auto run = decoder.run_stripe;
+            auto ctx = decoder.stripe_ctx;
+
+            mutex_unlock(mtx);
+
+            run(ctx, worker.id);
+
+            mutex_lock(mtx);
+
+            decoder.n_remaining--;
+            if (!decoder.n_remaining)
+            {
+                mutex_broadcast(mtx);
+            }
+        }
+
+        mutex_unlock(mtx);
+
+        return nullptr;
+    }
+
+
+    static void stop_stripe_workers(jpeg_decoder* decoder)
+    {
+        if (!decoder->n_workers)
+        {
+            return;
+        }
+
+        mutex_lock(decoder->worker_mtx);
+        decoder->stop_workers = 1;
+        mutex_unlock_broadcast(decoder->worker_mtx);
+
+        for (u32 i = 0; i < decoder->n_workers; i++)
+        {
+            thread_join(decoder->workers[i].thread);
+        }
+
+        decoder->n_workers = 0;
+        decoder->stop_workers = 0;
+    }
+
+
+    // worker i decodes stripe i + 1
+    static void start_stripe_workers(jpeg_decoder* decoder, u32 n_workers)
+    {
+        stop_stripe_workers(decoder);
+
+        for (u32 i = 0; i < n_workers; i++)
+        {
+            auto& worker = decoder->workers[i];
+            worker.decoder = decoder;
+            worker.id = i + 1;
+            worker.job_id = decoder->job_id;
+
+            thread_create(worker.thread, run_stripe_worker, &worker);
+        }
+
+        decoder->n_workers = n_workers;
+    }
+
+
+    jpeg_decoder* create_jpeg_decoder()
+    {
+        // read again after a longjmp, volatile so it is not kept in a clobbered register
+        jpeg_decoder* volatile decoder = uvc_malloc<jpeg_decoder>("jpeg_decoder");
+        if (!decoder)
+        {
+            return nullptr;
+        }
+
+        auto& dinfo = decoder->dinfo;
+
+        dinfo.err = jpeg_std_error(&decoder->jerr.super);
+        decoder->jerr.super.error_exit = _error_exit;
+
+        if (setjmp(decoder->jerr.jmp))
+        {
+            uvc_free(decoder);
+            return nullptr;
+        }
+
+        jpeg_create_decompress(&dinfo);
+
+        mutex_init(decoder->worker_mtx);
+
+        return decoder;
+    }
+
+
+    void destroy_jpeg_decoder(jpeg_decoder* decoder)
+    {
+        if (!decoder)
+        {
+            return;
+        }
+
+        stop_stripe_workers(decoder);
+        mutex_destroy(decoder->worker_mtx);
+
+        jpeg_destroy_decompress(&decoder->dinfo);
+
+        if (decoder->raw_data)
+        {
+            uvc_free(decoder->raw_data);
+        }
+
+        for (u32 i = 0; i < JPEG_STRIPES_MAX; i++)
+        {
+            destroy_jpeg_decoder(decoder->stripe_decoders[i]);
+        }
+
+        if (decoder->stripe_data)
+        {
+            uvc_free(decoder->stripe_data);
+        }
+
+        uvc_free(decoder);
+    }
+
+
+    // libjpeg errors longjmp to the caller's setjmp
+    static bool begin_decode(jpeg_decoder* decoder, frame* in)
+    {
+        auto& dinfo = decoder->dinfo;
+
+        jpeg_mem_src(&dinfo, (unsigned char *)in->data, in->data_bytes);
+        
+        if (jpeg_read_header(&dinfo, TRUE) != JPEG_HEADER_OK)
+        {
+            return false;
+        }
+
+        if (dinfo.dc_huff_tbl_ptrs[0] == NULL)
+        {
+            /* This frame is missing the Huffman tables: fill in the standard ones */
+            insert_huff_tables(&dinfo);
+        }
+
+        dinfo.dct_method = JDCT_IFAST;
+
+        return dinfo.image_width == in->width && dinfo.image_height == in->height;
+    }
+
+
+    static error mjpeg_decode(jpeg_decoder* decoder, frame* in, u8* out, u32 stride, J_COLOR_SPACE color_space)
+    {
+        auto& dinfo = decoder->dinfo;
+
+        if (setjmp(decoder->jerr.jmp))
+        {
+            jpeg_abort_decompress(&dinfo);
+            return UVC_ERROR_OTHER;
+        }
+
+        if (!begin_decode(decoder, in))
+        {
+            jpeg_abort_decompress(&dinfo);
+            return UVC_ERROR_OTHER;
+        }
+
+        dinfo.out_color_space = color_space;
+
+        jpeg_start_decompress(&dinfo);
+
+        JSAMPROW rows[JPEG_BATCH_ROWS];
+
+        // libjpeg returns as many rows as it has ready, up to the batch
+        while (dinfo.output_scanline < dinfo.output_height)
+        {
+            auto y = dinfo.output_scanline;
+            auto n_rows = dinfo.output_height - y;
+            n_rows = n_rows < JPEG_BATCH_ROWS ? n_rows : JPEG_BATCH_ROWS;
+
+            for (u32 i = 0; i < n_rows; i++)
+            {
+                rows[i] = out + (y + i) * stride;
+            }
+
+            jpeg_read_scanlines(&dinfo, rows, n_rows);
+        }
+
+        jpeg_finish_decompress(&dinfo);
+
+        return UVC_SUCCESS;
+    }
+
+
+    static bool reserve_raw_data(jpeg_decoder* decoder, u32 n_bytes)
+    {
+        if (decoder->raw_bytes >= n_bytes)
+        {
+            return true;
+        }
+
+        if (decoder->raw_data)
+        {
+            uvc_free(decoder->raw_data);
+        }
+
+        decoder->raw_data = uvc_malloc<u8>(n_bytes, "jpeg raw_data");
+        decoder->raw_bytes = decoder->raw_data ? n_bytes : 0;
+
+        return decoder->raw_data != nullptr;
+    }
+
+
+    static error mjpeg_decode_raw(jpeg_decoder* decoder, frame* in, u8* y, u8* u, u8* v)
+    {
+        auto& dinfo = decoder->dinfo;
+
+        auto const fail = [&]()
+        {
+            jpeg_abort_decompress(&dinfo);
+            return UVC_ERROR_OTHER;
+        };
+
+        if (setjmp(decoder->jerr.jmp))
+        {
+            return fail();
+        }
+
+        if (!begin_decode(decoder, in) || dinfo.num_components != 3 || dinfo.jpeg_color_space != JCS_YCbCr)
+        {
+            return fail();
+        }
+
+        dinfo.raw_data_out = TRUE;
+        dinfo.out_color_space = JCS_YCbCr;
+
+        jpeg_start_decompress(&dinfo);
+
+        u32 max_h = dinfo.max_h_samp_factor;
+        u32 max_v = dinfo.max_v_samp_factor;
+        u32 n_rows = max_v * DCTSIZE;
+
+        if (n_rows > JPEG_BATCH_ROWS)
+        {
+            return fail();
+        }
+
+        u8* planes[3] = { y, u, v };
+        u32 step_x[3] = { 0 };
+        u32 step_y[3] = { 0 };
+
+        JSAMPROW rows[3][JPEG_BATCH_ROWS];
+        JSAMPARRAY arrays[3] = { rows[0], rows[1], rows[2] };
+
+        u32 n_bytes = 0;
+
+        for (u32 c = 0; c < 3; c++)
+        {
+            auto& comp = dinfo.comp_info[c];
+            if (max_h % comp.h_samp_factor || max_v % comp.v_samp_factor)
+            {
+                return fail();
+            }
+
+            step_x[c] = max_h / comp.h_samp_factor;
+            step_y[c] = max_v / comp.v_samp_factor;
+
+            n_bytes += comp.v_samp_factor * DCTSIZE * comp.width_in_blocks * DCTSIZE;
+        }
+
+        if (!reserve_raw_data(decoder, n_bytes))
+        {
+            return fail();
+        }
+
+        auto raw = decoder->raw_data;
+
+        for (u32 c = 0; c < 3; c++)
+        {
+            auto& comp = dinfo.comp_info[c];
+            auto row_bytes = comp.width_in_blocks * DCTSIZE;
+
+            for (u32 r = 0; r < (u32)comp.v_samp_factor * DCTSIZE; r++)
+            {
+                rows[c][r] = raw;
+                raw += row_bytes;
+            }
+        }
+
+        auto width = dinfo.output_width;
+        auto height = dinfo.output_height;
+
+        // one iMCU row per call, chroma is repeated out to full size
+        while (dinfo.output_scanline < height)
+        {
+            auto y_begin = dinfo.output_scanline;
+
+            jpeg_read_raw_data(&dinfo, arrays, n_rows);
+
+            auto y_end = y_begin + n_rows < height ? y_begin + n_rows : height;
+
+            for (u32 c = 0; c < 3; c++)
+            {
+                for (u32 yi = y_begin; yi < y_end; yi++)
+                {
+                    auto src = rows[c][(yi - y_begin) / step_y[c]];
+                    auto dst = planes[c] + (size_t)yi * width;
+
+                    if (step_x[c] == 1)
+                    {
+                        memcpy(dst, src, width);
+                        continue;
+                    }
+
+                    for (u32 x = 0; x < width; x++)
+                    {
+                        dst[x] = src[x / step_x[c]];
+                    }
+                }
+            }
+        }
+
+        jpeg_finish_decompress(&dinfo);
+
+        return UVC_SUCCESS;
+    }
+
+
+    class jpeg_stripe
+    {
+    public:
+        u32 y_begin = 0;
+        u32 height = 0;
+
+        // entropy coded data, without the RST marker that ends it
+        u32 data_begin = 0;
+        u32 data_end = 0;
+
+        // restart intervals before the stripe, its markers are renumbered from RST0
+        u32 restart_begin = 0;
+    };
+
+
+    class jpeg_layout
+    {
+    public:
+        u32 width = 0;
+        u32 height = 0;
+
+        u32 sof_height_offset = 0;
+
+        // SOI through the SOS segment
+        u32 header_bytes = 0;
+
+        jpeg_stripe stripes[JPEG_STRIPES_MAX];
+        u32 n_stripes = 0;
+    };
+
+
+    static inline u32 read_u16_be(u8 const* p)
+    {
+        return ((u32)p[0] << 8) | p[1];
+    }
+
+
+    // baseline huffman, one interleaved scan, restart intervals that begin on MCU rows
+    static bool find_stripes(u8 const* data, u32 n_bytes, u32 n_stripes, jpeg_layout& layout)
+    {
+        if (n_bytes < 4 || data[0] != 0xFF || data[1] != 0xD8)
+        {
+            return false;
+        }
+
+        u32 restart_interval = 0;
+        u32 n_components = 0;
+        u32 max_h = 0;
+        u32 max_v = 0;
+
+        u32 pos = 2;
+
+        layout.header_bytes = 0;
+
+        while (!layout.header_bytes)
+        {
+            if (pos + 4 > n_bytes || data[pos] != 0xFF)
+            {
+                return false;
+            }
+
+            auto marker = data[pos + 1];
+            if (marker == 0xFF)
+            {
+                // fill byte
+                pos++;
+                continue;
+            }
+
+            auto len = read_u16_be(data + pos + 2);
+            auto seg = data + pos + 4;
+
+            if (len < 2 || pos + 2 + len > n_bytes)
+            {
+                return false;
+            }
+
+            switch (marker)
+            {
+            case 0xC0:
+            case 0xC1:
+                n_components = len < 8 ? 0 : seg[5];
+                if (!n_components || len < 8 + 3 * n_components)
+                {
+                    return false;
+                }
+
+                layout.sof_height_offset = pos + 5;
+                layout.height = read_u16_be(seg + 1);
+                layout.width = read_u16_be(seg + 3);
+
+                for (u32 c = 0; c < n_components; c++)
+                {
+                    u32 hv = seg[6 + 3 * c + 1];
+                    max_h = (hv >> 4) > max_h ? (hv >> 4) : max_h;
+                    max_v = (hv & 15) > max_v ? (hv & 15) : max_v;
+                }
+                break;
+
+            case 0xDD:
+                restart_interval = len < 4 ? 0 : read_u16_be(seg);
+                break;
+
+            case 0xDA:
+                if (seg[0] != n_components)
+                {
+                    return false;
+                }
+
+                layout.header_bytes = pos + 2 + len;
+                break;
+
+            default:
+                // progressive, lossless and arithmetic coding
+                if (marker > 0xC1 && marker <= 0xCF && marker != 0xC4 && marker != 0xC8 && marker != 0xCC)
+                {
+                    return false;
+                }
+                break;
+            }
+
+            pos += 2 + len;
+        }
+
+        if (!restart_interval || !max_h || !max_v || !layout.width || !layout.height)
         {
-            return fail();
-        }       
+            return false;
+        }
 
-        dinfo.err = jpeg_std_error(&jerr.super);
+        if (n_components == 1)
+        {
+            // a single component MCU is one block
+            max_h = max_v = 1;
+        }
 
-        jpeg_create_decompress(&dinfo);        
+        auto mcu_height = 8 * max_v;
+        auto mcus_per_row = (layout.width + 8 * max_h - 1) / (8 * max_h);
+        auto mcu_rows = (layout.height + mcu_height - 1) / mcu_height;
 
-        jpeg_mem_src(&dinfo, (unsigned char *)jframe->data, jframe->data_bytes);
-        jpeg_read_header(&dinfo, TRUE);
+        n_stripes = n_stripes < JPEG_STRIPES_MAX ? n_stripes : JPEG_STRIPES_MAX;
+        n_stripes = n_stripes < mcu_rows ? n_stripes : mcu_rows;
 
-        if (dinfo.dc_huff_tbl_ptrs[0] == NULL)
+        u32 rows[JPEG_STRIPES_MAX + 1] = { 0 };
+        u32 n = 0;
+
+        // first MCU row at or after an even split that starts a restart interval
+        for (u32 s = 0; s < n_stripes; s++)
         {
-            /* This frame is missing the Huffman tables: fill in the standard ones */
-            insert_huff_tables(&dinfo);
+            auto row = s * mcu_rows / n_stripes;
+            while (row < mcu_rows && (row * mcus_per_row) % restart_interval)
+            {
+                row++;
+            }
+
+            if (row >= mcu_rows || (n && row <= rows[n - 1]))
+            {
+                continue;
+            }
+
+            rows[n] = row;
+            layout.stripes[n].restart_begin = row * mcus_per_row / restart_interval;
+            n++;
         }
 
-        switch (out_format)
+        if (n < 2)
         {
-        case jpeg_out_format::RGB8:
-            dinfo.out_color_space = JCS_RGB;
-            jinfo.out_step = jframe->width * 3;
-            break;
-        case jpeg_out_format::RGBA8:
-            dinfo.out_color_space = JCS_EXT_RGBA;
-            jinfo.out_step = jframe->width * 4;
-            break;
-        case jpeg_out_format::GRAY8:
-            dinfo.out_color_space = JCS_GRAYSCALE;
-            jinfo.out_step = jframe->width;
-            break;
-        default:
-            return fail();
+            return false;
         }
 
-        dinfo.dct_method = JDCT_IFAST;
-        
+        rows[n] = mcu_rows;
+
+        // find the markers that begin each stripe
+        u32 stripe = 1;
+        u32 n_restarts = 0;
+        u32 data_end = n_bytes;
+
+        layout.stripes[0].data_begin = layout.header_bytes;
+
+        for (pos = layout.header_bytes; pos + 1 < n_bytes; pos++)
+        {
+            if (data[pos] != 0xFF)
+            {
+                continue;
+            }
+
+            auto marker = data[pos + 1];
+            if (marker == 0x00 || marker == 0xFF)
+            {
+                // stuffed zero or fill
+                continue;
+            }
+
+            if (marker < 0xD0 || marker > 0xD7)
+            {
+                // EOI
+                data_end = pos;
+                break;
+            }
+
+            n_restarts++;
+            if (stripe < n && n_restarts == layout.stripes[stripe].restart_begin)
+            {
+                layout.stripes[stripe - 1].data_end = pos;
+                layout.stripes[stripe].data_begin = pos + 2;
+                stripe++;
+            }
+
+            pos++;
+        }
+
+        if (stripe < n)
+        {
+            return false;
+        }
+
+        layout.stripes[n - 1].data_end = data_end;
+
+        for (u32 s = 0; s < n; s++)
+        {
+            auto& st = layout.stripes[s];
+            auto y_end = rows[s + 1] * mcu_height;
+
+            st.y_begin = rows[s] * mcu_height;
+            st.height = (y_end < layout.height ? y_end : layout.height) - st.y_begin;
+        }
+
+        layout.n_stripes = n;
+
         return true;
     }
-    
 
-    static uvc_error_t mjpeg_convert(frame* in, u8* out, jpeg_out_format out_format)
+
+    // each stripe is the original header with its own height, its entropy data and EOI
+    static bool build_stripes(jpeg_decoder* decoder, frame* in, jpeg_layout const& layout, frame* stripe_frames)
     {
-        // not actually parallel
+        auto src = (u8 const*)in->data;
+        auto header_bytes = layout.header_bytes;
 
+        u32 n_bytes = 0;
+        for (u32 s = 0; s < layout.n_stripes; s++)
+        {
+            auto& st = layout.stripes[s];
+            n_bytes += header_bytes + (st.data_end - st.data_begin) + 2;
+        }
 
-        jpeg_info_t jinfo;
-        if (!setup_jpeg(jinfo, in, out_format))
+        if (decoder->stripe_bytes < n_bytes)
         {
-            return UVC_ERROR_OTHER;
+            if (decoder->stripe_data)
+            {
+                uvc_free(decoder->stripe_data);
+            }
+
+            decoder->stripe_data = uvc_malloc<u8>(n_bytes, "jpeg stripe_data");
+            decoder->stripe_bytes = decoder->stripe_data ? n_bytes : 0;
+
+            if (!decoder->stripe_data)
+            {
+                return false;
+            }
         }
 
-        auto& dinfo = jinfo.dinfo;
+        auto dst = decoder->stripe_data;
 
-        constexpr u32 n_out_rows = 16;
+        for (u32 s = 0; s < layout.n_stripes; s++)
+        {
+            auto& st = layout.stripes[s];
+            auto begin = dst;
 
-        u8* out_array[n_out_rows] = { 0 };
+            memcpy(dst, src, header_bytes);
+            dst[layout.sof_height_offset] = (u8)(st.height >> 8);
+            dst[layout.sof_height_offset + 1] = (u8)(st.height & 0xFF);
+            dst += header_bytes;
 
-        jpeg_start_decompress(&dinfo);
+            auto data_bytes = st.data_end - st.data_begin;
+            memcpy(dst, src + st.data_begin, data_bytes);
 
-        size_t lines_read = 0;
-        
-        while (dinfo.output_scanline < dinfo.output_height)
+            // the decoder expects RST0 first
+            auto shift = st.restart_begin % 8;
+            for (u32 i = 0; shift && i + 1 < data_bytes; i++)
+            {
+                if (dst[i] == 0xFF && dst[i + 1] >= 0xD0 && dst[i + 1] <= 0xD7)
+                {
+                    dst[i + 1] = (u8)(0xD0 + (dst[i + 1] - 0xD0 + 8 - shift) % 8);
+                    i++;
+                }
+            }
+
+            dst += data_bytes;
+
+            dst[0] = 0xFF;
+            dst[1] = 0xD9;
+            dst += 2;
+
+            auto& f = stripe_frames[s];
+            f.data = begin;
+            f.data_bytes = (size_t)(dst - begin);
+            f.width = layout.width;
+            f.height = st.height;
+        }
+
+        return true;
+    }
+
+
+    // UVC_ERROR_NOT_SUPPORTED when the frame can't be split, decode it serially
+    // 4:2:0 chroma is not smoothed across the seams
+    template <class FN>
+    static error decode_stripes(jpeg_decoder* decoder, frame* in, FN const& decode_stripe)
+    {
+        jpeg_layout layout;
+
+        if (decoder->n_threads < 2 || !find_stripes((u8*)in->data, (u32)in->data_bytes, decoder->n_threads, layout))
+        {
+            return UVC_ERROR_NOT_SUPPORTED;
+        }
+
+        if (layout.width != in->width || layout.height != in->height)
+        {
+            return UVC_ERROR_NOT_SUPPORTED;
+        }
+
+        frame stripe_frames[JPEG_STRIPES_MAX] = {};
+
+        if (!build_stripes(decoder, in, layout, stripe_frames))
+        {
+            return UVC_ERROR_NO_MEM;
+        }
+
+        jpeg_decoder* decoders[JPEG_STRIPES_MAX] = { decoder };
+
+        for (u32 s = 1; s < layout.n_stripes; s++)
         {
-            for (u32 i = 0; i < n_out_rows; ++i)
+            auto& d = decoder->stripe_decoders[s];
+            if (!d)
             {
-                out_array[i] = (u8*)out + (lines_read + i) * jinfo.out_step;
-            }           
-            
-            lines_read += jpeg_read_scanlines(&dinfo, out_array, 1);
+                d = create_jpeg_decoder();
+            }
+
+            if (!d)
+            {
+                return UVC_ERROR_NO_MEM;
+            }
+
+            decoders[s] = d;
         }
 
-        jpeg_finish_decompress(&dinfo);
-        jpeg_destroy_decompress(&dinfo);
+        error results[JPEG_STRIPES_MAX];
+
+        auto const run = [&](u32 s)
+        {
+            if (s < layout.n_stripes)
+            {
+                results[s] = decode_stripe(decoders[s], stripe_frames + s, layout.stripes[s].y_begin);
+            }
+        };
+
+        // the thread count only changes between frames
+        auto n_workers = decoder->n_threads - 1;
+        if (decoder->n_workers != n_workers)
+        {
+            start_stripe_workers(decoder, n_workers);
+        }
+
+        auto& mtx = decoder->worker_mtx;
+
+        mutex_lock(mtx);
+
+        decoder->run_stripe = [](void* ctx, u32 s){ (*(decltype(run)*)ctx)(s); };
+        decoder->stripe_ctx = (void*)&run;
+        decoder->job_id++;
+        decoder->n_remaining = n_workers;
+
+        mutex_unlock_broadcast(mtx);
+
+        run(0);
+
+        mutex_lock(mtx);
+
+        while (decoder->n_remaining)
+        {
+            mutex_wait(mtx);
+        }
+
+        mutex_unlock(mtx);
+
+        for (u32 s = 0; s < layout.n_stripes; s++)
+        {
+            if (results[s] != UVC_SUCCESS)
+            {
+                return results[s];
+            }
+        }
 
         return UVC_SUCCESS;
     }
 
 
-    error mjpeg2rgba(frame* in, u8* out)
+    static error mjpeg_decode_any(jpeg_decoder* decoder, frame* in, u8* out, u32 stride, J_COLOR_SPACE color_space)
+    {
+        auto res = decode_stripes(decoder, in, [&](jpeg_decoder* d, frame* f, u32 y_begin)
+        {
+            return mjpeg_decode(d, f, out + (size_t)y_begin * stride, stride, color_space);
+        });
+
+        if (res == UVC_ERROR_NOT_SUPPORTED)
+        {
+            res = mjpeg_decode(decoder, in, out, stride, color_space);
+        }
+
+        return res;
+    }
+
+
+    void set_jpeg_threads(jpeg_decoder* decoder, u32 n_threads)
+    {
+        if (decoder)
+        {
+            decoder->n_threads = n_threads < JPEG_STRIPES_MAX ? n_threads : JPEG_STRIPES_MAX;
+        }
+    }
+
+
+    error mjpeg_decode_rgba(jpeg_decoder* decoder, frame* in, u8* out, u32 stride)
+    {
+        if (!decoder || !out)
+        {
+            return UVC_ERROR_INVALID_PARAM;
+        }
+
+        return mjpeg_decode_any(decoder, in, out, stride, JCS_EXT_RGBA);
+    }
+
+
+    error mjpeg_decode_yuv(jpeg_decoder* decoder, frame* in, u8* y, u8* u, u8* v)
+    {
+        if (!decoder || !y || !u || !v)
+        {
+            return UVC_ERROR_INVALID_PARAM;
+        }
+
+        auto res = decode_stripes(decoder, in, [&](jpeg_decoder* d, frame* f, u32 y_begin)
+        {
+            auto offset = (size_t)y_begin * in->width;
+            return mjpeg_decode_raw(d, f, y + offset, u + offset, v + offset);
+        });
+
+        if (res == UVC_ERROR_NOT_SUPPORTED)
+        {
+            res = mjpeg_decode_raw(decoder, in, y, u, v);
+        }
+
+        return res;
+    }
+
+
+    u32 mjpeg_encode_yuyv(u8 const* yuyv, u32 width, u32 height, u8* dst, u32 capacity, int quality)
+    {
+        // one MCU row of 8 lines, widths padded to whole MCUs
+        u32 const y_width = (width + 15) & ~15u;
+        u32 const c_width = y_width / 2;
+        u32 const n_pairs = width / 2;
+
+        if (!yuyv || !dst || !n_pairs || !height)
+        {
+            return 0;
+        }
+
+        auto rows = uvc_malloc<u8>(DCTSIZE * (y_width + 2 * c_width), "jpeg encode rows");
+        if (!rows)
+        {
+            return 0;
+        }
+
+        struct jpeg_compress_struct cinfo;
+        struct error_mgr jerr;
+
+        // allocated by libjpeg
+        unsigned char* out = NULL;
+        unsigned long out_bytes = 0;
+
+        cinfo.err = jpeg_std_error(&jerr.super);
+        jerr.super.error_exit = _error_exit;
+
+        if (setjmp(jerr.jmp))
+        {
+            jpeg_destroy_compress(&cinfo);
+            free(out);
+            uvc_free(rows);
+            return 0;
+        }
+
+        jpeg_create_compress(&cinfo);
+        jpeg_mem_dest(&cinfo, &out, &out_bytes);
+
+        cinfo.image_width = width;
+        cinfo.image_height = height;
+        cinfo.input_components = 3;
+        cinfo.in_color_space = JCS_YCbCr;
+
+        jpeg_set_defaults(&cinfo);
+        jpeg_set_quality(&cinfo, quality, TRUE);
+
+        // 4:2:2 as cameras send it, the chroma of a YUYV pair is one sample
+        cinfo.raw_data_in = TRUE;
+        cinfo.comp_info[0].h_samp_factor = 2;
+        cinfo.comp_info[0].v_samp_factor = 1;
+        cinfo.comp_info[1].h_samp_factor = 1;
+        cinfo.comp_info[1].v_samp_factor = 1;
+        cinfo.comp_info[2].h_samp_factor = 1;
+        cinfo.comp_info[2].v_samp_factor = 1;
+
+        // lets set_jpeg_threads decode in stripes
+        cinfo.restart_in_rows = 1;
+
+        jpeg_start_compress(&cinfo, TRUE);
+
+        JSAMPROW y_rows[DCTSIZE];
+        JSAMPROW u_rows[DCTSIZE];
+        JSAMPROW v_rows[DCTSIZE];
+        JSAMPARRAY planes[3] = { y_rows, u_rows, v_rows };
+
+        for (u32 r = 0; r < DCTSIZE; r++)
+        {
+            y_rows[r] = rows + r * y_width;
+            u_rows[r] = rows + DCTSIZE * y_width + r * c_width;
+            v_rows[r] = rows + DCTSIZE * (y_width + c_width) + r * c_width;
+        }
+
+        while (cinfo.next_scanline < height)
+        {
+            for (u32 r = 0; r < DCTSIZE; r++)
+            {
+                // the last row and column repeat into the padding
+                auto src_row = cinfo.next_scanline + r < height ? cinfo.next_scanline + r : height - 1;
+                auto src = yuyv + (size_t)src_row * width * 2;
+
+                for (u32 p = 0; p < c_width; p++)
+                {
+                    auto s = src + 4 * (p < n_pairs ? p : n_pairs - 1);
+
+                    y_rows[r][2 * p] = s[0];
+                    y_rows[r][2 * p + 1] = s[2];
+                    u_rows[r][p] = s[1];
+                    v_rows[r][p] = s[3];
+                }
+            }
+
+            jpeg_write_raw_data(&cinfo, planes, DCTSIZE);
+        }
+
+        jpeg_finish_compress(&cinfo);
+
+        u32 size = 0;
+        if (out_bytes <= capacity)
+        {
+            memcpy(dst, out, out_bytes);
+            size = (u32)out_bytes;
+        }
+
+        jpeg_destroy_compress(&cinfo);
+        free(out);
+        uvc_free(rows);
+
+        return size;
+    }
+
+
+    static uvc_error_t mjpeg_convert(frame* in, u8* out, u32 stride, J_COLOR_SPACE color_space, u32 n_threads)
+    {
+        auto decoder = create_jpeg_decoder();
+        if (!decoder)
+        {
+            return UVC_ERROR_NO_MEM;
+        }
+
+        set_jpeg_threads(decoder, n_threads);
+
+        auto res = mjpeg_decode_any(decoder, in, out, stride, color_space);
+
+        destroy_jpeg_decoder(decoder);
+
+        return res;
+    }
+
+
+    error mjpeg2rgba(frame* in, u8* out, u32 n_threads)
     {
         if (!out)
         {
             return UVC_ERROR_NO_MEM;
         }
 
-        return opt::mjpeg_convert(in, out, jpeg_out_format::RGBA8);
+        return opt::mjpeg_convert(in, out, in->width * 4, JCS_EXT_RGBA, n_threads);
     }
 
 
-    error mjpeg2gray(frame* in, u8* out)
+    error mjpeg2gray(frame* in, u8* out, u32 n_threads)
     {
         if (!out)
         {
             return UVC_ERROR_NO_MEM;
         }
 
-        return opt::mjpeg_convert(in, out, jpeg_out_format::GRAY8);
+        return opt::mjpeg_convert(in, out, in->width, JCS_GRAYSCALE, n_threads);
     }
 
 #endif 
@@ -81,6 +81,7 @@ namespace mem_uvc
 #else
 
 
+#include <mutex>
 #include <unordered_map>
 
 
@@ -88,10 +89,15 @@ namespace mem_uvc
 {
     static std::unordered_map<u64, MemoryTag> ptr_tags;
 
+    // the usb event thread and the decode workers allocate too
+    static std::mutex tags_mtx;
+
 
 
     void* malloc(u32 n_elements, u32 element_size, cstr tag)
-    {       
+    {
+        std::lock_guard<std::mutex> lock(tags_mtx);
+
         alloc_count++;
         auto bytes = n_elements * element_size;
         alloc_bytes += bytes;
@@ -105,7 +111,9 @@ namespace mem_uvc
 
 
     void* realloc(void* ptr, u32 n_elements, u32 element_size)
-    {      
+    {
+        std::lock_guard<std::mutex> lock(tags_mtx);
+
         auto& tag = ptr_tags[(u64)ptr];
         auto bytes = tag.bytes;
         auto new_bytes = n_elements * element_size;
@@ -128,6 +136,8 @@ namespace mem_uvc
 
     char* str_dup(cstr str, cstr tag)
     {
+        std::lock_guard<std::mutex> lock(tags_mtx);
+
         alloc_count++;
         char* data = 0;
 
@@ -150,7 +160,9 @@ namespace mem_uvc
 
 
     void free(void* ptr)
-    {        
+    {
+        std::lock_guard<std::mutex> lock(tags_mtx);
+
         alloc_count--;
 
         auto bytes = ptr_tags[(u64)ptr].bytes;
@@ -0,0 +1,38 @@
+#pragma once
+
+#include "../util/types.hpp"
+
+
+/* uvc payload headers */
+
+// the payloads of a recording or a payload source start with one, see uvc::opt::open_replay
+
+namespace camera_usb
+{
+namespace payload
+{
+    // PTS, SCR and SOF, as most cameras send them
+    constexpr u32 HEADER_BYTES = 12;
+
+
+    // pts and scr on the device clock, sof is the usb frame number when it was sent
+    inline void write_header(u8* dst, u32 fid, bool eof, u32 pts, u32 scr, u32 sof = 0)
+    {
+        dst[0] = (u8)HEADER_BYTES;
+
+        // end of header, SCR, PTS, EOF, FID
+        dst[1] = (u8)(0x80 | 0x08 | 0x04 | (eof ? 0x02 : 0) | (fid & 1));
+
+        for (u32 i = 0; i < 4; i++)
+        {
+            dst[2 + i] = (u8)(pts >> (8 * i));
+            dst[6 + i] = (u8)(scr >> (8 * i));
+        }
+
+        sof &= 0x7FF;
+
+        dst[10] = (u8)sof;
+        dst[11] = (u8)(sof >> 8);
+    }
+}
+}